@@ -0,0 +1,228 @@
+/*
+  This file is part of p4est.
+  p4est is a C library to manage a collection (a forest) of multiple
+  connected adaptive quadtrees or octrees in parallel.
+
+  Copyright (C) 2010 The University of Texas System
+  Additional copyright (C) 2011 individual authors
+  Written by Carsten Burstedde, Lucas C. Wilcox, and Tobin Isaac
+
+  p4est is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  p4est is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with p4est; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*/
+
+/*
+ * Usage: p4est_tpoints [-l <LEVEL>] [-m <MAX-POINTS>] [-N <NUM-POINTS>]
+ *
+ * NUM-POINTS clamped nodes are created on every process, first uniformly
+ * distributed over a brick of trees and then clustered around a few
+ * centers, and a forest is built from them with p4est_new_points.  The
+ * number of points grows with the number of processes, so running this
+ * program with increasing process counts measures the weak scaling of the
+ * parallel sample sort and of the forest construction.
+ */
+
+#ifndef P4_TO_P8
+#include <p4est_bits.h>
+#include <p4est_points.h>
+#else
+#include <p8est_bits.h>
+#include <p8est_points.h>
+#endif
+#include <sc_flops.h>
+#include <sc_options.h>
+#include <sc_statistics.h>
+
+/** Number of cluster centers for the clustered point cloud. */
+#define TPOINTS_CLUSTERS 5
+
+typedef enum tpoints_stats
+{
+  TPOINTS_RANDOM,
+  TPOINTS_CLUSTERED,
+  TPOINTS_NUM_STATS
+}
+tpoints_stats_t;
+
+/** Return a random number in [0, 1). */
+static double
+tpoints_random (void)
+{
+  return rand () / (RAND_MAX + 1.);
+}
+
+/** Convert a reference coordinate into a clamped node coordinate. */
+static              p4est_qcoord_t
+tpoints_coordinate (double x)
+{
+  const p4est_qcoord_t mask = ~(P4EST_QUADRANT_LEN (P4EST_QMAXLEVEL) - 1);
+  p4est_qcoord_t      c;
+
+  x = SC_MAX (x, 0.);
+  c = (p4est_qcoord_t) (x * P4EST_ROOT_LEN) & mask;
+  return SC_MIN (c, P4EST_ROOT_LEN - 1);
+}
+
+/** Create random points in the trees of a brick.
+ * \param [in] clustered  If false, the points are uniform.  Otherwise,
+ *                        they are normally distributed around random
+ *                        centers that are the same on all processes.
+ */
+static p4est_quadrant_t *
+tpoints_create (p4est_topidx_t num_trees, size_t num_points, int clustered)
+{
+  int                 i, j;
+  size_t              zz;
+  double              center[TPOINTS_CLUSTERS][P4EST_DIM + 1];
+  double              xyz[P4EST_DIM], g, u;
+  p4est_quadrant_t   *points, *q;
+
+  /* the cluster centers are drawn first with the shared seed */
+  for (i = 0; i < TPOINTS_CLUSTERS; ++i) {
+    for (j = 0; j < P4EST_DIM; ++j) {
+      center[i][j] = tpoints_random ();
+    }
+    center[i][P4EST_DIM] = floor (num_trees * tpoints_random ());
+  }
+
+  points = P4EST_ALLOC_ZERO (p4est_quadrant_t, num_points);
+  for (zz = 0; zz < num_points; ++zz) {
+    q = points + zz;
+    if (!clustered) {
+      for (j = 0; j < P4EST_DIM; ++j) {
+        xyz[j] = tpoints_random ();
+      }
+      q->p.which_tree = (p4est_topidx_t) (num_trees * tpoints_random ());
+    }
+    else {
+      i = rand () % TPOINTS_CLUSTERS;
+      for (j = 0; j < P4EST_DIM; ++j) {
+        /* approximate a normal distribution by a sum of uniforms */
+        for (g = 0., u = 0.; u < 4.; u += 1.) {
+          g += tpoints_random () - .5;
+        }
+        xyz[j] = center[i][j] + .02 * g;
+        xyz[j] = SC_MIN (xyz[j], 1.);
+      }
+      q->p.which_tree = (p4est_topidx_t) center[i][P4EST_DIM];
+    }
+    q->x = tpoints_coordinate (xyz[0]);
+    q->y = tpoints_coordinate (xyz[1]);
+#ifdef P4_TO_P8
+    q->z = tpoints_coordinate (xyz[2]);
+#endif
+    q->level = P4EST_MAXLEVEL;
+    P4EST_ASSERT (p4est_quadrant_is_node (q, 1));
+  }
+  return points;
+}
+
+/** Build a forest from a point cloud and time it. */
+static void
+tpoints_run (sc_MPI_Comm mpicomm, p4est_connectivity_t * conn,
+             int clustered, int maxlevel, p4est_locidx_t max_points,
+             size_t num_points, sc_statinfo_t * stats)
+{
+  int                 mpiret;
+  int                 rank;
+  sc_flopinfo_t       fi, snapshot;
+  p4est_quadrant_t   *points;
+  p4est_t            *p4est;
+
+  mpiret = sc_MPI_Comm_rank (mpicomm, &rank);
+  SC_CHECK_MPI (mpiret);
+
+  /* share the cluster centers and vary the points by process */
+  srand (1);
+  points = tpoints_create (conn->num_trees, 0, clustered);
+  P4EST_FREE (points);
+  srand (2 + rank);
+  points = tpoints_create (conn->num_trees, num_points, clustered);
+
+  mpiret = sc_MPI_Barrier (mpicomm);
+  SC_CHECK_MPI (mpiret);
+  sc_flops_start (&fi);
+  sc_flops_snap (&fi, &snapshot);
+  p4est = p4est_new_points (mpicomm, conn, maxlevel, points,
+                            (p4est_locidx_t) num_points, max_points,
+                            0, NULL, NULL);
+  sc_flops_shot (&fi, &snapshot);
+  sc_stats_set1 (stats, snapshot.iwtime,
+                 clustered ? "Clustered" : "Random");
+  P4EST_GLOBAL_PRODUCTIONF ("%s points created %lld quadrants\n",
+                            clustered ? "Clustered" : "Random",
+                            (long long) p4est->global_num_quadrants);
+
+  p4est_destroy (p4est);
+  P4EST_FREE (points);
+}
+
+int
+main (int argc, char **argv)
+{
+  int                 mpiret;
+  int                 first_argc;
+  int                 maxlevel, max_points;
+  size_t              znum_points;
+  sc_MPI_Comm         mpicomm;
+  sc_options_t       *opt;
+  sc_statinfo_t       stats[TPOINTS_NUM_STATS];
+  p4est_connectivity_t *conn;
+
+  mpiret = sc_MPI_Init (&argc, &argv);
+  SC_CHECK_MPI (mpiret);
+  mpicomm = sc_MPI_COMM_WORLD;
+
+  sc_init (mpicomm, 1, 1, NULL, SC_LP_DEFAULT);
+  p4est_init (NULL, SC_LP_DEFAULT);
+
+  opt = sc_options_new (argv[0]);
+  sc_options_add_int (opt, 'l', "level", &maxlevel, 12,
+                      "Maximum level of the forest");
+  sc_options_add_int (opt, 'm', "max-points", &max_points, 1,
+                      "Maximum number of points per quadrant");
+  sc_options_add_size_t (opt, 'N', "num-points", &znum_points, 10000,
+                         "Number of points per process");
+  first_argc = sc_options_parse (p4est_package_id, SC_LP_ERROR,
+                                 opt, argc, argv);
+  if (first_argc < 0 || first_argc != argc ||
+      maxlevel < 0 || maxlevel > P4EST_QMAXLEVEL || max_points < -1) {
+    sc_options_print_usage (p4est_package_id, SC_LP_ERROR, opt, NULL);
+    sc_abort_collective ("Usage error");
+  }
+  sc_options_print_summary (p4est_package_id, SC_LP_PRODUCTION, opt);
+
+#ifndef P4_TO_P8
+  conn = p4est_connectivity_new_brick (2, 2, 0, 0);
+#else
+  conn = p8est_connectivity_new_brick (2, 2, 2, 0, 0, 0);
+#endif
+  tpoints_run (mpicomm, conn, 0, maxlevel, (p4est_locidx_t) max_points,
+               znum_points, stats + TPOINTS_RANDOM);
+  tpoints_run (mpicomm, conn, 1, maxlevel, (p4est_locidx_t) max_points,
+               znum_points, stats + TPOINTS_CLUSTERED);
+  p4est_connectivity_destroy (conn);
+
+  sc_stats_compute (mpicomm, TPOINTS_NUM_STATS, stats);
+  sc_stats_print (p4est_package_id, SC_LP_STATISTICS,
+                  TPOINTS_NUM_STATS, stats, 1, 1);
+
+  sc_options_destroy (opt);
+  sc_finalize ();
+
+  mpiret = sc_MPI_Finalize ();
+  SC_CHECK_MPI (mpiret);
+
+  return 0;
+}
@@ -0,0 +1,310 @@
+/*
+  This file is part of p4est.
+  p4est is a C library to manage a collection (a forest) of multiple
+  connected adaptive quadtrees or octrees in parallel.
+
+  Copyright (C) 2010 The University of Texas System
+  Additional copyright (C) 2011 individual authors
+  Written by Carsten Burstedde, Lucas C. Wilcox, and Tobin Isaac
+
+  p4est is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  p4est is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with p4est; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*/
+
+/*
+ * Usage: p4est_bits [-n <quadrants>] [-l <maxlevel>] [options]
+ *        Time the quadrant primitives of p4est_bits that are called most
+ *        often: compare, is_ancestor, linear_id, set_morton,
+ *        face_neighbor_extra and transform_face.  Each one runs over an
+ *        array of random quadrants, once in random order and once sorted
+ *        in Morton order, and the average cost per call is printed.
+ *
+ *        On x86 with a GNU compatible compiler the cycles are read from
+ *        the time stamp counter, which ticks at a constant reference rate.
+ *        Otherwise they are computed from the wall clock and --frequency.
+ *        Every process runs the benchmark on its own; rank zero prints.
+ *
+ * Usage: p8est_bits [-n <quadrants>] [-l <maxlevel>] [options]
+ *        The same for the three-dimensional quadrant primitives.
+ */
+
+#ifndef P4_TO_P8
+#include <p4est_bits.h>
+#else
+#include <p8est_bits.h>
+#endif
+#include <sc_options.h>
+
+typedef struct bits_bench
+{
+  size_t              num_quadrants;
+  p4est_quadrant_t   *quads;      /* input quadrants */
+  uint64_t           *ids;        /* their linear ids on their level */
+  int                 num_transforms;     /* faces with a neighbor tree */
+  int                 ftransform[P4EST_FACES][9];
+  p4est_connectivity_t *conn;
+  long long           sink;       /* results that must not be optimized */
+}
+bits_bench_t;
+
+typedef void        (*bits_kernel_t) (bits_bench_t * b);
+
+static double       bits_frequency;
+
+static double
+bits_cycles (void)
+{
+#if defined (__GNUC__) && (defined (__x86_64__) || defined (__i386__))
+  return (double) __builtin_ia32_rdtsc ();
+#else
+  return sc_MPI_Wtime () * bits_frequency * 1.e9;
+#endif
+}
+
+static void
+bits_compare (bits_bench_t * b)
+{
+  size_t              zz;
+  long long           sink = 0;
+
+  for (zz = 1; zz < b->num_quadrants; ++zz) {
+    sink += p4est_quadrant_compare (&b->quads[zz - 1], &b->quads[zz]);
+  }
+  b->sink += sink;
+}
+
+static void
+bits_is_ancestor (bits_bench_t * b)
+{
+  size_t              zz;
+  long long           sink = 0;
+
+  for (zz = 1; zz < b->num_quadrants; ++zz) {
+    sink += p4est_quadrant_is_ancestor (&b->quads[zz - 1], &b->quads[zz]);
+  }
+  b->sink += sink;
+}
+
+static void
+bits_linear_id (bits_bench_t * b)
+{
+  size_t              zz;
+  long long           sink = 0;
+  const p4est_quadrant_t *q;
+
+  for (zz = 0; zz < b->num_quadrants; ++zz) {
+    q = &b->quads[zz];
+    sink += (long long) p4est_quadrant_linear_id (q, (int) q->level);
+  }
+  b->sink += sink;
+}
+
+static void
+bits_set_morton (bits_bench_t * b)
+{
+  size_t              zz;
+  long long           sink = 0;
+  p4est_quadrant_t    r;
+
+  for (zz = 0; zz < b->num_quadrants; ++zz) {
+    p4est_quadrant_set_morton (&r, (int) b->quads[zz].level, b->ids[zz]);
+    sink += r.x;
+  }
+  b->sink += sink;
+}
+
+static void
+bits_face_neighbor_extra (bits_bench_t * b)
+{
+  size_t              zz;
+  int                 nface;
+  long long           sink = 0;
+  p4est_quadrant_t    r;
+
+  for (zz = 0; zz < b->num_quadrants; ++zz) {
+    sink += p4est_quadrant_face_neighbor_extra
+      (&b->quads[zz], 0, (int) (zz % P4EST_FACES), &r, &nface, b->conn);
+    sink += r.x + nface;
+  }
+  b->sink += sink;
+}
+
+static void
+bits_transform_face (bits_bench_t * b)
+{
+  size_t              zz;
+  long long           sink = 0;
+  p4est_quadrant_t    r;
+
+  for (zz = 0; zz < b->num_quadrants; ++zz) {
+    r.level = b->quads[zz].level;
+    p4est_quadrant_transform_face (&b->quads[zz], &r,
+                                   b->ftransform[zz % b->num_transforms]);
+    sink += r.x;
+  }
+  b->sink += sink;
+}
+
+static void
+bits_run (bits_bench_t * b, const char *name, const char *input,
+          bits_kernel_t kernel, int repetitions)
+{
+  int                 r;
+  double              start_cycles, start_time;
+  double              cycles, elapsed, calls;
+
+  /* warm up the caches and the branch predictors */
+  kernel (b);
+
+  start_time = sc_MPI_Wtime ();
+  start_cycles = bits_cycles ();
+  for (r = 0; r < repetitions; ++r) {
+    kernel (b);
+  }
+  cycles = bits_cycles () - start_cycles;
+  elapsed = sc_MPI_Wtime () - start_time;
+
+  calls = (double) repetitions * (double) b->num_quadrants;
+  P4EST_GLOBAL_PRODUCTIONF ("%-36s %-7s %9.2f cycles/op %9.2f ns/op\n",
+                            name, input, cycles / calls,
+                            elapsed / calls * 1.e9);
+}
+
+static void
+bits_shuffle (bits_bench_t * b)
+{
+  size_t              zz, k;
+  p4est_quadrant_t    q;
+
+  for (zz = b->num_quadrants; zz > 1; --zz) {
+    k = (size_t) random () % zz;
+    q = b->quads[zz - 1];
+    b->quads[zz - 1] = b->quads[k];
+    b->quads[k] = q;
+  }
+}
+
+static void
+run_bits (size_t num_quadrants, int maxlevel, int repetitions)
+{
+  const char         *inputs[2] = { "random", "sorted" };
+  int                 i, f, level;
+  uint64_t            id;
+  size_t              zz;
+  sc_array_t          view;
+  bits_bench_t        sb, *b = &sb;
+
+  b->num_quadrants = num_quadrants;
+  b->quads = P4EST_ALLOC (p4est_quadrant_t, num_quadrants);
+  b->ids = P4EST_ALLOC (uint64_t, num_quadrants);
+  b->conn = p4est_connectivity_new_rotwrap ();
+  b->sink = 0;
+  b->num_transforms = 0;
+  for (f = 0; f < P4EST_FACES; ++f) {
+    if (p4est_find_face_transform (b->conn, 0, f,
+                                   b->ftransform[b->num_transforms]) >= 0) {
+      ++b->num_transforms;
+    }
+  }
+  P4EST_ASSERT (b->num_transforms > 0);
+
+  /* random quadrants on random levels */
+  srandom (9212007);
+  for (zz = 0; zz < num_quadrants; ++zz) {
+    level = (int) (random () % (maxlevel + 1));
+    id = ((uint64_t) random () << 31) ^ (uint64_t) random ();
+    id &= ((uint64_t) 1 << (P4EST_DIM * level)) - 1;
+    p4est_quadrant_set_morton (&b->quads[zz], level, id);
+  }
+  sc_array_init_data (&view, b->quads, sizeof (p4est_quadrant_t),
+                      num_quadrants);
+
+  P4EST_GLOBAL_PRODUCTIONF ("Timing %lld quadrants up to level %d, "
+                            "%d repetitions\n", (long long) num_quadrants,
+                            maxlevel, repetitions);
+  for (i = 0; i < 2; ++i) {
+    if (i == 0) {
+      bits_shuffle (b);
+    }
+    else {
+      sc_array_sort (&view, p4est_quadrant_compare);
+    }
+    for (zz = 0; zz < num_quadrants; ++zz) {
+      b->ids[zz] = p4est_quadrant_linear_id (&b->quads[zz],
+                                             (int) b->quads[zz].level);
+    }
+
+    bits_run (b, P4EST_STRING "_quadrant_compare", inputs[i],
+              bits_compare, repetitions);
+    bits_run (b, P4EST_STRING "_quadrant_is_ancestor", inputs[i],
+              bits_is_ancestor, repetitions);
+    bits_run (b, P4EST_STRING "_quadrant_linear_id", inputs[i],
+              bits_linear_id, repetitions);
+    bits_run (b, P4EST_STRING "_quadrant_set_morton", inputs[i],
+              bits_set_morton, repetitions);
+    bits_run (b, P4EST_STRING "_quadrant_face_neighbor_extra", inputs[i],
+              bits_face_neighbor_extra, repetitions);
+    bits_run (b, P4EST_STRING "_quadrant_transform_face", inputs[i],
+              bits_transform_face, repetitions);
+  }
+  P4EST_VERBOSEF ("Checksum of the results %lld\n", b->sink);
+
+  p4est_connectivity_destroy (b->conn);
+  P4EST_FREE (b->ids);
+  P4EST_FREE (b->quads);
+}
+
+int
+main (int argc, char **argv)
+{
+  sc_MPI_Comm         mpicomm;
+  int                 mpiret, retval;
+  int                 num_quadrants, maxlevel, repetitions;
+  sc_options_t       *opt;
+
+  mpiret = sc_MPI_Init (&argc, &argv);
+  SC_CHECK_MPI (mpiret);
+  mpicomm = sc_MPI_COMM_WORLD;
+
+  sc_init (mpicomm, 1, 1, NULL, SC_LP_DEFAULT);
+  p4est_init (NULL, SC_LP_DEFAULT);
+
+  opt = sc_options_new (argv[0]);
+  sc_options_add_int (opt, 'n', "quadrants", &num_quadrants, 1 << 20,
+                      "Number of random quadrants");
+  sc_options_add_int (opt, 'l', "maxlevel", &maxlevel, P4EST_QMAXLEVEL,
+                      "Maximum level of the quadrants");
+  sc_options_add_int (opt, 'R', "repetitions", &repetitions, 10,
+                      "Number of timed passes over the quadrants");
+  sc_options_add_double (opt, 'f', "frequency", &bits_frequency, 1.,
+                         "Clock rate in GHz without a cycle counter");
+  retval = sc_options_parse (p4est_package_id, SC_LP_ERROR, opt, argc, argv);
+  if (retval == -1 || retval < argc || num_quadrants < 2 ||
+      maxlevel < 0 || maxlevel > P4EST_QMAXLEVEL || repetitions <= 0 ||
+      bits_frequency <= 0.) {
+    sc_options_print_usage (p4est_package_id, SC_LP_PRODUCTION, opt, NULL);
+    sc_abort_collective ("Usage error");
+  }
+
+  run_bits ((size_t) num_quadrants, maxlevel, repetitions);
+
+  sc_options_destroy (opt);
+
+  sc_finalize ();
+
+  mpiret = sc_MPI_Finalize ();
+  SC_CHECK_MPI (mpiret);
+
+  return 0;
+}
@@ -0,0 +1,338 @@
+/*
+  This file is part of p4est.
+  p4est is a C library to manage a collection (a forest) of multiple
+  connected adaptive quadtrees or octrees in parallel.
+
+  Copyright (C) 2010 The University of Texas System
+  Additional copyright (C) 2011 individual authors
+  Written by Carsten Burstedde, Lucas C. Wilcox, and Tobin Isaac
+
+  p4est is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  p4est is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with p4est; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*/
+
+
+/*
+ * Compare the ghost layer of the Morton ordered forest with the one that
+ * would result from cutting the same leaves along the Hilbert curve.
+ *
+ * The Morton ghost layer and the time of a ghost exchange are measured
+ * on the distributed forest.  For the comparison, the same forest is
+ * created serially on rank zero and cut into equally sized parts, once in
+ * Morton and once in Hilbert order within each tree.  The number of
+ * ghosts is counted through face and corner neighbors of the mesh; edge
+ * neighbors in 3D are not included in this model.
+ */
+
+#ifndef P4_TO_P8
+#include <p4est_bits.h>
+#include <p4est_extended.h>
+#include <p4est_ghost.h>
+#include <p4est_mesh.h>
+#else
+#include <p8est_bits.h>
+#include <p8est_extended.h>
+#include <p8est_ghost.h>
+#include <p8est_mesh.h>
+#endif
+#include <sc_options.h>
+
+static int          refine_level;
+
+static int
+refine_fractal (p4est_t * p4est, p4est_topidx_t which_tree,
+                p4est_quadrant_t * q)
+{
+  int                 qid;
+
+  if ((int) q->level >= refine_level) {
+    return 0;
+  }
+
+  qid = ((int) q->level == 0 ?
+         (which_tree % P4EST_CHILDREN) : p4est_quadrant_child_id (q));
+
+  return (qid == 0 || qid == 3
+#ifdef P4_TO_P8
+          || qid == 5 || qid == 6
+#endif
+    );
+}
+
+static p4est_t     *
+hilbert_forest (sc_MPI_Comm mpicomm, p4est_connectivity_t * conn,
+                int level, int refine, size_t data_size)
+{
+  p4est_t            *p4est;
+
+  p4est = p4est_new_ext (mpicomm, conn, 0, level, 1, data_size, NULL, NULL);
+  refine_level = level + refine;
+  p4est_refine (p4est, 1, refine_fractal, NULL);
+  p4est_partition (p4est, 0, NULL);
+  p4est_balance (p4est, P4EST_CONNECT_FULL, NULL);
+  p4est_partition (p4est, 0, NULL);
+
+  return p4est;
+}
+
+static int
+hilbert_compare_piggy (const void *v1, const void *v2)
+{
+  const p4est_quadrant_t *q1 = (const p4est_quadrant_t *) v1;
+  const p4est_quadrant_t *q2 = (const p4est_quadrant_t *) v2;
+
+  if (q1->p.piggy3.which_tree != q2->p.piggy3.which_tree) {
+    return q1->p.piggy3.which_tree < q2->p.piggy3.which_tree ? -1 : 1;
+  }
+  return p4est_quadrant_compare_hilbert (q1, q2);
+}
+
+/** Count a neighbor as ghost of a part unless it has been counted before.
+ * Since the parts are traversed one after the other, remembering the last
+ * part a neighbor was counted for is sufficient.
+ */
+static void
+hilbert_count_neighbor (const int *part, int *mark, int p, p4est_locidx_t nl,
+                        long long *count)
+{
+  if (part[nl] != p && mark[nl] != p) {
+    mark[nl] = p;
+    ++*count;
+  }
+}
+
+/** Count the ghosts of all parts when cutting the leaves in a given order.
+ * \param [in] order    Local quadrant numbers in the order of the curve.
+ */
+static long long
+hilbert_count_ghosts (p4est_mesh_t * mesh, const p4est_locidx_t * order,
+                      int num_parts)
+{
+  const p4est_locidx_t lq = mesh->local_num_quadrants;
+  int                 f, c, h, p;
+  int                *part, *mark;
+  long long           count;
+  p4est_locidx_t      jl, il, v, cstart, cend;
+  p4est_locidx_t     *halfs;
+
+  part = P4EST_ALLOC (int, lq);
+  mark = P4EST_ALLOC (int, lq);
+  for (jl = 0; jl < lq; ++jl) {
+    part[order[jl]] = (int) (((long long) jl * num_parts) / lq);
+    mark[jl] = -1;
+  }
+
+  count = 0;
+  for (jl = 0; jl < lq; ++jl) {
+    il = order[jl];
+    p = part[il];
+
+    /* face neighbors */
+    for (f = 0; f < P4EST_FACES; ++f) {
+      v = mesh->quad_to_quad[P4EST_FACES * il + f];
+      if (mesh->quad_to_face[P4EST_FACES * il + f] >= 0) {
+        hilbert_count_neighbor (part, mark, p, v, &count);
+      }
+      else {
+        halfs = (p4est_locidx_t *) sc_array_index (mesh->quad_to_half, v);
+        for (h = 0; h < P4EST_HALF; ++h) {
+          hilbert_count_neighbor (part, mark, p, halfs[h], &count);
+        }
+      }
+    }
+
+    /* corner neighbors */
+    for (c = 0; c < P4EST_CHILDREN; ++c) {
+      v = mesh->quad_to_corner[P4EST_CHILDREN * il + c];
+      if (v < 0) {
+        continue;
+      }
+      if (v < lq) {
+        hilbert_count_neighbor (part, mark, p, v, &count);
+        continue;
+      }
+      v -= lq + mesh->ghost_num_quadrants;
+      cstart = *(p4est_locidx_t *) sc_array_index (mesh->corner_offset, v);
+      cend = *(p4est_locidx_t *) sc_array_index (mesh->corner_offset, v + 1);
+      for (; cstart < cend; ++cstart) {
+        hilbert_count_neighbor (part, mark, p, *(p4est_locidx_t *)
+                                sc_array_index (mesh->corner_quad, cstart),
+                                &count);
+      }
+    }
+  }
+
+  P4EST_FREE (part);
+  P4EST_FREE (mark);
+
+  return count;
+}
+
+static void
+hilbert_model (p4est_connectivity_t * conn, int level, int refine,
+               int num_parts)
+{
+  long long           morton_count, hilbert_count;
+  size_t              zz;
+  p4est_topidx_t      jt;
+  p4est_locidx_t      jl, lq;
+  p4est_locidx_t     *order;
+  p4est_t            *p4est;
+  p4est_ghost_t      *ghost;
+  p4est_mesh_t       *mesh;
+  p4est_tree_t       *tree;
+  p4est_quadrant_t   *q;
+  sc_array_t          leaves;
+
+  p4est = hilbert_forest (sc_MPI_COMM_SELF, conn, level, refine, 0);
+  ghost = p4est_ghost_new (p4est, P4EST_CONNECT_FULL);
+  mesh = p4est_mesh_new (p4est, ghost, P4EST_CONNECT_FULL);
+  lq = p4est->local_num_quadrants;
+  order = P4EST_ALLOC (p4est_locidx_t, lq);
+
+  /* Morton order is the storage order of the forest */
+  for (jl = 0; jl < lq; ++jl) {
+    order[jl] = jl;
+  }
+  morton_count = hilbert_count_ghosts (mesh, order, num_parts);
+
+  /* sort the leaves of every tree along the Hilbert curve */
+  sc_array_init (&leaves, sizeof (p4est_quadrant_t));
+  for (jt = p4est->first_local_tree; jt <= p4est->last_local_tree; ++jt) {
+    tree = p4est_tree_array_index (p4est->trees, jt);
+    for (zz = 0; zz < tree->quadrants.elem_count; ++zz) {
+      q = p4est_quadrant_array_push (&leaves);
+      *q = *p4est_quadrant_array_index (&tree->quadrants, zz);
+      q->p.piggy3.which_tree = jt;
+      q->p.piggy3.local_num = tree->quadrants_offset + (p4est_locidx_t) zz;
+    }
+  }
+  sc_array_sort (&leaves, hilbert_compare_piggy);
+  for (jl = 0; jl < lq; ++jl) {
+    order[jl] = p4est_quadrant_array_index (&leaves, jl)->p.piggy3.local_num;
+  }
+  sc_array_reset (&leaves);
+  hilbert_count = hilbert_count_ghosts (mesh, order, num_parts);
+
+  P4EST_PRODUCTIONF ("Model with %d parts of %lld quadrants: "
+                     "Morton ghosts %lld Hilbert ghosts %lld\n",
+                     num_parts, (long long) lq, morton_count, hilbert_count);
+
+  P4EST_FREE (order);
+  p4est_mesh_destroy (mesh);
+  p4est_ghost_destroy (ghost);
+  p4est_destroy (p4est);
+}
+
+static void
+run_hilbert (sc_MPI_Comm mpicomm, int level, int refine, int num_parts,
+             int repetitions)
+{
+  const size_t        data_size = 4 * sizeof (double);
+  int                 mpiret, mpirank, r;
+  long long           local_ghosts, global_ghosts;
+  double              elapsed_exchange;
+  void               *ghost_data;
+  p4est_connectivity_t *conn;
+  p4est_t            *p4est;
+  p4est_ghost_t      *ghost;
+
+  mpiret = sc_MPI_Comm_rank (mpicomm, &mpirank);
+  SC_CHECK_MPI (mpiret);
+
+#ifndef P4_TO_P8
+  conn = p4est_connectivity_new_brick (2, 2, 0, 0);
+#else
+  conn = p8est_connectivity_new_brick (2, 2, 2, 0, 0, 0);
+#endif
+
+  /* measure the Morton ordered forest in parallel */
+  p4est = hilbert_forest (mpicomm, conn, level, refine, data_size);
+  ghost = p4est_ghost_new (p4est, P4EST_CONNECT_FULL);
+  local_ghosts = (long long) ghost->ghosts.elem_count;
+  mpiret = sc_MPI_Allreduce (&local_ghosts, &global_ghosts, 1,
+                             sc_MPI_LONG_LONG_INT, sc_MPI_SUM, mpicomm);
+  SC_CHECK_MPI (mpiret);
+
+  ghost_data = P4EST_ALLOC (char, data_size * ghost->ghosts.elem_count);
+  mpiret = sc_MPI_Barrier (mpicomm);
+  SC_CHECK_MPI (mpiret);
+  elapsed_exchange = -sc_MPI_Wtime ();
+  for (r = 0; r < repetitions; ++r) {
+    p4est_ghost_exchange_data (p4est, ghost, ghost_data);
+  }
+  elapsed_exchange += sc_MPI_Wtime ();
+  P4EST_FREE (ghost_data);
+
+  P4EST_GLOBAL_PRODUCTIONF ("Forest of %lld quadrants: Morton ghosts %lld "
+                            "exchange %g\n",
+                            (long long) p4est->global_num_quadrants,
+                            global_ghosts,
+                            elapsed_exchange / SC_MAX (repetitions, 1));
+
+  p4est_ghost_destroy (ghost);
+  p4est_destroy (p4est);
+
+  /* compare Morton and Hilbert cuts of the same forest */
+  if (mpirank == 0) {
+    hilbert_model (conn, level, refine, num_parts);
+  }
+
+  p4est_connectivity_destroy (conn);
+}
+
+int
+main (int argc, char **argv)
+{
+  sc_MPI_Comm         mpicomm;
+  int                 mpiret, retval;
+  int                 mpisize;
+  int                 level, refine, num_parts, repetitions;
+  sc_options_t       *opt;
+
+  mpiret = sc_MPI_Init (&argc, &argv);
+  SC_CHECK_MPI (mpiret);
+  mpicomm = sc_MPI_COMM_WORLD;
+  mpiret = sc_MPI_Comm_size (mpicomm, &mpisize);
+  SC_CHECK_MPI (mpiret);
+
+  sc_init (mpicomm, 1, 1, NULL, SC_LP_DEFAULT);
+  p4est_init (NULL, SC_LP_DEFAULT);
+
+  opt = sc_options_new (argv[0]);
+  sc_options_add_int (opt, 'l', "level", &level, 3,
+                      "Upfront refinement level");
+  sc_options_add_int (opt, 'r', "refine", &refine, 3,
+                      "Levels of fractal refinement");
+  sc_options_add_int (opt, 'P', "parts", &num_parts, mpisize,
+                      "Number of parts in the model");
+  sc_options_add_int (opt, 'R', "repetitions", &repetitions, 10,
+                      "Number of timed ghost exchanges");
+  retval = sc_options_parse (p4est_package_id, SC_LP_ERROR, opt, argc, argv);
+  if (retval == -1 || retval < argc || num_parts <= 0) {
+    sc_options_print_usage (p4est_package_id, SC_LP_PRODUCTION, opt, NULL);
+    sc_abort_collective ("Usage error");
+  }
+
+  run_hilbert (mpicomm, level, refine, num_parts, repetitions);
+
+  sc_options_destroy (opt);
+
+  sc_finalize ();
+
+  mpiret = sc_MPI_Finalize ();
+  SC_CHECK_MPI (mpiret);
+
+  return 0;
+}
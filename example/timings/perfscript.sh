@@ -9,9 +9,11 @@ SPACESTATS=`echo $STATS | sed 's/,/ /g'`
 echo "type level time $SPACESTATS" > p8.perf
 
 for i in 5 6 7 8; do
-  for type in "base" "nodes" "lnodes"; do
+  for type in "base" "nodes" "nodessort" "lnodes"; do
     if [ $type = "nodes" ]; then
       othertype="lnodes"
+    elif [ $type = "nodessort" ]; then
+      othertype="lnodes --nodes-sort"
     elif [ $type = "base" ]; then
       othertype="lnodes --skip-nodes"
     else
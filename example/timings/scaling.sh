@@ -0,0 +1,43 @@
+#! /bin/sh
+
+# Run p{4,8}est_scaling for a sequence of process counts.
+# Usage: scaling.sh <program> strong|weak [further options to the program]
+# Each run writes scaling-<mode>-<np>.json into the current directory.
+# If the environment variable BASELINE names a directory that holds a file
+# of the same name, the run is compared against it and the script returns
+# nonzero if any phase has regressed.
+# The environment variables MPIRUN and PROCS override the launcher and the
+# list of process counts.
+
+if test "$#" -lt 2 ; then
+	echo "Usage: $0 <program> strong|weak [options]"
+	exit 1
+fi
+PROGRAM="$1"
+MODE="$2"
+shift
+shift
+
+if test "x$MODE" = "xweak" ; then
+	MODEOPT="--weak"
+elif test "x$MODE" = "xstrong" ; then
+	MODEOPT=
+else
+	echo "Mode must be strong or weak"
+	exit 1
+fi
+
+MPIRUN=${MPIRUN:-"mpirun -np"}
+PROCS=${PROCS:-"1 2 4 8"}
+
+FAILED=0
+for NP in $PROCS ; do
+	JSON="scaling-$MODE-$NP.json"
+	BASEOPT=
+	if test -n "$BASELINE" -a -f "$BASELINE/$JSON" ; then
+		BASEOPT="--baseline $BASELINE/$JSON"
+	fi
+	$MPIRUN $NP $PROGRAM $MODEOPT --json $JSON $BASEOPT "$@" || FAILED=1
+done
+
+exit $FAILED
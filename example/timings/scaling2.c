@@ -0,0 +1,660 @@
+/*
+  This file is part of p4est.
+  p4est is a C library to manage a collection (a forest) of multiple
+  connected adaptive quadtrees or octrees in parallel.
+
+  Copyright (C) 2010 The University of Texas System
+  Additional copyright (C) 2011 individual authors
+  Written by Carsten Burstedde, Lucas C. Wilcox, and Tobin Isaac
+
+  p4est is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  p4est is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with p4est; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*/
+
+/*
+ * Usage: p4est_scaling -w <workload> -l <level> [options]
+ *        Time the core pipeline new, refine, balance, partition, ghost,
+ *        mesh, lnodes, iterate, save and load on a brick of trees.
+ *        possible workloads:
+ *        o uniform   Uniform refinement.
+ *        o fractal   Fractal refinement as in p4est_timings.
+ *        o sphere    Refinement along a spherical shell.
+ *        o front     Refinement along a planar front that is moved
+ *                    through the domain for --steps adaptation cycles.
+ *        o brick     Uniform refinement with one tree per process unless
+ *                    --trees is given.
+ *
+ *        With --weak the number of trees given by --trees is multiplied
+ *        by the number of processes, which keeps the work per process
+ *        fixed.  Without --trees a weak run uses one tree per process for
+ *        every workload.  The results are written as JSON with --json, one
+ *        phase per line, and compared against a file written earlier with
+ *        --baseline.  The program returns nonzero if the baseline has a
+ *        different number of quadrants or if a phase is slower than the
+ *        baseline by more than the --tolerance fraction.
+ *
+ * Usage: p8est_scaling -w <workload> -l <level> [options]
+ *        The same for the three-dimensional forest.
+ */
+
+#ifndef P4_TO_P8
+#include <p4est_bits.h>
+#include <p4est_extended.h>
+#include <p4est_ghost.h>
+#include <p4est_iterate.h>
+#include <p4est_lnodes.h>
+#include <p4est_mesh.h>
+#else
+#include <p8est_bits.h>
+#include <p8est_extended.h>
+#include <p8est_ghost.h>
+#include <p8est_iterate.h>
+#include <p8est_lnodes.h>
+#include <p8est_mesh.h>
+#endif
+#include <sc_flops.h>
+#include <sc_statistics.h>
+#include <sc_options.h>
+
+typedef enum
+{
+  SCALING_WORKLOAD_NULL,
+  SCALING_WORKLOAD_UNIFORM,
+  SCALING_WORKLOAD_FRACTAL,
+  SCALING_WORKLOAD_SPHERE,
+  SCALING_WORKLOAD_FRONT,
+  SCALING_WORKLOAD_BRICK
+}
+scaling_workload_t;
+
+enum
+{
+  SCALING_NEW,
+  SCALING_REFINE,
+  SCALING_BALANCE,
+  SCALING_PARTITION,
+  SCALING_GHOST,
+  SCALING_MESH,
+  SCALING_LNODES,
+  SCALING_ITERATE,
+  SCALING_SAVE,
+  SCALING_LOAD,
+  SCALING_ADAPT,
+  SCALING_NUM_STATS
+};
+
+/* names used in the JSON output and the baseline */
+static const char  *scaling_names[SCALING_NUM_STATS] = {
+  "new", "refine", "balance", "partition", "ghost", "mesh",
+  "lnodes", "iterate", "save", "load", "adapt"
+};
+
+static const char  *workload_names[] = {
+  NULL, "uniform", "fractal", "sphere", "front", "brick"
+};
+
+typedef struct scaling_context
+{
+  scaling_workload_t  workload;
+  int                 level;            /* maximum refinement level */
+  int                 min_level;        /* level of the new forest */
+  double              extent[3];        /* size of the brick */
+  double              radius;           /* of the sphere in [0, 1]^d */
+  double              front;            /* position of the front */
+  double              width;            /* relative width of the front */
+  long                callbacks;        /* counted by iterate */
+}
+scaling_context_t;
+
+/** Compute the bounding box of a quadrant, scaled to the unit square/cube.
+ */
+static void
+scaling_box (p4est_t * p4est, p4est_topidx_t which_tree,
+             p4est_quadrant_t * q, double lower[3], double upper[3])
+{
+  scaling_context_t  *ctx = (scaling_context_t *) p4est->user_pointer;
+  const p4est_qcoord_t h = P4EST_QUADRANT_LEN (q->level);
+  int                 i;
+
+#ifndef P4_TO_P8
+  p4est_qcoord_to_vertex (p4est->connectivity, which_tree,
+                          q->x, q->y, lower);
+  p4est_qcoord_to_vertex (p4est->connectivity, which_tree,
+                          q->x + h, q->y + h, upper);
+#else
+  p8est_qcoord_to_vertex (p4est->connectivity, which_tree,
+                          q->x, q->y, q->z, lower);
+  p8est_qcoord_to_vertex (p4est->connectivity, which_tree,
+                          q->x + h, q->y + h, q->z + h, upper);
+#endif
+  for (i = 0; i < P4EST_DIM; ++i) {
+    lower[i] /= ctx->extent[i];
+    upper[i] /= ctx->extent[i];
+  }
+}
+
+/** Return true if a quadrant intersects the region to be refined.
+ */
+static int
+scaling_is_marked (p4est_t * p4est, p4est_topidx_t which_tree,
+                   p4est_quadrant_t * q)
+{
+  scaling_context_t  *ctx = (scaling_context_t *) p4est->user_pointer;
+  int                 i;
+  double              lower[3], upper[3];
+  double              dmin, dmax, d, sumlow, sumhigh;
+
+  switch (ctx->workload) {
+  case SCALING_WORKLOAD_SPHERE:
+    /* the box meets the sphere if it has points inside and outside */
+    scaling_box (p4est, which_tree, q, lower, upper);
+    dmin = dmax = 0.;
+    for (i = 0; i < P4EST_DIM; ++i) {
+      d = SC_MAX (lower[i] - .5, .5 - upper[i]);
+      dmin += d > 0. ? d * d : 0.;
+      d = SC_MAX (fabs (lower[i] - .5), fabs (upper[i] - .5));
+      dmax += d * d;
+    }
+    return dmin <= ctx->radius * ctx->radius &&
+      ctx->radius * ctx->radius <= dmax;
+  case SCALING_WORKLOAD_FRONT:
+    /* the front is the plane of points whose coordinates average to it */
+    scaling_box (p4est, which_tree, q, lower, upper);
+    sumlow = sumhigh = 0.;
+    for (i = 0; i < P4EST_DIM; ++i) {
+      sumlow += lower[i];
+      sumhigh += upper[i];
+    }
+    return sumlow / P4EST_DIM <= ctx->front + ctx->width &&
+      ctx->front - ctx->width <= sumhigh / P4EST_DIM;
+  default:
+    SC_ABORT_NOT_REACHED ();
+  }
+  return 0;
+}
+
+static int
+scaling_refine (p4est_t * p4est, p4est_topidx_t which_tree,
+                p4est_quadrant_t * q)
+{
+  scaling_context_t  *ctx = (scaling_context_t *) p4est->user_pointer;
+  int                 qid;
+
+  if ((int) q->level >= ctx->level) {
+    return 0;
+  }
+
+  switch (ctx->workload) {
+  case SCALING_WORKLOAD_UNIFORM:
+  case SCALING_WORKLOAD_BRICK:
+    return 1;
+  case SCALING_WORKLOAD_FRACTAL:
+    qid = ((int) q->level == 0 ?
+           (which_tree % P4EST_CHILDREN) : p4est_quadrant_child_id (q));
+    return (qid == 0 || qid == 3
+#ifdef P4_TO_P8
+            || qid == 5 || qid == 6
+#endif
+      );
+  default:
+    return scaling_is_marked (p4est, which_tree, q);
+  }
+}
+
+static int
+scaling_coarsen (p4est_t * p4est, p4est_topidx_t which_tree,
+                 p4est_quadrant_t * quadrants[])
+{
+  scaling_context_t  *ctx = (scaling_context_t *) p4est->user_pointer;
+  int                 i;
+
+  if ((int) quadrants[0]->level <= ctx->min_level) {
+    return 0;
+  }
+  for (i = 0; i < P4EST_CHILDREN; ++i) {
+    if (scaling_is_marked (p4est, which_tree, quadrants[i])) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+static void
+scaling_iter_volume (p4est_iter_volume_info_t * info, void *user_data)
+{
+  ++((scaling_context_t *) user_data)->callbacks;
+}
+
+static void
+scaling_iter_face (p4est_iter_face_info_t * info, void *user_data)
+{
+  ++((scaling_context_t *) user_data)->callbacks;
+}
+
+#ifdef P4_TO_P8
+static void
+scaling_iter_edge (p8est_iter_edge_info_t * info, void *user_data)
+{
+  ++((scaling_context_t *) user_data)->callbacks;
+}
+#endif
+
+static void
+scaling_iter_corner (p4est_iter_corner_info_t * info, void *user_data)
+{
+  ++((scaling_context_t *) user_data)->callbacks;
+}
+
+/** Split a number of trees into the dimensions of a brick of trees,
+ * keeping the brick as close to a square/cube as possible.
+ */
+static void
+scaling_brick_dims (int num_trees, int dims[3])
+{
+  int                 i, j, n, p;
+  int                 factors[32];
+
+  /* the prime factors in ascending order */
+  for (n = 0, p = 2; num_trees > 1; ++p) {
+    while (num_trees % p == 0) {
+      P4EST_ASSERT (n < 32);
+      factors[n++] = p;
+      num_trees /= p;
+    }
+  }
+
+  /* multiply the largest remaining factor into the smallest dimension */
+  dims[0] = dims[1] = dims[2] = 1;
+  while (n > 0) {
+    for (j = 0, i = 1; i < P4EST_DIM; ++i) {
+      if (dims[i] < dims[j]) {
+        j = i;
+      }
+    }
+    dims[j] *= factors[--n];
+  }
+}
+
+/** Write the results as JSON with one phase per line.
+ */
+static void
+scaling_write_json (const char *filename, scaling_context_t * ctx,
+                    p4est_t * p4est, int num_trees, unsigned crc,
+                    sc_statinfo_t * stats)
+{
+  int                 i;
+  FILE               *file;
+
+  file = fopen (filename, "w");
+  if (file == NULL) {
+    P4EST_LERRORF ("Could not open %s for writing\n", filename);
+    return;
+  }
+  fprintf (file, "{\n");
+  fprintf (file, "  \"program\": \"%s\",\n", P4EST_STRING "_scaling");
+  fprintf (file, "  \"workload\": \"%s\",\n",
+           workload_names[ctx->workload]);
+  fprintf (file, "  \"mpisize\": %d,\n", p4est->mpisize);
+  fprintf (file, "  \"level\": %d,\n", ctx->level);
+  fprintf (file, "  \"trees\": %d,\n", num_trees);
+  fprintf (file, "  \"quadrants\": %lld,\n",
+           (long long) p4est->global_num_quadrants);
+  fprintf (file, "  \"checksum\": \"0x%08x\",\n", crc);
+  fprintf (file, "  \"phases\": [\n");
+  for (i = 0; i < SCALING_NUM_STATS; ++i) {
+    fprintf (file, "    {\"name\": \"%s\", \"count\": %ld, \"avg\": %.6e,"
+             " \"min\": %.6e, \"max\": %.6e, \"standev\": %.6e,"
+             " \"min_at_rank\": %d, \"max_at_rank\": %d}%s\n",
+             scaling_names[i], stats[i].count, stats[i].average,
+             stats[i].min, stats[i].max, stats[i].standev,
+             stats[i].min_at_rank, stats[i].max_at_rank,
+             i + 1 < SCALING_NUM_STATS ? "," : "");
+  }
+  fprintf (file, "  ]\n}\n");
+  if (fclose (file)) {
+    P4EST_LERRORF ("Could not close %s\n", filename);
+  }
+}
+
+/** Compare the average time of each phase against a baseline file that
+ * was written by \ref scaling_write_json.
+ * \return          The number of phases that are slower than the baseline
+ *                  by more than the tolerance, or -1 on a read error or if
+ *                  the baseline was run with a different quadrant count.
+ */
+static int
+scaling_compare_baseline (const char *filename, p4est_t * p4est,
+                          sc_statinfo_t * stats, double tolerance,
+                          double min_time)
+{
+  int                 i, num_phases, num_slower;
+  long long           quadrants;
+  long                count;
+  double              avg;
+  char                line[BUFSIZ], name[BUFSIZ];
+  FILE               *file;
+
+  file = fopen (filename, "r");
+  if (file == NULL) {
+    P4EST_LERRORF ("Could not open baseline %s\n", filename);
+    return -1;
+  }
+  num_phases = num_slower = 0;
+  quadrants = -1;
+  while (fgets (line, BUFSIZ, file) != NULL) {
+    if (sscanf (line, " \"quadrants\": %lld", &quadrants) == 1) {
+      if (quadrants != (long long) p4est->global_num_quadrants) {
+        P4EST_LERRORF ("Baseline has %lld quadrants, not %lld\n",
+                       quadrants, (long long) p4est->global_num_quadrants);
+        fclose (file);
+        return -1;
+      }
+      continue;
+    }
+    if (sscanf (line, " {\"name\": \"%[^\"]\", \"count\": %ld,"
+                " \"avg\": %lf", name, &count, &avg) != 3) {
+      continue;
+    }
+    for (i = 0; i < SCALING_NUM_STATS; ++i) {
+      if (!strcmp (name, scaling_names[i])) {
+        break;
+      }
+    }
+    if (i == SCALING_NUM_STATS) {
+      continue;
+    }
+    ++num_phases;
+    if (avg >= min_time && stats[i].average > avg * (1. + tolerance)) {
+      P4EST_LERRORF ("Phase %s regressed from %.3e to %.3e seconds\n",
+                     name, avg, stats[i].average);
+      ++num_slower;
+    }
+    else {
+      P4EST_INFOF ("Phase %s baseline %.3e now %.3e seconds\n",
+                   name, avg, stats[i].average);
+    }
+  }
+  fclose (file);
+  if (num_phases == 0) {
+    P4EST_LERRORF ("No phases found in baseline %s\n", filename);
+    return -1;
+  }
+  return num_slower;
+}
+
+int
+main (int argc, char **argv)
+{
+  int                 mpiret;
+  int                 mpisize, mpirank;
+  int                 first_argc;
+  int                 retval;
+  int                 level_shift;
+  int                 num_trees, weak, steps, degree, skip_save;
+  int                 step;
+  int                 dims[3];
+  unsigned            crc;
+  const char         *workload_name, *json_name, *baseline_name;
+  const char         *save_name;
+  double              tolerance, min_time;
+  sc_MPI_Comm         mpicomm;
+  sc_options_t       *opt;
+  sc_statinfo_t       stats[SCALING_NUM_STATS];
+  sc_flopinfo_t       fi, snapshot;
+  scaling_context_t   context, *ctx = &context;
+  p4est_connectivity_t *connectivity, *conn_loaded;
+  p4est_t            *p4est, *loaded;
+  p4est_ghost_t      *ghost;
+  p4est_mesh_t       *mesh;
+  p4est_lnodes_t     *lnodes;
+
+  /* initialize MPI and p4est internals */
+  mpiret = sc_MPI_Init (&argc, &argv);
+  SC_CHECK_MPI (mpiret);
+  mpicomm = sc_MPI_COMM_WORLD;
+  mpiret = sc_MPI_Comm_size (mpicomm, &mpisize);
+  SC_CHECK_MPI (mpiret);
+  mpiret = sc_MPI_Comm_rank (mpicomm, &mpirank);
+  SC_CHECK_MPI (mpiret);
+
+  sc_init (mpicomm, 1, 1, NULL, SC_LP_DEFAULT);
+  p4est_init (NULL, SC_LP_DEFAULT);
+
+  /* process command line arguments */
+  memset (ctx, 0, sizeof (*ctx));
+  opt = sc_options_new (argv[0]);
+  sc_options_add_string (opt, 'w', "workload", &workload_name, "uniform",
+                         "uniform, fractal, sphere, front, or brick");
+  sc_options_add_int (opt, 'l', "level", &ctx->level, 4,
+                      "maximum refinement level");
+  sc_options_add_int (opt, 's', "shift", &level_shift, 4,
+                      "level difference of the new forest");
+  sc_options_add_int (opt, 't', "trees", &num_trees, 0,
+                      "number of trees in the brick");
+  sc_options_add_switch (opt, 0, "weak", &weak,
+                         "multiply the number of trees by the processes");
+  sc_options_add_double (opt, 0, "radius", &ctx->radius, .3,
+                         "radius of the sphere");
+  sc_options_add_double (opt, 0, "front", &ctx->front, .25,
+                         "initial position of the front");
+  sc_options_add_int (opt, 0, "steps", &steps, 4,
+                      "adaptation cycles of the moving front");
+  sc_options_add_int (opt, 0, "degree", &degree, 1, "degree of lnodes");
+  sc_options_add_switch (opt, 0, "skip-save", &skip_save,
+                         "skip timing save and load");
+  sc_options_add_string (opt, 0, "save-file", &save_name,
+                         P4EST_STRING "_scaling.p4est",
+                         "file to save and load the forest");
+  sc_options_add_string (opt, 'j', "json", &json_name, NULL,
+                         "write the results to this JSON file");
+  sc_options_add_string (opt, 'b', "baseline", &baseline_name, NULL,
+                         "compare against this JSON file");
+  sc_options_add_double (opt, 0, "tolerance", &tolerance, .1,
+                         "allowed relative slowdown against the baseline");
+  sc_options_add_double (opt, 0, "min-time", &min_time, 1e-3,
+                         "ignore baseline phases faster than this");
+
+  first_argc = sc_options_parse (p4est_package_id, SC_LP_DEFAULT,
+                                 opt, argc, argv);
+  if (first_argc < 0 || first_argc != argc) {
+    sc_options_print_usage (p4est_package_id, SC_LP_ERROR, opt, NULL);
+    retval = 1;
+    goto usage_error;
+  }
+  sc_options_print_summary (p4est_package_id, SC_LP_PRODUCTION, opt);
+
+  for (ctx->workload = SCALING_WORKLOAD_UNIFORM;
+       ctx->workload <= SCALING_WORKLOAD_BRICK; ++ctx->workload) {
+    if (!strcmp (workload_name, workload_names[ctx->workload])) {
+      break;
+    }
+  }
+  if (ctx->workload > SCALING_WORKLOAD_BRICK || ctx->level < 0 ||
+      ctx->level > P4EST_QMAXLEVEL || level_shift < 0 || num_trees < 0) {
+    P4EST_GLOBAL_LERRORF ("Wrong workload or level: %s %d\n",
+                          workload_name, ctx->level);
+    sc_options_print_usage (p4est_package_id, SC_LP_ERROR, opt, NULL);
+    retval = 1;
+    goto usage_error;
+  }
+  ctx->min_level = SC_MAX (ctx->level - level_shift, 0);
+  ctx->width = .5 / (1 << ctx->min_level);
+  if (ctx->workload != SCALING_WORKLOAD_FRONT) {
+    steps = 0;
+  }
+
+  /* create the brick connectivity */
+  if (num_trees == 0) {
+    /* the brick workload is weakly scaled by default */
+    num_trees = ctx->workload == SCALING_WORKLOAD_BRICK || weak ? mpisize : 1;
+  }
+  else if (weak) {
+    num_trees *= mpisize;
+  }
+  scaling_brick_dims (num_trees, dims);
+  ctx->extent[0] = dims[0];
+  ctx->extent[1] = dims[1];
+  ctx->extent[2] = dims[2];
+#ifndef P4_TO_P8
+  connectivity = p4est_connectivity_new_brick (dims[0], dims[1], 0, 0);
+#else
+  connectivity = p8est_connectivity_new_brick (dims[0], dims[1], dims[2],
+                                               0, 0, 0);
+#endif
+  P4EST_GLOBAL_STATISTICSF
+    ("Processors %d workload %s level %d trees %d\n", mpisize,
+     workload_names[ctx->workload], ctx->level, num_trees);
+
+  /* start overall timing */
+  mpiret = sc_MPI_Barrier (mpicomm);
+  SC_CHECK_MPI (mpiret);
+  sc_flops_start (&fi);
+
+  /* time creating the forest */
+  sc_flops_snap (&fi, &snapshot);
+  p4est = p4est_new_ext (mpicomm, connectivity, 0, ctx->min_level, 1, 0,
+                         NULL, ctx);
+  sc_flops_shot (&fi, &snapshot);
+  sc_stats_set1 (&stats[SCALING_NEW], snapshot.iwtime, "New");
+
+  /* time refine */
+  sc_flops_snap (&fi, &snapshot);
+  p4est_refine (p4est, 1, scaling_refine, NULL);
+  sc_flops_shot (&fi, &snapshot);
+  sc_stats_set1 (&stats[SCALING_REFINE], snapshot.iwtime, "Refine");
+
+  /* time balance */
+  sc_flops_snap (&fi, &snapshot);
+  p4est_balance (p4est, P4EST_CONNECT_FULL, NULL);
+  sc_flops_shot (&fi, &snapshot);
+  sc_stats_set1 (&stats[SCALING_BALANCE], snapshot.iwtime, "Balance");
+
+  /* time partition */
+  sc_flops_snap (&fi, &snapshot);
+  p4est_partition (p4est, 0, NULL);
+  sc_flops_shot (&fi, &snapshot);
+  sc_stats_set1 (&stats[SCALING_PARTITION], snapshot.iwtime, "Partition");
+  crc = p4est_checksum (p4est);
+
+  /* time the ghost layer */
+  sc_flops_snap (&fi, &snapshot);
+  ghost = p4est_ghost_new (p4est, P4EST_CONNECT_FULL);
+  sc_flops_shot (&fi, &snapshot);
+  sc_stats_set1 (&stats[SCALING_GHOST], snapshot.iwtime, "Ghost layer");
+
+  /* time the mesh */
+  sc_flops_snap (&fi, &snapshot);
+  mesh = p4est_mesh_new (p4est, ghost, P4EST_CONNECT_FULL);
+  sc_flops_shot (&fi, &snapshot);
+  sc_stats_set1 (&stats[SCALING_MESH], snapshot.iwtime, "Mesh");
+  p4est_mesh_destroy (mesh);
+
+  /* time the lnodes */
+  sc_flops_snap (&fi, &snapshot);
+  lnodes = p4est_lnodes_new (p4est, ghost, degree);
+  sc_flops_shot (&fi, &snapshot);
+  sc_stats_set1 (&stats[SCALING_LNODES], snapshot.iwtime, "L-Nodes");
+  p4est_lnodes_destroy (lnodes);
+
+  /* time iterate with trivial callbacks */
+  sc_flops_snap (&fi, &snapshot);
+#ifndef P4_TO_P8
+  p4est_iterate (p4est, ghost, ctx, scaling_iter_volume, scaling_iter_face,
+                 scaling_iter_corner);
+#else
+  p8est_iterate (p4est, ghost, ctx, scaling_iter_volume, scaling_iter_face,
+                 scaling_iter_edge, scaling_iter_corner);
+#endif
+  sc_flops_shot (&fi, &snapshot);
+  sc_stats_set1 (&stats[SCALING_ITERATE], snapshot.iwtime, "Iterate");
+  P4EST_VERBOSEF ("Iterate callbacks %ld\n", ctx->callbacks);
+  p4est_ghost_destroy (ghost);
+
+  /* time save and load */
+  if (!skip_save) {
+    sc_flops_snap (&fi, &snapshot);
+    p4est_save (save_name, p4est, 0);
+    sc_flops_shot (&fi, &snapshot);
+    sc_stats_set1 (&stats[SCALING_SAVE], snapshot.iwtime, "Save");
+
+    sc_flops_snap (&fi, &snapshot);
+    loaded = p4est_load (save_name, mpicomm, 0, 0, NULL, &conn_loaded);
+    sc_flops_shot (&fi, &snapshot);
+    sc_stats_set1 (&stats[SCALING_LOAD], snapshot.iwtime, "Load");
+    P4EST_ASSERT (p4est_checksum (loaded) == crc);
+    p4est_destroy (loaded);
+    p4est_connectivity_destroy (conn_loaded);
+    if (mpirank == 0) {
+      remove (save_name);
+    }
+  }
+  else {
+    sc_stats_set1 (&stats[SCALING_SAVE], 0., "Save");
+    sc_stats_set1 (&stats[SCALING_LOAD], 0., "Load");
+  }
+
+  /* time the adaptation cycles of the moving front */
+  sc_flops_snap (&fi, &snapshot);
+  for (step = 0; step < steps; ++step) {
+    ctx->front += .5 / steps;
+    p4est_coarsen (p4est, 1, scaling_coarsen, NULL);
+    p4est_refine (p4est, 1, scaling_refine, NULL);
+    p4est_balance (p4est, P4EST_CONNECT_FULL, NULL);
+    p4est_partition (p4est, 0, NULL);
+  }
+  sc_flops_shot (&fi, &snapshot);
+  sc_stats_set1 (&stats[SCALING_ADAPT], snapshot.iwtime, "Adapt");
+
+  /* print status and checksum */
+  P4EST_GLOBAL_STATISTICSF ("Processors %d level %d quadrants %lld"
+                            " checksum 0x%08x\n", mpisize, ctx->level,
+                            (long long) p4est->global_num_quadrants, crc);
+
+  /* calculate and print timings */
+  sc_stats_compute (mpicomm, SCALING_NUM_STATS, stats);
+  sc_stats_print (p4est_package_id, SC_LP_STATISTICS,
+                  SCALING_NUM_STATS, stats, 1, 1);
+
+  /* write and compare the machine-readable results on rank zero */
+  retval = 0;
+  if (mpirank == 0) {
+    if (json_name != NULL) {
+      scaling_write_json (json_name, ctx, p4est, num_trees, crc, stats);
+    }
+    if (baseline_name != NULL) {
+      retval = scaling_compare_baseline (baseline_name, p4est, stats,
+                                         tolerance, min_time) != 0;
+    }
+  }
+  mpiret = sc_MPI_Bcast (&retval, 1, sc_MPI_INT, 0, mpicomm);
+  SC_CHECK_MPI (mpiret);
+  if (retval) {
+    P4EST_GLOBAL_PRODUCTION ("Baseline comparison failed\n");
+  }
+
+  /* destroy the p4est and its connectivity structure */
+  p4est_destroy (p4est);
+  p4est_connectivity_destroy (connectivity);
+
+usage_error:
+  sc_options_destroy (opt);
+
+  /* clean up and exit */
+  sc_finalize ();
+
+  mpiret = sc_MPI_Finalize ();
+  SC_CHECK_MPI (mpiret);
+
+  return retval;
+}
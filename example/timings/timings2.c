@@ -58,6 +58,7 @@
 #include <p8est_vtk.h>
 #include <p8est_lnodes.h>
 #endif
+#include <p4est_trace.h>
 #include <sc_flops.h>
 #include <sc_statistics.h>
 #include <sc_options.h>
@@ -120,6 +121,7 @@ enum
   TIMINGS_LNODES,
   TIMINGS_LNODES3,
   TIMINGS_LNODES7,
+  TIMINGS_LNODES_DEGREE,
   TIMINGS_NUM_STATS
 };
 
@@ -237,6 +239,7 @@ main (int argc, char **argv)
   unsigned            crc, gcrc;
   const char         *config_name;
   const char         *load_name;
+  const char         *trace_name;
   p4est_locidx_t     *quadrant_counts;
   p4est_gloidx_t      count_refined, count_balanced;
   p4est_gloidx_t      prev_quadrant, next_quadrant;
@@ -257,11 +260,16 @@ main (int argc, char **argv)
   int                 borders;
   int                 max_ranges;
   int                 use_ranges, use_ranges_notify, use_balance_verify;
+  int                 use_balance_neighbor;
+  int                 refine_balance;
   int                 oldschool, generate;
   int                 first_argc;
   int                 test_multiple_orders;
-  int                 skip_nodes, skip_lnodes;
+  int                 skip_nodes, skip_lnodes, nodes_sort;
+  int                 nodes_threads, balance_threads, lnodes_threads;
   int                 repartition_lnodes;
+  int                 lnodes_degree;
+  int                 trace_capacity;
 
   /* initialize MPI and p4est internals */
   mpiret = sc_MPI_Init (&argc, &argv);
@@ -298,6 +306,10 @@ main (int argc, char **argv)
                          "use both ranges and notify");
   sc_options_add_switch (opt, 'y', "balance-verify", &use_balance_verify,
                          "use verifications in balance");
+  sc_options_add_switch (opt, 0, "balance-neighbor", &use_balance_neighbor,
+                         "use neighborhood collectives in balance");
+  sc_options_add_switch (opt, 0, "refine-balance", &refine_balance,
+                         "balance during refine; the balance time is zero");
   sc_options_add_int (opt, 'l', "level", &refine_level, 0,
                       "initial refine level");
 #ifndef P4_TO_P8
@@ -318,9 +330,23 @@ main (int argc, char **argv)
                          "Also time lnodes for orders 2, 4, and 8");
   sc_options_add_switch (opt, 0, "skip-nodes", &skip_nodes, "Skip nodes");
   sc_options_add_switch (opt, 0, "skip-lnodes", &skip_lnodes, "Skip lnodes");
+  sc_options_add_switch (opt, 0, "nodes-sort", &nodes_sort,
+                         "Deduplicate nodes by sorting instead of hashing");
+  sc_options_add_int (opt, 0, "nodes-threads", &nodes_threads, 0,
+                      "Threads for sorted nodes (0 means all)");
+  sc_options_add_int (opt, 0, "balance-threads", &balance_threads, 1,
+                      "Threads for the local balance");
   sc_options_add_switch (opt, 0, "repartition-lnodes",
                          &repartition_lnodes,
                          "Repartition to load-balance lnodes");
+  sc_options_add_int (opt, 0, "lnodes-degree", &lnodes_degree, 0,
+                      "Also time lnodes for this order if positive");
+  sc_options_add_int (opt, 0, "lnodes-threads", &lnodes_threads, 0,
+                      "Threads for lnodes (0 means all)");
+  sc_options_add_string (opt, 0, "trace", &trace_name, NULL,
+                         "Write a Chrome trace of phases and messages");
+  sc_options_add_int (opt, 0, "trace-capacity", &trace_capacity, 1 << 16,
+                      "Number of trace events kept per process");
 
   first_argc = sc_options_parse (p4est_package_id, SC_LP_DEFAULT,
                                  opt, argc, argv);
@@ -332,6 +358,10 @@ main (int argc, char **argv)
     P4EST_GLOBAL_LERROR ("The -m / --max-ranges option must be positive\n");
     return 1;
   }
+  if (trace_capacity <= 0) {
+    P4EST_GLOBAL_LERROR ("The --trace-capacity option must be positive\n");
+    return 1;
+  }
   sc_options_print_summary (p4est_package_id, SC_LP_PRODUCTION, opt);
 
   if (skip_lnodes) {
@@ -340,6 +370,7 @@ main (int argc, char **argv)
         ("Warning: cannot test multiple lnode orders if --skip-lnodes is given.\n");
       test_multiple_orders = 0;
     }
+    lnodes_degree = 0;
   }
   wrongusage = 0;
   config = P4EST_CONFIG_NULL;
@@ -395,6 +426,9 @@ main (int argc, char **argv)
      config_name, refine_level, level_shift);
 
   /* start overall timing */
+  if (trace_name != NULL) {
+    p4est_trace_start (mpi->mpicomm, (size_t) trace_capacity);
+  }
   mpiret = sc_MPI_Barrier (mpi->mpicomm);
   SC_CHECK_MPI (mpiret);
   sc_flops_start (&fi);
@@ -504,7 +538,12 @@ main (int argc, char **argv)
   p4est->inspect->use_balance_ranges = use_ranges;
   p4est->inspect->use_balance_ranges_notify = use_ranges_notify;
   p4est->inspect->use_balance_verify = use_balance_verify;
+  p4est->inspect->use_balance_neighbor = use_balance_neighbor;
   p4est->inspect->balance_max_ranges = max_ranges;
+  p4est->inspect->use_nodes_sort = nodes_sort;
+  p4est->inspect->nodes_num_threads = nodes_threads;
+  p4est->inspect->balance_num_threads = balance_threads;
+  p4est->inspect->lnodes_num_threads = lnodes_threads;
   P4EST_GLOBAL_STATISTICSF
     ("Balance: new overlap %d new subtree %d borders %d\n", overlap,
      (overlap && subtree), (overlap && borders));
@@ -512,7 +551,13 @@ main (int argc, char **argv)
 
   /* time refine */
   sc_flops_snap (&fi, &snapshot);
-  p4est_refine (p4est, 1, refine_fractal, NULL);
+  if (refine_balance) {
+    p4est_refine_balance_ext (p4est, 1, -1, refine_fractal,
+                              P4EST_CONNECT_FULL, NULL, NULL);
+  }
+  else {
+    p4est_refine (p4est, 1, refine_fractal, NULL);
+  }
   sc_flops_shot (&fi, &snapshot);
   sc_stats_set1 (&stats[TIMINGS_REFINE], snapshot.iwtime, "Refine");
 #ifdef P4EST_TIMINGS_VTK
@@ -522,7 +567,9 @@ main (int argc, char **argv)
 
   /* time balance */
   sc_flops_snap (&fi, &snapshot);
-  p4est_balance (p4est, P4EST_CONNECT_FULL, NULL);
+  if (!refine_balance) {
+    p4est_balance (p4est, P4EST_CONNECT_FULL, NULL);
+  }
   sc_flops_shot (&fi, &snapshot);
   sc_stats_set1 (&stats[TIMINGS_BALANCE], snapshot.iwtime, "Balance");
   sc_stats_set1 (&stats[TIMINGS_BALANCE_A],
@@ -687,6 +734,23 @@ main (int argc, char **argv)
     sc_stats_set1 (&stats[TIMINGS_LNODES7], 0., "L-Nodes 7");
   }
 
+  if (lnodes_degree > 0) {
+    if (repartition_lnodes) {
+      p4est_partition_lnodes (p4est, ghost, lnodes_degree, 0);
+      p4est_ghost_destroy (ghost);
+      ghost = p4est_ghost_new (p4est, P4EST_CONNECT_FULL);
+    }
+    sc_flops_snap (&fi, &snapshot);
+    lnodes = p4est_lnodes_new (p4est, ghost, lnodes_degree);
+    sc_flops_shot (&fi, &snapshot);
+    sc_stats_set1 (&stats[TIMINGS_LNODES_DEGREE], snapshot.iwtime,
+                   "L-Nodes degree");
+    p4est_lnodes_destroy (lnodes);
+  }
+  else {
+    sc_stats_set1 (&stats[TIMINGS_LNODES_DEGREE], 0., "L-Nodes degree");
+  }
+
   p4est_ghost_destroy (ghost);
 
   /* time a partition with a shift of all elements by one processor */
@@ -737,6 +801,12 @@ main (int argc, char **argv)
   sc_stats_print (p4est_package_id, SC_LP_STATISTICS,
                   TIMINGS_NUM_STATS, stats, 1, 1);
 
+  /* print the counters recorded by the forest itself */
+  p4est_stats_print (p4est, SC_LP_STATISTICS);
+  if (trace_name != NULL) {
+    p4est_trace_stop (trace_name);
+  }
+
   /* destroy the p4est and its connectivity structure */
   P4EST_FREE (quadrant_counts);
   P4EST_FREE (p4est->inspect);
@@ -58,6 +58,8 @@ typedef enum tsearch_stats
   TSEARCH_PARTITION,
   TSEARCH_SEARCH_1,
   TSEARCH_SEARCH_N,
+  TSEARCH_SEARCH_B,
+  TSEARCH_SEARCH_T,
   TSEARCH_NUM_STATS
 }
 tsearch_stats_t;
@@ -78,6 +80,7 @@ typedef struct
   sc_array_t         *points;
   int                 test_rays;
   int                 skip_1;
+  int                 num_threads;
 
   /* data for the currently active quadrant */
   p4est_locidx_t      which_tree;
@@ -497,15 +500,61 @@ tsearch_setup (tsearch_global_t * tsg)
   }
 }
 
+/* check a point against the quadrant set up in tsg */
+static int
+time_search_point (tsearch_global_t * tsg, p4est_quadrant_t * q,
+                   p4est_locidx_t local_num, tsearch_point_t * t)
+{
+  int                 j;
+  double              width, r2;
+  double              ref[P4EST_DIM];
+  const double       *qref;
+
+  /* root level check to see if the point is contained in the shell */
+  if (q->level == 0) {
+    r2 = t->xy[0] * t->xy[0] + t->xy[1] * t->xy[1] + t->xy[2] * t->xy[2];
+    if (r2 >= tsg->rout2 || r2 <= tsg->rin2) {
+      return 0;
+    }
+  }
+
+  if (!tsg->is_leaf) {
+    /* perform over-optimistic check with the quadrant's bounding sphere */
+    r2 = 0.;
+    for (j = 0; j < P4EST_DIM; ++j) {
+      r2 += (t->xy[j] - tsg->center[j]) * (t->xy[j] - tsg->center[j]);
+    }
+    return r2 < (1. + 1e-12) * tsg->radius2;
+  }
+  else {
+    /* perform strict check by inverse coordinate transformation */
+    if (physical_to_reference (tsg, t->xy, ref)) {
+      /* the point is contained in the correct tree, now check quadrant */
+      width = tsg->width;
+      qref = tsg->qref;
+      for (j = 0; j < P4EST_DIM; ++j) {
+        if (ref[j] < qref[j] || ref[j] > qref[j] + width) {
+          return 0;
+        }
+      }
+
+      /* we have found a matching quadrant for this point */
+      ++tsg->matches;
+      t->lid = local_num;
+      return 1;
+    }
+
+    /* the return value is irrelevant for leaves */
+    return 0;
+  }
+}
+
 static int
 time_search_fn (p4est_t * p4est, p4est_topidx_t which_tree,
                 p4est_quadrant_t * q, p4est_locidx_t local_num, void *point)
 {
   tsearch_global_t   *tsg = (tsearch_global_t *) p4est->user_pointer;
   int                 i, j;
-  double              width, r2;
-  double              ref[P4EST_DIM];
-  const double       *qref;
 
   if (point == NULL) {
     /* per-quadrant setup function */
@@ -519,45 +568,7 @@ time_search_fn (p4est_t * p4est, p4est_topidx_t which_tree,
   P4EST_ASSERT (tsg->is_leaf == (local_num >= 0));
 
   if (!tsg->test_rays) {
-    tsearch_point_t    *t = (tsearch_point_t *) point;
-
-    /* root level check to see if the point is contained in the shell */
-    if (q->level == 0) {
-      r2 = t->xy[0] * t->xy[0] + t->xy[1] * t->xy[1] + t->xy[2] * t->xy[2];
-      if (r2 >= tsg->rout2 || r2 <= tsg->rin2) {
-        return 0;
-      }
-    }
-
-    if (!tsg->is_leaf) {
-      /* perform over-optimistic check with the quadrant's bounding sphere */
-      r2 = 0.;
-      for (j = 0; j < P4EST_DIM; ++j) {
-        r2 += (t->xy[j] - tsg->center[j]) * (t->xy[j] - tsg->center[j]);
-      }
-      return r2 < (1. + 1e-12) * tsg->radius2;
-    }
-    else {
-      /* perform strict check by inverse coordinate transformation */
-      if (physical_to_reference (tsg, t->xy, ref)) {
-        /* the point is contained in the correct tree, now check quadrant */
-        width = tsg->width;
-        qref = tsg->qref;
-        for (j = 0; j < P4EST_DIM; ++j) {
-          if (ref[j] < qref[j] || ref[j] > qref[j] + width) {
-            return 0;
-          }
-        }
-
-        /* we have found a matching quadrant for this point */
-        ++tsg->matches;
-        t->lid = local_num;
-        return 1;
-      }
-
-      /* the return value is irrelevant for leaves */
-      return 0;
-    }
+    return time_search_point (tsg, q, local_num, (tsearch_point_t *) point);
   }
   else {
     ts_ray_t           *ray = (ts_ray_t *) point;
@@ -641,6 +652,60 @@ time_search_fn (p4est_t * p4est, p4est_topidx_t which_tree,
   }
 }
 
+static void
+time_search_batch_fn (p4est_t * p4est, p4est_topidx_t which_tree,
+                      p4est_quadrant_t * q, p4est_locidx_t local_num,
+                      sc_array_t * points, const size_t * actives,
+                      size_t num_actives, int *matches)
+{
+  tsearch_global_t   *tsg = (tsearch_global_t *) p4est->user_pointer;
+  int                 j;
+  size_t              zz;
+  double              r2, d;
+  const tsearch_point_t *t;
+
+  P4EST_ASSERT (tsg->sq == q);
+  P4EST_ASSERT (tsg->is_leaf == (local_num >= 0));
+
+  if (tsg->test_rays || tsg->is_leaf || q->level == 0) {
+    /* use the per-point checks */
+    for (zz = 0; zz < num_actives; ++zz) {
+      matches[zz] = time_search_fn (p4est, which_tree, q, local_num,
+                                    sc_array_index (points, actives[zz]));
+    }
+    return;
+  }
+
+  /* check all points against the quadrant's bounding sphere in one loop */
+  for (zz = 0; zz < num_actives; ++zz) {
+    t = (const tsearch_point_t *) sc_array_index (points, actives[zz]);
+    r2 = 0.;
+    for (j = 0; j < P4EST_DIM; ++j) {
+      d = t->xy[j] - tsg->center[j];
+      r2 += d * d;
+    }
+    matches[zz] = r2 < (1. + 1e-12) * tsg->radius2;
+  }
+}
+
+static int
+time_search_threads_fn (p4est_t * p4est, p4est_topidx_t which_tree,
+                        p4est_quadrant_t * q, p4est_locidx_t local_num,
+                        void *point)
+{
+  tsearch_global_t    tsl;
+
+  /* set up the quadrant in a private copy to be reentrant */
+  tsl = *(tsearch_global_t *) p4est->user_pointer;
+  P4EST_ASSERT (!tsl.test_rays);
+  tsl.which_tree = which_tree;
+  tsl.sq = q;
+  tsl.is_leaf = local_num >= 0;
+  tsearch_setup (&tsl);
+
+  return time_search_point (&tsl, q, local_num, (tsearch_point_t *) point);
+}
+
 static void
 time_search_1 (tsearch_global_t * tsg, p4est_t * p4est, size_t znum_points,
                sc_flopinfo_t * fi, sc_statinfo_t * stats)
@@ -722,9 +787,10 @@ time_search_1 (tsearch_global_t * tsg, p4est_t * p4est, size_t znum_points,
 
 static void
 time_search_N (tsearch_global_t * tsg, p4est_t * p4est, size_t znum_points,
-               sc_flopinfo_t * fi, sc_statinfo_t * stats)
+               sc_flopinfo_t * fi, sc_statinfo_t * stats, int batch)
 {
   const double        expected = tsg->expected;
+  const char         *name = batch ? "Search_B" : "Search_N";
   int                 mpiret;
   long long           ll, gg;
   sc_flopinfo_t       snapshot;
@@ -739,6 +805,8 @@ time_search_N (tsearch_global_t * tsg, p4est_t * p4est, size_t znum_points,
    *
    * The points are identical on all processors.  Due to points on quadrant
    * boundaries, we will find slightly more points than we expect.
+   *
+   * With batch, the points active for a quadrant are checked in one call.
    */
 
   if (tsg->test_rays) {
@@ -747,9 +815,16 @@ time_search_N (tsearch_global_t * tsg, p4est_t * p4est, size_t znum_points,
 
   tsg->matches = 0;
   sc_flops_snap (fi, &snapshot);
-  p4est_search (p4est, time_search_fn, time_search_fn, tsg->points);
+  if (!batch) {
+    p4est_search (p4est, time_search_fn, time_search_fn, tsg->points);
+  }
+  else {
+    p4est_search_batch (p4est, time_search_fn, time_search_batch_fn,
+                        tsg->points);
+  }
   sc_flops_shot (fi, &snapshot);
-  sc_stats_set1 (&stats[TSEARCH_SEARCH_N], snapshot.iwtime, "Search_N");
+  sc_stats_set1 (&stats[batch ? TSEARCH_SEARCH_B : TSEARCH_SEARCH_N],
+                 snapshot.iwtime, name);
   ll = (long long) tsg->matches;
 
   if (!tsg->test_rays) {
@@ -758,7 +833,7 @@ time_search_N (tsearch_global_t * tsg, p4est_t * p4est, size_t znum_points,
     SC_CHECK_MPI (mpiret);
 
     P4EST_GLOBAL_STATISTICSF
-      ("Search_N expected %lld found %lld of %lld error %.3g%%\n",
+      ("%s expected %lld found %lld of %lld error %.3g%%\n", name,
        (long long) round (expected), gg, (long long) znum_points,
        100. * fabs ((gg - expected) / expected));
   }
@@ -775,7 +850,8 @@ time_search_N (tsearch_global_t * tsg, p4est_t * p4est, size_t znum_points,
                             p4est->mpicomm);
     SC_CHECK_MPI (mpiret);
 
-    sc_stats_init (&raystat, "Search_N ray length errors");
+    sc_stats_init (&raystat, batch ? "Search_B ray length errors" :
+                   "Search_N ray length errors");
 
     if (!p4est->mpirank) {
       size_t              zz;
@@ -795,6 +871,56 @@ time_search_N (tsearch_global_t * tsg, p4est_t * p4est, size_t znum_points,
   }
 }
 
+static void
+time_search_T (tsearch_global_t * tsg, p4est_t * p4est, size_t znum_points,
+               sc_flopinfo_t * fi, sc_statinfo_t * stats)
+{
+  const double        expected = tsg->expected;
+  int                 mpiret;
+  long long           ll, gg;
+  size_t              zz;
+  tsearch_point_t    *point;
+  sc_flopinfo_t       snapshot;
+
+  /*
+   * Search all points in one pass through the forest with threads.
+   *
+   * The callback sets up each quadrant privately for every point, so it is
+   * slower per thread than Search_N.  Compare Search_T for different
+   * --threads to measure the thread scaling.
+   */
+
+  if (tsg->test_rays) {
+    sc_stats_set1 (&stats[TSEARCH_SEARCH_T], 0., "Search_T");
+    return;
+  }
+  for (zz = 0; zz < znum_points; ++zz) {
+    point = (tsearch_point_t *) sc_array_index (tsg->points, zz);
+    point->lid = -1;
+  }
+
+  sc_flops_snap (fi, &snapshot);
+  p4est_search_threads (p4est, tsg->num_threads, NULL,
+                        time_search_threads_fn, tsg->points);
+  sc_flops_shot (fi, &snapshot);
+  sc_stats_set1 (&stats[TSEARCH_SEARCH_T], snapshot.iwtime, "Search_T");
+
+  /* points on quadrant boundaries are only counted once here */
+  ll = 0;
+  for (zz = 0; zz < znum_points; ++zz) {
+    point = (tsearch_point_t *) sc_array_index (tsg->points, zz);
+    ll += point->lid >= 0;
+  }
+  mpiret = sc_MPI_Allreduce (&ll, &gg, 1, sc_MPI_LONG_LONG_INT, sc_MPI_SUM,
+                             tsg->mpicomm);
+  SC_CHECK_MPI (mpiret);
+
+  P4EST_GLOBAL_STATISTICSF
+    ("Search_T threads %d expected %lld found %lld of %lld error %.3g%%\n",
+     tsg->num_threads, (long long) round (expected), gg,
+     (long long) znum_points, 100. * fabs ((gg - expected) / expected));
+}
+
 static void
 time_search_all (tsearch_global_t * tsg, p4est_t * p4est, size_t znum_points,
                  sc_flopinfo_t * fi, sc_statinfo_t * stats)
@@ -906,7 +1032,9 @@ time_search_all (tsearch_global_t * tsg, p4est_t * p4est, size_t znum_points,
   else {
     sc_stats_set1 (&stats[TSEARCH_SEARCH_1], 0., "Search_1");
   }
-  time_search_N (tsg, p4est, znum_points, fi, stats);
+  time_search_N (tsg, p4est, znum_points, fi, stats, 0);
+  time_search_N (tsg, p4est, znum_points, fi, stats, 1);
+  time_search_T (tsg, p4est, znum_points, fi, stats);
 
   sc_array_destroy (tsg->points);
   if (tsg->test_rays) {
@@ -933,6 +1061,7 @@ main (int argc, char **argv)
   sc_options_t       *opt;
   tsearch_global_t    tsgt, *tsg = &tsgt;
   int                 skip_1;
+  int                 num_threads;
 
   /* initialize MPI */
   mpiret = sc_MPI_Init (&argc, &argv);
@@ -975,6 +1104,8 @@ main (int argc, char **argv)
                          "Test rays instead of points");
   sc_options_add_switch (opt, 'm', "skip-1", &skip_1,
                          "only test parallelized search");
+  sc_options_add_int (opt, 'T', "threads", &num_threads, 0,
+                      "Threads for Search_T (0 for OpenMP default)");
   first_argc = sc_options_parse (p4est_package_id, SC_LP_ERROR,
                                  opt, argc, argv);
   if (first_argc < 0 || first_argc != argc) {
@@ -985,6 +1116,7 @@ main (int argc, char **argv)
 
   tsg->test_rays = test_rays;
   tsg->skip_1 = skip_1;
+  tsg->num_threads = num_threads;
 
   /* start overall timing */
   mpiret = sc_MPI_Barrier (tsg->mpicomm);
@@ -29,6 +29,7 @@
 #include <p8est_extended.h>
 #include <p8est_ghost.h>
 #include <p8est_io.h>
+#include <p8est_search.h>
 #else
 #include <p4est_algorithms.h>
 #include <p4est_bits.h>
@@ -36,7 +37,9 @@
 #include <p4est_extended.h>
 #include <p4est_ghost.h>
 #include <p4est_io.h>
+#include <p4est_search.h>
 #endif /* !P4_TO_P8 */
+#include <p4est_trace.h>
 #include <sc_io.h>
 #include <sc_notify.h>
 #include <sc_ranges.h>
@@ -49,6 +52,10 @@
 #define P4EST_MPIIO_WRITE
 #endif
 
+#if defined P4EST_ENABLE_MPI && defined MPI_VERSION && MPI_VERSION >= 3
+#define P4EST_BALANCE_NEIGHBOR
+#endif
+
 #ifdef P4EST_HAVE_UNISTD_H
 #include <unistd.h>
 #endif
@@ -76,6 +83,40 @@ static const size_t number_toread_quadrants = 32;
 static const int8_t fully_owned_flag = 0x01;
 static const int8_t any_face_flag = 0x02;
 
+#ifdef P4EST_BALANCE_NEIGHBOR
+
+/** Distributed graph communicator over the peers of the balance exchange. */
+struct p4est_balance_graph
+{
+  MPI_Comm            parent;           /**< forest communicator at creation */
+  MPI_Comm            comm;             /**< symmetric neighborhood graph */
+  p4est_quadrant_t   *positions;        /**< partition at creation */
+  int                 num_neighbors;
+  int                *neighbors;        /**< sorted ranks, excluding myself */
+};
+
+#endif /* P4EST_BALANCE_NEIGHBOR */
+
+/** Free the neighborhood graph cached by the balance exchange, if any. */
+static void
+p4est_balance_graph_destroy (p4est_t * p4est)
+{
+#ifdef P4EST_BALANCE_NEIGHBOR
+  int                 mpiret;
+  p4est_balance_graph_t *graph = p4est->balance_graph;
+
+  if (graph != NULL) {
+    mpiret = MPI_Comm_free (&graph->comm);
+    SC_CHECK_MPI (mpiret);
+    P4EST_FREE (graph->positions);
+    P4EST_FREE (graph->neighbors);
+    P4EST_FREE (graph);
+    p4est->balance_graph = NULL;
+  }
+#endif
+  P4EST_ASSERT (p4est->balance_graph == NULL);
+}
+
 void
 p4est_qcoord_to_vertex (p4est_connectivity_t * connectivity,
                         p4est_topidx_t treeid,
@@ -188,6 +229,47 @@ p4est_revision (p4est_t * p4est)
   return p4est->revision;
 }
 
+void
+p4est_stats_reset (p4est_t * p4est)
+{
+  P4EST_ASSERT (p4est != NULL);
+
+  memset (p4est->stats, 0, sizeof (p4est->stats));
+}
+
+void
+p4est_stats_compute (p4est_t * p4est, sc_statinfo_t * stats)
+{
+  int                 i;
+
+  P4EST_ASSERT (p4est != NULL);
+  P4EST_ASSERT (stats != NULL);
+
+  for (i = 0; i < P4EST_STAT_NUM; ++i) {
+#ifndef P4EST_ENABLE_MEMTRACK
+    if (i == P4EST_STAT_BALANCE_MEMORY || i == P4EST_STAT_PARTITION_MEMORY ||
+        i == P4EST_STAT_GHOST_MEMORY || i == P4EST_STAT_LNODES_MEMORY) {
+      /* the peak memory is not measured */
+      sc_stats_init (stats + i, p4est_stat_name ((p4est_stat_t) i));
+      continue;
+    }
+#endif
+    sc_stats_set1 (stats + i, p4est->stats[i],
+                   p4est_stat_name ((p4est_stat_t) i));
+  }
+  sc_stats_compute (p4est->mpicomm, P4EST_STAT_NUM, stats);
+}
+
+void
+p4est_stats_print (p4est_t * p4est, int log_priority)
+{
+  sc_statinfo_t       stats[P4EST_STAT_NUM];
+
+  p4est_stats_compute (p4est, stats);
+  sc_stats_print (p4est_package_id, log_priority,
+                  P4EST_STAT_NUM, stats, 1, 0);
+}
+
 p4est_t            *
 p4est_new (sc_MPI_Comm mpicomm, p4est_connectivity_t * connectivity,
            size_t data_size, p4est_init_t init_fn, void *user_pointer)
@@ -523,6 +605,7 @@ p4est_destroy (p4est_t * p4est)
   }
   sc_mempool_destroy (p4est->quadrant_pool);
 
+  p4est_balance_graph_destroy (p4est);
   p4est_comm_parallel_env_release (p4est);
   P4EST_FREE (p4est->global_first_quadrant);
   P4EST_FREE (p4est->global_first_position);
@@ -557,6 +640,8 @@ p4est_copy_ext (p4est_t * input, int copy_data, int duplicate_mpicomm)
   p4est->trees = NULL;
   p4est->user_data_pool = NULL;
   p4est->quadrant_pool = NULL;
+  p4est->balance_graph = NULL;
+  memset (p4est->stats, 0, sizeof (p4est->stats));
 
   /* set parallel environment */
   p4est_comm_parallel_env_assign (p4est, input->mpicomm);
@@ -678,10 +763,14 @@ p4est_refine (p4est_t * p4est, int refine_recursive,
   p4est_refine_ext (p4est, refine_recursive, -1, refine_fn, init_fn, NULL);
 }
 
-void
-p4est_refine_ext (p4est_t * p4est, int refine_recursive, int allowed_level,
-                  p4est_refine_t refine_fn, p4est_init_t init_fn,
-                  p4est_replace_t replace_fn)
+/** Refine a forest and optionally record the refined leaves.
+ * \param [in,out] dirty  If not NULL, each input leaf that is refined is
+ *                        appended as by \ref p4est_balance_dirty_add.
+ */
+static void
+p4est_refine_dirty (p4est_t * p4est, int refine_recursive, int allowed_level,
+                    p4est_refine_t refine_fn, p4est_init_t init_fn,
+                    p4est_replace_t replace_fn, sc_array_t * dirty)
 {
 #ifdef P4EST_ENABLE_DEBUG
   size_t              quadrant_pool_size, data_pool_size;
@@ -711,6 +800,7 @@ p4est_refine_ext (p4est_t * p4est, int refine_recursive, int allowed_level,
                             (long long) p4est->global_num_quadrants,
                             allowed_level);
   p4est_log_indent_push ();
+  P4EST_TRACE_BEGIN (P4EST_STRING "_refine");
   P4EST_ASSERT (p4est_is_valid (p4est));
   P4EST_ASSERT (0 <= allowed_level && allowed_level <= P4EST_QMAXLEVEL);
   P4EST_ASSERT (refine_fn != NULL);
@@ -797,6 +887,11 @@ p4est_refine_ext (p4est_t * p4est, int refine_recursive, int allowed_level,
         sc_array_resize (tquadrants,
                          tquadrants->elem_count + P4EST_CHILDREN - 1);
 
+        if (dirty != NULL && !qpop->pad8) {
+          /* the children of refined children are inside of qpop */
+          p4est_balance_dirty_add (dirty, nt, 1, &qpop);
+        }
+
         if (replace_fn != NULL) {
           /* do not free qpop's data yet: we will do this when the parent
            * is replaced */
@@ -919,12 +1014,37 @@ p4est_refine_ext (p4est_t * p4est, int refine_recursive, int allowed_level,
   }
 
   P4EST_ASSERT (p4est_is_valid (p4est));
+  P4EST_TRACE_END (P4EST_STRING "_refine");
   p4est_log_indent_pop ();
   P4EST_GLOBAL_PRODUCTIONF ("Done " P4EST_STRING
                             "_refine with %lld total quadrants\n",
                             (long long) p4est->global_num_quadrants);
 }
 
+void
+p4est_refine_ext (p4est_t * p4est, int refine_recursive, int allowed_level,
+                  p4est_refine_t refine_fn, p4est_init_t init_fn,
+                  p4est_replace_t replace_fn)
+{
+  p4est_refine_dirty (p4est, refine_recursive, allowed_level,
+                      refine_fn, init_fn, replace_fn, NULL);
+}
+
+void
+p4est_refine_balance_ext (p4est_t * p4est, int refine_recursive,
+                          int allowed_level, p4est_refine_t refine_fn,
+                          p4est_connect_type_t btype,
+                          p4est_init_t init_fn, p4est_replace_t replace_fn)
+{
+  sc_array_t         *dirty;
+
+  dirty = sc_array_new (sizeof (p4est_quadrant_t));
+  p4est_refine_dirty (p4est, refine_recursive, allowed_level,
+                      refine_fn, init_fn, replace_fn, dirty);
+  p4est_balance_dirty_ext (p4est, btype, init_fn, replace_fn, dirty);
+  sc_array_destroy (dirty);
+}
+
 void
 p4est_coarsen (p4est_t * p4est, int coarsen_recursive,
                p4est_coarsen_t coarsen_fn, p4est_init_t init_fn)
@@ -1134,7 +1254,8 @@ p4est_coarsen_ext (p4est_t * p4est,
  * If yes, the quadrant itself is scheduled for sending.
  * Both quadrants are in the receiving tree's coordinates.
  * \param [in]  qtree       Tree id of the receiving tree.
- * \param [in]  inter_tree  Boolean flag to specify inter-tree communication.
+ * \param [in]  send_self   Also schedule for this processor.  This is
+ *                          required for inter-tree communication.
  * \param [in]  q           The quadrant to be sent if there is overlap.
  * \param [in]  insul       An insulation quadrant of \a q.
  * \param [in,out]  first_peer  Lowest peer, will be updated.
@@ -1142,7 +1263,7 @@ p4est_coarsen_ext (p4est_t * p4est,
  */
 static void
 p4est_balance_schedule (p4est_t * p4est, p4est_balance_peer_t * peers,
-                        p4est_topidx_t qtree, int inter_tree,
+                        p4est_topidx_t qtree, int send_self,
                         const p4est_quadrant_t * q,
                         const p4est_quadrant_t * insul,
                         int *first_peer, int *last_peer)
@@ -1165,7 +1286,7 @@ p4est_balance_schedule (p4est_t * p4est, p4est_balance_peer_t * peers,
 
   /* send to all processors possibly intersecting insulation */
   for (owner = first_owner; owner <= last_owner; ++owner) {
-    if (owner == rank && !inter_tree) {
+    if (owner == rank && !send_self) {
       /* do not send to self for the same tree */
       continue;
     }
@@ -1206,6 +1327,212 @@ p4est_balance_schedule (p4est_t * p4est, p4est_balance_peer_t * peers,
   }
 }
 
+/** Context to schedule the insulation layers of quadrants for sending. */
+typedef struct p4est_balance_insul
+{
+  p4est_t            *p4est;
+  p4est_balance_peer_t *peers;
+  int                 send_self;        /**< Schedule within own tree too. */
+  int                 first_peer, last_peer;
+#ifdef P4_TO_P8
+  p8est_edge_info_t   ei;
+#endif
+  p4est_corner_info_t ci;
+}
+p4est_balance_insul_t;
+
+/** Schedule a quadrant for all processors owning part of its insulation
+ * layer.  Insulation quadrants outside of the tree are transformed into
+ * the neighbor trees across faces, edges and corners.
+ * \param [in,out] bi      The scheduling context.
+ * \param [in] nt          Tree id of the quadrant.
+ * \param [in] tree_contact    Face contacts of the tree as computed by
+ *                         \ref p4est_comm_tree_info.
+ * \param [in] q           A local quadrant.
+ */
+static void
+p4est_balance_insulation (p4est_balance_insul_t * bi, p4est_topidx_t nt,
+                          const int *tree_contact, const p4est_quadrant_t * q)
+{
+  p4est_t            *p4est = bi->p4est;
+  p4est_connectivity_t *conn = p4est->connectivity;
+  const p4est_qcoord_t rh = P4EST_ROOT_LEN;
+  const p4est_qcoord_t qh = P4EST_QUADRANT_LEN (q->level);
+  int                 k, l, m, which;
+  int                 face, corner;
+  int                 quad_contact[P4EST_FACES];
+  int                 ftransform[P4EST_FTRANSFORM];
+  int                 face_axis[3];     /* 3 not P4EST_DIM */
+  int                 contact_face_only, contact_edge_only;
+  size_t              ctree;
+  p4est_topidx_t      qtree;
+  p4est_quadrant_t    tosend, insulq, tempq;
+  p4est_corner_transform_t *ct;
+  sc_array_t         *cta = &bi->ci.corner_transforms;
+#ifdef P4_TO_P8
+  int                 edge;
+  size_t              etree;
+  p8est_edge_transform_t *et;
+  sc_array_t         *eta = &bi->ei.edge_transforms;
+#endif
+
+  P4EST_QUADRANT_INIT (&tosend);
+  P4EST_QUADRANT_INIT (&insulq);
+  P4EST_QUADRANT_INIT (&tempq);
+
+#ifdef P4_TO_P8
+  for (m = 0; m < 3; ++m) {
+#if 0
+  }
+#endif
+#else
+  m = 0;
+#endif
+  for (k = 0; k < 3; ++k) {
+    for (l = 0; l < 3; ++l) {
+      which = m * 9 + k * 3 + l;    /* 2D: 0..8, 3D: 0..26 */
+      /* exclude myself from the queries */
+      if (which == P4EST_INSUL / 2) {
+        continue;
+      }
+      /* may modify insulq below, never modify q itself! */
+      insulq = *q;
+      insulq.x += (l - 1) * qh;
+      insulq.y += (k - 1) * qh;
+#ifdef P4_TO_P8
+      insulq.z += (m - 1) * qh;
+#endif
+      /* check boundary status of insulation quadrant */
+      quad_contact[0] = (insulq.x < 0);
+      quad_contact[1] = (insulq.x >= rh);
+      face_axis[0] = quad_contact[0] || quad_contact[1];
+      quad_contact[2] = (insulq.y < 0);
+      quad_contact[3] = (insulq.y >= rh);
+      face_axis[1] = quad_contact[2] || quad_contact[3];
+#ifndef P4_TO_P8
+      face_axis[2] = 0;
+#else
+      quad_contact[4] = (insulq.z < 0);
+      quad_contact[5] = (insulq.z >= rh);
+      face_axis[2] = quad_contact[4] || quad_contact[5];
+      edge = -1;
+#endif
+      contact_edge_only = contact_face_only = 0;
+      face = -1;
+      if (face_axis[0] || face_axis[1] || face_axis[2]) {
+        /* this quadrant is relevant for inter-tree balancing */
+        if (!face_axis[1] && !face_axis[2]) {
+          contact_face_only = 1;
+          face = 0 + quad_contact[1];
+        }
+        else if (!face_axis[0] && !face_axis[2]) {
+          contact_face_only = 1;
+          face = 2 + quad_contact[3];
+        }
+#ifdef P4_TO_P8
+        else if (!face_axis[0] && !face_axis[1]) {
+          contact_face_only = 1;
+          face = 4 + quad_contact[5];
+        }
+        else if (!face_axis[0]) {
+          contact_edge_only = 1;
+          edge = 0 + 2 * quad_contact[5] + quad_contact[3];
+        }
+        else if (!face_axis[1]) {
+          contact_edge_only = 1;
+          edge = 4 + 2 * quad_contact[5] + quad_contact[1];
+        }
+        else if (!face_axis[2]) {
+          contact_edge_only = 1;
+          edge = 8 + 2 * quad_contact[3] + quad_contact[1];
+        }
+#endif
+        if (contact_face_only) {
+          /* square contact across a face */
+          P4EST_ASSERT (!contact_edge_only);
+          P4EST_ASSERT (face >= 0 && face < P4EST_FACES);
+          P4EST_ASSERT (quad_contact[face]);
+          qtree = p4est_find_face_transform (conn, nt, face, ftransform);
+          if (qtree >= 0) {
+            P4EST_ASSERT (tree_contact[face]);
+            p4est_quadrant_transform_face (q, &tosend, ftransform);
+            tosend.p.piggy2.from_tree = nt;
+            tosend.pad16 = face;
+            p4est_quadrant_transform_face (&insulq, &tempq, ftransform);
+            p4est_balance_schedule (p4est, bi->peers, qtree, 1,
+                                    &tosend, &tempq,
+                                    &bi->first_peer, &bi->last_peer);
+          }
+          else {
+            /* goes across a face with no neighbor */
+            P4EST_ASSERT (!tree_contact[face]);
+          }
+        }
+#ifdef P4_TO_P8
+        else if (contact_edge_only) {
+          /* this quadrant crosses an edge */
+          P4EST_ASSERT (!contact_face_only);
+          P4EST_ASSERT (edge >= 0 && edge < P8EST_EDGES);
+          p8est_find_edge_transform (conn, nt, edge, &bi->ei);
+          for (etree = 0; etree < eta->elem_count; ++etree) {
+            et = p8est_edge_array_index (eta, etree);
+            p8est_quadrant_transform_edge (q, &tosend, &bi->ei, et, 0);
+            tosend.p.piggy2.from_tree = nt;
+            tosend.pad16 = edge;
+            p8est_quadrant_transform_edge (&insulq, &tempq, &bi->ei, et, 1);
+            p4est_balance_schedule (p4est, bi->peers, et->ntree, 1,
+                                    &tosend, &tempq,
+                                    &bi->first_peer, &bi->last_peer);
+          }
+        }
+#endif
+        else {
+          /* this quadrant crosses a corner */
+          P4EST_ASSERT (face_axis[0] && face_axis[1]);
+          corner = quad_contact[1] + 2 * quad_contact[3];
+#ifdef P4_TO_P8
+          P4EST_ASSERT (face_axis[2]);
+          corner += 4 * quad_contact[5];
+#endif
+          P4EST_ASSERT (p4est_quadrant_touches_corner (q, corner, 1));
+          P4EST_ASSERT (p4est_quadrant_touches_corner
+                        (&insulq, corner, 0));
+          p4est_find_corner_transform (conn, nt, corner, &bi->ci);
+          for (ctree = 0; ctree < cta->elem_count; ++ctree) {
+            ct = p4est_corner_array_index (cta, ctree);
+            tosend = *q;
+            p4est_quadrant_transform_corner (&tosend, (int) ct->ncorner,
+                                             0);
+            tosend.p.piggy2.from_tree = nt;
+            tosend.pad16 = corner;
+            tempq = insulq;
+            p4est_quadrant_transform_corner (&tempq, (int) ct->ncorner,
+                                             1);
+            p4est_balance_schedule (p4est, bi->peers, ct->ntree, 1,
+                                    &tosend, &tempq, &bi->first_peer,
+                                    &bi->last_peer);
+          }
+        }
+      }
+      else {
+        /* no inter-tree contact */
+        tosend = *q;
+        tosend.p.piggy2.from_tree = nt;
+        tosend.pad16 = -1;
+        p4est_balance_schedule (p4est, bi->peers, nt, bi->send_self,
+                                &tosend, &insulq, &bi->first_peer,
+                                &bi->last_peer);
+      }
+    }
+  }
+#ifdef P4_TO_P8
+#if 0
+  {
+#endif
+  }
+#endif
+}
+
 static void
 p4est_balance_response (p4est_t * p4est, p4est_balance_peer_t * peer,
                         p4est_connect_type_t balance, sc_array_t * borders)
@@ -1233,6 +1560,305 @@ p4est_balance_response (p4est_t * p4est, p4est_balance_peer_t * peer,
   }
 }
 
+#ifdef P4EST_BALANCE_NEIGHBOR
+
+/** Context to find the processes that the balance of a partition reaches. */
+typedef struct p4est_balance_reach
+{
+  p4est_balance_insul_t bi;
+  p4est_topidx_t      which_tree;       /**< tree of \a tree_contact */
+  int                 tree_contact[P4EST_FACES];
+}
+p4est_balance_reach_t;
+
+/** Schedule the insulation layer of the largest quadrants of my partition.
+ * This is a point callback for p4est_search_partition whose only point
+ * is a pointer to the p4est_balance_reach_t context.  The insulation
+ * layer of any local quadrant is contained in the one of the largest
+ * quadrant of my partition that contains it.
+ */
+static int
+p4est_balance_reach_point (p4est_t * p4est, p4est_topidx_t which_tree,
+                           p4est_quadrant_t * quadrant, int pfirst, int plast,
+                           void *point)
+{
+  const int           rank = p4est->mpirank;
+  int                 full_tree[2];
+  p4est_balance_reach_t *reach = *(p4est_balance_reach_t **) point;
+
+  if (rank < pfirst || rank > plast) {
+    return 0;
+  }
+  if (pfirst < plast) {
+    return 1;
+  }
+
+  /* this quadrant is entirely mine and its parent is not */
+  if (reach->which_tree != which_tree) {
+    p4est_comm_tree_info (p4est, which_tree, full_tree,
+                          reach->tree_contact, NULL, NULL);
+    reach->which_tree = which_tree;
+  }
+  p4est_balance_insulation (&reach->bi, which_tree, reach->tree_contact,
+                            quadrant);
+  return 0;
+}
+
+/** Return a distributed graph communicator for the balance exchange.
+ * The neighbors are all processes that any forest on the current partition
+ * may exchange balance quadrants with, in either direction.  Since they
+ * only depend on p4est->global_first_position, the graph of the previous
+ * call is reused without communication while the partition is the same.
+ * Otherwise it is rebuilt, which is collective over the communicator of
+ * the forest.  Every process makes the same decision.
+ * \param [in] p4est        The forest caches the graph.
+ * \return                  The graph owned by \a p4est.
+ */
+static p4est_balance_graph_t *
+p4est_balance_graph_get (p4est_t * p4est)
+{
+  const int           num_procs = p4est->mpisize;
+  const int           rank = p4est->mpirank;
+  const size_t        psize = (num_procs + 1) * sizeof (p4est_quadrant_t);
+  int                 mpiret;
+  int                 j, k, l, n;
+  int                 num_receivers, num_senders;
+  int                *receivers, *senders, *weights;
+  p4est_balance_peer_t *peers;
+  p4est_balance_reach_t sreach, *reach = &sreach;
+  p4est_balance_graph_t *graph = p4est->balance_graph;
+  sc_array_t          points;
+
+  if (graph != NULL && graph->parent == p4est->mpicomm &&
+      !memcmp (graph->positions, p4est->global_first_position, psize)) {
+    return graph;
+  }
+
+  /* the partition has changed since the graph was made */
+  p4est_balance_graph_destroy (p4est);
+  peers = P4EST_ALLOC (p4est_balance_peer_t, num_procs);
+  for (j = 0; j < num_procs; ++j) {
+    sc_array_init (&peers[j].send_first, sizeof (p4est_quadrant_t));
+  }
+  reach->bi.p4est = p4est;
+  reach->bi.peers = peers;
+  reach->bi.send_self = 0;
+  reach->bi.first_peer = num_procs;
+  reach->bi.last_peer = -1;
+#ifdef P4_TO_P8
+  sc_array_init (&reach->bi.ei.edge_transforms,
+                 sizeof (p8est_edge_transform_t));
+#endif
+  sc_array_init (&reach->bi.ci.corner_transforms,
+                 sizeof (p4est_corner_transform_t));
+  reach->which_tree = -1;
+  sc_array_init_data (&points, &reach, sizeof (p4est_balance_reach_t *), 1);
+  p4est_search_partition (p4est, NULL, p4est_balance_reach_point, &points);
+
+  /* collect the receivers and let sc_notify find the senders */
+  receivers = P4EST_ALLOC (int, num_procs);
+  senders = P4EST_ALLOC (int, num_procs);
+  num_receivers = 0;
+  for (j = 0; j < num_procs; ++j) {
+    if (j != rank && peers[j].send_first.elem_count > 0) {
+      receivers[num_receivers++] = j;
+    }
+    sc_array_reset (&peers[j].send_first);
+  }
+  P4EST_FREE (peers);
+#ifdef P4_TO_P8
+  sc_array_reset (&reach->bi.ei.edge_transforms);
+#endif
+  sc_array_reset (&reach->bi.ci.corner_transforms);
+  mpiret = sc_notify (receivers, num_receivers, senders, &num_senders,
+                      p4est->mpicomm);
+  SC_CHECK_MPI (mpiret);
+
+  /* merge both directions into a symmetric neighborhood */
+  graph = p4est->balance_graph = P4EST_ALLOC (p4est_balance_graph_t, 1);
+  graph->parent = p4est->mpicomm;
+  graph->positions = P4EST_ALLOC (p4est_quadrant_t, num_procs + 1);
+  memcpy (graph->positions, p4est->global_first_position, psize);
+  graph->neighbors = P4EST_ALLOC (int, SC_MAX (1, num_receivers +
+                                               num_senders));
+  n = k = l = 0;
+  while (k < num_receivers || l < num_senders) {
+    if (l == num_senders ||
+        (k < num_receivers && receivers[k] < senders[l])) {
+      graph->neighbors[n++] = receivers[k++];
+    }
+    else if (k == num_receivers || senders[l] < receivers[k]) {
+      graph->neighbors[n++] = senders[l++];
+    }
+    else {
+      graph->neighbors[n++] = receivers[k++];
+      ++l;
+    }
+  }
+  graph->num_neighbors = n;
+  P4EST_FREE (receivers);
+  P4EST_FREE (senders);
+
+  /* uniform weights in arrays of at least one entry, even if n is zero,
+     avoid passing the MPI_UNWEIGHTED and MPI_WEIGHTS_EMPTY sentinels */
+  weights = P4EST_ALLOC (int, SC_MAX (1, n));
+  for (j = 0; j < SC_MAX (1, n); ++j) {
+    weights[j] = 1;
+  }
+  mpiret = MPI_Dist_graph_create_adjacent (p4est->mpicomm,
+                                           n, graph->neighbors, weights,
+                                           n, graph->neighbors, weights,
+                                           MPI_INFO_NULL, 0, &graph->comm);
+  SC_CHECK_MPI (mpiret);
+  P4EST_FREE (weights);
+  P4EST_VERBOSEF ("New balance graph with %d neighbors\n", n);
+
+  return graph;
+}
+
+/** Run both rounds of the balance exchange by neighborhood collectives.
+ * Each round sends the quadrant counts by MPI_Neighbor_alltoall and
+ * then the quadrants by MPI_Neighbor_alltoallv.  The first round sends
+ * the send_first arrays, the second the responses computed from them.
+ * The neighbors are those of the graph cached for the partition, which
+ * needs no sc_notify or sc_ranges to find the communication pattern.
+ * \param [in,out] total_send_count    Incremented by quadrants sent.
+ * \param [in,out] total_recv_count    Incremented by quadrants received.
+ * \param [in,out] send_zero   Per round, incremented by empty sends.
+ * \param [in,out] send_load   Per round, incremented by nonempty sends.
+ * \param [in,out] recv_zero   Per round, incremented by empty receives.
+ * \param [in,out] recv_load   Per round, incremented by nonempty receives.
+ */
+static void
+p4est_balance_neighbor (p4est_t * p4est, p4est_balance_peer_t * peers,
+                        p4est_connect_type_t btype, sc_array_t * borders,
+                        int *total_send_count, int *total_recv_count,
+                        int send_zero[2], int send_load[2],
+                        int recv_zero[2], int recv_load[2])
+{
+  const int           qsize = (int) sizeof (p4est_quadrant_t);
+  int                 mpiret;
+  int                 i, n, round;
+  int                 send_total, recv_total;
+  const int          *neighbors;
+  int                *send_counts, *recv_counts;
+  int                *send_displs, *recv_displs;
+  char               *send_buffer, *recv_buffer;
+  MPI_Comm            comm;
+  p4est_balance_graph_t *graph;
+  p4est_balance_peer_t *peer;
+  sc_array_t         *sarr, *rarr;
+
+  graph = p4est_balance_graph_get (p4est);
+  comm = graph->comm;
+  neighbors = graph->neighbors;
+  n = graph->num_neighbors;
+#ifdef P4EST_ENABLE_DEBUG
+  {
+    int                 j;
+    sc_array_t          view;
+
+    /* every process that we send to must be a neighbor in the graph */
+    sc_array_init_data (&view, (void *) neighbors, sizeof (int), n);
+    for (j = 0; j < p4est->mpisize; ++j) {
+      P4EST_ASSERT (j == p4est->mpirank ||
+                    peers[j].send_first.elem_count == 0 ||
+                    sc_array_bsearch (&view, &j, sc_int_compare) >= 0);
+    }
+  }
+#endif
+
+  send_counts = P4EST_ALLOC (int, 4 * n);
+  recv_counts = send_counts + n;
+  send_displs = send_counts + 2 * n;
+  recv_displs = send_counts + 3 * n;
+  for (round = 0; round < 2; ++round) {
+    /* collect the outgoing quadrants of this round */
+    send_total = 0;
+    for (i = 0; i < n; ++i) {
+      peer = peers + neighbors[i];
+      if (round == 0) {
+        sarr = &peer->send_first;
+        sc_array_sort (sarr, p4est_quadrant_compare_piggy);
+        peer->send_first_count = (int) sarr->elem_count;
+      }
+      else {
+        sarr = &peer->send_second;
+        if (peer->recv_first.elem_count > 0) {
+          p4est_balance_response (p4est, peer, btype, borders);
+        }
+        peer->send_second_count = (int) sarr->elem_count;
+      }
+      send_counts[i] = (int) sarr->elem_count * qsize;
+      send_displs[i] = send_total;
+      send_total += send_counts[i];
+      if (sarr->elem_count > 0) {
+        ++send_load[round];
+      }
+      else {
+        ++send_zero[round];
+      }
+    }
+    *total_send_count += send_total / qsize;
+    send_buffer = P4EST_ALLOC (char, send_total);
+    for (i = 0; i < n; ++i) {
+      peer = peers + neighbors[i];
+      sarr = round == 0 ? &peer->send_first : &peer->send_second;
+      if (send_counts[i] > 0) {
+        memcpy (send_buffer + send_displs[i], sarr->array, send_counts[i]);
+      }
+    }
+
+    /* exchange the counts and then the quadrants */
+    P4EST_TRACE_BEGIN ("MPI_Neighbor_alltoallv");
+    mpiret = MPI_Neighbor_alltoall (send_counts, 1, MPI_INT,
+                                    recv_counts, 1, MPI_INT, comm);
+    SC_CHECK_MPI (mpiret);
+    recv_total = 0;
+    for (i = 0; i < n; ++i) {
+      recv_displs[i] = recv_total;
+      recv_total += recv_counts[i];
+    }
+    recv_buffer = P4EST_ALLOC (char, recv_total);
+    mpiret = MPI_Neighbor_alltoallv (send_buffer, send_counts, send_displs,
+                                     MPI_BYTE, recv_buffer, recv_counts,
+                                     recv_displs, MPI_BYTE, comm);
+    SC_CHECK_MPI (mpiret);
+    P4EST_TRACE_END ("MPI_Neighbor_alltoallv");
+    P4EST_FREE (send_buffer);
+
+    /* distribute the incoming quadrants to the peers */
+    *total_recv_count += recv_total / qsize;
+    for (i = 0; i < n; ++i) {
+      peer = peers + neighbors[i];
+      P4EST_ASSERT (recv_counts[i] % qsize == 0);
+      if (round == 0) {
+        rarr = &peer->recv_first;
+        peer->recv_first_count = recv_counts[i] / qsize;
+      }
+      else {
+        rarr = &peer->recv_second;
+        peer->recv_second_count = recv_counts[i] / qsize;
+      }
+      P4EST_ASSERT (rarr->elem_count == 0);
+      sc_array_resize (rarr, (size_t) (recv_counts[i] / qsize));
+      if (recv_counts[i] > 0) {
+        memcpy (rarr->array, recv_buffer + recv_displs[i], recv_counts[i]);
+      }
+      if (recv_counts[i] > 0) {
+        ++recv_load[round];
+      }
+      else {
+        ++recv_zero[round];
+      }
+    }
+    P4EST_FREE (recv_buffer);
+  }
+  P4EST_FREE (send_counts);
+}
+
+#endif /* P4EST_BALANCE_NEIGHBOR */
+
 void
 p4est_balance (p4est_t * p4est, p4est_connect_type_t btype,
                p4est_init_t init_fn)
@@ -1246,19 +1872,19 @@ p4est_balance_ext (p4est_t * p4est, p4est_connect_type_t btype,
 {
   const int           rank = p4est->mpirank;
   const int           num_procs = p4est->mpisize;
-  int                 j, k, l, m, which;
+  int                 j, k, l;
   int                 face;
   int                 first_peer, last_peer;
-  int                 quad_contact[P4EST_FACES];
   int                 any_face, tree_contact[P4EST_FACES];
   int                 tree_fully_owned, full_tree[2];
   int8_t             *tree_flags;
-  size_t              zz, treecount, ctree;
+  size_t              zz, treecount;
   size_t              localcount;
   size_t              qcount, qbytes;
   size_t              all_incount, all_outcount;
-  p4est_qcoord_t      qh;
-  const p4est_qcoord_t rh = P4EST_ROOT_LEN;
+  size_t              transient;
+  p4est_memory_peak_t memory;
+  double              start_time;
   p4est_topidx_t      qtree, nt;
   p4est_topidx_t      first_tree, last_tree;
   p4est_locidx_t      skipped;
@@ -1266,7 +1892,6 @@ p4est_balance_ext (p4est_t * p4est, p4est_connect_type_t btype,
   p4est_balance_peer_t *peers, *peer;
   p4est_tree_t       *tree;
   p4est_quadrant_t    mylow, nextlow;
-  p4est_quadrant_t    tosend, insulq, tempq;
   p4est_quadrant_t   *q, *s;
   p4est_connectivity_t *conn = p4est->connectivity;
   sc_array_t         *qarray, *tquadrants;
@@ -1274,20 +1899,7 @@ p4est_balance_ext (p4est_t * p4est, p4est_connect_type_t btype,
 #ifdef P4EST_ENABLE_DEBUG
   size_t              data_pool_size;
 #endif
-  int                 ftransform[P4EST_FTRANSFORM];
-  int                 face_axis[3];     /* 3 not P4EST_DIM */
-  int                 contact_face_only, contact_edge_only;
-#ifdef P4_TO_P8
-  int                 edge;
-  size_t              etree;
-  p8est_edge_info_t   ei;
-  p8est_edge_transform_t *et;
-  sc_array_t         *eta;
-#endif
-  int                 corner;
-  p4est_corner_info_t ci;
-  p4est_corner_transform_t *ct;
-  sc_array_t         *cta;
+  p4est_balance_insul_t bi;
 #ifdef P4EST_ENABLE_MPI
 #ifdef P4EST_ENABLE_DEBUG
   unsigned            checksum;
@@ -1313,6 +1925,9 @@ p4est_balance_ext (p4est_t * p4est, p4est_connect_type_t btype,
   int                 num_receivers_notify, num_senders_notify;
   int                 is_ranges_primary, is_balance_verify;
   int                 is_ranges_active, is_notify_active;
+#ifdef P4EST_BALANCE_NEIGHBOR
+  int                 is_neighbor_active;
+#endif
   int                 max_ranges;
   MPI_Request        *requests_first, *requests_second;
   MPI_Request        *send_requests_first_count, *send_requests_first_load;
@@ -1326,6 +1941,9 @@ p4est_balance_ext (p4est_t * p4est, p4est_connect_type_t btype,
                             (long long) p4est->global_num_quadrants);
   p4est_log_indent_push ();
   P4EST_ASSERT (p4est_is_valid (p4est));
+  P4EST_TRACE_BEGIN (P4EST_STRING "_balance");
+  start_time = sc_MPI_Wtime ();
+  p4est_memory_peak_begin (&memory);
 #ifndef P4_TO_P8
   P4EST_ASSERT (btype == P4EST_CONNECT_FACE || btype == P4EST_CONNECT_CORNER);
 #else
@@ -1345,9 +1963,6 @@ p4est_balance_ext (p4est_t * p4est, p4est_connect_type_t btype,
 
   P4EST_QUADRANT_INIT (&mylow);
   P4EST_QUADRANT_INIT (&nextlow);
-  P4EST_QUADRANT_INIT (&tosend);
-  P4EST_QUADRANT_INIT (&insulq);
-  P4EST_QUADRANT_INIT (&tempq);
 
   /* tree status flags (max 8 per tree) */
   tree_flags = P4EST_ALLOC (int8_t, conn->num_trees);
@@ -1397,12 +2012,14 @@ p4est_balance_ext (p4est_t * p4est, p4est_connect_type_t btype,
     peer->have_first_count = peer->have_first_load = 0;
     peer->have_second_count = peer->have_second_load = 0;
   }
+  bi.p4est = p4est;
+  bi.peers = peers;
+  bi.send_self = 0;
 #ifdef P4_TO_P8
-  eta = &ei.edge_transforms;
-  sc_array_init (eta, sizeof (p8est_edge_transform_t));
+  sc_array_init (&bi.ei.edge_transforms, sizeof (p8est_edge_transform_t));
 #endif
-  cta = &ci.corner_transforms;
-  sc_array_init (cta, sizeof (p4est_corner_transform_t));
+  sc_array_init (&bi.ci.corner_transforms,
+                 sizeof (p4est_corner_transform_t));
 
   /* compute first quadrant on finest level */
   mylow.x = p4est->global_first_position[rank].x;
@@ -1428,12 +2045,19 @@ p4est_balance_ext (p4est_t * p4est, p4est_connect_type_t btype,
     p4est->inspect->use_B = 0;
   }
 
-  /* loop over all local trees to assemble first send list */
+  /* local balance first pass; the trees are independent of each other */
   first_tree = p4est->first_local_tree;
   last_tree = p4est->last_local_tree;
-  first_peer = num_procs;
-  last_peer = -1;
   all_incount = 0;
+  for (nt = first_tree; nt <= last_tree; ++nt) {
+    tree = p4est_tree_array_index (p4est->trees, nt);
+    all_incount += tree->quadrants.elem_count;
+  }
+  p4est_balance_local (p4est, btype, init_fn, replace_fn);
+
+  /* loop over all local trees to assemble first send list */
+  bi.first_peer = num_procs;
+  bi.last_peer = -1;
   skipped = 0;
   for (nt = first_tree; nt <= last_tree; ++nt) {
     p4est_comm_tree_info (p4est, nt, full_tree, tree_contact, NULL, NULL);
@@ -1447,17 +2071,7 @@ p4est_balance_ext (p4est_t * p4est, p4est_connect_type_t btype,
     }
     tree = p4est_tree_array_index (p4est->trees, nt);
     tquadrants = &tree->quadrants;
-    all_incount += tquadrants->elem_count;
-
-    /* initial log message for this tree */
-    P4EST_VERBOSEF ("Into balance tree %lld with %llu\n", (long long) nt,
-                    (unsigned long long) tquadrants->elem_count);
-
-    /* local balance first pass */
-    p4est_balance_subtree_ext (p4est, btype, nt, init_fn, replace_fn);
     treecount = tquadrants->elem_count;
-    P4EST_VERBOSEF ("Balance tree %lld A %llu\n",
-                    (long long) nt, (unsigned long long) treecount);
 
     /* check if this tree is not shared with other processors */
     if (tree_fully_owned) {
@@ -1481,7 +2095,6 @@ p4est_balance_ext (p4est_t * p4est, p4est_connect_type_t btype,
     for (zz = 0; zz < treecount; ++zz) {
       /* this quadrant may be on the boundary with a range of processors */
       q = p4est_quadrant_array_index (tquadrants, zz);
-      qh = P4EST_QUADRANT_LEN (q->level);
       if (p4est_comm_neighborhood_owned (p4est, nt,
                                          full_tree, tree_contact, q)) {
         /* this quadrant's 3x3 neighborhood is owned by this processor */
@@ -1494,160 +2107,12 @@ p4est_balance_ext (p4est_t * p4est, p4est_connect_type_t btype,
         *s = *q;
       }
 
-#ifdef P4_TO_P8
-      for (m = 0; m < 3; ++m) {
-#if 0
-      }
-#endif
-#else
-      m = 0;
-#endif
-      for (k = 0; k < 3; ++k) {
-        for (l = 0; l < 3; ++l) {
-          which = m * 9 + k * 3 + l;    /* 2D: 0..8, 3D: 0..26 */
-          /* exclude myself from the queries */
-          if (which == P4EST_INSUL / 2) {
-            continue;
-          }
-          /* may modify insulq below, never modify q itself! */
-          insulq = *q;
-          insulq.x += (l - 1) * qh;
-          insulq.y += (k - 1) * qh;
-#ifdef P4_TO_P8
-          insulq.z += (m - 1) * qh;
-#endif
-          /* check boundary status of insulation quadrant */
-          quad_contact[0] = (insulq.x < 0);
-          quad_contact[1] = (insulq.x >= rh);
-          face_axis[0] = quad_contact[0] || quad_contact[1];
-          quad_contact[2] = (insulq.y < 0);
-          quad_contact[3] = (insulq.y >= rh);
-          face_axis[1] = quad_contact[2] || quad_contact[3];
-#ifndef P4_TO_P8
-          face_axis[2] = 0;
-#else
-          quad_contact[4] = (insulq.z < 0);
-          quad_contact[5] = (insulq.z >= rh);
-          face_axis[2] = quad_contact[4] || quad_contact[5];
-          edge = -1;
-#endif
-          contact_edge_only = contact_face_only = 0;
-          face = -1;
-          if (face_axis[0] || face_axis[1] || face_axis[2]) {
-            /* this quadrant is relevant for inter-tree balancing */
-            if (!face_axis[1] && !face_axis[2]) {
-              contact_face_only = 1;
-              face = 0 + quad_contact[1];
-            }
-            else if (!face_axis[0] && !face_axis[2]) {
-              contact_face_only = 1;
-              face = 2 + quad_contact[3];
-            }
-#ifdef P4_TO_P8
-            else if (!face_axis[0] && !face_axis[1]) {
-              contact_face_only = 1;
-              face = 4 + quad_contact[5];
-            }
-            else if (!face_axis[0]) {
-              contact_edge_only = 1;
-              edge = 0 + 2 * quad_contact[5] + quad_contact[3];
-            }
-            else if (!face_axis[1]) {
-              contact_edge_only = 1;
-              edge = 4 + 2 * quad_contact[5] + quad_contact[1];
-            }
-            else if (!face_axis[2]) {
-              contact_edge_only = 1;
-              edge = 8 + 2 * quad_contact[3] + quad_contact[1];
-            }
-#endif
-            if (contact_face_only) {
-              /* square contact across a face */
-              P4EST_ASSERT (!contact_edge_only);
-              P4EST_ASSERT (face >= 0 && face < P4EST_FACES);
-              P4EST_ASSERT (quad_contact[face]);
-              qtree = p4est_find_face_transform (conn, nt, face, ftransform);
-              if (qtree >= 0) {
-                P4EST_ASSERT (tree_contact[face]);
-                p4est_quadrant_transform_face (q, &tosend, ftransform);
-                tosend.p.piggy2.from_tree = nt;
-                tosend.pad16 = face;
-                p4est_quadrant_transform_face (&insulq, &tempq, ftransform);
-                p4est_balance_schedule (p4est, peers, qtree, 1,
-                                        &tosend, &tempq,
-                                        &first_peer, &last_peer);
-              }
-              else {
-                /* goes across a face with no neighbor */
-                P4EST_ASSERT (!tree_contact[face]);
-              }
-            }
-#ifdef P4_TO_P8
-            else if (contact_edge_only) {
-              /* this quadrant crosses an edge */
-              P4EST_ASSERT (!contact_face_only);
-              P4EST_ASSERT (edge >= 0 && edge < P8EST_EDGES);
-              p8est_find_edge_transform (conn, nt, edge, &ei);
-              for (etree = 0; etree < eta->elem_count; ++etree) {
-                et = p8est_edge_array_index (eta, etree);
-                p8est_quadrant_transform_edge (q, &tosend, &ei, et, 0);
-                tosend.p.piggy2.from_tree = nt;
-                tosend.pad16 = edge;
-                p8est_quadrant_transform_edge (&insulq, &tempq, &ei, et, 1);
-                p4est_balance_schedule (p4est, peers, et->ntree, 1,
-                                        &tosend, &tempq,
-                                        &first_peer, &last_peer);
-              }
-            }
-#endif
-            else {
-              /* this quadrant crosses a corner */
-              P4EST_ASSERT (face_axis[0] && face_axis[1]);
-              corner = quad_contact[1] + 2 * quad_contact[3];
-#ifdef P4_TO_P8
-              P4EST_ASSERT (face_axis[2]);
-              corner += 4 * quad_contact[5];
-#endif
-              P4EST_ASSERT (p4est_quadrant_touches_corner (q, corner, 1));
-              P4EST_ASSERT (p4est_quadrant_touches_corner
-                            (&insulq, corner, 0));
-              p4est_find_corner_transform (conn, nt, corner, &ci);
-              for (ctree = 0; ctree < cta->elem_count; ++ctree) {
-                ct = p4est_corner_array_index (cta, ctree);
-                tosend = *q;
-                p4est_quadrant_transform_corner (&tosend, (int) ct->ncorner,
-                                                 0);
-                tosend.p.piggy2.from_tree = nt;
-                tosend.pad16 = corner;
-                tempq = insulq;
-                p4est_quadrant_transform_corner (&tempq, (int) ct->ncorner,
-                                                 1);
-                p4est_balance_schedule (p4est, peers, ct->ntree, 1,
-                                        &tosend, &tempq, &first_peer,
-                                        &last_peer);
-              }
-            }
-          }
-          else {
-            /* no inter-tree contact */
-            tosend = *q;
-            tosend.p.piggy2.from_tree = nt;
-            tosend.pad16 = -1;
-            p4est_balance_schedule (p4est, peers, nt, 0,
-                                    &tosend, &insulq, &first_peer,
-                                    &last_peer);
-          }
-        }
-      }
-#ifdef P4_TO_P8
-#if 0
-      {
-#endif
-      }
-#endif
+      p4est_balance_insulation (&bi, nt, tree_contact, q);
     }
     tquadrants = NULL;          /* safeguard */
   }
+  first_peer = bi.first_peer;
+  last_peer = bi.last_peer;
 
   /* end balance_A, start balance_comm */
 #ifdef P4EST_ENABLE_MPI
@@ -1655,6 +2120,9 @@ p4est_balance_ext (p4est_t * p4est, p4est_connect_type_t btype,
   is_ranges_active = 0;
   is_notify_active = 1;
   is_balance_verify = 0;
+#endif
+#ifdef P4EST_BALANCE_NEIGHBOR
+  is_neighbor_active = 0;
 #endif
   if (p4est->inspect != NULL) {
     p4est->inspect->balance_A += sc_MPI_Wtime ();
@@ -1676,6 +2144,13 @@ p4est_balance_ext (p4est_t * p4est, p4est_connect_type_t btype,
       is_ranges_active = is_notify_active = 1;
     }
     is_balance_verify = p4est->inspect->use_balance_verify;
+#ifdef P4EST_BALANCE_NEIGHBOR
+    is_neighbor_active = p4est->inspect->use_balance_neighbor;
+    if (is_neighbor_active) {
+      /* the graph of the partition replaces the communication pattern */
+      is_ranges_primary = is_ranges_active = is_notify_active = 0;
+    }
+#endif
 #endif
   }
 
@@ -1921,17 +2396,33 @@ p4est_balance_ext (p4est_t * p4est, p4est_connect_type_t btype,
     num_receivers = num_receivers_ranges;
     num_senders = num_senders_ranges;
   }
-  else {
-    P4EST_ASSERT (is_notify_active);
+  else if (is_notify_active) {
     receiver_ranks = receiver_ranks_notify;
     sender_ranks = sender_ranks_notify;
     num_receivers = num_receivers_notify;
     num_senders = num_senders_notify;
   }
-  P4EST_ASSERT (receiver_ranks != NULL && sender_ranks != NULL);
+  else {
+    /* only the neighborhood graph does without the pattern */
+    num_receivers = num_senders = 0;
+  }
+  P4EST_ASSERT ((receiver_ranks != NULL) ==
+                (is_ranges_primary || is_notify_active));
+  P4EST_ASSERT ((sender_ranks != NULL) ==
+                (is_ranges_primary || is_notify_active));
   num_receivers_ranges = num_senders_ranges = 0;
   num_receivers_notify = num_senders_notify = 0;
 
+#ifdef P4EST_BALANCE_NEIGHBOR
+  /* run both rounds by neighborhood collectives instead of messages */
+  if (is_neighbor_active) {
+    p4est_balance_neighbor (p4est, peers, btype, borders,
+                            &total_send_count, &total_recv_count,
+                            send_zero, send_load, recv_zero, recv_load);
+    num_receivers = num_senders = 0;
+  }
+#endif
+
   /* Use receiver_ranks array to send to them */
   for (k = 0; k < num_receivers; ++k) {
     j = receiver_ranks[k];
@@ -1954,6 +2445,7 @@ p4est_balance_ext (p4est_t * p4est, p4est_connect_type_t btype,
                         j, P4EST_COMM_BALANCE_FIRST_COUNT,
                         p4est->mpicomm, &send_requests_first_count[j]);
     SC_CHECK_MPI (mpiret);
+    P4EST_TRACE_ISEND (j, P4EST_COMM_BALANCE_FIRST_COUNT, 1, MPI_INT);
     ++request_send_count;
 
     /* sort and send the actual quadrants and post receive for reply */
@@ -1971,11 +2463,14 @@ p4est_balance_ext (p4est_t * p4est, p4est_connect_type_t btype,
                           j, P4EST_COMM_BALANCE_FIRST_LOAD,
                           p4est->mpicomm, &send_requests_first_load[j]);
       SC_CHECK_MPI (mpiret);
+      P4EST_TRACE_ISEND (j, P4EST_COMM_BALANCE_FIRST_LOAD, (int) qbytes,
+                         MPI_BYTE);
       ++request_send_count;
       mpiret = MPI_Irecv (&peer->recv_second_count, 1, MPI_INT,
                           j, P4EST_COMM_BALANCE_SECOND_COUNT,
                           p4est->mpicomm, &requests_second[j]);
       SC_CHECK_MPI (mpiret);
+      P4EST_TRACE_IRECV (j, P4EST_COMM_BALANCE_SECOND_COUNT, 1, MPI_INT);
       ++request_second_count;
     }
   }
@@ -1992,6 +2487,7 @@ p4est_balance_ext (p4est_t * p4est, p4est_connect_type_t btype,
                         j, P4EST_COMM_BALANCE_FIRST_COUNT,
                         p4est->mpicomm, &requests_first[j]);
     SC_CHECK_MPI (mpiret);
+    P4EST_TRACE_IRECV (j, P4EST_COMM_BALANCE_FIRST_COUNT, 1, MPI_INT);
   }
   P4EST_FREE (sender_ranks_ranges);
   P4EST_FREE (sender_ranks_notify);
@@ -1999,9 +2495,11 @@ p4est_balance_ext (p4est_t * p4est, p4est_connect_type_t btype,
 
   /* wait for quadrant counts and post receive and send for quadrants */
   while (request_first_count > 0) {
+    P4EST_TRACE_BEGIN ("MPI_Waitsome");
     mpiret = MPI_Waitsome (num_procs, requests_first,
                            &outcount, wait_indices, recv_statuses);
     SC_CHECK_MPI (mpiret);
+    P4EST_TRACE_END ("MPI_Waitsome");
     P4EST_ASSERT (outcount != MPI_UNDEFINED);
     P4EST_ASSERT (outcount > 0);
     for (i = 0; i < outcount; ++i) {
@@ -2039,6 +2537,8 @@ p4est_balance_ext (p4est_t * p4est, p4est_connect_type_t btype,
                               j, P4EST_COMM_BALANCE_FIRST_LOAD,
                               p4est->mpicomm, &requests_first[j]);
           SC_CHECK_MPI (mpiret);
+          P4EST_TRACE_IRECV (j, P4EST_COMM_BALANCE_FIRST_LOAD, (int) qbytes,
+                             MPI_BYTE);
           ++recv_load[0];
         }
         else {
@@ -2090,6 +2590,7 @@ p4est_balance_ext (p4est_t * p4est, p4est_connect_type_t btype,
                             j, P4EST_COMM_BALANCE_SECOND_COUNT,
                             p4est->mpicomm, &send_requests_second_count[j]);
         SC_CHECK_MPI (mpiret);
+        P4EST_TRACE_ISEND (j, P4EST_COMM_BALANCE_SECOND_COUNT, 1, MPI_INT);
         ++request_send_count;
         if (qcount > 0) {
 
@@ -2106,6 +2607,8 @@ p4est_balance_ext (p4est_t * p4est, p4est_connect_type_t btype,
                               j, P4EST_COMM_BALANCE_SECOND_LOAD,
                               p4est->mpicomm, &send_requests_second_load[j]);
           SC_CHECK_MPI (mpiret);
+          P4EST_TRACE_ISEND (j, P4EST_COMM_BALANCE_SECOND_LOAD, (int) qbytes,
+                             MPI_BYTE);
           ++request_send_count;
         }
       }
@@ -2136,9 +2639,11 @@ p4est_balance_ext (p4est_t * p4est, p4est_connect_type_t btype,
 #ifdef P4EST_ENABLE_MPI
   /* receive second round appending to the same receive buffer */
   while (request_second_count > 0) {
+    P4EST_TRACE_BEGIN ("MPI_Waitsome");
     mpiret = MPI_Waitsome (num_procs, requests_second,
                            &outcount, wait_indices, recv_statuses);
     SC_CHECK_MPI (mpiret);
+    P4EST_TRACE_END ("MPI_Waitsome");
     P4EST_ASSERT (outcount != MPI_UNDEFINED);
     P4EST_ASSERT (outcount > 0);
     for (i = 0; i < outcount; ++i) {
@@ -2176,6 +2681,8 @@ p4est_balance_ext (p4est_t * p4est, p4est_connect_type_t btype,
                               MPI_BYTE, j, P4EST_COMM_BALANCE_SECOND_LOAD,
                               p4est->mpicomm, &requests_second[j]);
           SC_CHECK_MPI (mpiret);
+          P4EST_TRACE_IRECV (j, P4EST_COMM_BALANCE_SECOND_LOAD, (int) qbytes,
+                             MPI_BYTE);
           ++recv_load[1];
         }
         else {
@@ -2298,6 +2805,24 @@ p4est_balance_ext (p4est_t * p4est, p4est_connect_type_t btype,
     }
   }
 
+  /* count the exchanged quadrants and the borders as long as they live */
+  transient = 0;
+  for (j = 0; j < num_procs; ++j) {
+    peer = peers + j;
+    transient += sc_array_memory_used (&peer->send_first, 0);
+    transient += sc_array_memory_used (&peer->send_second, 0);
+    transient += sc_array_memory_used (&peer->recv_first, 0);
+    transient += sc_array_memory_used (&peer->recv_second, 0);
+  }
+  if (borders != NULL) {
+    transient += sc_array_memory_used (borders, 1);
+    for (zz = 0; zz < localcount; zz++) {
+      qarray = (sc_array_t *) sc_array_index (borders, zz);
+      transient += sc_array_memory_used (qarray, 0);
+    }
+  }
+  p4est_memory_hold (transient);
+
   /* rebalance and clamp result back to original tree boundaries */
   p4est->local_num_quadrants = 0;
   for (nt = first_tree; nt <= last_tree; ++nt) {
@@ -2334,9 +2859,11 @@ p4est_balance_ext (p4est_t * p4est, p4est_connect_type_t btype,
 #ifdef P4EST_ENABLE_MPI
   /* wait for all send operations */
   if (request_send_count > 0) {
+    P4EST_TRACE_BEGIN ("MPI_Waitall");
     mpiret = MPI_Waitall (4 * num_procs,
                           send_requests_first_count, MPI_STATUSES_IGNORE);
     SC_CHECK_MPI (mpiret);
+    P4EST_TRACE_END ("MPI_Waitall");
   }
 
   /* compute global sum of send and receive counts */
@@ -2365,6 +2892,7 @@ p4est_balance_ext (p4est_t * p4est, p4est_connect_type_t btype,
   }
 
   /* cleanup temporary storage */
+  p4est_memory_release (transient);
   P4EST_FREE (tree_flags);
   for (j = 0; j < num_procs; ++j) {
     peer = peers + j;
@@ -2384,9 +2912,9 @@ p4est_balance_ext (p4est_t * p4est, p4est_connect_type_t btype,
   }
 
 #ifdef P4_TO_P8
-  sc_array_reset (eta);
+  sc_array_reset (&bi.ei.edge_transforms);
 #endif
-  sc_array_reset (cta);
+  sc_array_reset (&bi.ci.corner_transforms);
 
 #ifdef P4EST_ENABLE_MPI
   P4EST_FREE (requests_first);  /* includes allocation for requests_second */
@@ -2414,12 +2942,405 @@ p4est_balance_ext (p4est_t * p4est, p4est_connect_type_t btype,
   P4EST_ASSERT (p4est_is_valid (p4est));
   P4EST_ASSERT (p4est_is_balanced (p4est, btype));
   P4EST_VERBOSEF ("Balance skipped %lld\n", (long long) skipped);
+  p4est->stats[P4EST_STAT_BALANCE_TIME] += sc_MPI_Wtime () - start_time;
+  p4est_memory_peak_stat (&memory, p4est_memory_used (p4est),
+                          &p4est->stats[P4EST_STAT_BALANCE_MEMORY]);
+  P4EST_TRACE_END (P4EST_STRING "_balance");
   p4est_log_indent_pop ();
   P4EST_GLOBAL_PRODUCTIONF ("Done " P4EST_STRING
                             "_balance with %lld total quadrants\n",
                             (long long) p4est->global_num_quadrants);
 }
 
+void
+p4est_balance_dirty_add (sc_array_t * dirty, p4est_topidx_t which_tree,
+                         int num_quadrants, p4est_quadrant_t * quadrants[])
+{
+  int                 i;
+  p4est_quadrant_t   *q;
+
+  P4EST_ASSERT (dirty->elem_size == sizeof (p4est_quadrant_t));
+
+  for (i = 0; i < num_quadrants; ++i) {
+    q = p4est_quadrant_array_push (dirty);
+    *q = *quadrants[i];
+    q->p.piggy2.which_tree = which_tree;
+    q->p.piggy2.from_tree = which_tree;
+  }
+}
+
+/** Find the local leaves that equal, contain, or are contained in the
+ * quadrants of a dirty list.  Entries outside of the local range are
+ * ignored; they may be left over from a coarser or finer state.
+ * \param [in] p4est        The forest.
+ * \param [in,out] dirty    Dirty quadrants with which_tree set.  Sorted.
+ * \param [out] leaves      Receives the matching local leaves, sorted
+ *                          and without duplicates.
+ */
+static void
+p4est_balance_dirty_resolve (p4est_t * p4est, sc_array_t * dirty,
+                             sc_array_t * leaves)
+{
+  size_t              zz, zy;
+  ssize_t             js;
+  p4est_topidx_t      nt;
+  p4est_tree_t       *tree;
+  p4est_quadrant_t   *d, *q, *r;
+  sc_array_t         *tquadrants;
+
+  sc_array_sort (dirty, p4est_quadrant_compare_piggy);
+  for (zz = 0; zz < dirty->elem_count; ++zz) {
+    d = p4est_quadrant_array_index (dirty, zz);
+    nt = d->p.piggy2.which_tree;
+    if (nt < p4est->first_local_tree || nt > p4est->last_local_tree) {
+      continue;
+    }
+    tree = p4est_tree_array_index (p4est->trees, nt);
+    tquadrants = &tree->quadrants;
+
+    /* a leaf that equals or contains the dirty quadrant */
+    js = p4est_find_higher_bound (tquadrants, d, 0);
+    if (js >= 0) {
+      q = p4est_quadrant_array_index (tquadrants, (size_t) js);
+      if (p4est_quadrant_is_equal (q, d) ||
+          p4est_quadrant_is_ancestor (q, d)) {
+        r = p4est_quadrant_array_push (leaves);
+        *r = *q;
+        r->p.piggy2.which_tree = nt;
+        continue;
+      }
+    }
+
+    /* the leaves inside of the dirty quadrant */
+    js = p4est_find_lower_bound (tquadrants, d, 0);
+    if (js < 0) {
+      continue;
+    }
+    for (zy = (size_t) js; zy < tquadrants->elem_count; ++zy) {
+      q = p4est_quadrant_array_index (tquadrants, zy);
+      if (!p4est_quadrant_is_ancestor (d, q)) {
+        break;
+      }
+      r = p4est_quadrant_array_push (leaves);
+      *r = *q;
+      r->p.piggy2.which_tree = nt;
+    }
+  }
+  sc_array_sort (leaves, p4est_quadrant_compare_piggy);
+  sc_array_uniq (leaves, p4est_quadrant_compare_piggy);
+}
+
+/** Send one array of quadrants per peer and receive the matching ones.
+ * \param [in] p4est        The forest.
+ * \param [in] peers        Per-peer send and receive arrays.
+ * \param [in] receivers    Ranks to send to, not including myself.
+ * \param [in] num_receivers    Number of entries in \a receivers.
+ * \param [in] senders      Ranks to receive from, not including myself.
+ * \param [in] num_senders  Number of entries in \a senders.
+ * \param [in] tag          Message tag.
+ * \param [in] second       If false, send send_first and receive into
+ *                          recv_first, otherwise use the second arrays.
+ */
+static void
+p4est_balance_dirty_exchange (p4est_t * p4est, p4est_balance_peer_t * peers,
+                              const int *receivers, int num_receivers,
+                              const int *senders, int num_senders,
+                              int tag, int second)
+{
+  const size_t        esize = sizeof (p4est_quadrant_t);
+  int                 mpiret;
+  int                 i, byte_count;
+  sc_array_t         *arr;
+  sc_MPI_Request     *requests;
+  sc_MPI_Status       status;
+
+  requests = P4EST_ALLOC (sc_MPI_Request, num_receivers);
+  for (i = 0; i < num_receivers; ++i) {
+    P4EST_ASSERT (receivers[i] != p4est->mpirank);
+    arr = second ? &peers[receivers[i]].send_second :
+      &peers[receivers[i]].send_first;
+    mpiret = sc_MPI_Isend (arr->array, (int) (arr->elem_count * esize),
+                           sc_MPI_BYTE, receivers[i], tag,
+                           p4est->mpicomm, requests + i);
+    SC_CHECK_MPI (mpiret);
+    P4EST_TRACE_ISEND (receivers[i], tag, (int) (arr->elem_count * esize),
+                       sc_MPI_BYTE);
+  }
+  for (i = 0; i < num_senders; ++i) {
+    P4EST_ASSERT (senders[i] != p4est->mpirank);
+    mpiret = sc_MPI_Probe (senders[i], tag, p4est->mpicomm, &status);
+    SC_CHECK_MPI (mpiret);
+    mpiret = sc_MPI_Get_count (&status, sc_MPI_BYTE, &byte_count);
+    SC_CHECK_MPI (mpiret);
+    P4EST_ASSERT (byte_count >= 0 && byte_count % esize == 0);
+    arr = second ? &peers[senders[i]].recv_second :
+      &peers[senders[i]].recv_first;
+    sc_array_resize (arr, (size_t) byte_count / esize);
+    mpiret = sc_MPI_Recv (arr->array, byte_count, sc_MPI_BYTE, senders[i],
+                          tag, p4est->mpicomm, sc_MPI_STATUS_IGNORE);
+    SC_CHECK_MPI (mpiret);
+  }
+  if (num_receivers > 0) {
+    P4EST_TRACE_BEGIN ("MPI_Waitall");
+    mpiret = sc_MPI_Waitall (num_receivers, requests,
+                             sc_MPI_STATUSES_IGNORE);
+    SC_CHECK_MPI (mpiret);
+    P4EST_TRACE_END ("MPI_Waitall");
+  }
+  P4EST_FREE (requests);
+}
+
+void
+p4est_balance_dirty_ext (p4est_t * p4est, p4est_connect_type_t btype,
+                         p4est_init_t init_fn, p4est_replace_t replace_fn,
+                         sc_array_t * dirty)
+{
+  const int           rank = p4est->mpirank;
+  const int           num_procs = p4est->mpisize;
+  int                 mpiret;
+  int                 j, num_rounds, num_exchanges, exchange;
+  int                 num_receivers, num_senders;
+  int                *receivers, *senders;
+  int                 tree_contact[P4EST_FACES], full_tree[2];
+  size_t              zz, localcount;
+  ssize_t             js;
+  p4est_topidx_t      nt, qtree, prev_tree;
+  p4est_topidx_t      first_tree = p4est->first_local_tree;
+  p4est_topidx_t      last_tree = p4est->last_local_tree;
+  p4est_gloidx_t      old_gnq, local_queries, global_queries;
+  p4est_balance_insul_t bi;
+  p4est_balance_peer_t *peers, *peer;
+  p4est_tree_t       *tree;
+  p4est_quadrant_t   *q, *r, *s;
+  sc_array_t         *leaves, *seeds, *borders, *qarray;
+
+  P4EST_GLOBAL_PRODUCTIONF ("Into " P4EST_STRING
+                            "_balance_dirty %s with %lld total quadrants\n",
+                            p4est_connect_type_string (btype),
+                            (long long) p4est->global_num_quadrants);
+  p4est_log_indent_push ();
+  P4EST_ASSERT (p4est_is_valid (p4est));
+  P4EST_ASSERT (dirty->elem_size == sizeof (p4est_quadrant_t));
+#ifndef P4_TO_P8
+  P4EST_ASSERT (btype == P4EST_CONNECT_FACE || btype == P4EST_CONNECT_CORNER);
+#else
+  P4EST_ASSERT (btype == P8EST_CONNECT_FACE || btype == P8EST_CONNECT_EDGE ||
+                btype == P8EST_CONNECT_CORNER);
+#endif
+
+  /* remember input quadrant count; it will not decrease */
+  old_gnq = p4est->global_num_quadrants;
+
+  /* per peer storage and the context to schedule insulation layers */
+  peers = P4EST_ALLOC (p4est_balance_peer_t, num_procs);
+  for (j = 0; j < num_procs; ++j) {
+    peer = peers + j;
+    sc_array_init (&peer->send_first, sizeof (p4est_quadrant_t));
+    sc_array_init (&peer->send_second, sizeof (p4est_quadrant_t));
+    sc_array_init (&peer->recv_first, sizeof (p4est_quadrant_t));
+    sc_array_init (&peer->recv_second, sizeof (p4est_quadrant_t));
+  }
+  bi.p4est = p4est;
+  bi.peers = peers;
+  bi.send_self = 1;
+#ifdef P4_TO_P8
+  sc_array_init (&bi.ei.edge_transforms, sizeof (p8est_edge_transform_t));
+#endif
+  sc_array_init (&bi.ci.corner_transforms,
+                 sizeof (p4est_corner_transform_t));
+  receivers = P4EST_ALLOC (int, num_procs);
+  senders = P4EST_ALLOC (int, num_procs);
+
+  localcount = (size_t) (last_tree + 1 - first_tree);
+  borders = sc_array_new_size (sizeof (sc_array_t), localcount);
+  for (zz = 0; zz < localcount; ++zz) {
+    qarray = (sc_array_t *) sc_array_index (borders, zz);
+    sc_array_init (qarray, sizeof (p4est_quadrant_t));
+  }
+  leaves = sc_array_new (sizeof (p4est_quadrant_t));
+  seeds = sc_array_new (sizeof (p4est_quadrant_t));
+
+  /* every round splits the leaves next to the dirty ones if needed;
+     the leaves created by a round are the dirty ones for the next */
+  bi.first_peer = num_procs;
+  bi.last_peer = -1;
+  num_exchanges = 0;
+  for (num_rounds = 0;; ++num_rounds) {
+    sc_array_truncate (leaves);
+    p4est_balance_dirty_resolve (p4est, dirty, leaves);
+    sc_array_truncate (dirty);
+    exchange = leaves->elem_count == 0;
+    if (!exchange) {
+      /* ripple locally: the queries to other processes are kept until
+         the local ripple has stopped and are then sent all at once */
+      prev_tree = -1;
+      for (zz = 0; zz < leaves->elem_count; ++zz) {
+        q = p4est_quadrant_array_index (leaves, zz);
+        nt = q->p.piggy2.which_tree;
+        if (nt != prev_tree) {
+          p4est_comm_tree_info (p4est, nt, full_tree, tree_contact,
+                                NULL, NULL);
+          prev_tree = nt;
+        }
+        p4est_balance_insulation (&bi, nt, tree_contact, q);
+      }
+      num_receivers = num_senders = 0;
+    }
+    else {
+      /* the local ripple has stopped: query the processes it reaches */
+      num_receivers = 0;
+      for (j = bi.first_peer; j <= bi.last_peer; ++j) {
+        if (j != rank && peers[j].send_first.elem_count > 0) {
+          receivers[num_receivers++] = j;
+        }
+      }
+      local_queries = (p4est_gloidx_t) num_receivers;
+      mpiret = sc_MPI_Allreduce (&local_queries, &global_queries, 1,
+                                 P4EST_MPI_GLOIDX, sc_MPI_SUM,
+                                 p4est->mpicomm);
+      SC_CHECK_MPI (mpiret);
+      P4EST_GLOBAL_VERBOSEF ("Balance dirty exchange %d after %d rounds"
+                             " with %lld messages\n", num_exchanges,
+                             num_rounds, (long long) global_queries);
+      if (global_queries == 0) {
+        break;
+      }
+      ++num_exchanges;
+      mpiret = sc_notify (receivers, num_receivers, senders, &num_senders,
+                          p4est->mpicomm);
+      SC_CHECK_MPI (mpiret);
+      p4est_balance_dirty_exchange (p4est, peers, receivers, num_receivers,
+                                    senders, num_senders,
+                                    P4EST_COMM_BALANCE_DIRTY_QUERY, 0);
+      bi.first_peer = num_procs;
+      bi.last_peer = -1;
+    }
+    peer = peers + rank;
+    sc_array_copy (&peer->recv_first, &peer->send_first);
+
+    /* split my leaves by the queries and answer with the querier's seeds */
+    sc_array_truncate (seeds);
+    for (j = -1; j < num_senders; ++j) {
+      peer = peers + (j < 0 ? rank : senders[j]);
+      if (peer->recv_first.elem_count == 0) {
+        continue;
+      }
+      sc_array_sort (&peer->recv_first, p4est_quadrant_compare_piggy);
+      p4est_tree_compute_overlap (p4est, &peer->recv_first,
+                                  &peer->send_second, btype, NULL, seeds);
+      p4est_tree_uniqify_overlap (&peer->send_second);
+    }
+    if (exchange) {
+      p4est_balance_dirty_exchange (p4est, peers, senders, num_senders,
+                                    receivers, num_receivers,
+                                    P4EST_COMM_BALANCE_DIRTY_RESPONSE, 1);
+    }
+    peer = peers + rank;
+    sc_array_copy (&peer->recv_second, &peer->send_second);
+    for (j = 0; j < num_procs; ++j) {
+      peer = peers + j;
+      if (!exchange && j != rank) {
+        /* the queries to this process wait for the next exchange */
+        continue;
+      }
+      qarray = &peer->recv_second;
+      if (qarray->elem_count > 0) {
+        zz = seeds->elem_count;
+        sc_array_resize (seeds, zz + qarray->elem_count);
+        memcpy (sc_array_index (seeds, zz), qarray->array,
+                qarray->elem_count * qarray->elem_size);
+      }
+      sc_array_truncate (&peer->send_first);
+      sc_array_truncate (&peer->send_second);
+      sc_array_truncate (&peer->recv_first);
+      sc_array_truncate (&peer->recv_second);
+    }
+
+    /* pair every seed with the leaf it splits and balance those leaves */
+    for (zz = 0; zz < seeds->elem_count; ++zz) {
+      s = p4est_quadrant_array_index (seeds, zz);
+      qtree = s->p.piggy2.which_tree;
+      P4EST_ASSERT (first_tree <= qtree && qtree <= last_tree);
+      tree = p4est_tree_array_index (p4est->trees, qtree);
+      js = p4est_find_higher_bound (&tree->quadrants, s, 0);
+      if (js < 0) {
+        continue;
+      }
+      q = p4est_quadrant_array_index (&tree->quadrants, (size_t) js);
+      if (!p4est_quadrant_is_ancestor (q, s)) {
+        /* the region of the seed is already fine enough */
+        continue;
+      }
+      qarray = (sc_array_t *) sc_array_index (borders,
+                                              (size_t) (qtree - first_tree));
+      r = p4est_quadrant_array_push (qarray);
+      *r = *q;
+      r = p4est_quadrant_array_push (qarray);
+      *r = *s;
+
+      /* the split leaf is dirty for the next round */
+      r = p4est_quadrant_array_push (dirty);
+      *r = *q;
+      r->p.piggy2.which_tree = qtree;
+    }
+    for (nt = first_tree; nt <= last_tree; ++nt) {
+      qarray = (sc_array_t *) sc_array_index (borders,
+                                              (size_t) (nt - first_tree));
+      if (qarray->elem_count > 0) {
+        p4est_balance_border (p4est, btype, nt, init_fn, replace_fn, borders);
+        sc_array_truncate (qarray);
+      }
+    }
+  }
+
+  /* recompute the local quadrant counts and offsets */
+  p4est->local_num_quadrants = 0;
+  for (nt = 0; nt < p4est->connectivity->num_trees; ++nt) {
+    tree = p4est_tree_array_index (p4est->trees, nt);
+    tree->quadrants_offset = p4est->local_num_quadrants;
+    if (first_tree <= nt && nt <= last_tree) {
+      p4est->local_num_quadrants +=
+        (p4est_locidx_t) tree->quadrants.elem_count;
+    }
+  }
+
+  /* cleanup temporary storage */
+  sc_array_destroy (seeds);
+  sc_array_destroy (leaves);
+  for (zz = 0; zz < localcount; ++zz) {
+    sc_array_reset ((sc_array_t *) sc_array_index (borders, zz));
+  }
+  sc_array_destroy (borders);
+  P4EST_FREE (senders);
+  P4EST_FREE (receivers);
+#ifdef P4_TO_P8
+  sc_array_reset (&bi.ei.edge_transforms);
+#endif
+  sc_array_reset (&bi.ci.corner_transforms);
+  for (j = 0; j < num_procs; ++j) {
+    peer = peers + j;
+    sc_array_reset (&peer->send_first);
+    sc_array_reset (&peer->send_second);
+    sc_array_reset (&peer->recv_first);
+    sc_array_reset (&peer->recv_second);
+  }
+  P4EST_FREE (peers);
+
+  /* compute global number of quadrants */
+  p4est_comm_count_quadrants (p4est);
+  P4EST_ASSERT (p4est->global_num_quadrants >= old_gnq);
+  if (old_gnq != p4est->global_num_quadrants) {
+    ++p4est->revision;
+  }
+  P4EST_ASSERT (p4est_is_valid (p4est));
+  p4est_log_indent_pop ();
+  P4EST_GLOBAL_PRODUCTIONF ("Done " P4EST_STRING
+                            "_balance_dirty with %lld total quadrants"
+                            " in %d rounds and %d exchanges\n",
+                            (long long) p4est->global_num_quadrants,
+                            num_rounds, num_exchanges);
+}
+
 void
 p4est_partition (p4est_t * p4est, int allow_for_coarsening,
                  p4est_weight_t weight_fn)
@@ -2479,6 +3400,7 @@ p4est_partition_ext (p4est_t * p4est, int partition_for_coarsening,
   }
 
   p4est_log_indent_push ();
+  P4EST_TRACE_BEGIN (P4EST_STRING "_partition");
 
 #ifdef P4EST_ENABLE_MPI
   /* allocate new quadrant distribution counts */
@@ -2553,6 +3475,7 @@ p4est_partition_ext (p4est_t * p4est, int partition_for_coarsening,
       P4EST_FREE (local_weights);
       P4EST_FREE (global_weight_sums);
       P4EST_FREE (num_quadrants_in_proc);
+      P4EST_TRACE_END (P4EST_STRING "_partition");
       p4est_log_indent_pop ();
       P4EST_GLOBAL_PRODUCTION ("Done " P4EST_STRING
                                "_partition no shipping\n");
@@ -2612,6 +3535,8 @@ p4est_partition_ext (p4est_t * p4est, int partition_for_coarsening,
                        P4EST_COMM_PARTITION_WEIGHTED_LOW, p4est->mpicomm,
                        &send_requests[base_index + 1]);
           SC_CHECK_MPI (mpiret);
+          P4EST_TRACE_ISEND (i, P4EST_COMM_PARTITION_WEIGHTED_LOW, 1,
+                             P4EST_MPI_GLOIDX);
         }
         else {
           lowers = 0;
@@ -2629,6 +3554,8 @@ p4est_partition_ext (p4est_t * p4est, int partition_for_coarsening,
                             i - 1, P4EST_COMM_PARTITION_WEIGHTED_HIGH,
                             p4est->mpicomm, &send_requests[base_index]);
         SC_CHECK_MPI (mpiret);
+        P4EST_TRACE_ISEND (i - 1, P4EST_COMM_PARTITION_WEIGHTED_HIGH, 1,
+                           P4EST_MPI_GLOIDX);
       }
     }
 
@@ -2649,6 +3576,8 @@ p4est_partition_ext (p4est_t * p4est, int partition_for_coarsening,
                               P4EST_COMM_PARTITION_WEIGHTED_LOW,
                               p4est->mpicomm, &recv_requests[0]);
           SC_CHECK_MPI (mpiret);
+          P4EST_TRACE_IRECV (i, P4EST_COMM_PARTITION_WEIGHTED_LOW, 1,
+                             P4EST_MPI_GLOIDX);
           break;
         }
       }
@@ -2670,6 +3599,8 @@ p4est_partition_ext (p4est_t * p4est, int partition_for_coarsening,
                               P4EST_COMM_PARTITION_WEIGHTED_HIGH,
                               p4est->mpicomm, &recv_requests[1]);
           SC_CHECK_MPI (mpiret);
+          P4EST_TRACE_IRECV (i, P4EST_COMM_PARTITION_WEIGHTED_HIGH, 1,
+                             P4EST_MPI_GLOIDX);
           break;
         }
       }
@@ -2686,13 +3617,17 @@ p4est_partition_ext (p4est_t * p4est, int partition_for_coarsening,
 
     /* wait for sends and receives to complete */
     if (num_sends > 0) {
+      P4EST_TRACE_BEGIN ("MPI_Waitall");
       mpiret = MPI_Waitall (num_sends, send_requests, MPI_STATUSES_IGNORE);
       SC_CHECK_MPI (mpiret);
+      P4EST_TRACE_END ("MPI_Waitall");
       P4EST_FREE (send_requests);
       P4EST_FREE (send_array);
     }
+    P4EST_TRACE_BEGIN ("MPI_Waitall");
     mpiret = MPI_Waitall (2, recv_requests, recv_statuses);
     SC_CHECK_MPI (mpiret);
+    P4EST_TRACE_END ("MPI_Waitall");
     if (my_lowcut != 0) {
       SC_CHECK_ABORT (recv_statuses[0].MPI_SOURCE == low_source,
                       "Wait low source");
@@ -2771,6 +3706,7 @@ p4est_partition_ext (p4est_t * p4est, int partition_for_coarsening,
   P4EST_ASSERT (p4est_is_valid (p4est));
 #endif /* P4EST_ENABLE_MPI */
 
+  P4EST_TRACE_END (P4EST_STRING "_partition");
   p4est_log_indent_pop ();
   P4EST_GLOBAL_PRODUCTIONF
     ("Done " P4EST_STRING "_partition shipped %lld quadrants %.3g%%\n",
@@ -2987,6 +3923,8 @@ p4est_partition_for_coarsening (p4est_t * p4est,
                             P4EST_COMM_PARTITION_CORRECTION, p4est->mpicomm,
                             &send_requests[parent_index]);
         SC_CHECK_MPI (mpiret);
+        P4EST_TRACE_ISEND (i, P4EST_COMM_PARTITION_CORRECTION,
+                           sizeof (p4est_quadrant_t), MPI_BYTE);
       }
       else {
         /* if quadrant near cut is root of tree, i.e., level is zero,
@@ -3011,6 +3949,8 @@ p4est_partition_for_coarsening (p4est_t * p4est,
                             P4EST_COMM_PARTITION_CORRECTION, p4est->mpicomm,
                             &send_requests[parent_index]);
         SC_CHECK_MPI (mpiret);
+        P4EST_TRACE_ISEND (i, P4EST_COMM_PARTITION_CORRECTION,
+                           sizeof (p4est_quadrant_t), MPI_BYTE);
       }
 
       /* increment parent index */
@@ -3083,6 +4023,8 @@ p4est_partition_for_coarsening (p4est_t * p4est,
                           P4EST_COMM_PARTITION_CORRECTION, p4est->mpicomm,
                           &receive_requests[parent_index]);
       SC_CHECK_MPI (mpiret);
+      P4EST_TRACE_IRECV (i, P4EST_COMM_PARTITION_CORRECTION,
+                         sizeof (p4est_quadrant_t), MPI_BYTE);
 
       /* increment parent index */
       parent_index++;
@@ -3093,9 +4035,11 @@ p4est_partition_for_coarsening (p4est_t * p4est,
   /* BEGIN: wait for MPI receive to complete */
   if (num_receives > 0) {
     /* wait for receives to complete */
+    P4EST_TRACE_BEGIN ("MPI_Waitall");
     mpiret =
       MPI_Waitall (num_receives, receive_requests, MPI_STATUSES_IGNORE);
     SC_CHECK_MPI (mpiret);
+    P4EST_TRACE_END ("MPI_Waitall");
 
     /* free receive memory */
     P4EST_FREE (receive_requests);
@@ -3163,8 +4107,10 @@ p4est_partition_for_coarsening (p4est_t * p4est,
   /* BEGIN: wait for MPI send to complete */
   if (num_sends > 0) {
     /* wait for sends to complete */
+    P4EST_TRACE_BEGIN ("MPI_Waitall");
     mpiret = MPI_Waitall (num_sends, send_requests, MPI_STATUSES_IGNORE);
     SC_CHECK_MPI (mpiret);
+    P4EST_TRACE_END ("MPI_Waitall");
 
     /* free send memory */
     P4EST_FREE (parent_send);
@@ -3272,6 +4218,7 @@ p4est_save_ext (const char *filename, p4est_t * p4est,
   long                fpos = -1, foffset;
   size_t              data_size, qbuf_size, comb_size, head_count;
   size_t              zz, zcount;
+  double              start_time;
   uint64_t           *u64a;
   FILE               *file;
 #ifdef P4EST_MPIIO_WRITE
@@ -3291,6 +4238,7 @@ p4est_save_ext (const char *filename, p4est_t * p4est,
 
   P4EST_GLOBAL_PRODUCTIONF ("Into " P4EST_STRING "_save %s\n", filename);
   p4est_log_indent_push ();
+  start_time = sc_MPI_Wtime ();
 
   P4EST_ASSERT (p4est_connectivity_is_valid (p4est->connectivity));
   P4EST_ASSERT (p4est_is_valid (p4est));
@@ -3354,6 +4302,8 @@ p4est_save_ext (const char *filename, p4est_t * p4est,
     sc_fwrite (u64a, sizeof (uint64_t), head_count,
                file, "write header information");
     P4EST_FREE (u64a);
+    p4est->stats[P4EST_STAT_SAVE_BYTES] +=
+      (double) (head_count * sizeof (uint64_t));
     fpos += head_count * sizeof (uint64_t);
 
     /* align the start of the quadrants */
@@ -3453,6 +4403,7 @@ p4est_save_ext (const char *filename, p4est_t * p4est,
                   "write quadrants");
 #endif
     P4EST_FREE (lbuf);
+    p4est->stats[P4EST_STAT_SAVE_BYTES] += (double) (comb_size * zcount);
   }
 
 #ifndef P4EST_MPIIO_WRITE
@@ -3480,6 +4431,7 @@ p4est_save_ext (const char *filename, p4est_t * p4est,
   SC_CHECK_MPI (mpiret);
 #endif
 
+  p4est->stats[P4EST_STAT_SAVE_TIME] += sc_MPI_Wtime () - start_time;
   p4est_log_indent_pop ();
   P4EST_GLOBAL_PRODUCTION ("Done " P4EST_STRING "_save\n");
 }
@@ -3543,6 +4495,7 @@ p4est_source_ext (sc_io_source_t * src, sc_MPI_Comm mpicomm, size_t data_size,
   size_t              save_data_size;
   size_t              qbuf_size, comb_size, head_count;
   size_t              zz, zcount, zpadding;
+  double              start_time, read_bytes;
   p4est_topidx_t      jt, num_trees;
   p4est_gloidx_t     *gfq;
   p4est_gloidx_t     *pertree;
@@ -3555,6 +4508,7 @@ p4est_source_ext (sc_io_source_t * src, sc_MPI_Comm mpicomm, size_t data_size,
   /* set some parameters */
   P4EST_ASSERT (src->bytes_out == 0);
   P4EST_ASSERT (connectivity != NULL);
+  start_time = sc_MPI_Wtime ();
   if (data_size == 0) {
     load_data = 0;
   }
@@ -3681,8 +4635,10 @@ p4est_source_ext (sc_io_source_t * src, sc_MPI_Comm mpicomm, size_t data_size,
   file_offset += num_trees * sizeof (uint64_t);
 
   /* seek to the beginning of this processor's storage */
+  read_bytes = 0.;
   if (!broadcasthead || rank == root) {
     P4EST_ASSERT (file_offset == src->bytes_out);
+    read_bytes = (double) file_offset;
     file_offset = 0;
   }
   head_count = (size_t) (headc + save_num_procs) + (size_t) num_trees;
@@ -3726,6 +4682,7 @@ p4est_source_ext (sc_io_source_t * src, sc_MPI_Comm mpicomm, size_t data_size,
     dap += data_size;
   }
   P4EST_FREE (lbuf);
+  read_bytes += (double) (zcount * (load_data ? comb_size : qbuf_size));
 
   /* seek every process to the end of the source (in case there is data
    * appended to the end of this source) */
@@ -3747,6 +4704,8 @@ p4est_source_ext (sc_io_source_t * src, sc_MPI_Comm mpicomm, size_t data_size,
 
   /* assert that we loaded a valid forest and return */
   SC_CHECK_ABORT (p4est_is_valid (p4est), "invalid forest");
+  p4est->stats[P4EST_STAT_LOAD_BYTES] = read_bytes;
+  p4est->stats[P4EST_STAT_LOAD_TIME] = sc_MPI_Wtime () - start_time;
 
   return p4est;
 }
@@ -126,6 +126,11 @@ p4est_tree_t;
  */
 typedef struct p4est_inspect p4est_inspect_t;
 
+/** Neighborhood communicator cached by the balance exchange.
+ * Opaque; see \ref p4est_inspect::use_balance_neighbor.
+ */
+typedef struct p4est_balance_graph p4est_balance_graph_t;
+
 /** The p4est forest datatype */
 typedef struct p4est
 {
@@ -164,6 +169,9 @@ typedef struct p4est
   sc_mempool_t       *quadrant_pool;  /**< memory allocator for temporary
                                            quadrants */
   p4est_inspect_t    *inspect;        /**< algorithmic switches */
+  p4est_balance_graph_t *balance_graph;  /**< cached by balance, internal */
+  double              stats[P4EST_STAT_NUM];  /**< counters and timings,
+                                                 see p4est_stat_t */
 }
 p4est_t;
 
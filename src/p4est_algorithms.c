@@ -35,6 +35,7 @@
 #include <p4est_search.h>
 #include <p4est_balance.h>
 #endif /* !P4_TO_P8 */
+#include <p4est_trace.h>
 
 /* htonl is in either of these two */
 #ifdef P4EST_HAVE_ARPA_NET_H
@@ -747,6 +748,7 @@ p4est_tree_compute_overlap (p4est_t * p4est, sc_array_t * in,
   sc_array_t         *cta;
   sc_array_t         *tquadrants;
   sc_array_t         *seeds = NULL;
+  sc_array_t         *cands;
   p4est_quadrant_t   *neigharray[P4EST_CHILDREN];
   size_t              nneigh = -1;
 
@@ -778,6 +780,7 @@ p4est_tree_compute_overlap (p4est_t * p4est, sc_array_t * in,
   treecount = -1;
 
   seeds = sc_array_new (sizeof (p4est_quadrant_t));
+  cands = sc_array_new (sizeof (p4est_quadrant_t));
   first_tree = p4est->first_local_tree;
 
   /* loop over input list of quadrants */
@@ -1003,7 +1006,8 @@ p4est_tree_compute_overlap (p4est_t * p4est, sc_array_t * in,
 
         level = inq->level + 1;
 
-        /* copy relevant quadrants into out */
+        /* gather the leaves that may cause inq to split */
+        sc_array_resize (cands, 0);
         for (js = first_index; js <= last_index; ++js) {
           tq = p4est_quadrant_array_index (tquadrants, (size_t) js);
           if (tq->level <= level) {
@@ -1011,85 +1015,77 @@ p4est_tree_compute_overlap (p4est_t * p4est, sc_array_t * in,
           }
           if (f >= 0) {
             p4est_quadrant_face_neighbor (tq, f ^ 1, &tempq);
-            if (p4est_quadrant_is_ancestor (inq, &tempq)) {
-              continue;
-            }
-            split = p4est_balance_seeds_face (tq, inq, f, balance, seeds);
           }
 #ifdef P4_TO_P8
           else if (e >= 0) {
             p8est_quadrant_edge_neighbor (tq, e ^ 3, &tempq);
-            if (p4est_quadrant_is_ancestor (inq, &tempq)) {
-              continue;
-            }
-            split = p8est_balance_seeds_edge (tq, inq, e, balance, seeds);
           }
 #endif
           else {
             P4EST_ASSERT (c >= 0);
             p4est_quadrant_corner_neighbor (tq, (P4EST_CHILDREN - 1) ^ c,
                                             &tempq);
-            if (p4est_quadrant_is_ancestor (inq, &tempq)) {
-              continue;
-            }
-            split = p4est_balance_seeds_corner (tq, inq, c, balance, seeds);
           }
-          if (split) {
-            seedcount = seeds->elem_count;
-            for (jz = 0; jz < seedcount; jz++) {
-              u = p4est_quadrant_array_index (seeds, jz);
-              P4EST_ASSERT (p4est_quadrant_is_ancestor (inq, u));
-              if (inter_tree) {
-                if (contact_face_only) {
-                  P4EST_ASSERT (!contact_edge_only);
-                  P4EST_ASSERT (ntree == ftree);
-                  p4est_quadrant_transform_face (u, &tempq, ftransform);
-                  outq = p4est_quadrant_array_push (out);
-                  p4est_quadrant_sibling (&tempq, outq, 0);
-                  outq->p.piggy2.which_tree = ntree;
-                }
+          if (p4est_quadrant_is_ancestor (inq, &tempq)) {
+            continue;
+          }
+          *p4est_quadrant_array_push (cands) = *tq;
+        }
+
+        /* compute the seeds of all of them at once and copy them into out */
+        sc_array_resize (seeds, 0);
+        split = p4est_balance_seeds_batch (inq, cands, balance, seeds);
+        if (split) {
+          seedcount = seeds->elem_count;
+          for (jz = 0; jz < seedcount; jz++) {
+            u = p4est_quadrant_array_index (seeds, jz);
+            P4EST_ASSERT (p4est_quadrant_is_ancestor (inq, u));
+            if (inter_tree) {
+              if (contact_face_only) {
+                P4EST_ASSERT (!contact_edge_only);
+                P4EST_ASSERT (ntree == ftree);
+                p4est_quadrant_transform_face (u, &tempq, ftransform);
+                outq = p4est_quadrant_array_push (out);
+                p4est_quadrant_sibling (&tempq, outq, 0);
+                outq->p.piggy2.which_tree = ntree;
+              }
 #ifdef P4_TO_P8
-                else if (contact_edge_only) {
-                  P4EST_ASSERT (inq->pad16 >= 0 && inq->pad16 < P8EST_EDGES);
-                  for (etree = 0; etree < eta->elem_count; ++etree) {
-                    et = p8est_edge_array_index (eta, etree);
-                    if (et->ntree == ftree && et->nedge == inq->pad16) {
-                      p8est_quadrant_transform_edge (u, &tempq, &ei, et, 1);
-                      outq = p4est_quadrant_array_push (out);
-                      p4est_quadrant_sibling (&tempq, outq, 0);
-                      outq->p.piggy2.which_tree = et->ntree;
-                    }
+              else if (contact_edge_only) {
+                P4EST_ASSERT (inq->pad16 >= 0 && inq->pad16 < P8EST_EDGES);
+                for (etree = 0; etree < eta->elem_count; ++etree) {
+                  et = p8est_edge_array_index (eta, etree);
+                  if (et->ntree == ftree && et->nedge == inq->pad16) {
+                    p8est_quadrant_transform_edge (u, &tempq, &ei, et, 1);
+                    outq = p4est_quadrant_array_push (out);
+                    p4est_quadrant_sibling (&tempq, outq, 0);
+                    outq->p.piggy2.which_tree = et->ntree;
                   }
-                  et = NULL;
                 }
+                et = NULL;
+              }
 #endif
-                else {
-                  P4EST_ASSERT (corner >= 0);
-                  P4EST_ASSERT (inq->pad16 >= 0 &&
-                                inq->pad16 < P4EST_CHILDREN);
-                  for (ctree = 0; ctree < cta->elem_count; ++ctree) {
-                    ct = p4est_corner_array_index (cta, ctree);
-                    if (ct->ntree == ftree && ct->ncorner == inq->pad16) {
-                      p4est_quadrant_transform_corner (u, (int) ct->ncorner,
-                                                       1);
-                      outq = p4est_quadrant_array_push (out);
-                      p4est_quadrant_sibling (u, outq, 0);
-                      outq->p.piggy2.which_tree = ct->ntree;
-                    }
+              else {
+                P4EST_ASSERT (corner >= 0);
+                P4EST_ASSERT (inq->pad16 >= 0 &&
+                              inq->pad16 < P4EST_CHILDREN);
+                for (ctree = 0; ctree < cta->elem_count; ++ctree) {
+                  ct = p4est_corner_array_index (cta, ctree);
+                  if (ct->ntree == ftree && ct->ncorner == inq->pad16) {
+                    p4est_quadrant_transform_corner (u, (int) ct->ncorner,
+                                                     1);
+                    outq = p4est_quadrant_array_push (out);
+                    p4est_quadrant_sibling (u, outq, 0);
+                    outq->p.piggy2.which_tree = ct->ntree;
                   }
-                  ct = NULL;
                 }
-              }
-              else {
-                outq = p4est_quadrant_array_push (out);
-                p4est_quadrant_sibling (u, outq, 0);
-                outq->p.piggy2.which_tree = qtree;
-              }
-
-              if (c >= 0) {
-                level = SC_MAX (level, u->level);
+                ct = NULL;
               }
             }
+            else {
+              outq = p4est_quadrant_array_push (out);
+              p4est_quadrant_sibling (u, outq, 0);
+              outq->p.piggy2.which_tree = qtree;
+            }
           }
         }
       }
@@ -1108,6 +1104,7 @@ p4est_tree_compute_overlap (p4est_t * p4est, sc_array_t * in,
   sc_array_reset (cta);
 
   sc_array_destroy (seeds);
+  sc_array_destroy (cands);
 }
 
 void
@@ -1502,7 +1499,7 @@ p4est_complete_or_balance_kernel (sc_array_t * inlist,
 {
   int                 inserted;
   size_t              iz, jz;
-  size_t              incount, ocount;
+  size_t              incount, ocount, transient;
 #ifdef P4EST_ENABLE_DEBUG
   size_t              quadrant_pool_size;
   sc_array_t          outview;
@@ -1814,6 +1811,16 @@ p4est_complete_or_balance_kernel (sc_array_t * inlist,
     sc_array_resize (inlist, jz);
     incount = jz;
 
+    /* count the hash tables and lists at their largest size */
+    transient = sc_mempool_memory_used (list_alloc) +
+      sc_array_memory_used (inlist, 0) + sc_array_memory_used (out, 0);
+    for (l = minlevel + 1; l < maxlevel; ++l) {
+      transient += sc_hash_memory_used (hash[l]) +
+        sc_array_memory_used (&outlist[l], 0);
+    }
+    p4est_memory_hold (transient);
+    p4est_memory_release (transient);
+
     for (l = minlevel + 1; l < maxlevel; ++l) {
       /* print statistics and free hash tables */
 #ifdef P4EST_ENABLE_DEBUG
@@ -2013,6 +2020,29 @@ p4est_complete_or_balance_kernel (sc_array_t * inlist,
 
 }
 
+/** Add the counters of one local balance call to the inspect structure. */
+static void
+p4est_balance_inspect_counts (p4est_t * p4est, size_t count_already_inlist,
+                              size_t count_already_outlist,
+                              size_t count_ancestor_inlist)
+{
+  p4est_inspect_t    *inspect = p4est->inspect;
+
+  if (inspect == NULL) {
+    return;
+  }
+  if (!inspect->use_B) {
+    inspect->balance_A_count_in += count_already_inlist;
+    inspect->balance_A_count_in += count_ancestor_inlist;
+    inspect->balance_A_count_out += count_already_outlist;
+  }
+  else {
+    inspect->balance_B_count_in += count_already_inlist;
+    inspect->balance_B_count_in += count_ancestor_inlist;
+    inspect->balance_B_count_out += count_already_outlist;
+  }
+}
+
 static void
 p4est_balance_replace_recursive (p4est_t * p4est, p4est_topidx_t nt,
                                  sc_array_t * array, size_t start, size_t end,
@@ -2064,99 +2094,80 @@ p4est_balance_replace_recursive (p4est_t * p4est, p4est_topidx_t nt,
   }
 }
 
-static void
-p4est_complete_or_balance (p4est_t * p4est, p4est_topidx_t which_tree,
-                           p4est_init_t init_fn, p4est_replace_t replace_fn,
-                           int btype)
-{
-  p4est_tree_t       *tree;
-  sc_array_t         *tquadrants;
-  int                 bound;
-  int8_t              maxlevel;
-  sc_mempool_t       *qpool;
-#ifdef P4EST_ENABLE_DEBUG
-  size_t              data_pool_size;
-#endif
-  size_t              tcount;
-  size_t              count_already_inlist, count_already_outlist;
-  size_t              count_ancestor_inlist;
-  p4est_quadrant_t   *q, *p;
-  sc_mempool_t       *list_alloc;
-  sc_array_t         *inlist, *outlist;
-  size_t              iz, jz, jzstart = 0, jzend, ocount;
-  p4est_quadrant_t    tempq, root;
-
-  P4EST_ASSERT (which_tree >= p4est->first_local_tree);
-  P4EST_ASSERT (which_tree <= p4est->last_local_tree);
-  tree = p4est_tree_array_index (p4est->trees, which_tree);
-  tquadrants = &(tree->quadrants);
 
-  P4EST_ASSERT (0 <= btype && btype <= P4EST_DIM);
-  P4EST_ASSERT (sc_array_is_sorted (tquadrants, p4est_quadrant_compare));
+/** A range of leaves of a local tree that is balanced on its own. */
+typedef struct p4est_balance_piece
+{
+  p4est_topidx_t      which_tree;       /**< The local tree of the piece. */
+  p4est_quadrant_t    root;     /**< Ancestor or equal of all its leaves. */
+  size_t              first;    /**< Position of its first leaf in the tree. */
+  size_t              count;    /**< Number of its leaves in the tree. */
+  sc_array_t          outlist;  /**< The balanced leaves of the piece. */
+  sc_array_t          seeds;    /**< Leaves of other pieces with seeds. */
+  size_t              count_in, count_out, count_an;    /**< Kernel counts. */
+}
+p4est_balance_piece_t;
 
+/** Return the neighborhood bound of the kernel for a balance type. */
+static int
+p4est_balance_bound (int btype)
+{
   switch (btype) {
   case 0:
-    bound = 1;
-    break;
+    return 1;
   case 1:
-    bound = P4EST_DIM + 1;
-    break;
+    return P4EST_DIM + 1;
   case P4EST_DIM:
-    bound = (1 << P4EST_DIM);
-    break;
+    return (1 << P4EST_DIM);
 #ifdef P4_TO_P8
   case 2:
-    bound = 7;
-    break;
+    return 7;
 #endif
   default:
     SC_ABORT_NOT_REACHED ();
   }
+  return -1;
+}
 
-  qpool = p4est->quadrant_pool;
+/** Complete or balance the leaves of a piece into its outlist.
+ * The tree is only read, so the pieces may be computed concurrently if each
+ * thread passes its own pools.
+ * \param [in] tree         The tree that contains the leaves of the piece.
+ * \param [in,out] piece    The balanced leaves are appended to its outlist.
+ * \param [in] bound        The neighborhood bound of the kernel.
+ * \param [in,out] qpool    Quadrant pool for temporary quadrants.
+ * \param [in,out] list_alloc   Link pool for the hash tables.
+ */
+static void
+p4est_balance_piece_compute (p4est_tree_t * tree,
+                             p4est_balance_piece_t * piece, int bound,
+                             sc_mempool_t * qpool, sc_mempool_t * list_alloc)
+{
+  size_t              iz, transient;
+  p4est_quadrant_t   *q, *p;
+  p4est_quadrant_t   *first_desc, *last_desc;
+  p4est_quadrant_t    tempq;
+  sc_array_t         *tquadrants = &tree->quadrants;
+  sc_array_t         *inlist;
 
-#ifdef P4EST_ENABLE_DEBUG
-  data_pool_size = 0;
-  if (p4est->user_data_pool != NULL) {
-    data_pool_size = p4est->user_data_pool->elem_count;
-  }
-#endif
+  P4EST_ASSERT (piece->count > 0);
+  P4EST_ASSERT (piece->first + piece->count <= tquadrants->elem_count);
 
-  tcount = tquadrants->elem_count;
-  /* if tree is empty, there is nothing to do */
-  if (!tcount) {
+  if (piece->count == 1) {
+    /* a single leaf is balanced within its own extent */
+    p = p4est_quadrant_array_index (tquadrants, piece->first);
+    *p4est_quadrant_array_push (&piece->outlist) = *p;
     return;
   }
 
-  /* initialize some counters */
-  count_already_inlist = count_already_outlist = 0;
-  count_ancestor_inlist = 0;
-
-  /* get containing quadrant */
-  P4EST_QUADRANT_INIT (&root);
-  p4est_nearest_common_ancestor (&tree->first_desc, &tree->last_desc, &root);
-
-  if (tcount == 1) {
-    p = p4est_quadrant_array_index (tquadrants, 0);
-    if (p4est_quadrant_is_equal (p, &root)) {
-      /* nothing to be done, clean up and exit */
-      return;
-    }
-  }
-
-  /* initialize temporary storage */
-  list_alloc = sc_mempool_new (sizeof (sc_link_t));
-
+  /* get the reduced representation of the piece */
   inlist = sc_array_new (sizeof (p4est_quadrant_t));
-  outlist = sc_array_new (sizeof (p4est_quadrant_t));
-
-  /* get the reduced representation of the tree */
-  q = (p4est_quadrant_t *) sc_array_push (inlist);
-  p = p4est_quadrant_array_index (tquadrants, 0);
+  q = p4est_quadrant_array_push (inlist);
+  p = p4est_quadrant_array_index (tquadrants, piece->first);
   p4est_quadrant_sibling (p, q, 0);
-  for (iz = 1; iz < tcount; iz++) {
-    p = p4est_quadrant_array_index (tquadrants, iz);
-    P4EST_ASSERT (p4est_quadrant_is_ancestor (&root, p));
+  for (iz = 1; iz < piece->count; iz++) {
+    p = p4est_quadrant_array_index (tquadrants, piece->first + iz);
+    P4EST_ASSERT (p4est_quadrant_is_ancestor (&piece->root, p));
     p4est_nearest_common_ancestor (p, q, &tempq);
     if (tempq.level >= SC_MIN (q->level, p->level) - 1) {
       if (p->level > q->level) {
@@ -2164,20 +2175,70 @@ p4est_complete_or_balance (p4est_t * p4est, p4est_topidx_t which_tree,
       }
       continue;
     }
-    q = (p4est_quadrant_t *) sc_array_push (inlist);
+    q = p4est_quadrant_array_push (inlist);
     p4est_quadrant_sibling (p, q, 0);
   }
 
+  /* the root of a piece may reach beyond the local part of the tree */
+  first_desc = p4est_quadrant_is_ancestor (&piece->root, &tree->first_desc) ?
+    &tree->first_desc : NULL;
+  last_desc = p4est_quadrant_is_ancestor (&piece->root, &tree->last_desc) ?
+    &tree->last_desc : NULL;
+
   /* balance */
-  p4est_complete_or_balance_kernel (inlist, &root, bound, qpool,
-                                    list_alloc, outlist,
-                                    &(tree->first_desc),
-                                    &(tree->last_desc),
-                                    &count_already_inlist,
-                                    &count_already_outlist,
-                                    &count_ancestor_inlist);
+  p4est_complete_or_balance_kernel (inlist, &piece->root, bound, qpool,
+                                    list_alloc, &piece->outlist,
+                                    first_desc, last_desc,
+                                    &piece->count_in, &piece->count_out,
+                                    &piece->count_an);
+
+  /* count the reduced list while the output is alive */
+  transient = sc_array_memory_used (inlist, 1) +
+    sc_array_memory_used (&piece->outlist, 0);
+  p4est_memory_hold (transient);
+  p4est_memory_release (transient);
+  sc_array_destroy (inlist);
+}
+
+/** Replace the leaves of a tree by their completed or balanced refinement.
+ * The quadrant data is moved or initialized and the callbacks are called
+ * in the order of the leaves.  The tree counters are updated.
+ * \param [in,out] p4est    The forest whose tree is modified.
+ * \param [in] which_tree   The local tree to modify.
+ * \param [in] init_fn      Callback to initialize new quadrants.
+ * \param [in] replace_fn   Callback for each replaced leaf, may be NULL.
+ * \param [in,out] outlist  The sorted refinement of the tree's leaves.
+ *                          The data of its quadrants is assigned.
+ */
+static void
+p4est_complete_or_balance_apply (p4est_t * p4est, p4est_topidx_t which_tree,
+                                 p4est_init_t init_fn,
+                                 p4est_replace_t replace_fn,
+                                 sc_array_t * outlist)
+{
+  p4est_tree_t       *tree;
+  sc_array_t         *tquadrants;
+  int8_t              maxlevel;
+#ifdef P4EST_ENABLE_DEBUG
+  size_t              data_pool_size;
+#endif
+  size_t              tcount;
+  p4est_quadrant_t   *q, *p;
+  size_t              iz, jz, jzstart = 0, jzend, ocount;
+  p4est_quadrant_t    tempq;
 
+  tree = p4est_tree_array_index (p4est->trees, which_tree);
+  tquadrants = &(tree->quadrants);
+  tcount = tquadrants->elem_count;
   ocount = outlist->elem_count;
+  P4EST_ASSERT (tcount <= ocount);
+
+#ifdef P4EST_ENABLE_DEBUG
+  data_pool_size = 0;
+  if (p4est->user_data_pool != NULL) {
+    data_pool_size = p4est->user_data_pool->elem_count;
+  }
+#endif
 
   iz = 0;                       /* tquadrants */
   jz = 0;                       /* outlist */
@@ -2255,37 +2316,94 @@ p4est_complete_or_balance (p4est_t * p4est, p4est_topidx_t which_tree,
     P4EST_ASSERT (data_pool_size + (ocount - tcount) ==
                   p4est->user_data_pool->elem_count);
   }
+}
+
+static void
+p4est_complete_or_balance (p4est_t * p4est, p4est_topidx_t which_tree,
+                           p4est_init_t init_fn, p4est_replace_t replace_fn,
+                           int btype)
+{
+  p4est_tree_t       *tree;
+  sc_array_t         *tquadrants;
+  size_t              tcount, transient;
+  sc_mempool_t       *list_alloc;
+  p4est_balance_piece_t piece;
+
+  P4EST_ASSERT (which_tree >= p4est->first_local_tree);
+  P4EST_ASSERT (which_tree <= p4est->last_local_tree);
+  tree = p4est_tree_array_index (p4est->trees, which_tree);
+  tquadrants = &(tree->quadrants);
+
+  P4EST_ASSERT (0 <= btype && btype <= P4EST_DIM);
+  P4EST_ASSERT (sc_array_is_sorted (tquadrants, p4est_quadrant_compare));
+
+  tcount = tquadrants->elem_count;
+  /* if tree is empty, there is nothing to do */
+  if (!tcount) {
+    return;
+  }
+
+  /* the whole tree is one piece within its containing quadrant */
+  piece.which_tree = which_tree;
+  P4EST_QUADRANT_INIT (&piece.root);
+  p4est_nearest_common_ancestor (&tree->first_desc, &tree->last_desc,
+                                 &piece.root);
+  piece.first = 0;
+  piece.count = tcount;
+  if (tcount == 1 && p4est_quadrant_is_equal
+      (p4est_quadrant_array_index (tquadrants, 0), &piece.root)) {
+    /* nothing to be done */
+    return;
+  }
+  piece.count_in = piece.count_out = piece.count_an = 0;
+  sc_array_init (&piece.outlist, sizeof (p4est_quadrant_t));
+
+  /* balance and replace the leaves */
+  list_alloc = sc_mempool_new (sizeof (sc_link_t));
+  p4est_balance_piece_compute (tree, &piece, p4est_balance_bound (btype),
+                               p4est->quadrant_pool, list_alloc);
+  p4est_complete_or_balance_apply (p4est, which_tree, init_fn, replace_fn,
+                                   &piece.outlist);
 
   P4EST_VERBOSEF
     ("Tree %lld inlist %llu outlist %llu ancestor %llu insert %llu\n",
-     (long long) which_tree, (unsigned long long) count_already_inlist,
-     (unsigned long long) count_already_outlist,
-     (unsigned long long) count_ancestor_inlist,
-     (unsigned long long) (ocount - tcount));
-
-  sc_array_destroy (inlist);
-  sc_array_destroy (outlist);
+     (long long) which_tree, (unsigned long long) piece.count_in,
+     (unsigned long long) piece.count_out,
+     (unsigned long long) piece.count_an,
+     (unsigned long long) (tquadrants->elem_count - tcount));
+
+  /* count the temporary list and pool before they are freed */
+  transient = sc_array_memory_used (&piece.outlist, 0) +
+    sc_mempool_memory_used (list_alloc);
+  p4est_memory_hold (transient);
+  p4est_memory_release (transient);
+
+  sc_array_reset (&piece.outlist);
   sc_mempool_destroy (list_alloc);
 
-  if (p4est->inspect) {
-    if (!p4est->inspect->use_B) {
-      p4est->inspect->balance_A_count_in += count_already_inlist;
-      p4est->inspect->balance_A_count_in += count_ancestor_inlist;
-      p4est->inspect->balance_A_count_out += count_already_outlist;
-    }
-    else {
-      p4est->inspect->balance_B_count_in += count_already_inlist;
-      p4est->inspect->balance_B_count_in += count_ancestor_inlist;
-      p4est->inspect->balance_B_count_out += count_already_outlist;
-    }
-  }
+  p4est_balance_inspect_counts (p4est, piece.count_in, piece.count_out,
+                                piece.count_an);
+}
+
+/** A border quadrant with its descendants, balanced independently. */
+typedef struct p4est_balance_border_job
+{
+  p4est_quadrant_t    root;     /**< The border quadrant in the tree. */
+  size_t              tqindex;  /**< Position of the root in the tree. */
+  sc_array_t          inlist;   /**< Reduced descendants from the border. */
+  sc_array_t          outlist;  /**< Balanced quadrants replacing root. */
 }
+p4est_balance_border_job_t;
 
 void
 p4est_balance_border (p4est_t * p4est, p4est_connect_type_t btype,
                       p4est_topidx_t which_tree, p4est_init_t init_fn,
                       p4est_replace_t replace_fn, sc_array_t * borders)
 {
+#ifdef SC_ENABLE_OPENMP
+  int                 num_threads;
+#endif
+  long                lj, num_jobs;
   size_t              iz, jz, kz;
   size_t              incount;
   size_t              count_already_inlist, count_already_outlist;
@@ -2296,13 +2414,16 @@ p4est_balance_border (p4est_t * p4est, p4est_connect_type_t btype,
   sc_array_t          qview;
   sc_array_t         *inlist, *flist, *tquadrants;
   sc_array_t          tqview;
+  sc_array_t         *jobs;
   size_t              tqoffset, fcount;
+  size_t              transient, outlists, bytes;
   p4est_topidx_t      first_tree = p4est->first_local_tree;
   size_t              num_added, num_this_added;
   int                 bound;
   ssize_t             tqindex;
   size_t              tqorig;
   sc_mempool_t       *list_alloc, *qpool;
+  p4est_balance_border_job_t *job;
   /* get this tree's border */
   sc_array_t         *qarray = (sc_array_t *) sc_array_index (borders,
                                                               which_tree -
@@ -2341,18 +2462,10 @@ p4est_balance_border (p4est_t * p4est, p4est_connect_type_t btype,
   sc_array_init_view (&tqview, tquadrants, tqoffset,
                       tquadrants->elem_count - tqoffset);
 
-  qpool = p4est->quadrant_pool;
-
   count_already_inlist = count_already_outlist = 0;
   count_ancestor_inlist = 0;
   num_added = 0;
 
-  /* initialize temporary storage */
-  list_alloc = sc_mempool_new (sizeof (sc_link_t));
-
-  inlist = sc_array_new (sizeof (p4est_quadrant_t));
-  flist = sc_array_new (sizeof (p4est_quadrant_t));
-
   /* sort the border and remove duplicates */
   sc_array_sort (qarray, p4est_quadrant_compare);
   jz = 1;                       /* number included */
@@ -2377,7 +2490,8 @@ p4est_balance_border (p4est_t * p4est, p4est_connect_type_t btype,
   sc_array_resize (qarray, jz);
   qcount = jz;
 
-  /* step through border */
+  /* step through border and collect the subtrees to balance */
+  jobs = sc_array_new (sizeof (p4est_balance_border_job_t));
   for (iz = 0; iz < qcount; iz++) {
     p = p4est_quadrant_array_index (qarray, iz);
 
@@ -2419,30 +2533,17 @@ p4est_balance_border (p4est_t * p4est, p4est_connect_type_t btype,
 
     P4EST_ASSERT (tqindex >= 0);
 
-    /* copy everything before p into flist */
-    if (tqindex) {
-      fcount = flist->elem_count;
-      sc_array_resize (flist, fcount + tqindex);
-      memcpy (sc_array_index (flist, fcount),
-              tqview.array, tqindex * sizeof (p4est_quadrant_t));
-    }
-
     /* update the view of tquadrants to be everything past p */
     tqindex += tqoffset;        /* tqindex is the index of p in tquadrants */
     tqoffset = tqindex + 1;
     sc_array_init_view (&tqview, tquadrants, tqoffset, tqorig - tqoffset);
 
-    /* first, remove p */
-    q = p4est_quadrant_array_index (tquadrants, tqindex);
-    P4EST_ASSERT (p4est_quadrant_is_equal (q, p));
-    /* reset the data, decrement level count */
-    if (replace_fn == NULL) {
-      p4est_quadrant_free_data (p4est, q);
-    }
-    else {
-      tempp = *q;
-    }
-    --tree->quadrants_per_level[q->level];
+    job = (p4est_balance_border_job_t *) sc_array_push (jobs);
+    job->root = *p;
+    job->tqindex = (size_t) tqindex;
+    inlist = &job->inlist;
+    sc_array_init (inlist, sizeof (p4est_quadrant_t));
+    sc_array_init (&job->outlist, sizeof (p4est_quadrant_t));
 
     /* get all of the quadrants that descend from p into inlist */
     sc_array_init_view (&qview, qarray, jz, incount);
@@ -2465,14 +2566,94 @@ p4est_balance_border (p4est_t * p4est, p4est_connect_type_t btype,
       *q = *r;
     }
 
-    fcount = flist->elem_count;
+    /* skip over the quadrants that we just collected */
+    iz = kz - 1;
+  }
+
+  /* balance the subtrees within their containing quads; they do not
+   * interact, so they may be distributed over threads */
+  num_jobs = (long) jobs->elem_count;
+  transient = sc_array_memory_used (jobs, 1);
+  for (lj = 0; lj < num_jobs; ++lj) {
+    job = (p4est_balance_border_job_t *) sc_array_index (jobs, lj);
+    transient += sc_array_memory_used (&job->inlist, 0);
+  }
+  p4est_memory_hold (transient);
+#ifdef SC_ENABLE_OPENMP
+  num_threads = 1;
+  if (p4est->inspect != NULL && p4est->inspect->balance_num_threads > 1) {
+    num_threads = p4est->inspect->balance_num_threads;
+  }
+#pragma omp parallel num_threads (num_threads) if (num_jobs > 1) \
+  private (lj, job, qpool, list_alloc, bytes) \
+  reduction (+:count_already_inlist, count_already_outlist, \
+             count_ancestor_inlist)
+#endif
+  {
+    /* initialize temporary storage */
+    qpool = sc_mempool_new (sizeof (p4est_quadrant_t));
+    list_alloc = sc_mempool_new (sizeof (sc_link_t));
+#ifdef SC_ENABLE_OPENMP
+#pragma omp for schedule (dynamic)
+#endif
+    for (lj = 0; lj < num_jobs; ++lj) {
+      job = (p4est_balance_border_job_t *) sc_array_index (jobs, lj);
+      p4est_complete_or_balance_kernel (&job->inlist, &job->root, bound,
+                                        qpool, list_alloc, &job->outlist,
+                                        NULL, NULL,
+                                        &count_already_inlist,
+                                        &count_already_outlist,
+                                        &count_ancestor_inlist);
+    }
+    bytes = sc_mempool_memory_used (list_alloc) +
+      sc_mempool_memory_used (qpool);
+    p4est_memory_hold (bytes);
+    p4est_memory_release (bytes);
+    sc_mempool_destroy (list_alloc);
+    sc_mempool_destroy (qpool);
+  }
+  outlists = 0;
+  for (lj = 0; lj < num_jobs; ++lj) {
+    job = (p4est_balance_border_job_t *) sc_array_index (jobs, lj);
+    outlists += sc_array_memory_used (&job->outlist, 0);
+  }
+  p4est_memory_hold (outlists);
+  transient += outlists;
+
+  /* replace each subtree root by its balanced quadrants in order */
+  flist = sc_array_new (sizeof (p4est_quadrant_t));
+  tqoffset = 0;
+  for (lj = 0; lj < num_jobs; ++lj) {
+    job = (p4est_balance_border_job_t *) sc_array_index (jobs, lj);
+    p = &job->root;
 
-    /* balance them within the containing quad */
-    p4est_complete_or_balance_kernel (inlist, p, bound, qpool, list_alloc,
-                                      flist, NULL, NULL,
-                                      &count_already_inlist,
-                                      &count_already_outlist,
-                                      &count_ancestor_inlist);
+    /* copy everything before p into flist */
+    if (job->tqindex > tqoffset) {
+      fcount = flist->elem_count;
+      sc_array_resize (flist, fcount + job->tqindex - tqoffset);
+      memcpy (sc_array_index (flist, fcount),
+              sc_array_index (tquadrants, tqoffset),
+              (job->tqindex - tqoffset) * sizeof (p4est_quadrant_t));
+    }
+    tqoffset = job->tqindex + 1;
+
+    /* first, remove p */
+    q = p4est_quadrant_array_index (tquadrants, job->tqindex);
+    P4EST_ASSERT (p4est_quadrant_is_equal (q, p));
+    /* reset the data, decrement level count */
+    if (replace_fn == NULL) {
+      p4est_quadrant_free_data (p4est, q);
+    }
+    else {
+      tempp = *q;
+    }
+    --tree->quadrants_per_level[q->level];
+
+    /* append the balanced quadrants */
+    fcount = flist->elem_count;
+    sc_array_resize (flist, fcount + job->outlist.elem_count);
+    memcpy (sc_array_index (flist, fcount), job->outlist.array,
+            job->outlist.elem_count * sizeof (p4est_quadrant_t));
 
     /* count the amount we've added (-1 because we subtract p) */
     num_this_added = flist->elem_count - 1 - fcount;
@@ -2491,17 +2672,25 @@ p4est_balance_border (p4est_t * p4est, p4est_connect_type_t btype,
                                        flist, fcount, flist->elem_count,
                                        &tempp, init_fn, replace_fn);
     }
-
-    /* skip over the quadrants that we just operated on */
-    iz = kz - 1;
   }
+  bytes = sc_array_memory_used (flist, 1);
+  p4est_memory_hold (bytes);
+  p4est_memory_release (bytes);
+  for (lj = 0; lj < num_jobs; ++lj) {
+    job = (p4est_balance_border_job_t *) sc_array_index (jobs, lj);
+    sc_array_reset (&job->inlist);
+    sc_array_reset (&job->outlist);
+  }
+  sc_array_destroy (jobs);
+  p4est_memory_release (transient);
 
   /* copy the remaining tquadrants to flist */
   if (tqoffset < tqorig) {
     fcount = flist->elem_count;
     sc_array_resize (flist, fcount + tqorig - tqoffset);
     memcpy (sc_array_index (flist, fcount),
-            tqview.array, (tqorig - tqoffset) * sizeof (p4est_quadrant_t));
+            sc_array_index (tquadrants, tqoffset),
+            (tqorig - tqoffset) * sizeof (p4est_quadrant_t));
   }
 
   /* copy flist into tquadrants */
@@ -2509,7 +2698,6 @@ p4est_balance_border (p4est_t * p4est, p4est_connect_type_t btype,
   memcpy (tquadrants->array, flist->array,
           flist->elem_count * flist->elem_size);
 
-  sc_mempool_destroy (list_alloc);
   P4EST_ASSERT (tqorig + num_added == tquadrants->elem_count);
 
   /* print more statistics */
@@ -2520,18 +2708,400 @@ p4est_balance_border (p4est_t * p4est, p4est_connect_type_t btype,
      (unsigned long long) count_ancestor_inlist,
      (unsigned long long) num_added);
 
-  sc_array_destroy (inlist);
   sc_array_destroy (flist);
 
   P4EST_ASSERT (p4est_tree_is_complete (tree));
 
-  if (p4est->inspect) {
-    p4est->inspect->balance_B_count_in += count_already_inlist;
-    p4est->inspect->balance_B_count_in += count_ancestor_inlist;
-    p4est->inspect->balance_B_count_out += count_already_outlist;
+  p4est_balance_inspect_counts (p4est, count_already_inlist,
+                                count_already_outlist, count_ancestor_inlist);
+}
+
+/** Collect the leaves of one piece that are split by other pieces.
+ * Each split leaf is followed by its seeds, which is the input format of
+ * \ref p4est_balance_border.  A leaf can only be split by the smaller
+ * leaves in its insulation layer.  The tree is only read, so the pieces may
+ * be processed concurrently.
+ * \param [in] p4est        The forest after the pieces have been applied.
+ * \param [in,out] piece    The leaves in its range at the boundary of its
+ *                          root are examined and the
+ *                          split leaves and seeds are appended to its seeds.
+ * \param [in] btype        The balance type.
+ * \param [in,out] seeds    Temporary array of quadrants.
+ */
+static void
+p4est_balance_piece_seeds (p4est_t * p4est, p4est_balance_piece_t * piece,
+                           p4est_connect_type_t btype, sc_array_t * seeds)
+{
+  int                 k, l, m, which;
+  size_t              iz, jz, last;
+  ssize_t             first_index, last_index;
+  p4est_qcoord_t      ph, rh;
+  p4est_quadrant_t   *p, *r, *u, s, ld;
+  p4est_quadrant_t   *root = &piece->root;
+  p4est_tree_t       *tree;
+  sc_array_t         *tquadrants;
+  sc_array_t          view;
+
+  tree = p4est_tree_array_index (p4est->trees, piece->which_tree);
+  tquadrants = &tree->quadrants;
+  rh = P4EST_QUADRANT_LEN (root->level);
+  last = piece->first + piece->count;
+  P4EST_ASSERT (last <= tquadrants->elem_count);
+  P4EST_QUADRANT_INIT (&ld);
+  for (iz = piece->first; iz < last; ++iz) {
+    p = p4est_quadrant_array_index (tquadrants, iz);
+    if ((int) p->level + 1 >= (int) tree->maxlevel) {
+      /* there is no leaf small enough to split p */
+      continue;
+    }
+
+    /* only a leaf at the boundary of its piece reaches into other pieces */
+    ph = P4EST_QUADRANT_LEN (p->level);
+    if (p->x > root->x && p->x + ph < root->x + rh &&
+        p->y > root->y && p->y + ph < root->y + rh &&
+#ifdef P4_TO_P8
+        p->z > root->z && p->z + ph < root->z + rh &&
+#endif
+        1) {
+      continue;
+    }
+
+    /* loop over the insulation layer of p */
+    sc_array_truncate (seeds);
+#ifdef P4_TO_P8
+    for (m = 0; m < 3; ++m) {
+#if 0
+    }
+#endif
+#else
+    m = 0;
+#endif
+    for (k = 0; k < 3; ++k) {
+      for (l = 0; l < 3; ++l) {
+        which = m * 9 + k * 3 + l;      /* 2D: 0..8, 3D: 0..26 */
+        if (which == P4EST_INSUL / 2) {
+          continue;
+        }
+        s = *p;
+        s.x += (l - 1) * ph;
+        s.y += (k - 1) * ph;
+#ifdef P4_TO_P8
+        s.z += (m - 1) * ph;
+#endif
+        if (!p4est_quadrant_is_inside_root (&s) ||
+            p4est_quadrant_is_ancestor (root, &s)) {
+          /* this is another tree or the piece of p itself */
+          continue;
+        }
+
+        /* the leaves within s may cause p to split */
+        first_index = p4est_find_lower_bound (tquadrants, &s, iz);
+        if (first_index < 0) {
+          continue;
+        }
+        p4est_quadrant_last_descendant (&s, &ld, P4EST_QMAXLEVEL);
+        last_index = p4est_find_higher_bound (tquadrants, &ld,
+                                              (size_t) first_index);
+        if (last_index < first_index) {
+          continue;
+        }
+        sc_array_init_view (&view, tquadrants, (size_t) first_index,
+                            (size_t) (last_index - first_index + 1));
+        p4est_balance_seeds_batch (p, &view, btype, seeds);
+      }
+    }
+#ifdef P4_TO_P8
+#if 0
+    {
+#endif
+    }
+#endif
+
+    /* record p followed by the seeds that split it */
+    if (seeds->elem_count > 0) {
+      r = p4est_quadrant_array_push (&piece->seeds);
+      *r = *p;
+      for (jz = 0; jz < seeds->elem_count; ++jz) {
+        u = p4est_quadrant_array_index (seeds, jz);
+        P4EST_ASSERT (p4est_quadrant_is_ancestor (p, u));
+        r = p4est_quadrant_array_push (&piece->seeds);
+        p4est_quadrant_sibling (u, r, 0);
+      }
+    }
   }
 }
 
+void
+p4est_balance_local (p4est_t * p4est, p4est_connect_type_t btype,
+                     p4est_init_t init_fn, p4est_replace_t replace_fn)
+{
+  const p4est_topidx_t first_tree = p4est->first_local_tree;
+  const p4est_topidx_t last_tree = p4est->last_local_tree;
+  int                 num_threads, bound, level, n;
+  long                lj, num_pieces;
+  size_t              iz, jz, zz, tcount, all_count, localcount;
+  size_t              pcount, ocount, num_split;
+  size_t              transient, bytes;
+  size_t              count_in, count_out, count_an;
+  size_t             *tree_pieces;
+  p4est_topidx_t      nt;
+  p4est_tree_t       *tree;
+  p4est_quadrant_t   *q, root, r;
+  p4est_balance_piece_t *piece;
+  sc_array_t         *pieces, *borders, *qarray, *outlist, *seeds;
+  sc_array_t          tlist;
+  sc_mempool_t       *qpool, *list_alloc;
+
+  if (first_tree < 0) {
+    /* there are no local trees */
+    return;
+  }
+  P4EST_ASSERT (first_tree <= last_tree);
+  localcount = (size_t) (last_tree + 1 - first_tree);
+
+  num_threads = 1;
+  if (p4est->inspect != NULL && p4est->inspect->balance_num_threads > 1) {
+    num_threads = p4est->inspect->balance_num_threads;
+  }
+  bound = p4est_balance_bound (p4est_connect_type_int (btype));
+
+  all_count = 0;
+  for (nt = first_tree; nt <= last_tree; ++nt) {
+    tree = p4est_tree_array_index (p4est->trees, nt);
+    all_count += tree->quadrants.elem_count;
+  }
+
+  /* cut the trees into pieces; a tree with more than its share of the
+   * quadrants is split into the subtrees below a common level */
+  pieces = sc_array_new (sizeof (p4est_balance_piece_t));
+  tree_pieces = P4EST_ALLOC (size_t, localcount + 1);
+  piece = NULL;
+  for (nt = first_tree; nt <= last_tree; ++nt) {
+    tree_pieces[nt - first_tree] = pieces->elem_count;
+    tree = p4est_tree_array_index (p4est->trees, nt);
+    tcount = tree->quadrants.elem_count;
+    P4EST_ASSERT (sc_array_is_sorted (&tree->quadrants,
+                                      p4est_quadrant_compare));
+
+    /* initial log message for this tree */
+    P4EST_VERBOSEF ("Into balance tree %lld with %llu\n", (long long) nt,
+                    (unsigned long long) tcount);
+    if (tcount == 0) {
+      continue;
+    }
+
+    /* get containing quadrant */
+    P4EST_QUADRANT_INIT (&root);
+    p4est_nearest_common_ancestor (&tree->first_desc, &tree->last_desc,
+                                   &root);
+    level = (int) root.level;
+    if (num_threads > 1 && tcount > 1 && tcount > all_count / num_threads) {
+      /* aim at a few subtrees per thread */
+      P4EST_ASSERT (p4est_tree_is_complete (tree));
+      for (n = 1; n < 4 * num_threads && level < P4EST_QMAXLEVEL;
+           n *= P4EST_CHILDREN) {
+        ++level;
+      }
+    }
+    for (iz = 0; iz < tcount; ++iz) {
+      q = p4est_quadrant_array_index (&tree->quadrants, iz);
+      if (q->level > level) {
+        p4est_quadrant_ancestor (q, level, &r);
+      }
+      else {
+        /* a leaf not below the common level is a piece of its own */
+        r = *q;
+      }
+      if (iz == 0 || !p4est_quadrant_is_equal (&r, &piece->root)) {
+        piece = (p4est_balance_piece_t *) sc_array_push (pieces);
+        piece->which_tree = nt;
+        piece->root = r;
+        piece->first = iz;
+        piece->count = 0;
+        sc_array_init (&piece->outlist, sizeof (p4est_quadrant_t));
+        sc_array_init (&piece->seeds, sizeof (p4est_quadrant_t));
+        piece->count_in = piece->count_out = piece->count_an = 0;
+      }
+      ++piece->count;
+    }
+  }
+  tree_pieces[localcount] = pieces->elem_count;
+
+  /* balance the pieces independently; the trees are only read */
+  num_pieces = (long) pieces->elem_count;
+#ifdef SC_ENABLE_OPENMP
+#pragma omp parallel num_threads (num_threads) if (num_pieces > 1) \
+  private (lj, piece, qpool, list_alloc, bytes)
+#endif
+  {
+    /* initialize temporary storage */
+    qpool = sc_mempool_new (sizeof (p4est_quadrant_t));
+    list_alloc = sc_mempool_new (sizeof (sc_link_t));
+#ifdef SC_ENABLE_OPENMP
+#pragma omp for schedule (dynamic)
+#endif
+    for (lj = 0; lj < num_pieces; ++lj) {
+      piece = (p4est_balance_piece_t *) sc_array_index (pieces, lj);
+      p4est_balance_piece_compute (p4est_tree_array_index
+                                   (p4est->trees, piece->which_tree),
+                                   piece, bound, qpool, list_alloc);
+    }
+    bytes = sc_mempool_memory_used (list_alloc) +
+      sc_mempool_memory_used (qpool);
+    p4est_memory_hold (bytes);
+    p4est_memory_release (bytes);
+    sc_mempool_destroy (list_alloc);
+    sc_mempool_destroy (qpool);
+  }
+  transient = sc_array_memory_used (pieces, 1);
+  for (lj = 0; lj < num_pieces; ++lj) {
+    piece = (p4est_balance_piece_t *) sc_array_index (pieces, lj);
+    transient += sc_array_memory_used (&piece->outlist, 0);
+  }
+  p4est_memory_hold (transient);
+
+  /* replace the leaves of each tree serially, so the callbacks are called
+   * in order and the tree arrays are never resized concurrently */
+  sc_array_init (&tlist, sizeof (p4est_quadrant_t));
+  count_in = count_out = count_an = 0;
+  for (nt = first_tree; nt <= last_tree; ++nt) {
+    zz = (size_t) (nt - first_tree);
+    pcount = tree_pieces[zz + 1] - tree_pieces[zz];
+    if (pcount == 0) {
+      continue;
+    }
+    if (pcount == 1) {
+      piece = (p4est_balance_piece_t *)
+        sc_array_index (pieces, tree_pieces[zz]);
+      outlist = &piece->outlist;
+    }
+    else {
+      sc_array_truncate (&tlist);
+      for (jz = tree_pieces[zz]; jz < tree_pieces[zz + 1]; ++jz) {
+        piece = (p4est_balance_piece_t *) sc_array_index (pieces, jz);
+        piece->first = ocount = tlist.elem_count;
+        piece->count = piece->outlist.elem_count;
+        sc_array_resize (&tlist, ocount + piece->outlist.elem_count);
+        memcpy (sc_array_index (&tlist, ocount), piece->outlist.array,
+                piece->outlist.elem_count * sizeof (p4est_quadrant_t));
+      }
+      outlist = &tlist;
+    }
+    for (jz = tree_pieces[zz]; jz < tree_pieces[zz + 1]; ++jz) {
+      piece = (p4est_balance_piece_t *) sc_array_index (pieces, jz);
+      count_in += piece->count_in;
+      count_out += piece->count_out;
+      count_an += piece->count_an;
+    }
+    p4est_complete_or_balance_apply (p4est, nt, init_fn, replace_fn,
+                                     outlist);
+  }
+  bytes = sc_array_memory_used (&tlist, 0);
+  p4est_memory_hold (bytes);
+  p4est_memory_release (bytes);
+  sc_array_reset (&tlist);
+
+  /* the seeds only see the current leaves of the other pieces, and the
+   * leaves refined by the border balance may split leaves of neighboring
+   * pieces in turn, so we repeat until no leaf is split anymore */
+  borders = sc_array_new_size (sizeof (sc_array_t), localcount);
+  for (zz = 0; zz < localcount; ++zz) {
+    qarray = (sc_array_t *) sc_array_index (borders, zz);
+    sc_array_init (qarray, sizeof (p4est_quadrant_t));
+  }
+  do {
+    /* find the leaves that the pieces of a split tree split in each other */
+#ifdef SC_ENABLE_OPENMP
+#pragma omp parallel num_threads (num_threads) if (num_pieces > 1) \
+  private (lj, piece, zz, seeds)
+#endif
+    {
+      seeds = sc_array_new (sizeof (p4est_quadrant_t));
+#ifdef SC_ENABLE_OPENMP
+#pragma omp for schedule (dynamic)
+#endif
+      for (lj = 0; lj < num_pieces; ++lj) {
+        piece = (p4est_balance_piece_t *) sc_array_index (pieces, lj);
+        zz = (size_t) (piece->which_tree - first_tree);
+        if (tree_pieces[zz + 1] - tree_pieces[zz] > 1) {
+          p4est_balance_piece_seeds (p4est, piece, btype, seeds);
+        }
+      }
+      sc_array_destroy (seeds);
+    }
+
+    /* balance the split leaves with their seeds within the split trees */
+    num_split = 0;
+    for (nt = first_tree; nt <= last_tree; ++nt) {
+      zz = (size_t) (nt - first_tree);
+      if (tree_pieces[zz + 1] - tree_pieces[zz] <= 1) {
+        continue;
+      }
+      qarray = (sc_array_t *) sc_array_index (borders, zz);
+      for (jz = tree_pieces[zz]; jz < tree_pieces[zz + 1]; ++jz) {
+        piece = (p4est_balance_piece_t *) sc_array_index (pieces, jz);
+        ocount = qarray->elem_count;
+        sc_array_resize (qarray, ocount + piece->seeds.elem_count);
+        memcpy (sc_array_index (qarray, ocount), piece->seeds.array,
+                piece->seeds.elem_count * sizeof (p4est_quadrant_t));
+        sc_array_truncate (&piece->seeds);
+      }
+      if (qarray->elem_count == 0) {
+        continue;
+      }
+      num_split += qarray->elem_count;
+      bytes = sc_array_memory_used (qarray, 0);
+      p4est_memory_hold (bytes);
+      p4est_balance_border (p4est, btype, nt, init_fn, replace_fn, borders);
+      p4est_memory_release (bytes);
+      sc_array_truncate (qarray);
+
+      /* the leaves of each piece remain below its root */
+      tree = p4est_tree_array_index (p4est->trees, nt);
+      tcount = tree->quadrants.elem_count;
+      iz = 0;
+      for (jz = tree_pieces[zz]; jz < tree_pieces[zz + 1]; ++jz) {
+        piece = (p4est_balance_piece_t *) sc_array_index (pieces, jz);
+        piece->first = iz;
+        for (; iz < tcount; ++iz) {
+          q = p4est_quadrant_array_index (&tree->quadrants, iz);
+          if (!p4est_quadrant_is_equal (&piece->root, q) &&
+              !p4est_quadrant_is_ancestor (&piece->root, q)) {
+            break;
+          }
+        }
+        piece->count = iz - piece->first;
+        P4EST_ASSERT (piece->count > 0);
+      }
+      P4EST_ASSERT (iz == tcount);
+    }
+  }
+  while (num_split > 0);
+  for (nt = first_tree; nt <= last_tree; ++nt) {
+    qarray = (sc_array_t *) sc_array_index (borders, nt - first_tree);
+    sc_array_reset (qarray);
+    tree = p4est_tree_array_index (p4est->trees, nt);
+    P4EST_VERBOSEF ("Balance tree %lld A %llu\n", (long long) nt,
+                    (unsigned long long) tree->quadrants.elem_count);
+  }
+  sc_array_destroy (borders);
+
+  P4EST_VERBOSEF
+    ("Local balance pieces %ld inlist %llu outlist %llu ancestor %llu\n",
+     num_pieces, (unsigned long long) count_in,
+     (unsigned long long) count_out, (unsigned long long) count_an);
+  p4est_balance_inspect_counts (p4est, count_in, count_out, count_an);
+
+  for (lj = 0; lj < num_pieces; ++lj) {
+    piece = (p4est_balance_piece_t *) sc_array_index (pieces, lj);
+    sc_array_reset (&piece->outlist);
+    sc_array_reset (&piece->seeds);
+  }
+  sc_array_destroy (pieces);
+  P4EST_FREE (tree_pieces);
+  p4est_memory_release (transient);
+}
+
 void
 p4est_complete_subtree (p4est_t * p4est,
                         p4est_topidx_t which_tree, p4est_init_t init_fn)
@@ -2730,6 +3300,8 @@ p4est_partition_given (p4est_t * p4est,
   char               *user_data_recv_buf;
   char              **recv_buf, **send_buf;
   size_t              recv_size, send_size, zz, zoffset;
+  p4est_memory_peak_t memory;
+  double              start_time;
   p4est_topidx_t      it;
   p4est_topidx_t      which_tree;
   p4est_topidx_t      first_tree, last_tree;
@@ -2773,6 +3345,9 @@ p4est_partition_given (p4est_t * p4est,
   P4EST_GLOBAL_INFOF
     ("Into " P4EST_STRING "_partition_given with %lld total quadrants\n",
      (long long) p4est->global_num_quadrants);
+  P4EST_TRACE_BEGIN (P4EST_STRING "_partition_given");
+  start_time = sc_MPI_Wtime ();
+  p4est_memory_peak_begin (&memory);
 
 #ifdef P4EST_ENABLE_DEBUG
   /* Save a checksum of the original forest */
@@ -2911,6 +3486,8 @@ p4est_partition_given (p4est_t * p4est,
         + quad_plus_data_size * num_recv_from[from_proc];
 
       recv_buf[from_proc] = P4EST_ALLOC (char, recv_size);
+      p4est->stats[P4EST_STAT_PARTITION_PEERS] += 1.;
+      p4est->stats[P4EST_STAT_PARTITION_BYTES] += (double) recv_size;
 
       /* Post receives for the quadrants and their data */
 #ifdef P4EST_ENABLE_MPI
@@ -2920,6 +3497,8 @@ p4est_partition_given (p4est_t * p4est,
                           from_proc, P4EST_COMM_PARTITION_GIVEN,
                           comm, recv_request + sk);
       SC_CHECK_MPI (mpiret);
+      P4EST_TRACE_IRECV (from_proc, P4EST_COMM_PARTITION_GIVEN,
+                         (int) recv_size, MPI_BYTE);
 #endif
       ++sk;
     }
@@ -3014,6 +3593,10 @@ p4est_partition_given (p4est_t * p4est,
         + quad_plus_data_size * num_send_to[to_proc];
 
       send_buf[to_proc] = P4EST_ALLOC (char, send_size);
+      p4est->stats[P4EST_STAT_PARTITION_PEERS] += 1.;
+      p4est->stats[P4EST_STAT_PARTITION_QUADRANTS] +=
+        (double) num_send_to[to_proc];
+      p4est->stats[P4EST_STAT_PARTITION_BYTES] += (double) send_size;
 
       num_per_tree_send_buf = (p4est_locidx_t *) send_buf[to_proc];
       memset (num_per_tree_send_buf, 0,
@@ -3082,6 +3665,8 @@ p4est_partition_given (p4est_t * p4est,
                           to_proc, P4EST_COMM_PARTITION_GIVEN,
                           comm, send_request + sk);
       SC_CHECK_MPI (mpiret);
+      P4EST_TRACE_ISEND (to_proc, P4EST_COMM_PARTITION_GIVEN, (int) send_size,
+                         MPI_BYTE);
       ++sk;
 #endif
     }
@@ -3095,9 +3680,11 @@ p4est_partition_given (p4est_t * p4est,
   }
 
   /* Fill in forest */
+  P4EST_TRACE_BEGIN ("MPI_Waitall");
   mpiret =
     MPI_Waitall (num_proc_recv_from, recv_request, MPI_STATUSES_IGNORE);
   SC_CHECK_MPI (mpiret);
+  P4EST_TRACE_END ("MPI_Waitall");
 #endif
 
   /* Loop through and fill in */
@@ -3409,8 +3996,10 @@ p4est_partition_given (p4est_t * p4est,
   /* Clean up */
 
 #ifdef P4EST_ENABLE_MPI
+  P4EST_TRACE_BEGIN ("MPI_Waitall");
   mpiret = MPI_Waitall (num_proc_send_to, send_request, MPI_STATUSES_IGNORE);
   SC_CHECK_MPI (mpiret);
+  P4EST_TRACE_END ("MPI_Waitall");
 
 #ifdef P4EST_ENABLE_DEBUG
   for (i = 0; i < num_proc_recv_from; ++i) {
@@ -3445,6 +4034,10 @@ p4est_partition_given (p4est_t * p4est,
 
   /* Assert that we have a valid partition */
   P4EST_ASSERT (crc == p4est_checksum (p4est));
+  p4est->stats[P4EST_STAT_PARTITION_TIME] += sc_MPI_Wtime () - start_time;
+  p4est_memory_peak_stat (&memory, p4est_memory_used (p4est),
+                          &p4est->stats[P4EST_STAT_PARTITION_MEMORY]);
+  P4EST_TRACE_END (P4EST_STRING "_partition_given");
   P4EST_GLOBAL_INFOF
     ("Done " P4EST_STRING
      "_partition_given shipped %lld quadrants %.3g%%\n",
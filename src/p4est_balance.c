@@ -872,22 +872,83 @@ p8est_balance_seeds_edge (p4est_quadrant_t * q,
 }
 #endif
 
+/* Dispatch to the face, edge, or corner variant by the position of \a q
+ * relative to \a p.  Each entry of \a outside is -1 if \a q is below \a p
+ * in this coordinate, 1 if it is above, and 0 if it is within its range.
+ */
+static int
+p4est_balance_seeds_outside (p4est_quadrant_t * q, p4est_quadrant_t * p,
+                             const int outside[], p4est_connect_type_t balance,
+                             sc_array_t * seeds)
+{
+  int                 i;
+  int                 type = 0;
+  p4est_quadrant_t   *s;
+  int                 f, c;
+#ifdef P4_TO_P8
+  int                 e;
+#endif
+
+  for (i = 0; i < P4EST_DIM; i++) {
+    type += (outside[i] ? 1 : 0);
+  }
+
+  switch (type) {
+  case 0:
+    /* q is inside p, so it is its own seed */
+    if (seeds != NULL) {
+      sc_array_resize (seeds, 1);
+      s = p4est_quadrant_array_index (seeds, 0);
+      *s = *q;
+    }
+    return 1;
+  case 1:
+    for (i = 0; i < P4EST_DIM; i++) {
+      if (outside[i]) {
+        f = 2 * i + (outside[i] > 0 ? 1 : 0);
+        return p4est_balance_seeds_face (q, p, f, balance, seeds);
+      }
+    }
+    SC_ABORT_NOT_REACHED ();
+    return -1;
+  case P4EST_DIM:
+    c = 0;
+    for (i = 0; i < P4EST_DIM; i++) {
+      c += (outside[i] > 0 ? (1 << i) : 0);
+    }
+    return p4est_balance_seeds_corner (q, p, c, balance, seeds);
+#ifdef P4_TO_P8
+  case 2:
+    e = 0;
+    c = 0;
+    for (i = 2; i >= 0; i--) {
+      if (outside[i]) {
+        c <<= 1;
+        c |= (outside[i] > 0 ? 1 : 0);
+      }
+      else {
+        e |= (i << 2);
+      }
+    }
+    e |= c;
+    return p8est_balance_seeds_edge (q, p, e, balance, seeds);
+#endif
+  default:
+    SC_ABORT_NOT_REACHED ();
+    return -1;
+  }
+}
+
 int
 p4est_balance_seeds (p4est_quadrant_t * q, p4est_quadrant_t * p,
                      p4est_connect_type_t balance, sc_array_t * seeds)
 {
   int                 outside[P4EST_DIM];
   int                 i;
-  int                 type = 0;
   p4est_qcoord_t      diff;
   p4est_qcoord_t      qc, pc;
   p4est_qcoord_t      pdist = P4EST_QUADRANT_LEN (p->level);
   p4est_qcoord_t      qdist = P4EST_QUADRANT_LEN (q->level);
-  p4est_quadrant_t   *s;
-  int                 f, c;
-#ifdef P4_TO_P8
-  int                 e;
-#endif
 
   if (seeds != NULL) {
     sc_array_resize (seeds, 0);
@@ -937,49 +998,85 @@ p4est_balance_seeds (p4est_quadrant_t * q, p4est_quadrant_t * p,
         outside[i] = 1;
       }
     }
-    type += (outside[i] ? 1 : 0);
   }
 
-  switch (type) {
-  case 0:
-    /* q is inside p, so it is its own seed */
-    sc_array_resize (seeds, seeds->elem_count + 1);
-    s = p4est_quadrant_array_index (seeds, seeds->elem_count - 1);
-    *s = *q;
-    return 1;
-  case 1:
+  return p4est_balance_seeds_outside (q, p, outside, balance, seeds);
+}
+
+size_t
+p4est_balance_seeds_batch (p4est_quadrant_t * p, sc_array_t * quadrants,
+                           p4est_connect_type_t balance, sc_array_t * seeds)
+{
+  const int64_t       pdist = P4EST_QUADRANT_LEN (p->level);
+  const int64_t       plow[3] = { p->x, p->y,
+#ifdef P4_TO_P8
+    p->z
+#else
+    0
+#endif
+  };
+  int                 i;
+  int                 candidate;
+  int                 outside[P4EST_DIM];
+  int64_t             qdist, qlow, qhigh;
+  size_t              zz, first_seed, num_seeds, num_split;
+  p4est_quadrant_t   *q, *s, *t;
+  sc_array_t         *qseeds;
+
+  P4EST_ASSERT (quadrants->elem_size == sizeof (p4est_quadrant_t));
+  P4EST_ASSERT (seeds->elem_size == sizeof (p4est_quadrant_t));
+
+  qseeds = sc_array_new (sizeof (p4est_quadrant_t));
+  first_seed = seeds->elem_count;
+  num_split = 0;
+  for (zz = 0; zz < quadrants->elem_count; ++zz) {
+    q = p4est_quadrant_array_index (quadrants, zz);
+    qdist = P4EST_QUADRANT_LEN (q->level);
+
+    /* level and insulation layer test without branches; in each
+       coordinate q must lie within one length of p on either side */
+    candidate = (q->level > p->level + 1);
     for (i = 0; i < P4EST_DIM; i++) {
-      if (outside[i]) {
-        f = 2 * i + (outside[i] > 0 ? 1 : 0);
-        return p4est_balance_seeds_face (q, p, f, balance, seeds);
-      }
+      qlow = i == 0 ? q->x : i == 1 ? q->y :
+#ifdef P4_TO_P8
+        q->z;
+#else
+        0;
+#endif
+      qhigh = qlow + qdist;
+      candidate &= (qlow >= plow[i] - pdist) & (qhigh <= plow[i] + 2 * pdist);
+      outside[i] = (qhigh > plow[i] + pdist) - (qlow < plow[i]);
     }
-    SC_ABORT_NOT_REACHED ();
-    return -1;
-  case P4EST_DIM:
-    c = 0;
-    for (i = 0; i < P4EST_DIM; i++) {
-      c += (outside[i] > 0 ? (1 << i) : 0);
+    if (!candidate) {
+      continue;
     }
-    return p4est_balance_seeds_corner (q, p, c, balance, seeds);
-#ifdef P4_TO_P8
-  case 2:
-    e = 0;
-    c = 0;
-    for (i = 2; i >= 0; i--) {
-      if (outside[i]) {
-        c <<= 1;
-        c |= (outside[i] > 0 ? 1 : 0);
-      }
-      else {
-        e |= (i << 2);
+
+    /* append the seeds of this quadrant */
+    if (p4est_balance_seeds_outside (q, p, outside, balance, qseeds)) {
+      ++num_split;
+      num_seeds = seeds->elem_count;
+      sc_array_resize (seeds, num_seeds + qseeds->elem_count);
+      memcpy (sc_array_index (seeds, num_seeds), qseeds->array,
+              qseeds->elem_count * qseeds->elem_size);
+    }
+  }
+  sc_array_destroy (qseeds);
+
+  /* sort the new seeds and remove duplicates */
+  num_seeds = seeds->elem_count - first_seed;
+  if (num_seeds > 1) {
+    qsort (sc_array_index (seeds, first_seed), num_seeds,
+           sizeof (p4est_quadrant_t), p4est_quadrant_compare);
+    t = p4est_quadrant_array_index (seeds, first_seed);
+    for (zz = first_seed + 1; zz < seeds->elem_count; ++zz) {
+      s = p4est_quadrant_array_index (seeds, zz);
+      if (!p4est_quadrant_is_equal (s, t)) {
+        *++t = *s;
       }
     }
-    e |= c;
-    return p8est_balance_seeds_edge (q, p, e, balance, seeds);
-#endif
-  default:
-    SC_ABORT_NOT_REACHED ();
-    return -1;
+    sc_array_resize (seeds, (size_t) (t + 1 - (p4est_quadrant_t *)
+                                      seeds->array));
   }
+
+  return num_split;
 }
@@ -47,6 +47,191 @@ p4est_init (sc_log_handler_t log_handler, int log_threshold)
   P4EST_GLOBAL_PRODUCTIONF ("%-*s %s\n", w, "LIBS", P4EST_LIBS);
 }
 
+/* bytes allocated by P4EST_ALLOC and their peak */
+static size_t       p4est_memory_in_use = 0;
+static size_t       p4est_memory_peak = 0;
+
+#ifdef P4EST_ENABLE_MEMTRACK
+
+/* the header keeps the alignment guaranteed by malloc */
+#define P4EST_MEMTRACK_HEADER 16
+
+static void
+p4est_memtrack_count (size_t added, size_t removed)
+{
+#ifdef SC_ENABLE_OPENMP
+#pragma omp critical (p4est_memtrack)
+#endif
+  {
+    P4EST_ASSERT (removed <= p4est_memory_in_use);
+    p4est_memory_in_use += added;
+    p4est_memory_in_use -= removed;
+    p4est_memory_peak = SC_MAX (p4est_memory_peak, p4est_memory_in_use);
+  }
+}
+
+void               *
+p4est_memtrack_malloc (size_t size)
+{
+  char               *block;
+
+  block = (char *) sc_malloc (p4est_package_id, P4EST_MEMTRACK_HEADER + size);
+  *(size_t *) block = size;
+  p4est_memtrack_count (size, 0);
+
+  return block + P4EST_MEMTRACK_HEADER;
+}
+
+void               *
+p4est_memtrack_calloc (size_t nmemb, size_t size)
+{
+  char               *block;
+
+  block = (char *) sc_calloc (p4est_package_id, 1,
+                              P4EST_MEMTRACK_HEADER + nmemb * size);
+  *(size_t *) block = nmemb * size;
+  p4est_memtrack_count (nmemb * size, 0);
+
+  return block + P4EST_MEMTRACK_HEADER;
+}
+
+void               *
+p4est_memtrack_realloc (void *ptr, size_t size)
+{
+  size_t              old_size;
+  char               *block;
+
+  if (ptr == NULL) {
+    return p4est_memtrack_malloc (size);
+  }
+  block = (char *) ptr - P4EST_MEMTRACK_HEADER;
+  old_size = *(size_t *) block;
+  block = (char *) sc_realloc (p4est_package_id, block,
+                               P4EST_MEMTRACK_HEADER + size);
+  *(size_t *) block = size;
+  p4est_memtrack_count (size, old_size);
+
+  return block + P4EST_MEMTRACK_HEADER;
+}
+
+char               *
+p4est_memtrack_strdup (const char *s)
+{
+  size_t              len;
+  char               *d;
+
+  if (s == NULL) {
+    return NULL;
+  }
+  len = strlen (s) + 1;
+  d = (char *) p4est_memtrack_malloc (len);
+  memcpy (d, s, len);
+
+  return d;
+}
+
+void
+p4est_memtrack_free (void *ptr)
+{
+  char               *block;
+
+  if (ptr == NULL) {
+    return;
+  }
+  block = (char *) ptr - P4EST_MEMTRACK_HEADER;
+  p4est_memtrack_count (0, *(size_t *) block);
+  sc_free (p4est_package_id, block);
+}
+
+#endif /* P4EST_ENABLE_MEMTRACK */
+
+void
+p4est_memory_peak_begin (p4est_memory_peak_t * peak)
+{
+  peak->base = p4est_memory_in_use;
+  peak->outer = p4est_memory_peak;
+  p4est_memory_peak = p4est_memory_in_use;
+}
+
+size_t
+p4est_memory_peak_end (p4est_memory_peak_t * peak)
+{
+  size_t              high;
+
+  high = p4est_memory_peak;
+  p4est_memory_peak = SC_MAX (peak->outer, high);
+
+  return high > peak->base ? high - peak->base : 0;
+}
+
+void
+p4est_memory_peak_stat (p4est_memory_peak_t * peak, size_t used,
+                        double *stat)
+{
+#ifdef P4EST_ENABLE_MEMTRACK
+  size_t              high;
+
+  high = p4est_memory_peak_end (peak);
+  *stat = SC_MAX (*stat, (double) (high + used));
+#else
+  (void) p4est_memory_peak_end (peak);
+#endif
+}
+
+void
+p4est_memory_hold (size_t bytes)
+{
+#ifdef P4EST_ENABLE_MEMTRACK
+  p4est_memtrack_count (bytes, 0);
+#endif
+}
+
+void
+p4est_memory_release (size_t bytes)
+{
+#ifdef P4EST_ENABLE_MEMTRACK
+  p4est_memtrack_count (0, bytes);
+#endif
+}
+
+static const char  *p4est_stat_names[P4EST_STAT_NUM] = {
+  "balance_time",
+  "balance_memory",
+  "partition_time",
+  "partition_peers",
+  "partition_quadrants",
+  "partition_bytes",
+  "partition_memory",
+  "ghost_time",
+  "ghost_mirrors",
+  "ghost_ghosts",
+  "ghost_messages",
+  "ghost_bytes",
+  "ghost_memory",
+  "lnodes_time",
+  "lnodes_rounds",
+  "lnodes_messages",
+  "lnodes_bytes",
+  "lnodes_memory",
+  "iterate_time",
+  "iterate_volume",
+  "iterate_face",
+  "iterate_edge",
+  "iterate_corner",
+  "save_time",
+  "save_bytes",
+  "load_time",
+  "load_bytes",
+};
+
+const char         *
+p4est_stat_name (p4est_stat_t which)
+{
+  P4EST_ASSERT (0 <= (int) which && which < P4EST_STAT_NUM);
+
+  return p4est_stat_names[which];
+}
+
 #ifndef __cplusplus
 #undef P4EST_GLOBAL_LOGF
 #undef P4EST_LOGF
@@ -123,10 +123,64 @@ typedef enum p4est_comm_tag
   P4EST_COMM_LNODES_PASS,
   P4EST_COMM_LNODES_OWNED,
   P4EST_COMM_LNODES_ALL,
+  P4EST_COMM_SEARCH_ROUTE,
+  P4EST_COMM_RAY,
+  P4EST_COMM_POINTS_SORT,
+  P4EST_COMM_BALANCE_DIRTY_QUERY,
+  P4EST_COMM_BALANCE_DIRTY_RESPONSE,
+  P4EST_COMM_TRACE,
   P4EST_COMM_TAG_LAST
 }
 p4est_comm_tag_t;
 
+/** Counters and timings recorded by the collective algorithms.
+ * Each forest carries one value per entry in p4est_t::stats.
+ * The times are wall clock seconds of the most recent calls,
+ * summed since the last p4est_stats_reset; the remaining entries
+ * are counts or bytes summed in the same way.  The iterate counts include
+ * the traversals run internally by p4est_lnodes_new and p4est_mesh_new.
+ * The memory entries hold the largest value seen since the reset: the
+ * peak of bytes newly allocated during the call, plus the memory of the
+ * forest including its mempools at the end of the call.  The mempools never
+ * shrink, so they are at their peak at that time.  The peak counts every
+ * P4EST_ALLOC and the sc_array_t and sc_mempool_t temporaries of the
+ * algorithm at their largest size.  It is only measured if p4est is
+ * configured with --enable-memtrack; otherwise the memory entries remain
+ * zero and p4est_stats_compute reports them without values.
+ */
+typedef enum p4est_stat
+{
+  P4EST_STAT_BALANCE_TIME,      /**< time spent in p4est_balance */
+  P4EST_STAT_BALANCE_MEMORY,    /**< peak bytes in p4est_balance */
+  P4EST_STAT_PARTITION_TIME,    /**< time spent in p4est_partition_given */
+  P4EST_STAT_PARTITION_PEERS,   /**< processes sent to or received from */
+  P4EST_STAT_PARTITION_QUADRANTS,       /**< quadrants sent away */
+  P4EST_STAT_PARTITION_BYTES,   /**< bytes sent and received */
+  P4EST_STAT_PARTITION_MEMORY,  /**< peak bytes in p4est_partition_given */
+  P4EST_STAT_GHOST_TIME,        /**< time spent in p4est_ghost_new */
+  P4EST_STAT_GHOST_MIRRORS,     /**< number of mirror quadrants */
+  P4EST_STAT_GHOST_GHOSTS,      /**< number of ghost quadrants */
+  P4EST_STAT_GHOST_MESSAGES,    /**< messages sent */
+  P4EST_STAT_GHOST_BYTES,       /**< bytes sent */
+  P4EST_STAT_GHOST_MEMORY,      /**< peak bytes in p4est_ghost_new */
+  P4EST_STAT_LNODES_TIME,       /**< time spent in p4est_lnodes_new */
+  P4EST_STAT_LNODES_ROUNDS,     /**< rounds of node sharing */
+  P4EST_STAT_LNODES_MESSAGES,   /**< messages sent */
+  P4EST_STAT_LNODES_BYTES,      /**< bytes sent */
+  P4EST_STAT_LNODES_MEMORY,     /**< peak bytes in p4est_lnodes_new */
+  P4EST_STAT_ITERATE_TIME,      /**< time spent in p4est_iterate */
+  P4EST_STAT_ITERATE_VOLUME,    /**< volume callbacks executed */
+  P4EST_STAT_ITERATE_FACE,      /**< face callbacks executed */
+  P4EST_STAT_ITERATE_EDGE,      /**< edge callbacks executed (3D only) */
+  P4EST_STAT_ITERATE_CORNER,    /**< corner callbacks executed */
+  P4EST_STAT_SAVE_TIME,         /**< time spent in p4est_save */
+  P4EST_STAT_SAVE_BYTES,        /**< bytes written by this process */
+  P4EST_STAT_LOAD_TIME,         /**< time spent in p4est_load */
+  P4EST_STAT_LOAD_BYTES,        /**< bytes read by this process */
+  P4EST_STAT_NUM                /**< number of entries, not a statistic */
+}
+p4est_stat_t;
+
 /* some error checking possibly specific to p4est */
 #ifdef P4EST_ENABLE_DEBUG
 #define P4EST_ASSERT(c) SC_CHECK_ABORT ((c), "Assertion '" #c "'")
@@ -150,6 +204,7 @@ p4est_comm_tag_t;
 #endif
 
 /* macros for memory allocation, will abort if out of memory */
+#ifndef P4EST_ENABLE_MEMTRACK
 /** allocate a \a t-array with \a n elements */
 #define P4EST_ALLOC(t,n)          (t *) sc_malloc (p4est_package_id,    \
                                                    (n) * sizeof(t))
@@ -163,6 +218,17 @@ p4est_comm_tag_t;
 #define P4EST_STRDUP(s)                 sc_strdup (p4est_package_id, (s))
 /** free an allocated array */
 #define P4EST_FREE(p)                   sc_free (p4est_package_id, (p))
+#else
+/* the same macros counting the bytes in use */
+#define P4EST_ALLOC(t,n)          (t *) p4est_memtrack_malloc           \
+  ((n) * sizeof(t))
+#define P4EST_ALLOC_ZERO(t,n)     (t *) p4est_memtrack_calloc           \
+  ((size_t) (n), sizeof(t))
+#define P4EST_REALLOC(p,t,n)      (t *) p4est_memtrack_realloc          \
+  ((p), (n) * sizeof(t))
+#define P4EST_STRDUP(s)                 p4est_memtrack_strdup (s)
+#define P4EST_FREE(p)                   p4est_memtrack_free (p)
+#endif
 
 /* log helper macros */
 #define P4EST_GLOBAL_LOG(p,s)                           \
@@ -300,6 +366,72 @@ p4est_log_indent_pop ()
 void                p4est_init (sc_log_handler_t log_handler,
                                 int log_threshold);
 
+#ifdef P4EST_ENABLE_MEMTRACK
+
+/* allocation functions behind the P4EST_ALLOC macros with --enable-memtrack;
+ * each block is prefixed by a header that remembers its size */
+void               *p4est_memtrack_malloc (size_t size);
+void               *p4est_memtrack_calloc (size_t nmemb, size_t size);
+void               *p4est_memtrack_realloc (void *ptr, size_t size);
+char               *p4est_memtrack_strdup (const char *s);
+void                p4est_memtrack_free (void *ptr);
+
+#endif
+
+/** State of one measurement of the bytes allocated by P4EST_ALLOC. */
+typedef struct p4est_memory_peak
+{
+  size_t              base;     /**< bytes in use at the begin */
+  size_t              outer;    /**< peak of an enclosing measurement */
+}
+p4est_memory_peak_t;
+
+/** Begin to measure the peak of the bytes allocated by P4EST_ALLOC.
+ * The measurements may be nested; every call must be matched by a call to
+ * p4est_memory_peak_end.  Not collective.  Without --enable-memtrack no
+ * bytes are counted and the peak is always zero.
+ * \param [out] peak   State to pass to p4est_memory_peak_end.
+ */
+void                p4est_memory_peak_begin (p4est_memory_peak_t * peak);
+
+/** End to measure the peak of the bytes allocated by P4EST_ALLOC.
+ * \param [in] peak    State initialized by p4est_memory_peak_begin.
+ * \return             The most bytes in use since the matching begin,
+ *                     minus the bytes that were in use at the begin.
+ */
+size_t              p4est_memory_peak_end (p4est_memory_peak_t * peak);
+
+/** End to measure the peak and record it in a memory statistics entry.
+ * Without --enable-memtrack the entry is not changed.
+ * \param [in] peak    State initialized by p4est_memory_peak_begin.
+ * \param [in] used    Bytes to add to the peak, usually those of the
+ *                     forest as returned by p4est_memory_used.
+ * \param [in,out] stat The entry is set to the maximum of its value and
+ *                     the sum of the peak and \a used.
+ */
+void                p4est_memory_peak_stat (p4est_memory_peak_t * peak,
+                                            size_t used, double *stat);
+
+/** Count bytes that are not allocated by P4EST_ALLOC as in use.
+ * Meant for the storage of sc_array_t and sc_mempool_t temporaries, which
+ * is counted at its largest size.  Must be matched by a call to
+ * p4est_memory_release with the same number.
+ * Does nothing without --enable-memtrack.
+ * \param [in] bytes   Number of bytes to add.
+ */
+void                p4est_memory_hold (size_t bytes);
+
+/** Stop counting bytes added by p4est_memory_hold.
+ * \param [in] bytes   Number of bytes to subtract.
+ */
+void                p4est_memory_release (size_t bytes);
+
+/** Return a short printable name of a statistics entry.
+ * \param [in] which   A valid entry less than P4EST_STAT_NUM.
+ * \return             A static string such as "ghost_bytes".
+ */
+const char         *p4est_stat_name (p4est_stat_t which);
+
 /** Compute hash value for two p4est_topidx_t integers.
  * \param [in] tt     Array of (at least) two values.
  * \return            An unsigned hash value.
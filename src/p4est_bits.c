@@ -184,6 +184,24 @@ p4est_quadrant_compare_local_num (const void *v1, const void *v2)
                                &q2->p.piggy3.local_num);
 }
 
+int
+p4est_quadrant_compare_hilbert (const void *v1, const void *v2)
+{
+  const p4est_quadrant_t *q1 = (const p4est_quadrant_t *) v1;
+  const p4est_quadrant_t *q2 = (const p4est_quadrant_t *) v2;
+  int                 level;
+  uint64_t            id1, id2;
+
+  /* descendants are contiguous on the curve, compare the coarser level */
+  level = SC_MIN (q1->level, q2->level);
+  id1 = p4est_quadrant_hilbert_id (q1, level);
+  id2 = p4est_quadrant_hilbert_id (q2, level);
+  if (id1 != id2) {
+    return id1 < id2 ? -1 : 1;
+  }
+  return (int) q1->level - (int) q2->level;
+}
+
 int
 p4est_quadrant_equal_fn (const void *v1, const void *v2, const void *u)
 {
@@ -1798,3 +1816,61 @@ p4est_quadrant_set_morton (p4est_quadrant_t * quadrant,
 
   P4EST_ASSERT (p4est_quadrant_is_extended (quadrant));
 }
+
+uint64_t
+p4est_quadrant_hilbert_id (const p4est_quadrant_t * quadrant, int level)
+{
+  int                 i;
+  uint64_t            id;
+  p4est_qcoord_t      P, Q, t;
+  p4est_qcoord_t      X[P4EST_DIM];
+  const p4est_qcoord_t M = (p4est_qcoord_t) 1 << (P4EST_QMAXLEVEL - 1);
+
+  P4EST_ASSERT (p4est_quadrant_is_valid (quadrant));
+  P4EST_ASSERT ((int) quadrant->level >= level && level >= 0);
+
+  /* coordinates in multiples of the smallest quadrant length */
+  X[0] = quadrant->x >> (P4EST_MAXLEVEL - P4EST_QMAXLEVEL);
+  X[1] = quadrant->y >> (P4EST_MAXLEVEL - P4EST_QMAXLEVEL);
+#ifdef P4_TO_P8
+  X[2] = quadrant->z >> (P4EST_MAXLEVEL - P4EST_QMAXLEVEL);
+#endif
+
+  /* transform the coordinates into the transposed Hilbert index
+   * following J. Skilling, Programming the Hilbert curve (2004) */
+  for (Q = M; Q > 1; Q >>= 1) {
+    P = Q - 1;
+    for (i = 0; i < P4EST_DIM; ++i) {
+      if (X[i] & Q) {
+        X[0] ^= P;
+      }
+      else {
+        t = (X[0] ^ X[i]) & P;
+        X[0] ^= t;
+        X[i] ^= t;
+      }
+    }
+  }
+  for (i = 1; i < P4EST_DIM; ++i) {
+    X[i] ^= X[i - 1];
+  }
+  t = 0;
+  for (Q = M; Q > 1; Q >>= 1) {
+    if (X[P4EST_DIM - 1] & Q) {
+      t ^= Q - 1;
+    }
+  }
+  for (i = 0; i < P4EST_DIM; ++i) {
+    X[i] ^= t;
+  }
+
+  /* interleave the bits with the first coordinate most significant */
+  id = 0;
+  for (Q = M; Q > 0; Q >>= 1) {
+    for (i = 0; i < P4EST_DIM; ++i) {
+      id = (id << 1) | (uint64_t) ((X[i] & Q) != 0);
+    }
+  }
+
+  return id >> (P4EST_DIM * (P4EST_QMAXLEVEL - level));
+}
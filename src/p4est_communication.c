@@ -31,6 +31,7 @@
 #include <p4est_communication.h>
 #include <p4est_bits.h>
 #endif /* !P4_TO_P8 */
+#include <p4est_trace.h>
 #include <sc_search.h>
 #ifdef P4EST_HAVE_ZLIB
 #include <zlib.h>
@@ -513,6 +514,7 @@ p4est_comm_count_pertree (p4est_t * p4est, p4est_gloidx_t * pertree)
                                P4EST_COMM_COUNT_PERTREE, p4est->mpicomm,
                                &req_recv);
         SC_CHECK_MPI (mpiret);
+        P4EST_TRACE_IRECV (p, P4EST_COMM_COUNT_PERTREE, 1, P4EST_MPI_LOCIDX);
         addtomytree = c;
       }
       else {
@@ -534,12 +536,15 @@ p4est_comm_count_pertree (p4est_t * p4est, p4est_gloidx_t * pertree)
                            P4EST_COMM_COUNT_PERTREE, p4est->mpicomm,
                            &req_send);
     SC_CHECK_MPI (mpiret);
+    P4EST_TRACE_ISEND (p, P4EST_COMM_COUNT_PERTREE, 1, P4EST_MPI_LOCIDX);
   }
 
   /* Complete MPI operations and cumulative count */
   if (addtomytree >= 0) {
+    P4EST_TRACE_BEGIN ("MPI_Wait");
     mpiret = sc_MPI_Wait (&req_recv, &status);
     SC_CHECK_MPI (mpiret);
+    P4EST_TRACE_END ("MPI_Wait");
     mypertree[addtomytree] += (p4est_gloidx_t) recvbuf;
   }
   pertree[0] = 0;
@@ -551,8 +556,10 @@ p4est_comm_count_pertree (p4est_t * p4est, p4est_gloidx_t * pertree)
     pertree[c + 1] += pertree[c];
   }
   if (sendbuf >= 0) {
+    P4EST_TRACE_BEGIN ("MPI_Wait");
     mpiret = sc_MPI_Wait (&req_send, &status);
     SC_CHECK_MPI (mpiret);
+    P4EST_TRACE_END ("MPI_Wait");
   }
 
   /* Clean up */
@@ -1063,6 +1070,7 @@ p4est_transfer_fixed_begin (const p4est_gloidx_t * dest_gfq,
           mpiret = sc_MPI_Irecv (rb, byte_len, sc_MPI_BYTE, q,
                                  tag, mpicomm, rq++);
           SC_CHECK_MPI (mpiret);
+          P4EST_TRACE_IRECV (q, tag, byte_len, sc_MPI_BYTE);
         }
         rb += byte_len;
       }
@@ -1116,6 +1124,7 @@ p4est_transfer_fixed_begin (const p4est_gloidx_t * dest_gfq,
           mpiret = sc_MPI_Isend (rb, byte_len, sc_MPI_BYTE, q,
                                  tag, mpicomm, rq++);
           SC_CHECK_MPI (mpiret);
+          P4EST_TRACE_ISEND (q, tag, byte_len, sc_MPI_BYTE);
         }
         rb += byte_len;
       }
@@ -1144,14 +1153,18 @@ p4est_transfer_end (p4est_transfer_context_t * tc)
 
   /* wait for messages to complete and deallocate request buffers */
   if (tc->num_senders > 0) {
+    P4EST_TRACE_BEGIN ("MPI_Waitall");
     mpiret = sc_MPI_Waitall (tc->num_senders, tc->recv_req,
                              sc_MPI_STATUSES_IGNORE);
     SC_CHECK_MPI (mpiret);
+    P4EST_TRACE_END ("MPI_Waitall");
   }
   if (tc->num_receivers > 0) {
+    P4EST_TRACE_BEGIN ("MPI_Waitall");
     mpiret = sc_MPI_Waitall (tc->num_receivers, tc->send_req,
                              sc_MPI_STATUSES_IGNORE);
     SC_CHECK_MPI (mpiret);
+    P4EST_TRACE_END ("MPI_Waitall");
   }
   P4EST_FREE (tc->recv_req);
   P4EST_FREE (tc->send_req);
@@ -1275,6 +1288,7 @@ p4est_transfer_custom_begin (const p4est_gloidx_t * dest_gfq,
           mpiret = sc_MPI_Irecv (rb, byte_len, sc_MPI_BYTE, q,
                                  tag, mpicomm, rq++);
           SC_CHECK_MPI (mpiret);
+          P4EST_TRACE_IRECV (q, tag, byte_len, sc_MPI_BYTE);
         }
         rb += byte_len;
       }
@@ -1332,6 +1346,7 @@ p4est_transfer_custom_begin (const p4est_gloidx_t * dest_gfq,
           mpiret = sc_MPI_Isend (rb, byte_len, sc_MPI_BYTE, q,
                                  tag, mpicomm, rq++);
           SC_CHECK_MPI (mpiret);
+          P4EST_TRACE_ISEND (q, tag, byte_len, sc_MPI_BYTE);
         }
         rb += byte_len;
       }
@@ -36,6 +36,7 @@
 #include <p8est_lnodes.h>
 #include <p8est_algorithms.h>
 #endif
+#include <p4est_trace.h>
 #include <sc_search.h>
 
 /* htonl is in either of these two */
@@ -341,8 +342,9 @@ p4est_quadrant_exists (p4est_t * p4est, p4est_ghost_t * ghost,
   p4est_corner_transform_t *ct;
 
   if (exists_arr != NULL) {
+    /* keep the memory, which a caller may have allocated in advance */
     P4EST_ASSERT (exists_arr->elem_size == sizeof (int));
-    sc_array_resize (exists_arr, 0);
+    sc_array_truncate (exists_arr);
   }
   if (rproc_arr != NULL) {
     P4EST_ASSERT (rproc_arr->elem_size == sizeof (int));
@@ -1477,6 +1479,11 @@ p4est_ghost_new_check (p4est_t * p4est, p4est_connect_type_t btype,
   p4est_ghost_mirror_t m;
 #endif
   size_t             *ppz;
+#ifdef P4EST_ENABLE_MPI
+  size_t              transient;
+#endif
+  p4est_memory_peak_t memory;
+  double              start_time;
   sc_array_t          split;
   sc_array_t         *ghost_layer;
   p4est_topidx_t      nt;
@@ -1485,6 +1492,9 @@ p4est_ghost_new_check (p4est_t * p4est, p4est_connect_type_t btype,
   P4EST_GLOBAL_PRODUCTIONF ("Into " P4EST_STRING "_ghost_new %s\n",
                             p4est_connect_type_string (btype));
   p4est_log_indent_push ();
+  P4EST_TRACE_BEGIN (P4EST_STRING "_ghost_new");
+  start_time = sc_MPI_Wtime ();
+  p4est_memory_peak_begin (&memory);
 
   gl = P4EST_ALLOC (p4est_ghost_t, 1);
   gl->mpisize = num_procs;
@@ -1994,6 +2004,9 @@ failtest:
       }
 
       p4est_ghost_destroy (gl);
+      p4est_memory_peak_stat (&memory, p4est_memory_used (p4est),
+                              &p4est->stats[P4EST_STAT_GHOST_MEMORY]);
+      P4EST_TRACE_END (P4EST_STRING "_ghost_new");
 
       return NULL;
     }
@@ -2029,6 +2042,8 @@ failtest:
                           peer_proc, P4EST_COMM_GHOST_COUNT, comm,
                           recv_request + peer);
       SC_CHECK_MPI (mpiret);
+      P4EST_TRACE_IRECV (peer_proc, P4EST_COMM_GHOST_COUNT, 1,
+                         P4EST_MPI_LOCIDX);
       ++peer;
     }
   }
@@ -2045,6 +2060,10 @@ failtest:
                           peer_proc, P4EST_COMM_GHOST_COUNT,
                           comm, send_request + peer);
       SC_CHECK_MPI (mpiret);
+      P4EST_TRACE_ISEND (peer_proc, P4EST_COMM_GHOST_COUNT, 1,
+                         P4EST_MPI_LOCIDX);
+      p4est->stats[P4EST_STAT_GHOST_MESSAGES] += 1.;
+      p4est->stats[P4EST_STAT_GHOST_BYTES] += (double) sizeof (p4est_locidx_t);
       ++peer;
     }
   }
@@ -2054,11 +2073,13 @@ failtest:
 
   /* Wait for the counts */
   if (num_peers > 0) {
+    P4EST_TRACE_BEGIN ("MPI_Waitall");
     mpiret = MPI_Waitall (num_peers, recv_request, MPI_STATUSES_IGNORE);
     SC_CHECK_MPI (mpiret);
 
     mpiret = MPI_Waitall (num_peers, send_request, MPI_STATUSES_IGNORE);
     SC_CHECK_MPI (mpiret);
+    P4EST_TRACE_END ("MPI_Waitall");
   }
 
 #ifdef P4EST_ENABLE_DEBUG
@@ -2096,6 +2117,9 @@ failtest:
                    MPI_BYTE, peer_proc, P4EST_COMM_GHOST_LOAD, comm,
                    recv_load_request + peer);
       SC_CHECK_MPI (mpiret);
+      P4EST_TRACE_IRECV (peer_proc, P4EST_COMM_GHOST_LOAD,
+                         (int) (recv_counts[peer] * sizeof (p4est_quadrant_t)),
+                         MPI_BYTE);
 
       ghost_offset += recv_counts[peer];        /* same type */
       ++peer;
@@ -2119,17 +2143,25 @@ failtest:
                    MPI_BYTE, peer_proc, P4EST_COMM_GHOST_LOAD, comm,
                    send_load_request + peer);
       SC_CHECK_MPI (mpiret);
+      P4EST_TRACE_ISEND (peer_proc, P4EST_COMM_GHOST_LOAD,
+                         (int) (send_counts[peer] * sizeof (p4est_quadrant_t)),
+                         MPI_BYTE);
+      p4est->stats[P4EST_STAT_GHOST_MESSAGES] += 1.;
+      p4est->stats[P4EST_STAT_GHOST_BYTES] +=
+        (double) (send_counts[peer] * sizeof (p4est_quadrant_t));
       ++peer;
     }
   }
 
   /* Wait for everything */
   if (num_peers > 0) {
+    P4EST_TRACE_BEGIN ("MPI_Waitall");
     mpiret = MPI_Waitall (num_peers, recv_load_request, MPI_STATUSES_IGNORE);
     SC_CHECK_MPI (mpiret);
 
     mpiret = MPI_Waitall (num_peers, send_load_request, MPI_STATUSES_IGNORE);
     SC_CHECK_MPI (mpiret);
+    P4EST_TRACE_END ("MPI_Waitall");
   }
 
   /* Clean up */
@@ -2159,14 +2191,22 @@ failtest:
   P4EST_FREE (recv_request);
   P4EST_FREE (send_request);
 
+  /* count the send buffers and the ghost arrays before the former go */
+  transient = sc_array_memory_used (&send_bufs, 0) +
+    sc_array_memory_used (ghost_layer, 0) +
+    sc_array_memory_used (&gl->mirrors, 0);
   for (i = 0; i < num_procs; ++i) {
     buf = p4est_ghost_array_index (&send_bufs, i);
+    transient += sc_array_memory_used (buf, 0);
     sc_array_reset (buf);
   }
   sc_array_reset (&send_bufs);
   for (i = 0; i < P4EST_DIM - 1; ++i) {
+    transient += sc_array_memory_used (&procs[i], 0);
     sc_array_reset (&procs[i]);
   }
+  p4est_memory_hold (transient);
+  p4est_memory_release (transient);
 #endif /* P4EST_ENABLE_MPI */
 
   /* calculate tree offsets */
@@ -2200,6 +2240,12 @@ failtest:
   gl->mirror_proc_front_offsets = gl->mirror_proc_offsets;
 
   P4EST_ASSERT (p4est_ghost_is_valid (p4est, gl));
+  p4est->stats[P4EST_STAT_GHOST_MIRRORS] += (double) gl->mirrors.elem_count;
+  p4est->stats[P4EST_STAT_GHOST_GHOSTS] += (double) gl->ghosts.elem_count;
+  p4est->stats[P4EST_STAT_GHOST_TIME] += sc_MPI_Wtime () - start_time;
+  p4est_memory_peak_stat (&memory, p4est_memory_used (p4est),
+                          &p4est->stats[P4EST_STAT_GHOST_MEMORY]);
+  P4EST_TRACE_END (P4EST_STRING "_ghost_new");
 
   p4est_log_indent_pop ();
   P4EST_GLOBAL_PRODUCTION ("Done " P4EST_STRING "_ghost_new\n");
@@ -2422,6 +2468,8 @@ p4est_ghost_exchange_custom_begin (p4est_t * p4est, p4est_ghost_t * ghost,
                              ng * data_size, sc_MPI_BYTE, q,
                              P4EST_COMM_GHOST_EXCHANGE, p4est->mpicomm, r);
       SC_CHECK_MPI (mpiret);
+      P4EST_TRACE_IRECV (q, P4EST_COMM_GHOST_EXCHANGE, ng * data_size,
+                         sc_MPI_BYTE);
       ng_excl = ng_incl;
     }
   }
@@ -2447,6 +2495,8 @@ p4est_ghost_exchange_custom_begin (p4est_t * p4est, p4est_ghost_t * ghost,
       mpiret = sc_MPI_Isend (*sbuf, ng * data_size, sc_MPI_BYTE, q,
                              P4EST_COMM_GHOST_EXCHANGE, p4est->mpicomm, r);
       SC_CHECK_MPI (mpiret);
+      P4EST_TRACE_ISEND (q, P4EST_COMM_GHOST_EXCHANGE, ng * data_size,
+                         sc_MPI_BYTE);
       ng_excl = ng_incl;
     }
   }
@@ -2469,9 +2519,11 @@ p4est_ghost_exchange_custom_end (p4est_ghost_exchange_t * exc)
   P4EST_ASSERT (!exc->is_levels);
 
   /* wait for messages to complete and clean up */
+  P4EST_TRACE_BEGIN ("MPI_Waitall");
   mpiret = sc_MPI_Waitall (exc->requests.elem_count, (sc_MPI_Request *)
                            exc->requests.array, sc_MPI_STATUSES_IGNORE);
   SC_CHECK_MPI (mpiret);
+  P4EST_TRACE_END ("MPI_Waitall");
   sc_array_reset (&exc->requests);
   for (zz = 0; zz < exc->sbuffers.elem_count; ++zz) {
     sbuf = (char **) sc_array_index (&exc->sbuffers, zz);
@@ -2578,6 +2630,8 @@ p4est_ghost_exchange_custom_levels_begin (p4est_t * p4est,
           mpiret = sc_MPI_Irecv (*rbuf, lmatches * data_size, sc_MPI_BYTE, q,
                                  P4EST_COMM_GHOST_EXCHANGE, p4est->mpicomm,
                                  r);
+          P4EST_TRACE_IRECV (q, P4EST_COMM_GHOST_EXCHANGE,
+                             lmatches * data_size, sc_MPI_BYTE);
         }
         else {
           /* use the ghost data memory as is */
@@ -2586,6 +2640,8 @@ p4est_ghost_exchange_custom_levels_begin (p4est_t * p4est,
                                  ng * data_size, sc_MPI_BYTE, q,
                                  P4EST_COMM_GHOST_EXCHANGE, p4est->mpicomm,
                                  r);
+          P4EST_TRACE_IRECV (q, P4EST_COMM_GHOST_EXCHANGE, ng * data_size,
+                             sc_MPI_BYTE);
         }
         SC_CHECK_MPI (mpiret);
       }
@@ -2626,6 +2682,8 @@ p4est_ghost_exchange_custom_levels_begin (p4est_t * p4est,
         mpiret = sc_MPI_Isend (*sbuf, lmatches * data_size, sc_MPI_BYTE, q,
                                P4EST_COMM_GHOST_EXCHANGE, p4est->mpicomm, r);
         SC_CHECK_MPI (mpiret);
+        P4EST_TRACE_ISEND (q, P4EST_COMM_GHOST_EXCHANGE, lmatches * data_size,
+                           sc_MPI_BYTE);
       }
       ng_excl = ng_incl;
     }
@@ -2710,9 +2768,11 @@ p4est_ghost_exchange_custom_levels_end (p4est_ghost_exchange_t * exc)
   sc_array_reset (&exc->rbuffers);
 
   /* wait for sends and clean up */
+  P4EST_TRACE_BEGIN ("MPI_Waitall");
   mpiret = sc_MPI_Waitall (exc->requests.elem_count, (sc_MPI_Request *)
                            exc->requests.array, sc_MPI_STATUSES_IGNORE);
   SC_CHECK_MPI (mpiret);
+  P4EST_TRACE_END ("MPI_Waitall");
   sc_array_reset (&exc->requests);
   for (zz = 0; zz < exc->sbuffers.elem_count; ++zz) {
     sbuf = (char **) sc_array_index (&exc->sbuffers, zz);
@@ -3253,6 +3313,8 @@ p4est_ghost_expand_internal (p4est_t * p4est, p4est_lnodes_t * lnodes,
                           P4EST_COMM_GHOST_EXPAND_COUNT, comm, recv_request +
                           peer);
       SC_CHECK_MPI (mpiret);
+      P4EST_TRACE_IRECV (p, P4EST_COMM_GHOST_EXPAND_COUNT, 1,
+                         P4EST_MPI_LOCIDX);
       peer++;
     }
   }
@@ -3499,6 +3561,7 @@ p4est_ghost_expand_internal (p4est_t * p4est, p4est_lnodes_t * lnodes,
                         P4EST_COMM_GHOST_EXPAND_COUNT, comm, send_request +
                         peer);
     SC_CHECK_MPI (mpiret);
+    P4EST_TRACE_ISEND (p, P4EST_COMM_GHOST_EXPAND_COUNT, 1, P4EST_MPI_LOCIDX);
     peer++;
   }
   P4EST_ASSERT (peer == num_peers);
@@ -3506,11 +3569,13 @@ p4est_ghost_expand_internal (p4est_t * p4est, p4est_lnodes_t * lnodes,
 
   /* Wait for the counts */
   if (num_peers > 0) {
+    P4EST_TRACE_BEGIN ("MPI_Waitall");
     mpiret = MPI_Waitall (num_peers, recv_request, MPI_STATUSES_IGNORE);
     SC_CHECK_MPI (mpiret);
 
     mpiret = MPI_Waitall (num_peers, send_request, MPI_STATUSES_IGNORE);
     SC_CHECK_MPI (mpiret);
+    P4EST_TRACE_END ("MPI_Waitall");
   }
 
 #ifdef P4EST_ENABLE_DEBUG
@@ -3552,6 +3617,9 @@ p4est_ghost_expand_internal (p4est_t * p4est, p4est_lnodes_t * lnodes,
                    recv_load_request + peer);
 
       SC_CHECK_MPI (mpiret);
+      P4EST_TRACE_IRECV (p, P4EST_COMM_GHOST_EXPAND_LOAD,
+                         (int) (recv_counts[peer] * sizeof (p4est_quadrant_t)),
+                         MPI_BYTE);
       ghost_offset += recv_counts[peer];
     }
     else {
@@ -3578,6 +3646,9 @@ p4est_ghost_expand_internal (p4est_t * p4est, p4est_lnodes_t * lnodes,
                    MPI_BYTE, p, P4EST_COMM_GHOST_EXPAND_LOAD, comm,
                    send_load_request + peer);
       SC_CHECK_MPI (mpiret);
+      P4EST_TRACE_ISEND (p, P4EST_COMM_GHOST_EXPAND_LOAD,
+                         (int) (send_counts[peer] * sizeof (p4est_quadrant_t)),
+                         MPI_BYTE);
     }
     else {
       send_load_request[peer] = MPI_REQUEST_NULL;
@@ -3587,11 +3658,13 @@ p4est_ghost_expand_internal (p4est_t * p4est, p4est_lnodes_t * lnodes,
 
   /* Wait for everything */
   if (num_peers > 0) {
+    P4EST_TRACE_BEGIN ("MPI_Waitall");
     mpiret = MPI_Waitall (num_peers, recv_load_request, MPI_STATUSES_IGNORE);
     SC_CHECK_MPI (mpiret);
 
     mpiret = MPI_Waitall (num_peers, send_load_request, MPI_STATUSES_IGNORE);
     SC_CHECK_MPI (mpiret);
+    P4EST_TRACE_END ("MPI_Waitall");
   }
 
 #ifdef P4EST_ENABLE_DEBUG
@@ -4004,6 +4077,8 @@ p4est_ghost_is_valid (p4est_t * p4est, p4est_ghost_t * ghost)
       mpiret = sc_MPI_Irecv (&checksums_recv[i], 1, sc_MPI_LONG_LONG_INT, i,
                              P4EST_COMM_GHOST_CHECKSUM, p4est->mpicomm, req);
       SC_CHECK_MPI (mpiret);
+      P4EST_TRACE_IRECV (i, P4EST_COMM_GHOST_CHECKSUM, 1,
+                         sc_MPI_LONG_LONG_INT);
     }
 
     proc_offset = ghost->mirror_proc_offsets[i];
@@ -4032,12 +4107,16 @@ p4est_ghost_is_valid (p4est_t * p4est, p4est_ghost_t * ghost)
       mpiret = sc_MPI_Isend (&checksums_send[i], 1, sc_MPI_LONG_LONG_INT, i,
                              P4EST_COMM_GHOST_CHECKSUM, p4est->mpicomm, req);
       SC_CHECK_MPI (mpiret);
+      P4EST_TRACE_ISEND (i, P4EST_COMM_GHOST_CHECKSUM, 1,
+                         sc_MPI_LONG_LONG_INT);
     }
   }
 
+  P4EST_TRACE_BEGIN ("MPI_Waitall");
   mpiret = sc_MPI_Waitall (requests->elem_count, (sc_MPI_Request *)
                            requests->array, sc_MPI_STATUSES_IGNORE);
   SC_CHECK_MPI (mpiret);
+  P4EST_TRACE_END ("MPI_Waitall");
   sc_array_destroy (workspace);
   sc_array_destroy (requests);
   P4EST_FREE (checksums_send);
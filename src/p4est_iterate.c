@@ -1087,6 +1087,7 @@ p4est_corner_iterate (p4est_iter_corner_args_t * args, void *user_data,
   }
   if (has_local) {
     /* always run if a local quadrant touches the corner */
+    ++info->p4est->stats[P4EST_STAT_ITERATE_CORNER];
     iter_corner (info, user_data);
   }
   else if (args->remote) {
@@ -1149,6 +1150,7 @@ p4est_corner_iterate (p4est_iter_corner_args_t * args, void *user_data,
                     &&
                     (ht < llt ||
                      (ht == llt && p4est_quadrant_disjoint (&h, lq) < 0))) {
+                  ++info->p4est->stats[P4EST_STAT_ITERATE_CORNER];
                   iter_corner (info, user_data);
                   return;
                 }
@@ -1195,6 +1197,7 @@ p4est_corner_iterate (p4est_iter_corner_args_t * args, void *user_data,
                   (ht < llt ||
                    (ht == llt && p4est_quadrant_disjoint (&h, lq) < 0))) {
                 /* run the callback */
+                ++info->p4est->stats[P4EST_STAT_ITERATE_CORNER];
                 iter_corner (info, user_data);
                 return;
               }
@@ -1696,6 +1699,7 @@ p8est_edge_iterate (p8est_iter_edge_args_t * args, void *user_data,
     if (stop_refine) {
       if (has_local) {
         /* if there is a local quadrant, we run the callback */
+        ++info->p4est->stats[P4EST_STAT_ITERATE_EDGE];
         iter_edge (info, user_data);
       }
       else if (args->remote) {
@@ -1756,6 +1760,7 @@ p8est_edge_iterate (p8est_iter_edge_args_t * args, void *user_data,
                         && (ht < llt
                             || (ht == llt
                                 && p4est_quadrant_disjoint (&h, lq) < 0))) {
+                      ++info->p4est->stats[P4EST_STAT_ITERATE_EDGE];
                       iter_edge (info, user_data);
                       /* this goto is to avoid a 5-level break */
                       goto change_search_area;
@@ -2352,6 +2357,7 @@ p4est_face_iterate (p4est_iter_face_args_t * args, void *user_data,
     }
     if (stop_refine) {
       if (has_local) {
+        ++info->p4est->stats[P4EST_STAT_ITERATE_FACE];
         iter_face (info, user_data);
       }
     }
@@ -2687,6 +2693,7 @@ p4est_volume_iterate_simple (p4est_t * p4est, p4est_ghost_t * ghost_layer,
       info.quadid = si;
       iter_volume (&info, user_data);
     }
+    p4est->stats[P4EST_STAT_ITERATE_VOLUME] += (double) n_quads;
   }
 }
 
@@ -2764,6 +2771,7 @@ p4est_volume_iterate (p4est_iter_volume_args_t * args, void *user_data,
             info->quad = test[type];
             info->quadid = (p4est_locidx_t) first_index[type];
             if (iter_volume != NULL) {
+              ++info->p4est->stats[P4EST_STAT_ITERATE_VOLUME];
               iter_volume (info, user_data);
             }
           }
@@ -3159,6 +3167,7 @@ p4est_iterate_ext (p4est_t * p4est, p4est_ghost_t * Ghost_layer,
   p4est_topidx_t      last_run_tree;
   int32_t            *owned;
   int32_t             mask, touch;
+  double              start_time;
 
   P4EST_ASSERT (p4est_is_valid (p4est));
 
@@ -3170,6 +3179,7 @@ p4est_iterate_ext (p4est_t * p4est, p4est_ghost_t * Ghost_layer,
        iter_volume == NULL)) {
     return;
   }
+  start_time = sc_MPI_Wtime ();
 
   if (Ghost_layer == NULL) {
     sc_array_init (&(empty_ghost_layer.ghosts), sizeof (p4est_quadrant_t));
@@ -3194,6 +3204,7 @@ p4est_iterate_ext (p4est_t * p4est, p4est_ghost_t * Ghost_layer,
       P4EST_FREE (empty_ghost_layer.tree_offsets);
       P4EST_FREE (empty_ghost_layer.proc_offsets);
     }
+    p4est->stats[P4EST_STAT_ITERATE_TIME] += sc_MPI_Wtime () - start_time;
     return;
   }
 
@@ -3292,6 +3303,7 @@ p4est_iterate_ext (p4est_t * p4est, p4est_ghost_t * Ghost_layer,
 
   P4EST_FREE (owned);
   p4est_iter_loop_args_destroy (loop_args);
+  p4est->stats[P4EST_STAT_ITERATE_TIME] += sc_MPI_Wtime () - start_time;
 }
 
 void
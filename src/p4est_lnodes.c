@@ -40,6 +40,13 @@
 #ifdef P4EST_ENABLE_DEBUG
 #include <sc_statistics.h>
 #endif
+#ifdef SC_ENABLE_OPENMP
+#include <omp.h>
+#endif
+
+#if defined P4EST_ENABLE_MPI && defined MPI_VERSION && MPI_VERSION >= 3
+#define P4EST_LNODES_NEIGHBOR
+#endif
 
 #ifndef P4_TO_P8
 #define P4EST_LN_C_OFFSET 4
@@ -116,6 +123,34 @@ typedef struct p4est_lnodes_buf_info
 }
 p4est_lnodes_buf_info_t;
 
+/** block: the independent nodes created by one face or volume callback.
+ * The callbacks only reserve the nodes in the inodes array, and their owners
+ * are filled in after the iteration, possibly by several threads.
+ */
+typedef struct p4est_lnodes_block
+{
+  p4est_locidx_t      start;    /* first node in the inodes array */
+  p4est_locidx_t      owner_qid;
+  int                 owner_proc;
+  int                 count;
+}
+p4est_lnodes_block_t;
+
+/** fill: the element nodes of a local quadrant that point into a block.
+ * The face is -1 for the volume nodes.  For face nodes, the code tells how the
+ * nodes of the quadrant's face are ordered relative to the block: in 2D it is
+ * 1 if they are reversed, in 3D the bits 1, 2, and 4 stand for flipj, flipk,
+ * and swapjk as returned by p8est_lnodes_face_node_transform.
+ */
+typedef struct p4est_lnodes_fill
+{
+  p4est_locidx_t      qid;
+  p4est_locidx_t      start;    /* first node of the block */
+  int8_t              face;
+  int8_t              code;
+}
+p4est_lnodes_fill_t;
+
 typedef struct p4est_lnodes_data
 {
   p4est_lnodes_dep_t *local_dep;        /* num local quads */
@@ -142,6 +177,9 @@ typedef struct p4est_lnodes_data
   sc_array_t         *send_buf;
   sc_array_t         *touching_procs;
   sc_array_t         *all_procs;
+  sc_array_t          blocks;   /* p4est_lnodes_block_t */
+  sc_array_t          fills;    /* p4est_lnodes_fill_t */
+  int                 num_threads;
 }
 p4est_lnodes_data_t;
 
@@ -467,6 +505,61 @@ cside_get_fields (p4est_iter_corner_side_t * cside,
   *quad = cside->quad;
 }
 
+/** Append \a count independent nodes owned by the same quadrant at once.
+ */
+static inline void
+p4est_lnodes_push_inodes (sc_array_t * inodes, int count,
+                          int owner_proc, p4est_locidx_t owner_qid)
+{
+  int                 i;
+  p4est_locidx_t     *inode;
+
+  if (count <= 0) {
+    return;
+  }
+  inode = (p4est_locidx_t *) sc_array_push_count (inodes, (size_t) count);
+  for (i = 0; i < count; i++, inode += 2) {
+    inode[0] = owner_proc;
+    inode[1] = owner_qid;
+  }
+}
+
+/** Reserve \a count independent nodes owned by the same quadrant and record
+ * them as a block, whose owners are filled in by p4est_lnodes_expand.
+ * \return the index of the first node.
+ */
+static inline       p4est_locidx_t
+p4est_lnodes_reserve_inodes (p4est_lnodes_data_t * data, int count,
+                             int owner_proc, p4est_locidx_t owner_qid)
+{
+  p4est_lnodes_block_t *block;
+
+  block = (p4est_lnodes_block_t *) sc_array_push (&data->blocks);
+  block->start = (p4est_locidx_t) data->inodes->elem_count;
+  block->owner_qid = owner_qid;
+  block->owner_proc = owner_proc;
+  block->count = count;
+  (void) sc_array_push_count (data->inodes, (size_t) count);
+
+  return block->start;
+}
+
+/** Record that the nodes of face \a face of the local quadrant \a qid, or its
+ * volume nodes if \a face is -1, point to the block starting at \a start.
+ */
+static inline void
+p4est_lnodes_push_fill (p4est_lnodes_data_t * data, p4est_locidx_t qid,
+                        p4est_locidx_t start, int face, int code)
+{
+  p4est_lnodes_fill_t *fill;
+
+  fill = (p4est_lnodes_fill_t *) sc_array_push (&data->fills);
+  fill->qid = qid;
+  fill->start = start;
+  fill->face = (int8_t) face;
+  fill->code = (int8_t) code;
+}
+
 /** Once we have found the quadrant (\a q, \a tid, \a type) that owns a set of
  * nodes, push the info describing the owner quadrant on the appropriate
  * send/recv lists.
@@ -631,7 +724,7 @@ p4est_lnodes_corner_callback (p4est_iter_corner_info_t * info, void *Data)
   p4est_lnodes_data_t *data = (p4est_lnodes_data_t *) Data;
   p4est_iter_corner_side_t *cside, *owner_cside;
   sc_array_t         *inodes = data->inodes;
-  p4est_locidx_t     *inode, *lp;
+  p4est_locidx_t     *lp;
   sc_array_t         *inode_sharers = data->inode_sharers;
   p4est_lnodes_dep_t *local_dep = data->local_dep;
   p4est_lnodes_dep_t *ghost_dep = data->ghost_dep;
@@ -875,11 +968,7 @@ p4est_lnodes_corner_callback (p4est_iter_corner_info_t * info, void *Data)
     }
   }
   /* create the new node */
-  for (j = 0; j < npc; j++) {
-    inode = (p4est_locidx_t *) sc_array_push (inodes);
-    inode[0] = owner_proc;
-    inode[1] = owner_qid;
-  }
+  p4est_lnodes_push_inodes (inodes, npc, owner_proc, owner_qid);
 
   /* figure out if this is a remote corner or one for which we can determing
    * all touching and sharing procs */
@@ -1091,7 +1180,6 @@ p8est_lnodes_edge_callback (p8est_iter_edge_info_t * info, void *Data)
   p4est_lnodes_data_t *data = (p4est_lnodes_data_t *) Data;
   p8est_iter_edge_side_t *eside, *owner_eside;
   sc_array_t         *inodes = data->inodes;
-  p4est_locidx_t     *inode;
   sc_array_t         *inode_sharers = data->inode_sharers;
   p4est_lnodes_dep_t *local_dep = data->local_dep;
   p4est_lnodes_dep_t *ghost_dep = data->ghost_dep;
@@ -1283,13 +1371,9 @@ p8est_lnodes_edge_callback (p8est_iter_edge_info_t * info, void *Data)
     sc_array_uniq (touching_procs, sc_int_compare);
   }
   /* create nodes */
-  for (i = 0; i < nodes_per_edge; i++) {
-    inode = (p4est_locidx_t *) sc_array_push (inodes);
-    P4EST_ASSERT (inodes->elem_count <= (size_t)
-                  (nodes_per_elem * info->p4est->local_num_quadrants));
-    inode[0] = owner_proc;
-    inode[1] = owner_qid;
-  }
+  p4est_lnodes_push_inodes (inodes, nodes_per_edge, owner_proc, owner_qid);
+  P4EST_ASSERT (inodes->elem_count <= (size_t)
+                (nodes_per_elem * info->p4est->local_num_quadrants));
   /* point element nodes at created nodes; find all sharing procs */
   is_remote = !has_local;
   if (!is_remote) {
@@ -1452,9 +1536,7 @@ p4est_lnodes_face_callback (p4est_iter_face_info_t * info, void *Data)
   p4est_lnodes_data_t *data = (p4est_lnodes_data_t *) Data;
   p4est_iter_face_side_t *fside;
   sc_array_t         *inodes = data->inodes;
-  p4est_locidx_t     *inode;
   sc_array_t         *inode_sharers = data->inode_sharers;
-  p4est_locidx_t     *local_elem_nodes = data->local_elem_nodes;
   sc_array_t         *send_buf_info = data->send_buf_info;
   sc_array_t         *recv_buf_info = data->recv_buf_info;
   sc_array_t         *touching_procs = data->touching_procs;
@@ -1467,24 +1549,18 @@ p4est_lnodes_face_callback (p4est_iter_face_info_t * info, void *Data)
   p4est_locidx_t      num_inodes = (p4est_locidx_t) inodes->elem_count;
   int8_t             *is_ghost, owner_is_ghost;
   int                 f, owner_f;
-  p4est_locidx_t      nid;
   int                 owner_proc;
   int                 rank = info->p4est->mpirank;
   p4est_quadrant_t  **q;
   /* p4est_quadrant_t   *owner_q; */
   int                 nodes_per_face = data->nodes_per_face;
   int                 nodes_per_elem = data->nodes_per_elem;
-  int               **face_nodes = data->face_nodes;
   int                 is_hanging;
-  int                 i, j, limit;
-#ifndef P4_TO_P8
-  int                 stride;
-#else
-  int                 nodes_per_edge = SC_MAX (1, data->nodes_per_edge);
+  int                 i, limit;
+  int                 code;
+#ifdef P4_TO_P8
   int8_t              flipj, flipk, swapjk;
-  int                 k, l, jind, kind, lind;
 #endif
-  p4est_locidx_t      start_node;
   int8_t              type;
 
   sc_array_truncate (touching_procs);
@@ -1518,15 +1594,11 @@ p4est_lnodes_face_callback (p4est_iter_face_info_t * info, void *Data)
   sc_array_sort (touching_procs, sc_int_compare);
   sc_array_uniq (touching_procs, sc_int_compare);
   /* create the nodes */
-  for (i = 0; i < nodes_per_face; i++) {
-    inode = (p4est_locidx_t *) sc_array_push (inodes);
-    P4EST_ASSERT (inodes->elem_count <= (size_t)
-                  (nodes_per_elem * info->p4est->local_num_quadrants));
-    inode[0] = owner_proc;
-    inode[1] = owner_qid;
-  }
+  p4est_lnodes_reserve_inodes (data, nodes_per_face, owner_proc, owner_qid);
+  P4EST_ASSERT (inodes->elem_count <= (size_t)
+                (nodes_per_elem * info->p4est->local_num_quadrants));
 
-  /* point element nodes to created nodes */
+  /* record how the element nodes point to the created nodes */
   for (zz = 0; zz < count; zz++) {
     fside = p4est_iter_fside_array_index (sides, zz);
     limit = fside_get_fields (fside, &is_hanging, &tid, &f, &is_ghost, &qids,
@@ -1539,38 +1611,16 @@ p4est_lnodes_face_callback (p4est_iter_face_info_t * info, void *Data)
       if (!is_ghost[i]) {
         qid += quadrants_offset;
 #ifndef P4_TO_P8
-        start_node = num_inodes + (!zz ? 0 :
-                                   !info->orientation ? 0 :
-                                   nodes_per_face - 1);
-        stride = !zz ? 1 : !info->orientation ? 1 : -1;
-        for (j = 0; j < nodes_per_face; j++, start_node += stride) {
-          nid = qid * nodes_per_elem + face_nodes[f][j];
-          P4EST_ASSERT (local_elem_nodes[nid] == -1);
-          local_elem_nodes[nid] = start_node;
-        }
+        code = zz && info->orientation;
 #else
-        if (!zz) {
-          flipj = 0;
-          flipk = 0;
-          swapjk = 0;
-        }
-        else {
+        code = 0;
+        if (zz) {
           p8est_lnodes_face_node_transform (owner_f, f, info->orientation,
                                             &flipj, &flipk, &swapjk);
-        }
-        start_node = num_inodes;
-        for (l = 0, k = 0; k < nodes_per_edge; k++) {
-          for (j = 0; j < nodes_per_edge; j++, l++) {
-            nid = qid * nodes_per_elem + face_nodes[f][l];
-            jind = flipj ? (nodes_per_edge - 1 - j) : j;
-            kind = flipk ? (nodes_per_edge - 1 - k) : k;
-            lind = swapjk ? (nodes_per_edge * jind + kind) :
-              (nodes_per_edge * kind + jind);
-            P4EST_ASSERT (local_elem_nodes[nid] == -1);
-            local_elem_nodes[nid] = start_node + lind;
-          }
+          code = flipj | (flipk << 1) | (swapjk << 2);
         }
 #endif
+        p4est_lnodes_push_fill (data, qid, num_inodes, f, code);
       }
     }
   }
@@ -1595,27 +1645,109 @@ p4est_lnodes_volume_callback (p4est_iter_volume_info_t * info, void *Data)
   p4est_tree_t       *tree = p4est_tree_array_index (info->p4est->trees,
                                                      info->treeid);
   p4est_locidx_t      qid = info->quadid + tree->quadrants_offset;
-  p4est_locidx_t     *elem_nodes = data->local_elem_nodes;
-  sc_array_t         *inodes = data->inodes;
-  p4est_locidx_t      num_inodes = (p4est_locidx_t) inodes->elem_count;
-  p4est_locidx_t      nid;
-  p4est_locidx_t     *inode;
+  p4est_locidx_t      start;
+  int                 rank = info->p4est->mpirank;
+
+  start = p4est_lnodes_reserve_inodes (data, data->nodes_per_volume,
+                                       rank, qid);
+  p4est_lnodes_push_fill (data, qid, start, -1, 0);
+  P4EST_ASSERT (data->inodes->elem_count <= (size_t)
+                (data->nodes_per_elem * info->p4est->local_num_quadrants));
+}
+
+/* p4est_lnodes_expand:
+ *
+ * Fill in the owners of the nodes reserved by the face and volume callbacks
+ * and point the element nodes at them.  Every block and every fill writes
+ * entries of its own, so the local elements are processed in several threads,
+ * each taking a contiguous range of the records in the order of the iteration.
+ */
+static void
+p4est_lnodes_expand (p4est_lnodes_data_t * data)
+{
+#ifdef SC_ENABLE_OPENMP
+  int                 num_threads = data->num_threads;
+#endif
+  int                 nodes_per_elem = data->nodes_per_elem;
+  int                 nodes_per_face = data->nodes_per_face;
   int                 nodes_per_volume = data->nodes_per_volume;
   int                *volume_nodes = data->volume_nodes;
-  int                 nodes_per_elem = data->nodes_per_elem;
-  int                 i;
-  int                 rank = info->p4est->mpirank;
+  int               **face_nodes = data->face_nodes;
+  int                 i, j, f;
+#ifdef P4_TO_P8
+  int                 nodes_per_edge = SC_MAX (1, data->nodes_per_edge);
+  int                 k, jind, kind, lind;
+#endif
+  size_t              zz, num_blocks, num_fills;
+  size_t              transient;
+  p4est_locidx_t     *elem_nodes = data->local_elem_nodes;
+  p4est_locidx_t     *inode, *enodes;
+  p4est_lnodes_block_t *block;
+  p4est_lnodes_fill_t *fill;
+
+  num_blocks = data->blocks.elem_count;
+#ifdef SC_ENABLE_OPENMP
+#pragma omp parallel for num_threads (num_threads) schedule (static) \
+  private (i, block, inode)
+#endif
+  for (zz = 0; zz < num_blocks; zz++) {
+    block = (p4est_lnodes_block_t *) sc_array_index (&data->blocks, zz);
+    inode = (p4est_locidx_t *) sc_array_index (data->inodes,
+                                               (size_t) block->start);
+    for (i = 0; i < block->count; i++, inode += 2) {
+      inode[0] = block->owner_proc;
+      inode[1] = block->owner_qid;
+    }
+  }
 
-  for (i = 0; i < nodes_per_volume; i++) {
-    nid = qid * nodes_per_elem + volume_nodes[i];
-    P4EST_ASSERT (elem_nodes[nid] == -1);
-    elem_nodes[nid] = num_inodes + (p4est_locidx_t) i;
-    inode = (p4est_locidx_t *) sc_array_push (inodes);
-    P4EST_ASSERT (inodes->elem_count <= (size_t)
-                  (nodes_per_elem * info->p4est->local_num_quadrants));
-    inode[0] = rank;
-    inode[1] = qid;
+  num_fills = data->fills.elem_count;
+#ifdef SC_ENABLE_OPENMP
+#ifndef P4_TO_P8
+#pragma omp parallel for num_threads (num_threads) schedule (static) \
+  private (i, j, f, fill, enodes)
+#else
+#pragma omp parallel for num_threads (num_threads) schedule (static) \
+  private (i, j, k, f, jind, kind, lind, fill, enodes)
+#endif
+#endif
+  for (zz = 0; zz < num_fills; zz++) {
+    fill = (p4est_lnodes_fill_t *) sc_array_index (&data->fills, zz);
+    enodes = elem_nodes + fill->qid * nodes_per_elem;
+    f = (int) fill->face;
+    if (f < 0) {
+      for (i = 0; i < nodes_per_volume; i++) {
+        P4EST_ASSERT (enodes[volume_nodes[i]] == -1);
+        enodes[volume_nodes[i]] = fill->start + i;
+      }
+      continue;
+    }
+#ifndef P4_TO_P8
+    for (j = 0; j < nodes_per_face; j++) {
+      P4EST_ASSERT (enodes[face_nodes[f][j]] == -1);
+      enodes[face_nodes[f][j]] = fill->start +
+        (fill->code ? nodes_per_face - 1 - j : j);
+    }
+#else
+    P4EST_ASSERT (nodes_per_face == nodes_per_edge * nodes_per_edge);
+    for (i = 0, k = 0; k < nodes_per_edge; k++) {
+      for (j = 0; j < nodes_per_edge; j++, i++) {
+        jind = (fill->code & 1) ? (nodes_per_edge - 1 - j) : j;
+        kind = (fill->code & 2) ? (nodes_per_edge - 1 - k) : k;
+        lind = (fill->code & 4) ? (nodes_per_edge * jind + kind) :
+          (nodes_per_edge * kind + jind);
+        P4EST_ASSERT (enodes[face_nodes[f][i]] == -1);
+        enodes[face_nodes[f][i]] = fill->start + lind;
+      }
+    }
+#endif
   }
+
+  transient = sc_array_memory_used (&data->blocks, 0) +
+    sc_array_memory_used (&data->fills, 0);
+  p4est_memory_hold (transient);
+  p4est_memory_release (transient);
+  sc_array_reset (&data->blocks);
+  sc_array_reset (&data->fills);
 }
 
 static void
@@ -1643,6 +1775,7 @@ p4est_lnodes_init_data (p4est_lnodes_data_t * data, int p, p4est_t * p4est,
   p4est_locidx_t      nldep = nlq;
   p4est_locidx_t      ngdep = ngq;
   int                 mpisize = p4est->mpisize;
+  size_t              nest;
 
   if (p == -1) {
     data->nodes_per_elem = P4EST_FACES;
@@ -1845,6 +1978,26 @@ p4est_lnodes_init_data (p4est_lnodes_data_t * data, int p, p4est_t * p4est,
 
   data->inodes = sc_array_new (2 * sizeof (p4est_locidx_t));
   data->inode_sharers = sc_array_new (sizeof (int));
+
+  /* reserve the node count of a uniform periodic mesh, where every element
+   * creates the nodes of one corner, one face per direction, and the volume,
+   * to avoid repeated reallocation during the iteration */
+  nest = (size_t) nlq * (npv + P4EST_DIM * npf +
+#ifdef P4_TO_P8
+                         3 * npe +
+#endif
+                         npc);
+  sc_array_resize (data->inodes, nest);
+  sc_array_truncate (data->inodes);
+
+  /* the same estimate for the face and volume blocks and their fills */
+  sc_array_init_size (&data->blocks, sizeof (p4est_lnodes_block_t),
+                      (size_t) nlq * ((npv > 0) + P4EST_DIM * (npf > 0)));
+  sc_array_truncate (&data->blocks);
+  sc_array_init_size (&data->fills, sizeof (p4est_lnodes_fill_t),
+                      (size_t) nlq * ((npv > 0) + P4EST_FACES * (npf > 0)));
+  sc_array_truncate (&data->fills);
+  data->num_threads = 1;
   data->send_buf_info = P4EST_ALLOC (sc_array_t, mpisize);
   data->recv_buf_info = P4EST_ALLOC (sc_array_t, mpisize);
   for (i = 0; i < mpisize; i++) {
@@ -1864,6 +2017,19 @@ p4est_lnodes_reset_data (p4est_lnodes_data_t * data, p4est_t * p4est)
 {
   int                 mpisize = p4est->mpisize;
   int                 i;
+  size_t              transient;
+
+  /* count the node arrays and the buffer infos before they are freed */
+  transient = sc_array_memory_used (data->touching_procs, 1) +
+    sc_array_memory_used (data->all_procs, 1) +
+    sc_array_memory_used (data->inodes, 1) +
+    sc_array_memory_used (data->inode_sharers, 1);
+  for (i = 0; i < mpisize; i++) {
+    transient += sc_array_memory_used (&(data->send_buf_info[i]), 0) +
+      sc_array_memory_used (&(data->recv_buf_info[i]), 0);
+  }
+  p4est_memory_hold (transient);
+  p4est_memory_release (transient);
 
   sc_array_destroy (data->touching_procs);
   sc_array_destroy (data->all_procs);
@@ -1911,7 +2077,7 @@ p4est_lnodes_count_send (p4est_lnodes_data_t * data, p4est_t * p4est,
                          p4est_lnodes_t * lnodes)
 {
   p4est_locidx_t      nlq = p4est->local_num_quadrants;
-  p4est_locidx_t      nlen, nln;
+  p4est_locidx_t      nln;
   p4est_locidx_t      li, *lp;
   p4est_locidx_t      inidx;
   sc_array_t         *inodes = data->inodes;
@@ -1946,18 +2112,79 @@ p4est_lnodes_count_send (p4est_lnodes_data_t * data, p4est_t * p4est,
   size_t              countz;
   p4est_locidx_t     *poff = data->poff;
   p4est_locidx_t      pcount;
+  p4est_locidx_t     *owned, *roff, rcount, num_inodes;
+  p4est_locidx_t      first, last;
+  int                 r, num_ranges = data->num_threads;
+#ifdef SC_ENABLE_OPENMP
+  int                 num_threads = data->num_threads;
+#endif
 
-  nlen = ((p4est_locidx_t) npe) * nlq;
-  for (li = 0; li < nlen; li++) {
-    inidx = local_en[li];
-    P4EST_ASSERT (inidx >= 0);
-    inode = (p4est_locidx_t *) sc_array_index (inodes, (size_t) inidx);
-    /* if this quadrant owns the node */
-    if (inode[0] == rank && inode[1] == li / npe) {
+  /* The owned nodes are numbered in the order of the element nodes that point
+   * to them from their owner quadrant.  Each range of local elements counts
+   * its owned nodes, the counts are summed into offsets, and then each range
+   * numbers its nodes from its offset.  The numbers are stored aside so that
+   * the owners stay readable by all ranges until they are replaced. */
+  roff = P4EST_ALLOC (p4est_locidx_t, num_ranges + 1);
+  owned = P4EST_ALLOC (p4est_locidx_t, inodes->elem_count);
+#ifdef SC_ENABLE_OPENMP
+#pragma omp parallel for num_threads (num_threads) schedule (static) \
+  private (li, first, last, inidx, inode, rcount)
+#endif
+  for (r = 0; r < num_ranges; r++) {
+    first = npe * (p4est_locidx_t)
+      p4est_partition_cut_uint64 ((uint64_t) nlq, r, num_ranges);
+    last = npe * (p4est_locidx_t)
+      p4est_partition_cut_uint64 ((uint64_t) nlq, r + 1, num_ranges);
+    rcount = 0;
+    for (li = first; li < last; li++) {
+      inidx = local_en[li];
+      P4EST_ASSERT (inidx >= 0);
+      inode = (p4est_locidx_t *) sc_array_index (inodes, (size_t) inidx);
+      /* if this quadrant owns the node */
+      if (inode[0] == rank && inode[1] == li / npe) {
+        ++rcount;
+      }
+    }
+    roff[r + 1] = rcount;
+  }
+  roff[0] = 0;
+  for (r = 0; r < num_ranges; r++) {
+    roff[r + 1] += roff[r];
+  }
+  count = roff[num_ranges];
+#ifdef SC_ENABLE_OPENMP
+#pragma omp parallel for num_threads (num_threads) schedule (static) \
+  private (li, first, last, inidx, inode, rcount)
+#endif
+  for (r = 0; r < num_ranges; r++) {
+    first = npe * (p4est_locidx_t)
+      p4est_partition_cut_uint64 ((uint64_t) nlq, r, num_ranges);
+    last = npe * (p4est_locidx_t)
+      p4est_partition_cut_uint64 ((uint64_t) nlq, r + 1, num_ranges);
+    rcount = roff[r];
+    for (li = first; li < last; li++) {
+      inidx = local_en[li];
+      inode = (p4est_locidx_t *) sc_array_index (inodes, (size_t) inidx);
+      if (inode[0] == rank && inode[1] == li / npe) {
+        owned[inidx] = rcount++;
+      }
+    }
+    P4EST_ASSERT (rcount == roff[r + 1]);
+  }
+  num_inodes = (p4est_locidx_t) inodes->elem_count;
+#ifdef SC_ENABLE_OPENMP
+#pragma omp parallel for num_threads (num_threads) schedule (static) \
+  private (inode)
+#endif
+  for (li = 0; li < num_inodes; li++) {
+    inode = (p4est_locidx_t *) sc_array_index (inodes, (size_t) li);
+    if (inode[0] == rank) {
       inode[0] = -1;
-      inode[1] = count++;
+      inode[1] = owned[li];
     }
   }
+  P4EST_FREE (owned);
+  P4EST_FREE (roff);
   for (zz = 0; zz < inodes->elem_count; zz++) {
     inode = (p4est_locidx_t *) sc_array_index (inodes, zz);
     if (inode[0] >= 0) {
@@ -2043,6 +2270,9 @@ p4est_lnodes_count_send (p4est_lnodes_data_t * data, p4est_t * p4est,
   }
   P4EST_VERBOSEF ("Total of %llu bytes sent to %d processes\n",
                   (unsigned long long) total_sent, num_send_procs);
+  ++p4est->stats[P4EST_STAT_LNODES_ROUNDS];
+  p4est->stats[P4EST_STAT_LNODES_MESSAGES] += (double) num_send_procs;
+  p4est->stats[P4EST_STAT_LNODES_BYTES] += (double) total_sent;
 }
 
 #ifdef P4EST_ENABLE_DEBUG
@@ -2352,6 +2582,7 @@ p4est_lnodes_global_and_sharers (p4est_lnodes_data_t * data,
                                                                mpisize);
   sc_MPI_Allgather (&owned_count, 1, P4EST_MPI_LOCIDX, global_num_indep, 1,
                     P4EST_MPI_LOCIDX, p4est->mpicomm);
+  ++p4est->stats[P4EST_STAT_LNODES_ROUNDS];
 
   global_offsets[0] = 0;
   for (i = 0; i < mpisize; i++) {
@@ -2375,6 +2606,10 @@ p4est_lnodes_global_and_sharers (p4est_lnodes_data_t * data,
     }
   }
 
+#ifdef SC_ENABLE_OPENMP
+#pragma omp parallel for num_threads (data->num_threads) schedule (static) \
+  private (inidx, inode)
+#endif
   for (li = 0; li < nlen; li++) {
     inidx = elnodes[li];
     P4EST_ASSERT (0 <= inidx && inidx < num_inodes);
@@ -2569,10 +2804,14 @@ p4est_lnodes_new (p4est_t * p4est, p4est_ghost_t * ghost_layer, int degree)
 #endif
   p4est_lnodes_t     *lnodes = P4EST_ALLOC (p4est_lnodes_t, 1);
   p4est_gloidx_t      gtotal;
+  p4est_memory_peak_t memory;
+  double              start_time;
 
   P4EST_GLOBAL_PRODUCTIONF ("Into " P4EST_STRING "_lnodes_new, degree %d\n",
                             degree);
   p4est_log_indent_push ();
+  start_time = sc_MPI_Wtime ();
+  p4est_memory_peak_begin (&memory);
 
 #ifndef P4_TO_P8
   P4EST_ASSERT (degree >= 1 || degree == -1 || degree == -P4EST_DIM);
@@ -2612,6 +2851,13 @@ p4est_lnodes_new (p4est_t * p4est, p4est_ghost_t * ghost_layer, int degree)
   memset (lnodes->element_nodes, -1, nlen * sizeof (p4est_locidx_t));
 
   p4est_lnodes_init_data (&data, degree, p4est, ghost_layer, lnodes);
+#ifdef SC_ENABLE_OPENMP
+  data.num_threads = p4est->inspect != NULL ?
+    p4est->inspect->lnodes_num_threads : 0;
+  if (data.num_threads <= 0) {
+    data.num_threads = omp_get_max_threads ();
+  }
+#endif
   viter = data.nodes_per_volume ? p4est_lnodes_volume_callback : NULL;
   fiter = data.nodes_per_face ? p4est_lnodes_face_callback :
     ((data.nodes_per_corner ||
@@ -2630,6 +2876,7 @@ p4est_lnodes_new (p4est_t * p4est, p4est_ghost_t * ghost_layer, int degree)
                      eiter,
 #endif
                      citer, 1);
+  p4est_lnodes_expand (&data);
 
 #ifdef P4EST_ENABLE_DEBUG
   for (lj = 0; lj < nlen; lj++) {
@@ -2646,6 +2893,9 @@ p4est_lnodes_new (p4est_t * p4est, p4est_ghost_t * ghost_layer, int degree)
   gtotal = p4est_lnodes_global_and_sharers (&data, lnodes, p4est);
 
   p4est_lnodes_reset_data (&data, p4est);
+  p4est->stats[P4EST_STAT_LNODES_TIME] += sc_MPI_Wtime () - start_time;
+  p4est_memory_peak_stat (&memory, p4est_memory_used (p4est),
+                          &p4est->stats[P4EST_STAT_LNODES_MEMORY]);
 
 #ifdef P4EST_ENABLE_DEBUG
   {
@@ -2686,6 +2936,232 @@ p4est_lnodes_destroy (p4est_lnodes_t * lnodes)
   P4EST_FREE (lnodes);
 }
 
+/** Compare two pairs of local indices lexicographically. */
+static int
+p4est_lnodes_pair_compare (const void *v1, const void *v2)
+{
+  const p4est_locidx_t *a = (const p4est_locidx_t *) v1;
+  const p4est_locidx_t *b = (const p4est_locidx_t *) v2;
+
+  if (a[0] != b[0]) {
+    return a[0] < b[0] ? -1 : 1;
+  }
+  return (a[1] > b[1]) - (a[1] < b[1]);
+}
+
+/** Compute a reverse Cuthill-McKee ordering of the owned nodes.
+ * Two owned nodes are adjacent if they belong to a common element, and the
+ * degree of a node is approximated by the number of its elements.
+ * \param [in] lnodes   The node numbering.
+ * \param [out] perm    Maps each owned node to its new local number.
+ */
+static void
+p4est_lnodes_rcm (p4est_lnodes_t * lnodes, p4est_locidx_t * perm)
+{
+  const p4est_locidx_t owned = lnodes->owned_count;
+  const p4est_locidx_t nel = lnodes->num_local_elements;
+  const int           vnodes = lnodes->vnodes;
+  const p4est_locidx_t *elnodes = lnodes->element_nodes;
+  int                 j;
+  size_t              zz;
+  p4est_locidx_t      el, li, ni, u, k;
+  p4est_locidx_t      head, tail, nseed;
+  p4est_locidx_t     *eoff, *elist, *degree, *order;
+  p4est_locidx_t     *pair;
+  sc_array_t         *seeds, *front;
+
+  if (owned == 0) {
+    return;
+  }
+
+  /* node to element incidence in compressed row storage */
+  eoff = P4EST_ALLOC_ZERO (p4est_locidx_t, owned + 1);
+  degree = P4EST_ALLOC_ZERO (p4est_locidx_t, owned);
+  for (el = 0; el < nel; el++) {
+    for (j = 0; j < vnodes; j++) {
+      ni = elnodes[el * vnodes + j];
+      if (ni < owned) {
+        ++eoff[ni + 1];
+      }
+    }
+  }
+  for (li = 0; li < owned; li++) {
+    eoff[li + 1] += eoff[li];
+  }
+  elist = P4EST_ALLOC (p4est_locidx_t, eoff[owned]);
+  for (el = 0; el < nel; el++) {
+    for (j = 0; j < vnodes; j++) {
+      ni = elnodes[el * vnodes + j];
+      if (ni < owned) {
+        elist[eoff[ni] + degree[ni]++] = el;
+      }
+    }
+  }
+
+  /* every connected component is started from a node of minimum degree */
+  seeds = sc_array_new_size (2 * sizeof (p4est_locidx_t), owned);
+  for (li = 0; li < owned; li++) {
+    pair = (p4est_locidx_t *) sc_array_index (seeds, li);
+    pair[0] = degree[li];
+    pair[1] = li;
+    perm[li] = -1;
+  }
+  sc_array_sort (seeds, p4est_lnodes_pair_compare);
+
+  /* breadth-first traversal visiting neighbors in order of degree */
+  order = P4EST_ALLOC (p4est_locidx_t, owned);
+  front = sc_array_new (2 * sizeof (p4est_locidx_t));
+  head = tail = nseed = 0;
+  while (tail < owned) {
+    do {
+      pair = (p4est_locidx_t *) sc_array_index (seeds, nseed++);
+    } while (perm[pair[1]] != -1);
+    perm[pair[1]] = tail;
+    order[tail++] = pair[1];
+    while (head < tail) {
+      u = order[head++];
+      sc_array_truncate (front);
+      for (k = eoff[u]; k < eoff[u + 1]; k++) {
+        el = elist[k];
+        for (j = 0; j < vnodes; j++) {
+          ni = elnodes[el * vnodes + j];
+          if (ni < owned && perm[ni] == -1) {
+            perm[ni] = -2;
+            pair = (p4est_locidx_t *) sc_array_push (front);
+            pair[0] = degree[ni];
+            pair[1] = ni;
+          }
+        }
+      }
+      sc_array_sort (front, p4est_lnodes_pair_compare);
+      for (zz = 0; zz < front->elem_count; zz++) {
+        pair = (p4est_locidx_t *) sc_array_index (front, zz);
+        perm[pair[1]] = tail;
+        order[tail++] = pair[1];
+      }
+    }
+  }
+  P4EST_ASSERT (head == owned);
+
+  /* reverse the order */
+  for (li = 0; li < owned; li++) {
+    perm[order[li]] = owned - 1 - li;
+  }
+
+  sc_array_destroy (front);
+  sc_array_destroy (seeds);
+  P4EST_FREE (order);
+  P4EST_FREE (elist);
+  P4EST_FREE (degree);
+  P4EST_FREE (eoff);
+}
+
+void
+p4est_lnodes_renumber (p4est_lnodes_t * lnodes)
+{
+  const p4est_locidx_t owned = lnodes->owned_count;
+  const p4est_locidx_t nlocal = lnodes->num_local_nodes;
+  const p4est_locidx_t nelnodes =
+    lnodes->num_local_elements * lnodes->vnodes;
+  int                 mpiret, mpirank;
+  size_t              zz, zy, count;
+  p4est_locidx_t      li, lj;
+  p4est_locidx_t     *perm, *lp;
+  p4est_gloidx_t     *gp;
+  sc_array_t         *sharers = lnodes->sharers;
+  sc_array_t         *gnodes, *sorter;
+  p4est_lnodes_rank_t *lrank;
+
+  mpiret = sc_MPI_Comm_rank (lnodes->mpicomm, &mpirank);
+  SC_CHECK_MPI (mpiret);
+
+  perm = P4EST_ALLOC (p4est_locidx_t, nlocal);
+  p4est_lnodes_rcm (lnodes, perm);
+
+  /* renumber the owned nodes in the sharer lists: their order is kept,
+   * since it matches the order of the corresponding lists of the sharers */
+  for (zz = 0; zz < sharers->elem_count; zz++) {
+    lrank = p4est_lnodes_rank_array_index (sharers, zz);
+    lp = (p4est_locidx_t *) lrank->shared_nodes.array;
+    for (zy = 0; zy < lrank->shared_nodes.elem_count; zy++) {
+      if (lp[zy] < owned) {
+        lp[zy] = perm[lp[zy]];
+      }
+    }
+  }
+
+  /* the owners send the new global numbers of the nonlocal nodes */
+  gnodes = sc_array_new_size (sizeof (p4est_gloidx_t), nlocal);
+  gp = (p4est_gloidx_t *) gnodes->array;
+  for (li = 0; li < owned; li++) {
+    gp[li] = lnodes->global_offset + li;
+  }
+  p4est_lnodes_share_owned (gnodes, lnodes);
+
+  /* the nonlocal nodes of each owner are sorted by their global number */
+  sorter = sc_array_new (2 * sizeof (p4est_gloidx_t));
+  for (zz = 0; zz < sharers->elem_count; zz++) {
+    lrank = p4est_lnodes_rank_array_index (sharers, zz);
+    if (lrank->rank == mpirank) {
+      continue;
+    }
+    sc_array_resize (sorter, (size_t) lrank->owned_count);
+    for (li = 0; li < lrank->owned_count; li++) {
+      lj = lrank->owned_offset + li;
+      gp = (p4est_gloidx_t *) sc_array_index (sorter, li);
+      gp[0] = *(p4est_gloidx_t *) sc_array_index (gnodes, lj);
+      gp[1] = lj;
+    }
+    sc_array_sort (sorter, p4est_gloidx_compare);
+    for (li = 0; li < lrank->owned_count; li++) {
+      lj = lrank->owned_offset + li;
+      gp = (p4est_gloidx_t *) sc_array_index (sorter, li);
+      perm[gp[1]] = lj;
+      lnodes->nonlocal_nodes[lj - owned] = gp[0];
+    }
+  }
+
+  /* apply the permutation to the elements and the remaining sharer entries */
+  for (li = 0; li < nelnodes; li++) {
+    lnodes->element_nodes[li] = perm[lnodes->element_nodes[li]];
+  }
+  for (zz = 0; zz < sharers->elem_count; zz++) {
+    lrank = p4est_lnodes_rank_array_index (sharers, zz);
+    count = lrank->shared_nodes.elem_count;
+    lp = (p4est_locidx_t *) lrank->shared_nodes.array;
+    for (zy = 0; zy < count; zy++) {
+      if (lp[zy] >= owned) {
+        lp[zy] = perm[lp[zy]];
+      }
+    }
+
+    /* the sharer lists are sorted by global number */
+    sc_array_resize (sorter, count);
+    for (zy = 0; zy < count; zy++) {
+      gp = (p4est_gloidx_t *) sc_array_index (sorter, zy);
+      gp[0] = p4est_lnodes_global_index (lnodes, lp[zy]);
+      gp[1] = lp[zy];
+    }
+    sc_array_sort (sorter, p4est_gloidx_compare);
+    lrank->shared_mine_offset = -1;
+    lrank->shared_mine_count = 0;
+    for (zy = 0; zy < count; zy++) {
+      gp = (p4est_gloidx_t *) sc_array_index (sorter, zy);
+      lp[zy] = (p4est_locidx_t) gp[1];
+      if (lp[zy] < owned) {
+        if (lrank->shared_mine_count == 0) {
+          lrank->shared_mine_offset = (p4est_locidx_t) zy;
+        }
+        lrank->shared_mine_count++;
+      }
+    }
+  }
+
+  sc_array_destroy (sorter);
+  sc_array_destroy (gnodes);
+  P4EST_FREE (perm);
+}
+
 #ifdef P4EST_ENABLE_MPI
 
 static              size_t
@@ -3724,3 +4200,417 @@ p4est_lnodes_buffer_destroy (p4est_lnodes_buffer_t * buffer)
   }
   P4EST_FREE (buffer);
 }
+
+#ifndef P4EST_LNODES_NEIGHBOR
+
+/** Append a persistent request for a point-to-point message of a plan. */
+static void
+p4est_lnodes_plan_request (sc_array_t * requests, int is_send, void *data,
+                           size_t bytes, int proc, int tag, sc_MPI_Comm comm)
+{
+#ifdef P4EST_ENABLE_MPI
+  int                 mpiret;
+  sc_MPI_Request     *request;
+
+  request = (sc_MPI_Request *) sc_array_push (requests);
+  if (is_send) {
+    mpiret = MPI_Send_init (data, (int) bytes, MPI_BYTE, proc, tag, comm,
+                            request);
+  }
+  else {
+    mpiret = MPI_Recv_init (data, (int) bytes, MPI_BYTE, proc, tag, comm,
+                            request);
+  }
+  SC_CHECK_MPI (mpiret);
+#else
+  /* without MPI there is no process other than the current one */
+  SC_ABORT_NOT_REACHED ();
+#endif
+}
+
+static void
+p4est_lnodes_plan_start (sc_array_t * requests)
+{
+#ifdef P4EST_ENABLE_MPI
+  int                 mpiret;
+
+  if (requests->elem_count) {
+    mpiret = MPI_Startall ((int) requests->elem_count,
+                           (sc_MPI_Request *) requests->array);
+    SC_CHECK_MPI (mpiret);
+  }
+#else
+  P4EST_ASSERT (requests->elem_count == 0);
+#endif
+}
+
+static void
+p4est_lnodes_plan_wait (sc_array_t * requests)
+{
+  int                 mpiret;
+
+  if (requests->elem_count) {
+    mpiret = sc_MPI_Waitall ((int) requests->elem_count,
+                             (sc_MPI_Request *) requests->array,
+                             sc_MPI_STATUSES_IGNORE);
+    SC_CHECK_MPI (mpiret);
+  }
+}
+
+#endif /* !P4EST_LNODES_NEIGHBOR */
+
+static void
+p4est_lnodes_plan_free_requests (sc_array_t * requests)
+{
+#ifdef P4EST_ENABLE_MPI
+  int                 mpiret;
+  size_t              zz;
+
+  for (zz = 0; zz < requests->elem_count; zz++) {
+    mpiret =
+      MPI_Request_free ((sc_MPI_Request *) sc_array_index (requests, zz));
+    SC_CHECK_MPI (mpiret);
+  }
+#endif
+  sc_array_destroy (requests);
+}
+
+/** Begin the owned or the all exchange of a plan. */
+static void
+p4est_lnodes_plan_begin (p4est_lnodes_plan_t * plan, int owned)
+{
+#ifdef P4EST_LNODES_NEIGHBOR
+  int                 mpiret;
+  int                 n = plan->num_neighbors;
+  int                *counts = plan->graph_counts;
+  size_t              elem_size = plan->elem_size;
+  char               *send_block = plan->block;
+  char               *owned_block = send_block + elem_size * plan->num_shared;
+  char               *recv_block = owned_block + elem_size * plan->num_owned;
+
+  /* the counts are laid out as described in p4est_lnodes_plan_new */
+  if (owned) {
+    mpiret = MPI_Ineighbor_alltoallv (send_block, counts, counts + n,
+                                      MPI_BYTE, owned_block, counts + 2 * n,
+                                      counts + 3 * n, MPI_BYTE, plan->graph,
+                                      &plan->graph_request);
+  }
+  else {
+    mpiret = MPI_Ineighbor_alltoallv (send_block, counts + 4 * n,
+                                      counts + 5 * n, MPI_BYTE, recv_block,
+                                      counts + 4 * n, counts + 5 * n,
+                                      MPI_BYTE, plan->graph,
+                                      &plan->graph_request);
+  }
+  SC_CHECK_MPI (mpiret);
+#else
+  p4est_lnodes_plan_start (owned ? plan->owned_requests : plan->all_requests);
+#endif
+}
+
+/** Complete the exchange begun by p4est_lnodes_plan_begin. */
+static void
+p4est_lnodes_plan_end (p4est_lnodes_plan_t * plan, int owned)
+{
+#ifdef P4EST_LNODES_NEIGHBOR
+  int                 mpiret;
+
+  mpiret = sc_MPI_Wait (&plan->graph_request, sc_MPI_STATUS_IGNORE);
+  SC_CHECK_MPI (mpiret);
+#else
+  p4est_lnodes_plan_wait (owned ? plan->owned_requests : plan->all_requests);
+#endif
+}
+
+/** Copy the node data of a section of the shared nodes into the send buffers
+ * of all remote sharers.  The buffers are indexed like the shared nodes.
+ */
+static void
+p4est_lnodes_plan_gather (p4est_lnodes_plan_t * plan, sc_array_t * node_data,
+                          int mine_only)
+{
+  int                 p;
+  sc_array_t         *sharers = plan->lnodes->sharers;
+  int                 npeers = (int) sharers->elem_count;
+  p4est_lnodes_rank_t *lrank;
+  sc_array_t         *send_buf;
+  p4est_locidx_t      li, lz, offset, count;
+  p4est_locidx_t     *shared;
+  size_t              elem_size = plan->elem_size;
+
+  for (p = 0; p < npeers; p++) {
+    lrank = p4est_lnodes_rank_array_index_int (sharers, p);
+    if (lrank->rank == plan->mpirank) {
+      continue;
+    }
+    if (mine_only) {
+      offset = lrank->shared_mine_offset;
+      count = lrank->shared_mine_count;
+    }
+    else {
+      offset = 0;
+      count = (p4est_locidx_t) lrank->shared_nodes.elem_count;
+    }
+    send_buf = (sc_array_t *) sc_array_index_int (plan->send_buffers, p);
+    shared = (p4est_locidx_t *) lrank->shared_nodes.array;
+    for (li = offset; li < offset + count; li++) {
+      lz = shared[li];
+      memcpy (send_buf->array + elem_size * li,
+              node_data->array + elem_size * lz, elem_size);
+    }
+  }
+}
+
+p4est_lnodes_plan_t *
+p4est_lnodes_plan_new (p4est_lnodes_t * lnodes, size_t elem_size)
+{
+  int                 mpiret;
+  int                 p, proc;
+  sc_array_t         *sharers = lnodes->sharers;
+  int                 npeers = (int) sharers->elem_count;
+  p4est_lnodes_rank_t *lrank;
+  p4est_lnodes_plan_t *plan;
+  sc_array_t         *send_buf, *owned_buf, *recv_buf;
+  size_t              count, send_offset, owned_offset;
+  char               *owned_block, *recv_block;
+  sc_MPI_Comm         comm = lnodes->mpicomm;
+#ifdef P4EST_LNODES_NEIGHBOR
+  int                 n, *counts, *neighbors, *weights;
+#endif
+
+  P4EST_ASSERT (elem_size > 0);
+
+  plan = P4EST_ALLOC (p4est_lnodes_plan_t, 1);
+  plan->lnodes = lnodes;
+  plan->elem_size = elem_size;
+  mpiret = sc_MPI_Comm_rank (comm, &plan->mpirank);
+  SC_CHECK_MPI (mpiret);
+  plan->node_data = NULL;
+  plan->owned_requests = sc_array_new (sizeof (sc_MPI_Request));
+  plan->all_requests = sc_array_new (sizeof (sc_MPI_Request));
+  plan->send_buffers = sc_array_new_size (sizeof (sc_array_t), npeers);
+  plan->owned_buffers = sc_array_new_size (sizeof (sc_array_t), npeers);
+  plan->recv_buffers = sc_array_new_size (sizeof (sc_array_t), npeers);
+  plan->graph = sc_MPI_COMM_NULL;
+  plan->graph_request = sc_MPI_REQUEST_NULL;
+  plan->num_neighbors = 0;
+  plan->graph_counts = NULL;
+
+  /* the buffers of all remote sharers are views into one block, where the
+   * send buffers come first, then the owned buffers, then the recv buffers */
+  plan->num_shared = plan->num_owned = 0;
+  for (p = 0; p < npeers; p++) {
+    lrank = p4est_lnodes_rank_array_index_int (sharers, p);
+    if (lrank->rank != plan->mpirank) {
+      plan->num_shared += lrank->shared_nodes.elem_count;
+      plan->num_owned += (size_t) lrank->owned_count;
+      ++plan->num_neighbors;
+    }
+  }
+  plan->block = P4EST_ALLOC (char, elem_size *
+                             (2 * plan->num_shared + plan->num_owned));
+  owned_block = plan->block + elem_size * plan->num_shared;
+  recv_block = owned_block + elem_size * plan->num_owned;
+
+#ifdef P4EST_LNODES_NEIGHBOR
+  /* six arrays of byte counts and displacements for the neighbors: send
+   * counts, send displacements, recv counts, recv displacements of the owned
+   * exchange, and counts and displacements of the all exchange, which are
+   * the same for sending and receiving */
+  n = plan->num_neighbors;
+  plan->graph_counts = counts = P4EST_ALLOC (int, 6 * n);
+  neighbors = P4EST_ALLOC (int, SC_MAX (1, n));
+  n = 0;
+#endif
+  send_offset = owned_offset = 0;
+  for (p = 0; p < npeers; p++) {
+    lrank = p4est_lnodes_rank_array_index_int (sharers, p);
+    proc = lrank->rank;
+    send_buf = (sc_array_t *) sc_array_index_int (plan->send_buffers, p);
+    owned_buf = (sc_array_t *) sc_array_index_int (plan->owned_buffers, p);
+    recv_buf = (sc_array_t *) sc_array_index_int (plan->recv_buffers, p);
+    if (proc == plan->mpirank) {
+      sc_array_init (send_buf, elem_size);
+      sc_array_init (owned_buf, elem_size);
+      sc_array_init (recv_buf, elem_size);
+      continue;
+    }
+    count = lrank->shared_nodes.elem_count;
+    sc_array_init_data (send_buf, plan->block + elem_size * send_offset,
+                        elem_size, count);
+    sc_array_init_data (owned_buf, owned_block + elem_size * owned_offset,
+                        elem_size, (size_t) lrank->owned_count);
+    sc_array_init_data (recv_buf, recv_block + elem_size * send_offset,
+                        elem_size, count);
+
+#ifdef P4EST_LNODES_NEIGHBOR
+    neighbors[n] = proc;
+    counts[n] = (int) (elem_size * lrank->shared_mine_count);
+    counts[plan->num_neighbors + n] = (int)
+      (elem_size * (send_offset + lrank->shared_mine_offset));
+    counts[2 * plan->num_neighbors + n] =
+      (int) (elem_size * lrank->owned_count);
+    counts[3 * plan->num_neighbors + n] = (int) (elem_size * owned_offset);
+    counts[4 * plan->num_neighbors + n] = (int) (elem_size * count);
+    counts[5 * plan->num_neighbors + n] = (int) (elem_size * send_offset);
+    ++n;
+#else
+    /* the owned exchange receives into a separate buffer since the
+     * node_data array may differ between calls */
+    if (lrank->owned_count) {
+      p4est_lnodes_plan_request (plan->owned_requests, 0, owned_buf->array,
+                                 owned_buf->elem_count * elem_size, proc,
+                                 P4EST_COMM_LNODES_OWNED, comm);
+    }
+    if (lrank->shared_mine_count) {
+      p4est_lnodes_plan_request (plan->owned_requests, 1,
+                                 send_buf->array +
+                                 elem_size * lrank->shared_mine_offset,
+                                 elem_size * lrank->shared_mine_count, proc,
+                                 P4EST_COMM_LNODES_OWNED, comm);
+    }
+    if (count) {
+      p4est_lnodes_plan_request (plan->all_requests, 0, recv_buf->array,
+                                 count * elem_size, proc,
+                                 P4EST_COMM_LNODES_ALL, comm);
+      p4est_lnodes_plan_request (plan->all_requests, 1, send_buf->array,
+                                 count * elem_size, proc,
+                                 P4EST_COMM_LNODES_ALL, comm);
+    }
+#endif
+    send_offset += count;
+    owned_offset += (size_t) lrank->owned_count;
+  }
+  P4EST_ASSERT (send_offset == plan->num_shared);
+  P4EST_ASSERT (owned_offset == plan->num_owned);
+
+#ifdef P4EST_LNODES_NEIGHBOR
+  /* the sharer relation is symmetric and the sharers are sorted by rank;
+     uniform weights in arrays of at least one entry avoid the sentinels */
+  P4EST_ASSERT (n == plan->num_neighbors);
+  weights = P4EST_ALLOC (int, SC_MAX (1, n));
+  for (p = 0; p < SC_MAX (1, n); p++) {
+    weights[p] = 1;
+  }
+  mpiret = MPI_Dist_graph_create_adjacent (comm, n, neighbors, weights,
+                                           n, neighbors, weights,
+                                           MPI_INFO_NULL, 0, &plan->graph);
+  SC_CHECK_MPI (mpiret);
+  P4EST_FREE (weights);
+  P4EST_FREE (neighbors);
+#endif
+
+  return plan;
+}
+
+void
+p4est_lnodes_plan_destroy (p4est_lnodes_plan_t * plan)
+{
+  int                 i;
+  size_t              zz;
+  sc_array_t         *bufs, *buf;
+
+  P4EST_ASSERT (plan->node_data == NULL);
+
+  p4est_lnodes_plan_free_requests (plan->owned_requests);
+  p4est_lnodes_plan_free_requests (plan->all_requests);
+#ifdef P4EST_LNODES_NEIGHBOR
+  {
+    int                 mpiret;
+
+    mpiret = sc_MPI_Comm_free (&plan->graph);
+    SC_CHECK_MPI (mpiret);
+  }
+#endif
+  for (i = 0; i < 3; i++) {
+    bufs = (i == 0) ? plan->send_buffers :
+      (i == 1) ? plan->owned_buffers : plan->recv_buffers;
+    for (zz = 0; zz < bufs->elem_count; zz++) {
+      buf = (sc_array_t *) sc_array_index (bufs, zz);
+      sc_array_reset (buf);
+    }
+    sc_array_destroy (bufs);
+  }
+  P4EST_FREE (plan->graph_counts);
+  P4EST_FREE (plan->block);
+  P4EST_FREE (plan);
+}
+
+void
+p4est_lnodes_plan_share_owned_begin (p4est_lnodes_plan_t * plan,
+                                     sc_array_t * node_data)
+{
+  P4EST_ASSERT (plan->node_data == NULL);
+  P4EST_ASSERT (node_data->elem_size == plan->elem_size);
+  P4EST_ASSERT (node_data->elem_count ==
+                (size_t) plan->lnodes->num_local_nodes);
+
+  plan->node_data = node_data;
+  p4est_lnodes_plan_gather (plan, node_data, 1);
+  p4est_lnodes_plan_begin (plan, 1);
+}
+
+void
+p4est_lnodes_plan_share_owned_end (p4est_lnodes_plan_t * plan)
+{
+  int                 p;
+  sc_array_t         *sharers = plan->lnodes->sharers;
+  int                 npeers = (int) sharers->elem_count;
+  p4est_lnodes_rank_t *lrank;
+  sc_array_t         *owned_buf;
+  sc_array_t         *node_data = plan->node_data;
+  size_t              elem_size = plan->elem_size;
+
+  P4EST_ASSERT (node_data != NULL);
+
+  p4est_lnodes_plan_end (plan, 1);
+  for (p = 0; p < npeers; p++) {
+    lrank = p4est_lnodes_rank_array_index_int (sharers, p);
+    if (lrank->rank == plan->mpirank || !lrank->owned_count) {
+      continue;
+    }
+    owned_buf = (sc_array_t *) sc_array_index_int (plan->owned_buffers, p);
+    memcpy (node_data->array + elem_size * lrank->owned_offset,
+            owned_buf->array, elem_size * lrank->owned_count);
+  }
+  plan->node_data = NULL;
+}
+
+void
+p4est_lnodes_plan_share_owned (p4est_lnodes_plan_t * plan,
+                               sc_array_t * node_data)
+{
+  p4est_lnodes_plan_share_owned_begin (plan, node_data);
+  p4est_lnodes_plan_share_owned_end (plan);
+}
+
+void
+p4est_lnodes_plan_share_all_begin (p4est_lnodes_plan_t * plan,
+                                   sc_array_t * node_data)
+{
+  P4EST_ASSERT (plan->node_data == NULL);
+  P4EST_ASSERT (node_data->elem_size == plan->elem_size);
+  P4EST_ASSERT (node_data->elem_count ==
+                (size_t) plan->lnodes->num_local_nodes);
+
+  plan->node_data = node_data;
+  p4est_lnodes_plan_gather (plan, node_data, 0);
+  p4est_lnodes_plan_begin (plan, 0);
+}
+
+void
+p4est_lnodes_plan_share_all_end (p4est_lnodes_plan_t * plan)
+{
+  P4EST_ASSERT (plan->node_data != NULL);
+
+  p4est_lnodes_plan_end (plan, 0);
+  plan->node_data = NULL;
+}
+
+void
+p4est_lnodes_plan_share_all (p4est_lnodes_plan_t * plan,
+                             sc_array_t * node_data)
+{
+  p4est_lnodes_plan_share_all_begin (plan, node_data);
+  p4est_lnodes_plan_share_all_end (plan);
+}
@@ -212,6 +212,17 @@ p4est_lnodes_t     *p4est_lnodes_new (p4est_t * p4est,
 
 void                p4est_lnodes_destroy (p4est_lnodes_t * lnodes);
 
+/** Renumber the owned nodes of each process to reduce the bandwidth.
+ * The owned nodes are permuted by a reverse Cuthill-McKee ordering of the
+ * graph where two nodes are adjacent if they belong to a common element.
+ * The nodes owned by each process remain a contiguous block of the global
+ * numbering starting at \a global_offset.  The element_nodes,
+ * nonlocal_nodes and sharers arrays are updated accordingly, such that all
+ * invariants documented above continue to hold.  This function is collective.
+ * \param [in,out] lnodes     The nodes to renumber.
+ */
+void                p4est_lnodes_renumber (p4est_lnodes_t * lnodes);
+
 /** Expand the ghost layer to include the support of all nodes supported on
  * the local partition.
  *
@@ -348,6 +359,99 @@ p4est_lnodes_buffer_t *p4est_lnodes_share_all (sc_array_t * node_data,
 void                p4est_lnodes_buffer_destroy (p4est_lnodes_buffer_t *
                                                  buffer);
 
+/** p4est_lnodes_plan_t is a persistent communication plan for node data of
+ * a fixed element size.  It is meant for repeated exchanges on the same
+ * \a lnodes, such as in the inner loop of an iterative solver, where the
+ * buffers and the communication pattern are set up once and reused.
+ * If MPI-3 is available, the plan holds a distributed graph communicator
+ * over the sharers and each exchange is a single MPI_Ineighbor_alltoallv.
+ * Otherwise it holds MPI persistent point-to-point requests.
+ *
+ * \a recv_buffers has the same layout as in p4est_lnodes_buffer_t:
+ * \a recv_buffers[j] corresponds with lnodes->sharers[j].  At the completion
+ * of p4est_lnodes_plan_share_all or p4est_lnodes_plan_share_all_end it
+ * contains the node-data from the process lnodes->sharers[j]->rank, and it
+ * stays valid until the next exchange is begun with this plan.
+ * The other members are internal.
+ */
+typedef struct p4est_lnodes_plan
+{
+  p4est_lnodes_t     *lnodes;
+  size_t              elem_size;
+  int                 mpirank;
+  sc_array_t         *node_data;        /* during an active exchange */
+  sc_array_t         *owned_requests;   /* sc_MPI_Request */
+  sc_array_t         *all_requests;     /* sc_MPI_Request */
+  sc_array_t         *send_buffers;     /* views into block */
+  sc_array_t         *owned_buffers;    /* views into block */
+  sc_array_t         *recv_buffers;     /* views into block */
+  char               *block;
+  size_t              num_shared, num_owned;
+  sc_MPI_Comm         graph;    /* neighborhood graph if MPI-3 */
+  sc_MPI_Request      graph_request;
+  int                 num_neighbors;
+  int                *graph_counts;     /* byte counts and displacements */
+}
+p4est_lnodes_plan_t;
+
+/** Create a persistent communication plan for \a lnodes.
+ * If MPI-3 is available this function is collective over lnodes->mpicomm,
+ * and so are the exchanges with the plan, which all processes must begin
+ * and end in the same order.
+ * \param [in] lnodes      The plan refers to this structure, which must
+ *                         remain alive until the plan is destroyed.
+ * \param [in] elem_size   The element size of all \a node_data arrays
+ *                         that are exchanged with this plan.
+ * \return                 The plan, to be freed with
+ *                         p4est_lnodes_plan_destroy.
+ */
+p4est_lnodes_plan_t *p4est_lnodes_plan_new (p4est_lnodes_t * lnodes,
+                                            size_t elem_size);
+
+/** Free the buffers, requests and the graph of a communication plan.
+ * No exchange may be active on the plan.  This function is collective
+ * whenever p4est_lnodes_plan_new is.
+ */
+void                p4est_lnodes_plan_destroy (p4est_lnodes_plan_t * plan);
+
+/** Equivalent to p4est_lnodes_share_owned_begin using a plan.
+ * \a node_data must not be altered or freed until the exchange is completed
+ * by p4est_lnodes_plan_share_owned_end.  The values from the owner processes
+ * are written into \a node_data by p4est_lnodes_plan_share_owned_end.
+ */
+void                p4est_lnodes_plan_share_owned_begin (p4est_lnodes_plan_t
+                                                         * plan,
+                                                         sc_array_t *
+                                                         node_data);
+
+void                p4est_lnodes_plan_share_owned_end (p4est_lnodes_plan_t *
+                                                       plan);
+
+/** Equivalent to calling p4est_lnodes_plan_share_owned_end directly after
+ * p4est_lnodes_plan_share_owned_begin.
+ */
+void                p4est_lnodes_plan_share_owned (p4est_lnodes_plan_t *
+                                                   plan,
+                                                   sc_array_t * node_data);
+
+/** Equivalent to p4est_lnodes_share_all_begin using a plan.
+ * The received values are available in \a plan->recv_buffers after
+ * p4est_lnodes_plan_share_all_end.
+ */
+void                p4est_lnodes_plan_share_all_begin (p4est_lnodes_plan_t *
+                                                       plan,
+                                                       sc_array_t *
+                                                       node_data);
+
+void                p4est_lnodes_plan_share_all_end (p4est_lnodes_plan_t *
+                                                     plan);
+
+/** Equivalent to calling p4est_lnodes_plan_share_all_end directly after
+ * p4est_lnodes_plan_share_all_begin.
+ */
+void                p4est_lnodes_plan_share_all (p4est_lnodes_plan_t * plan,
+                                                 sc_array_t * node_data);
+
 /** Return a pointer to a lnodes_rank array element indexed by a int.
  */
 /*@unused@*/
@@ -24,14 +24,18 @@
 
 #ifndef P4_TO_P8
 #include <p4est_bits.h>
+#include <p4est_communication.h>
 #include <p4est_extended.h>
 #include <p4est_iterate.h>
 #include <p4est_mesh.h>
+#include <p4est_search.h>
 #else
 #include <p8est_bits.h>
+#include <p8est_communication.h>
 #include <p8est_extended.h>
 #include <p8est_iterate.h>
 #include <p8est_mesh.h>
+#include <p8est_search.h>
 #endif
 
 /** For a quadrant that touches a tree face with a corner inside the face,
@@ -605,30 +609,23 @@ p4est_mesh_new (p4est_t * p4est, p4est_ghost_t * ghost,
   return p4est_mesh_new_ext (p4est, ghost, 0, 0, btype);
 }
 
-p4est_mesh_t       *
-p4est_mesh_new_ext (p4est_t * p4est, p4est_ghost_t * ghost,
-                    int compute_tree_index, int compute_level_lists,
-                    p4est_connect_type_t btype)
+/** Allocate a mesh structure and fill it with default values.
+ * The face and corner neighbors are left to be filled in by the caller.
+ */
+static p4est_mesh_t *
+mesh_allocate (p4est_t * p4est, p4est_ghost_t * ghost,
+               int compute_tree_index, int compute_level_lists, int do_corner)
 {
-  int                 do_corner = 0;
-  int                 do_volume = 0;
   int                 rank;
   p4est_locidx_t      lq, ng;
   p4est_locidx_t      jl;
   p4est_mesh_t       *mesh;
 
-  P4EST_ASSERT (p4est_is_balanced (p4est, P4EST_CONNECT_FULL));
-
   mesh = P4EST_ALLOC_ZERO (p4est_mesh_t, 1);
 
   lq = mesh->local_num_quadrants = p4est->local_num_quadrants;
   ng = mesh->ghost_num_quadrants = (p4est_locidx_t) ghost->ghosts.elem_count;
 
-  if (btype == P4EST_CONNECT_FULL) {
-    do_corner = 1;
-  }
-  do_volume = (compute_tree_index || compute_level_lists ? 1 : 0);
-
   /* Optional map of tree index for each quadrant */
   if (compute_tree_index) {
     mesh->quad_to_tree = P4EST_ALLOC (p4est_topidx_t, lq);
@@ -675,6 +672,28 @@ p4est_mesh_new_ext (p4est_t * p4est, p4est_ghost_t * ghost,
     mesh->corner_corner = sc_array_new (sizeof (int8_t));
   }
 
+  return mesh;
+}
+
+p4est_mesh_t       *
+p4est_mesh_new_ext (p4est_t * p4est, p4est_ghost_t * ghost,
+                    int compute_tree_index, int compute_level_lists,
+                    p4est_connect_type_t btype)
+{
+  int                 do_corner = 0;
+  int                 do_volume = 0;
+  p4est_mesh_t       *mesh;
+
+  P4EST_ASSERT (p4est_is_balanced (p4est, P4EST_CONNECT_FULL));
+
+  if (btype == P4EST_CONNECT_FULL) {
+    do_corner = 1;
+  }
+  do_volume = (compute_tree_index || compute_level_lists ? 1 : 0);
+
+  mesh = mesh_allocate (p4est, ghost, compute_tree_index,
+                        compute_level_lists, do_corner);
+
   /* Call the forest iterator to collect face connectivity */
   p4est_iterate (p4est, ghost, mesh,
                  (do_volume ? mesh_iter_volume : NULL), mesh_iter_face,
@@ -717,6 +736,929 @@ p4est_mesh_destroy (p4est_mesh_t * mesh)
   P4EST_FREE (mesh);
 }
 
+p4est_mesh_changes_t *
+p4est_mesh_changes_new (void)
+{
+  p4est_mesh_changes_t *changes;
+
+  changes = P4EST_ALLOC (p4est_mesh_changes_t, 1);
+  sc_array_init (&changes->outgoing, sizeof (p4est_quadrant_t));
+  sc_array_init (&changes->incoming, sizeof (p4est_quadrant_t));
+
+  return changes;
+}
+
+void
+p4est_mesh_changes_destroy (p4est_mesh_changes_t * changes)
+{
+  sc_array_reset (&changes->outgoing);
+  sc_array_reset (&changes->incoming);
+  P4EST_FREE (changes);
+}
+
+void
+p4est_mesh_changes_replace (p4est_mesh_changes_t * changes,
+                            p4est_topidx_t which_tree,
+                            int num_outgoing, p4est_quadrant_t * outgoing[],
+                            int num_incoming, p4est_quadrant_t * incoming[])
+{
+  int                 i;
+  p4est_quadrant_t   *q;
+
+  for (i = 0; i < num_outgoing; ++i) {
+    q = p4est_quadrant_array_push (&changes->outgoing);
+    *q = *outgoing[i];
+    q->p.piggy3.which_tree = which_tree;
+    q->p.piggy3.local_num = -1;
+  }
+  for (i = 0; i < num_incoming; ++i) {
+    q = p4est_quadrant_array_push (&changes->incoming);
+    *q = *incoming[i];
+    q->p.piggy3.which_tree = which_tree;
+    q->p.piggy3.local_num = 1;
+  }
+}
+
+/** Scratch data for computing the neighbors of single quadrants. */
+typedef struct mesh_update
+{
+  p4est_t            *p4est;
+  p4est_ghost_t      *ghost;
+  p4est_mesh_t       *mesh;
+  sc_array_t          quads;
+  sc_array_t          treeids;
+  sc_array_t          entities;
+  sc_array_t          sides;
+}
+mesh_update_t;
+
+/** A tree corner touching a corner point of the forest. */
+typedef struct mesh_tree_corner
+{
+  p4est_topidx_t      treeid;
+  int                 corner;
+}
+mesh_tree_corner_t;
+
+static void
+mesh_update_reset_scratch (mesh_update_t * mu)
+{
+  sc_array_truncate (&mu->quads);
+  sc_array_truncate (&mu->treeids);
+  sc_array_truncate (&mu->entities);
+}
+
+/** Reduce the recorded replacements to the quadrants that have been added
+ * and removed in total.  Both arrays are sorted by tree and Morton index.
+ */
+static void
+mesh_changes_net (p4est_mesh_changes_t * changes,
+                  sc_array_t * added, sc_array_t * removed)
+{
+  int                 net;
+  size_t              zz, zy;
+  sc_array_t          events;
+  p4est_quadrant_t   *q, *r;
+
+  sc_array_init (&events, sizeof (p4est_quadrant_t));
+  if (changes != NULL) {
+    sc_array_copy (&events, &changes->outgoing);
+    zz = events.elem_count;
+    sc_array_push_count (&events, changes->incoming.elem_count);
+    if (changes->incoming.elem_count > 0) {
+      memcpy (sc_array_index (&events, zz), changes->incoming.array,
+              changes->incoming.elem_count * sizeof (p4est_quadrant_t));
+    }
+  }
+  sc_array_sort (&events, p4est_quadrant_compare_piggy);
+
+  for (zz = 0; zz < events.elem_count; zz = zy) {
+    q = p4est_quadrant_array_index (&events, zz);
+    net = 0;
+    for (zy = zz; zy < events.elem_count; ++zy) {
+      r = p4est_quadrant_array_index (&events, zy);
+      if (p4est_quadrant_compare_piggy (q, r)) {
+        break;
+      }
+      net += (int) r->p.piggy3.local_num;
+    }
+    P4EST_ASSERT (-1 <= net && net <= 1);
+    if (net > 0) {
+      *p4est_quadrant_array_push (added) = *q;
+    }
+    else if (net < 0) {
+      *p4est_quadrant_array_push (removed) = *q;
+    }
+  }
+  sc_array_reset (&events);
+}
+
+/** Find the local or ghost quadrant that equals or contains a quadrant.
+ * \param [in] ghost    If NULL, only the local quadrants are searched.
+ * \param [out] level   If not NULL, the level of the quadrant found.
+ * \return              Local index, or number of local quadrants plus the
+ *                      ghost index, or -1 if no such quadrant is known.
+ */
+static              p4est_locidx_t
+mesh_update_lookup (p4est_t * p4est, p4est_ghost_t * ghost,
+                    p4est_topidx_t which_tree, const p4est_quadrant_t * q,
+                    int *level)
+{
+  int                 owner;
+  ssize_t             pos;
+  p4est_tree_t       *tree;
+  p4est_quadrant_t   *found;
+
+  P4EST_ASSERT (p4est_quadrant_is_inside_root (q));
+
+  if (p4est->first_local_tree <= which_tree &&
+      which_tree <= p4est->last_local_tree) {
+    tree = p4est_tree_array_index (p4est->trees, which_tree);
+    pos = p4est_find_higher_bound (&tree->quadrants, q,
+                                   tree->quadrants.elem_count / 2);
+    if (pos >= 0) {
+      found = p4est_quadrant_array_index (&tree->quadrants, (size_t) pos);
+      if (p4est_quadrant_is_equal (found, q) ||
+          p4est_quadrant_is_ancestor (found, q)) {
+        if (level != NULL) {
+          *level = (int) found->level;
+        }
+        return tree->quadrants_offset + (p4est_locidx_t) pos;
+      }
+    }
+  }
+  if (ghost != NULL) {
+    owner = p4est_comm_find_owner (p4est, which_tree, q, p4est->mpirank);
+    if (owner != p4est->mpirank) {
+      pos = p4est_ghost_contains (ghost, owner, which_tree, q);
+      if (pos >= 0) {
+        if (level != NULL) {
+          found = p4est_quadrant_array_index (&ghost->ghosts, (size_t) pos);
+          *level = (int) found->level;
+        }
+        return p4est->local_num_quadrants + (p4est_locidx_t) pos;
+      }
+    }
+  }
+  return -1;
+}
+
+/** Mark the local quadrants that touch a face, edge or corner of a region.
+ * \param [in] r        Neighbor region of an added quadrant in tree \a nt.
+ * \param [in] ctype    Type of contact between \a r and the added quadrant.
+ * \param [in] entity   Face, edge or corner number of \a r in contact.
+ */
+static void
+mesh_update_mark (p4est_t * p4est, p4est_topidx_t nt,
+                  const p4est_quadrant_t * r, p4est_connect_type_t ctype,
+                  int entity, int8_t * dirty)
+{
+  int                 h, nchildren;
+  int                 child[P4EST_HALF];
+  p4est_locidx_t      jl;
+  p4est_quadrant_t    c;
+
+  jl = mesh_update_lookup (p4est, NULL, nt, r, NULL);
+  if (jl >= 0) {
+    dirty[jl] = 1;
+    return;
+  }
+  if (r->level == P4EST_QMAXLEVEL) {
+    return;
+  }
+
+  /* by balance, only the children of the region can be in contact */
+  if (ctype == P4EST_CONNECT_FACE) {
+    nchildren = P4EST_HALF;
+    for (h = 0; h < P4EST_HALF; ++h) {
+      child[h] = p4est_face_corners[entity][h];
+    }
+  }
+#ifdef P4_TO_P8
+  else if (ctype == P8EST_CONNECT_EDGE) {
+    nchildren = 2;
+    child[0] = p8est_edge_corners[entity][0];
+    child[1] = p8est_edge_corners[entity][1];
+  }
+#endif
+  else {
+    nchildren = 1;
+    child[0] = entity;
+  }
+  for (h = 0; h < nchildren; ++h) {
+    p4est_quadrant_child (r, &c, child[h]);
+    jl = mesh_update_lookup (p4est, NULL, nt, &c, NULL);
+    if (jl >= 0) {
+      dirty[jl] = 1;
+    }
+  }
+}
+
+/** Mark the local quadrants that touch a quadrant new to the forest. */
+static void
+mesh_update_touch (mesh_update_t * mu, p4est_topidx_t which_tree,
+                   const p4est_quadrant_t * q, int8_t * dirty)
+{
+  int                 f, nface;
+  int                 c;
+  size_t              zz;
+  p4est_topidx_t      nt;
+  p4est_quadrant_t    r;
+  p4est_connectivity_t *conn = mu->p4est->connectivity;
+#ifdef P4_TO_P8
+  int                 e;
+#endif
+
+  for (f = 0; f < P4EST_FACES; ++f) {
+    nt = p4est_quadrant_face_neighbor_extra (q, which_tree, f, &r, &nface,
+                                             conn);
+    if (nt >= 0) {
+      mesh_update_mark (mu->p4est, nt, &r, P4EST_CONNECT_FACE,
+                        nface % P4EST_FACES, dirty);
+    }
+  }
+  if (mu->mesh->quad_to_corner == NULL) {
+    return;
+  }
+
+#ifdef P4_TO_P8
+  for (e = 0; e < P8EST_EDGES; ++e) {
+    p8est_quadrant_edge_neighbor_extra (q, which_tree, e, &mu->quads,
+                                        &mu->treeids, &mu->entities, conn);
+    for (zz = 0; zz < mu->quads.elem_count; ++zz) {
+      mesh_update_mark (mu->p4est,
+                        *(p4est_topidx_t *) sc_array_index (&mu->treeids, zz),
+                        p4est_quadrant_array_index (&mu->quads, zz),
+                        P8EST_CONNECT_EDGE,
+                        *(int *) sc_array_index (&mu->entities, zz) %
+                        P8EST_EDGES, dirty);
+    }
+    mesh_update_reset_scratch (mu);
+  }
+#endif
+  for (c = 0; c < P4EST_CHILDREN; ++c) {
+    p4est_quadrant_corner_neighbor_extra (q, which_tree, c, &mu->quads,
+                                          &mu->treeids, &mu->entities, conn);
+    for (zz = 0; zz < mu->quads.elem_count; ++zz) {
+      mesh_update_mark (mu->p4est,
+                        *(p4est_topidx_t *) sc_array_index (&mu->treeids, zz),
+                        p4est_quadrant_array_index (&mu->quads, zz),
+                        P4EST_CONNECT_CORNER,
+                        *(int *) sc_array_index (&mu->entities, zz), dirty);
+    }
+    mesh_update_reset_scratch (mu);
+  }
+}
+
+/** Check whether the old neighbor information of a quadrant is only made of
+ * local quadrants, which means it can be renumbered without lookups.
+ */
+static int
+mesh_update_is_local (p4est_mesh_t * mesh, p4est_locidx_t ol)
+{
+  int                 f, c, h;
+  p4est_locidx_t      lq = mesh->local_num_quadrants;
+  p4est_locidx_t      cornerid_offset, v;
+  p4est_locidx_t      cstart, cend, *halfentries;
+
+  for (f = 0; f < P4EST_FACES; ++f) {
+    v = mesh->quad_to_quad[P4EST_FACES * ol + f];
+    if (mesh->quad_to_face[P4EST_FACES * ol + f] >= 0) {
+      if (v >= lq) {
+        return 0;
+      }
+    }
+    else {
+      halfentries =
+        (p4est_locidx_t *) sc_array_index (mesh->quad_to_half, (size_t) v);
+      for (h = 0; h < P4EST_HALF; ++h) {
+        if (halfentries[h] >= lq) {
+          return 0;
+        }
+      }
+    }
+  }
+  if (mesh->quad_to_corner == NULL) {
+    return 1;
+  }
+
+  cornerid_offset = lq + mesh->ghost_num_quadrants;
+  for (c = 0; c < P4EST_CHILDREN; ++c) {
+    v = mesh->quad_to_corner[P4EST_CHILDREN * ol + c];
+    if (v < lq) {
+      continue;
+    }
+    if (v < cornerid_offset) {
+      return 0;
+    }
+    v -= cornerid_offset;
+    cstart = *(p4est_locidx_t *) sc_array_index (mesh->corner_offset, v);
+    cend = *(p4est_locidx_t *) sc_array_index (mesh->corner_offset, v + 1);
+    for (; cstart < cend; ++cstart) {
+      if (*(p4est_locidx_t *) sc_array_index (mesh->corner_quad, cstart)
+          >= lq) {
+        return 0;
+      }
+    }
+  }
+  return 1;
+}
+
+/** Copy the neighbor information of an unchanged quadrant to the new mesh. */
+static void
+mesh_update_copy (p4est_mesh_t * newmesh, p4est_mesh_t * mesh,
+                  const p4est_locidx_t * old_to_new,
+                  p4est_locidx_t nl, p4est_locidx_t ol)
+{
+  int                 f, c, h;
+  int8_t             *pccorner;
+  p4est_locidx_t      cornerid_offset, newcorner_offset;
+  p4est_locidx_t      v, cstart, cend, cornerid;
+  p4est_locidx_t      halfindex, *halfentries, *newentries, *pcquad;
+
+  for (f = 0; f < P4EST_FACES; ++f) {
+    v = mesh->quad_to_quad[P4EST_FACES * ol + f];
+    newmesh->quad_to_face[P4EST_FACES * nl + f] =
+      mesh->quad_to_face[P4EST_FACES * ol + f];
+    if (mesh->quad_to_face[P4EST_FACES * ol + f] >= 0) {
+      P4EST_ASSERT (old_to_new[v] >= 0);
+      newmesh->quad_to_quad[P4EST_FACES * nl + f] = old_to_new[v];
+    }
+    else {
+      halfentries =
+        (p4est_locidx_t *) sc_array_index (mesh->quad_to_half, (size_t) v);
+      halfindex = (p4est_locidx_t) newmesh->quad_to_half->elem_count;
+      newentries = (p4est_locidx_t *) sc_array_push (newmesh->quad_to_half);
+      for (h = 0; h < P4EST_HALF; ++h) {
+        P4EST_ASSERT (old_to_new[halfentries[h]] >= 0);
+        newentries[h] = old_to_new[halfentries[h]];
+      }
+      newmesh->quad_to_quad[P4EST_FACES * nl + f] = halfindex;
+    }
+  }
+  if (mesh->quad_to_corner == NULL) {
+    return;
+  }
+
+  cornerid_offset = mesh->local_num_quadrants + mesh->ghost_num_quadrants;
+  newcorner_offset =
+    newmesh->local_num_quadrants + newmesh->ghost_num_quadrants;
+  for (c = 0; c < P4EST_CHILDREN; ++c) {
+    v = mesh->quad_to_corner[P4EST_CHILDREN * ol + c];
+    if (v < 0) {
+      newmesh->quad_to_corner[P4EST_CHILDREN * nl + c] = v;
+    }
+    else if (v < mesh->local_num_quadrants) {
+      P4EST_ASSERT (old_to_new[v] >= 0);
+      newmesh->quad_to_corner[P4EST_CHILDREN * nl + c] = old_to_new[v];
+    }
+    else {
+      P4EST_ASSERT (v >= cornerid_offset);
+      v -= cornerid_offset;
+      cstart = *(p4est_locidx_t *) sc_array_index (mesh->corner_offset, v);
+      cend = *(p4est_locidx_t *) sc_array_index (mesh->corner_offset, v + 1);
+      cornerid = mesh_corner_allocate (newmesh, cend - cstart,
+                                       &pcquad, &pccorner);
+      newmesh->quad_to_corner[P4EST_CHILDREN * nl + c] =
+        newcorner_offset + cornerid;
+      for (h = 0; cstart < cend; ++cstart, ++h) {
+        v = *(p4est_locidx_t *) sc_array_index (mesh->corner_quad, cstart);
+        P4EST_ASSERT (old_to_new[v] >= 0);
+        pcquad[h] = old_to_new[v];
+        pccorner[h] =
+          *(int8_t *) sc_array_index (mesh->corner_corner, cstart);
+      }
+    }
+  }
+}
+
+/** Compute the face neighbors of a quadrant by searching the forest. */
+static void
+mesh_update_faces (mesh_update_t * mu, p4est_topidx_t which_tree,
+                   const p4est_quadrant_t * q, p4est_locidx_t qid)
+{
+  int                 f, nface, nf, o, h, level;
+  p4est_topidx_t      nt;
+  p4est_locidx_t      in_qtoq, nid, halfindex, *halfentries;
+  p4est_quadrant_t    r, c;
+  p4est_mesh_t       *mesh = mu->mesh;
+
+  for (f = 0; f < P4EST_FACES; ++f) {
+    in_qtoq = P4EST_FACES * qid + f;
+    nt = p4est_quadrant_face_neighbor_extra (q, which_tree, f, &r, &nface,
+                                             mu->p4est->connectivity);
+    if (nt < 0) {
+      /* this face is on an outside boundary of the forest */
+      mesh->quad_to_quad[in_qtoq] = qid;
+      mesh->quad_to_face[in_qtoq] = (int8_t) f;
+      continue;
+    }
+    o = nface / P4EST_FACES;
+    nf = nface % P4EST_FACES;
+
+    nid = mesh_update_lookup (mu->p4est, mu->ghost, nt, &r, &level);
+    if (nid >= 0) {
+      mesh->quad_to_quad[in_qtoq] = nid;
+      if (level == (int) q->level) {
+        /* same-size face neighbor */
+        mesh->quad_to_face[in_qtoq] = (int8_t) (P4EST_FACES * o + nf);
+      }
+      else {
+        /* double-size face neighbor */
+        P4EST_ASSERT (level + 1 == (int) q->level);
+        h = p4est_corner_face_corners[p4est_quadrant_child_id (q)][f];
+        P4EST_ASSERT (0 <= h && h < P4EST_HALF);
+        mesh->quad_to_face[in_qtoq] =
+          (int8_t) (P4EST_FACES * (o + (h + 1) * P4EST_HALF) + nf);
+      }
+      continue;
+    }
+
+    /* half-size face neighbors */
+    halfindex = (p4est_locidx_t) mesh->quad_to_half->elem_count;
+    halfentries = (p4est_locidx_t *) sc_array_push (mesh->quad_to_half);
+    for (h = 0; h < P4EST_HALF; ++h) {
+      p4est_quadrant_child (&r, &c, p4est_face_corners[nf][h]);
+      halfentries[h] = mesh_update_lookup (mu->p4est, mu->ghost, nt, &c,
+                                           NULL);
+      P4EST_ASSERT (halfentries[h] >= 0);
+    }
+    mesh->quad_to_quad[in_qtoq] = halfindex;
+    mesh->quad_to_face[in_qtoq] =
+      (int8_t) (P4EST_FACES * (o - P4EST_HALF) + nf);
+  }
+}
+
+/** Determine whether a corner of a quadrant lies inside a face or an edge
+ * of a neighbor of twice its size, in which case it has no corner neighbor.
+ */
+static int
+mesh_update_corner_is_hanging (mesh_update_t * mu, p4est_topidx_t which_tree,
+                               const p4est_quadrant_t * q, int corner)
+{
+  int                 i, m, diff, face;
+  p4est_topidx_t      nt;
+  p4est_quadrant_t    p, r;
+#ifdef P4_TO_P8
+  int                 edge, hanging;
+  size_t              zz;
+#endif
+
+  if (q->level == 0) {
+    return 0;
+  }
+
+  /* count the directions in which the corner is inside the parent */
+  diff = corner ^ p4est_quadrant_child_id (q);
+  for (m = 0, i = 0; i < P4EST_DIM; ++i) {
+    m += (diff >> i) & 1;
+  }
+  if (m == 0 || m == P4EST_DIM) {
+    /* a corner of the parent or its center */
+    return 0;
+  }
+
+  /* check the parent's face neighbors that contain the corner */
+  p4est_quadrant_parent (q, &p);
+  for (i = 0; i < P4EST_DIM; ++i) {
+    if ((diff >> i) & 1) {
+      continue;
+    }
+    face = 2 * i + ((corner >> i) & 1);
+    nt = p4est_quadrant_face_neighbor_extra (&p, which_tree, face, &r, NULL,
+                                             mu->p4est->connectivity);
+    if (nt >= 0 &&
+        mesh_update_lookup (mu->p4est, mu->ghost, nt, &r, NULL) >= 0) {
+      return 1;
+    }
+  }
+
+#ifdef P4_TO_P8
+  if (m == 1) {
+    /* check the parent's edge neighbors that contain the corner */
+    for (i = 0; i < P4EST_DIM; ++i) {
+      if ((diff >> i) & 1) {
+        break;
+      }
+    }
+    edge = p8est_corner_edges[corner][i];
+    p8est_quadrant_edge_neighbor_extra (&p, which_tree, edge, &mu->quads,
+                                        &mu->treeids, NULL,
+                                        mu->p4est->connectivity);
+    hanging = 0;
+    for (zz = 0; zz < mu->quads.elem_count; ++zz) {
+      if (mesh_update_lookup
+          (mu->p4est, mu->ghost,
+           *(p4est_topidx_t *) sc_array_index (&mu->treeids, zz),
+           p4est_quadrant_array_index (&mu->quads, zz), NULL) >= 0) {
+        hanging = 1;
+        break;
+      }
+    }
+    mesh_update_reset_scratch (mu);
+    return hanging;
+  }
+#endif
+
+  return 0;
+}
+
+static int
+mesh_tree_corner_compare (const void *v1, const void *v2)
+{
+  const mesh_tree_corner_t *tc1 = (const mesh_tree_corner_t *) v1;
+  const mesh_tree_corner_t *tc2 = (const mesh_tree_corner_t *) v2;
+
+  if (tc1->treeid != tc2->treeid) {
+    return tc1->treeid < tc2->treeid ? -1 : 1;
+  }
+  return tc1->corner - tc2->corner;
+}
+
+static void
+mesh_tree_corner_push (sc_array_t * sides, p4est_topidx_t nt, int nc)
+{
+  size_t              zz;
+  mesh_tree_corner_t *tc;
+
+  for (zz = 0; zz < sides->elem_count; ++zz) {
+    tc = (mesh_tree_corner_t *) sc_array_index (sides, zz);
+    if (tc->treeid == nt && tc->corner == nc) {
+      return;
+    }
+  }
+  tc = (mesh_tree_corner_t *) sc_array_push (sides);
+  tc->treeid = nt;
+  tc->corner = nc;
+}
+
+/** Collect the tree corners meeting at a corner of a tree.
+ * The result is the same set and order that p4est_iterate uses.
+ */
+static void
+mesh_tree_corner_sides (p4est_connectivity_t * conn,
+                        p4est_topidx_t which_tree, int corner,
+                        sc_array_t * sides)
+{
+  int                 i, f, nf, o, c2;
+  p4est_topidx_t      nt, corner_id;
+  p4est_topidx_t      ti;
+#ifdef P4_TO_P8
+  int                 e, ne, orig_o, ref, set;
+  p4est_topidx_t      edge_id;
+#endif
+
+  P4EST_ASSERT (sides->elem_count == 0);
+  corner_id = (conn->tree_to_corner == NULL) ? -1 :
+    conn->tree_to_corner[P4EST_CHILDREN * which_tree + corner];
+  if (corner_id >= 0) {
+    for (ti = conn->ctt_offset[corner_id];
+         ti < conn->ctt_offset[corner_id + 1]; ++ti) {
+      mesh_tree_corner_push (sides, conn->corner_to_tree[ti],
+                             (int) conn->corner_to_corner[ti]);
+    }
+  }
+  else {
+    mesh_tree_corner_push (sides, which_tree, corner);
+    for (i = 0; i < P4EST_DIM; ++i) {
+      f = p4est_corner_faces[corner][i];
+      c2 = p4est_corner_face_corners[corner][f];
+      nt = conn->tree_to_tree[P4EST_FACES * which_tree + f];
+      nf = (int) conn->tree_to_face[P4EST_FACES * which_tree + f];
+      o = nf / P4EST_FACES;
+      nf %= P4EST_FACES;
+      if (nt == which_tree && nf == f) {
+        continue;
+      }
+#ifndef P4_TO_P8
+      mesh_tree_corner_push (sides, nt,
+                             p4est_face_corners[nf][(o == 0) ? c2 : 1 - c2]);
+#else
+      ref = p8est_face_permutation_refs[f][nf];
+      set = p8est_face_permutation_sets[ref][o];
+      mesh_tree_corner_push (sides, nt, p8est_face_corners[nf]
+                             [p8est_face_permutations[set][c2]]);
+#endif
+    }
+#ifdef P4_TO_P8
+    for (i = 0; i < 3; ++i) {
+      e = p8est_corner_edges[corner][i];
+      c2 = (p8est_edge_corners[e][0] == corner) ? 0 : 1;
+      edge_id = (conn->tree_to_edge == NULL) ? -1 :
+        conn->tree_to_edge[P8EST_EDGES * which_tree + e];
+      if (edge_id < 0) {
+        continue;
+      }
+      orig_o = -1;
+      for (ti = conn->ett_offset[edge_id];
+           ti < conn->ett_offset[edge_id + 1]; ++ti) {
+        if (conn->edge_to_tree[ti] == which_tree &&
+            conn->edge_to_edge[ti] % P8EST_EDGES == e) {
+          orig_o = conn->edge_to_edge[ti] / P8EST_EDGES;
+          break;
+        }
+      }
+      P4EST_ASSERT (orig_o >= 0);
+      for (ti = conn->ett_offset[edge_id];
+           ti < conn->ett_offset[edge_id + 1]; ++ti) {
+        nt = conn->edge_to_tree[ti];
+        ne = conn->edge_to_edge[ti] % P8EST_EDGES;
+        o = conn->edge_to_edge[ti] / P8EST_EDGES;
+        if (nt == which_tree && ne == e) {
+          continue;
+        }
+        mesh_tree_corner_push (sides, nt, p8est_edge_corners[ne]
+                               [(o == orig_o) ? c2 : 1 - c2]);
+      }
+    }
+#endif
+  }
+  sc_array_sort (sides, mesh_tree_corner_compare);
+}
+
+/** Compute the corner neighbor entry of a quadrant by searching the forest.
+ * \return          The value to store in quad_to_corner.
+ */
+static              p4est_locidx_t
+mesh_update_corner (mesh_update_t * mu, p4est_topidx_t which_tree,
+                    const p4est_quadrant_t * q, int corner)
+{
+  const p4est_qcoord_t rh = P4EST_ROOT_LEN;
+  const p4est_qcoord_t qh = P4EST_QUADRANT_LEN (q->level);
+  int                 i, nb, nc, c1, ignore;
+  int                 f1, orientation;
+  int                 ncorner[P4EST_DIM];
+  int                 nface[P4EST_DIM];
+  int8_t             *pccorner, *ccorners;
+  size_t              zz;
+  p4est_topidx_t      nt, ntree[P4EST_DIM];
+  p4est_locidx_t      nid, cornerid, goodones;
+  p4est_locidx_t      cornerid_offset, *pcquad, *cquads;
+  p4est_quadrant_t    r, d, *qp;
+  p4est_mesh_t       *mesh = mu->mesh;
+  p4est_connectivity_t *conn = mu->p4est->connectivity;
+  mesh_tree_corner_t *tc;
+
+  if (mesh_update_corner_is_hanging (mu, which_tree, q, corner)) {
+    return -1;
+  }
+  cornerid_offset = mesh->local_num_quadrants + mesh->ghost_num_quadrants;
+
+  /* count the tree boundaries the corner point lies on */
+  nb = ((corner & 1) ? q->x + qh == rh : q->x == 0);
+  nb += ((corner & 2) ? q->y + qh == rh : q->y == 0);
+#ifdef P4_TO_P8
+  nb += ((corner & 4) ? q->z + qh == rh : q->z == 0);
+#endif
+
+  if (nb == 0) {
+    /* the corner is inside the tree */
+    p4est_quadrant_corner_neighbor (q, corner, &r);
+    p4est_quadrant_corner_descendant (&r, &d, corner ^ (P4EST_CHILDREN - 1),
+                                      P4EST_QMAXLEVEL);
+    nid = mesh_update_lookup (mu->p4est, mu->ghost, which_tree, &d, NULL);
+    P4EST_ASSERT (nid >= 0);
+    return nid;
+  }
+
+  if (nb == 1) {
+    /* the corner is inside a tree face */
+    p4est_quadrant_corner_neighbor_extra (q, which_tree, corner, &mu->quads,
+                                          &mu->treeids, &mu->entities, conn);
+    if (mu->quads.elem_count == 0) {
+      return -1;
+    }
+    P4EST_ASSERT (mu->quads.elem_count == 1);
+    nt = *(p4est_topidx_t *) sc_array_index (&mu->treeids, 0);
+    nc = *(int *) sc_array_index (&mu->entities, 0);
+    qp = p4est_quadrant_array_index (&mu->quads, 0);
+    p4est_quadrant_corner_descendant (qp, &d, nc, P4EST_QMAXLEVEL);
+    mesh_update_reset_scratch (mu);
+    nid = mesh_update_lookup (mu->p4est, mu->ghost, nt, &d, NULL);
+    P4EST_ASSERT (nid >= 0);
+    cornerid = mesh_corner_allocate (mesh, 1, &pcquad, &pccorner);
+    *pcquad = nid;
+    *pccorner = (int8_t) nc;
+    return cornerid_offset + cornerid;
+  }
+
+#ifdef P4_TO_P8
+  if (nb == 2) {
+    /* tree corner neighbors across an edge are not implemented */
+    return -2;
+  }
+#endif
+
+  /* the corner is a tree corner */
+  P4EST_ASSERT (nb == P4EST_DIM);
+  sc_array_truncate (&mu->sides);
+  mesh_tree_corner_sides (conn, which_tree, corner, &mu->sides);
+  if (mu->sides.elem_count == 1) {
+    return -1;
+  }
+
+  /* exclude the tree corners that are reached through a face neighbor */
+  c1 = corner;
+  for (i = 0; i < P4EST_DIM; ++i) {
+    f1 = p4est_corner_faces[c1][i];
+    ntree[i] = conn->tree_to_tree[P4EST_FACES * which_tree + f1];
+    nface[i] = conn->tree_to_face[P4EST_FACES * which_tree + f1];
+    if (ntree[i] == which_tree && nface[i] == f1) {
+      ncorner[i] = -1;
+      continue;
+    }
+    orientation = nface[i] / P4EST_FACES;
+    nface[i] %= P4EST_FACES;
+    ncorner[i] = p4est_connectivity_face_neighbor_corner_orientation
+      (c1, f1, nface[i], orientation);
+  }
+
+  cquads = P4EST_ALLOC (p4est_locidx_t, mu->sides.elem_count - 1);
+  ccorners = P4EST_ALLOC (int8_t, mu->sides.elem_count - 1);
+  goodones = 0;
+  ignore = 1;
+  for (zz = 0; zz < mu->sides.elem_count; ++zz) {
+    tc = (mesh_tree_corner_t *) sc_array_index (&mu->sides, zz);
+    if (ignore && tc->treeid == which_tree && tc->corner == corner) {
+      /* we do not count ourselves as a neighbor */
+      ignore = 0;
+      continue;
+    }
+    for (i = 0; i < P4EST_DIM; ++i) {
+      if (ncorner[i] == tc->corner && ntree[i] == tc->treeid) {
+        break;
+      }
+    }
+    if (i < P4EST_DIM) {
+      continue;
+    }
+    p4est_quadrant_set_morton (&r, 0, 0);
+    p4est_quadrant_corner_descendant (&r, &d, tc->corner, P4EST_QMAXLEVEL);
+    nid = mesh_update_lookup (mu->p4est, mu->ghost, tc->treeid, &d, NULL);
+    P4EST_ASSERT (nid >= 0);
+    P4EST_ASSERT ((size_t) goodones < mu->sides.elem_count - 1);
+    cquads[goodones] = nid;
+    ccorners[goodones] = (int8_t) tc->corner;
+    ++goodones;
+  }
+
+  cornerid = -1;
+  if (goodones > 0) {
+    cornerid = mesh_corner_allocate (mesh, goodones, &pcquad, &pccorner);
+    memcpy (pcquad, cquads, goodones * sizeof (p4est_locidx_t));
+    memcpy (pccorner, ccorners, goodones * sizeof (int8_t));
+  }
+  P4EST_FREE (cquads);
+  P4EST_FREE (ccorners);
+  return (goodones > 0) ? cornerid_offset + cornerid : -1;
+}
+
+p4est_mesh_t       *
+p4est_mesh_new_update (p4est_mesh_t * mesh, p4est_t * p4est,
+                       p4est_ghost_t * ghost, p4est_mesh_changes_t * changes)
+{
+  int                 c;
+  int8_t             *dirty;
+  size_t              zz, za, zr;
+  p4est_topidx_t      jt;
+  p4est_locidx_t      lq, old_lq, nl, ol;
+  p4est_locidx_t     *old_to_new, *new_to_old;
+  p4est_tree_t       *tree;
+  p4est_quadrant_t   *q, *aq, *rq;
+  p4est_mesh_t       *newmesh;
+  sc_array_t          added, removed;
+  mesh_update_t       smu, *mu = &smu;
+
+  P4EST_ASSERT (p4est_is_balanced (p4est, P4EST_CONNECT_FULL));
+
+  newmesh = mesh_allocate (p4est, ghost, mesh->quad_to_tree != NULL,
+                           mesh->quad_level != NULL,
+                           mesh->quad_to_corner != NULL);
+  lq = newmesh->local_num_quadrants;
+  old_lq = mesh->local_num_quadrants;
+
+  /* determine which quadrants have been added and removed in total */
+  sc_array_init (&added, sizeof (p4est_quadrant_t));
+  sc_array_init (&removed, sizeof (p4est_quadrant_t));
+  mesh_changes_net (changes, &added, &removed);
+  P4EST_ASSERT ((size_t) old_lq + added.elem_count ==
+                (size_t) lq + removed.elem_count);
+
+  /* match the unchanged quadrants between the old and new numbering */
+  old_to_new = P4EST_ALLOC (p4est_locidx_t, old_lq);
+  new_to_old = P4EST_ALLOC (p4est_locidx_t, lq);
+  dirty = P4EST_ALLOC_ZERO (int8_t, lq);
+  za = zr = 0;
+  ol = 0;
+  for (jt = p4est->first_local_tree; jt <= p4est->last_local_tree; ++jt) {
+    tree = p4est_tree_array_index (p4est->trees, jt);
+    nl = tree->quadrants_offset;
+    for (zz = 0; zz < tree->quadrants.elem_count; ++zz, ++nl) {
+      q = p4est_quadrant_array_index (&tree->quadrants, zz);
+      for (; zr < removed.elem_count; ++zr) {
+        rq = p4est_quadrant_array_index (&removed, zr);
+        if (rq->p.piggy3.which_tree > jt ||
+            (rq->p.piggy3.which_tree == jt &&
+             p4est_quadrant_compare (rq, q) > 0)) {
+          break;
+        }
+        P4EST_ASSERT (ol < old_lq);
+        old_to_new[ol++] = -1;
+      }
+      aq = (za < added.elem_count) ?
+        p4est_quadrant_array_index (&added, za) : NULL;
+      if (aq != NULL && aq->p.piggy3.which_tree == jt &&
+          p4est_quadrant_is_equal (aq, q)) {
+        new_to_old[nl] = -1;
+        dirty[nl] = 1;
+        ++za;
+      }
+      else {
+        P4EST_ASSERT (ol < old_lq);
+        old_to_new[ol] = nl;
+        new_to_old[nl] = ol++;
+      }
+    }
+  }
+  for (; zr < removed.elem_count; ++zr) {
+    P4EST_ASSERT (ol < old_lq);
+    old_to_new[ol++] = -1;
+  }
+  P4EST_ASSERT (ol == old_lq);
+  P4EST_ASSERT (za == added.elem_count);
+
+  /* the neighbors of new quadrants and the ghost layer need to be searched */
+  mu->p4est = p4est;
+  mu->ghost = ghost;
+  mu->mesh = newmesh;
+  sc_array_init (&mu->quads, sizeof (p4est_quadrant_t));
+  sc_array_init (&mu->treeids, sizeof (p4est_topidx_t));
+  sc_array_init (&mu->entities, sizeof (int));
+  sc_array_init (&mu->sides, sizeof (mesh_tree_corner_t));
+  for (za = 0; za < added.elem_count; ++za) {
+    aq = p4est_quadrant_array_index (&added, za);
+    mesh_update_touch (mu, aq->p.piggy3.which_tree, aq, dirty);
+  }
+  for (zz = 0; zz < ghost->mirrors.elem_count; ++zz) {
+    q = p4est_quadrant_array_index (&ghost->mirrors, zz);
+    dirty[q->p.piggy3.local_num] = 1;
+  }
+  sc_array_reset (&added);
+  sc_array_reset (&removed);
+
+  /* renumber the clean quadrants and search the others */
+  for (jt = p4est->first_local_tree; jt <= p4est->last_local_tree; ++jt) {
+    tree = p4est_tree_array_index (p4est->trees, jt);
+    nl = tree->quadrants_offset;
+    for (zz = 0; zz < tree->quadrants.elem_count; ++zz, ++nl) {
+      q = p4est_quadrant_array_index (&tree->quadrants, zz);
+      if (!dirty[nl] && mesh_update_is_local (mesh, new_to_old[nl])) {
+        mesh_update_copy (newmesh, mesh, old_to_new, nl, new_to_old[nl]);
+      }
+      else {
+        mesh_update_faces (mu, jt, q, nl);
+        if (newmesh->quad_to_corner != NULL) {
+          for (c = 0; c < P4EST_CHILDREN; ++c) {
+            newmesh->quad_to_corner[P4EST_CHILDREN * nl + c] =
+              mesh_update_corner (mu, jt, q, c);
+          }
+        }
+      }
+      if (newmesh->quad_to_tree != NULL) {
+        newmesh->quad_to_tree[nl] = jt;
+      }
+      if (newmesh->quad_level != NULL) {
+        *(p4est_locidx_t *) sc_array_push (newmesh->quad_level + q->level) =
+          nl;
+      }
+    }
+  }
+
+  sc_array_reset (&mu->quads);
+  sc_array_reset (&mu->treeids);
+  sc_array_reset (&mu->entities);
+  sc_array_reset (&mu->sides);
+  P4EST_FREE (old_to_new);
+  P4EST_FREE (new_to_old);
+  P4EST_FREE (dirty);
+
+  return newmesh;
+}
+
+void
+p4est_mesh_update (p4est_mesh_t * mesh, p4est_t * p4est,
+                   p4est_ghost_t * ghost, p4est_mesh_changes_t * changes)
+{
+  p4est_mesh_t       *newmesh;
+  p4est_mesh_t        swap;
+
+  newmesh = p4est_mesh_new_update (mesh, p4est, ghost, changes);
+  swap = *mesh;
+  *mesh = *newmesh;
+  *newmesh = swap;
+  p4est_mesh_destroy (newmesh);
+}
+
 p4est_quadrant_t   *
 p4est_mesh_quadrant_cumulative (p4est_t * p4est, p4est_locidx_t cumulative_id,
                                 p4est_topidx_t * which_tree,
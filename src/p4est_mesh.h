@@ -153,6 +153,72 @@ p4est_mesh_t       *p4est_mesh_new (p4est_t * p4est, p4est_ghost_t * ghost,
  */
 void                p4est_mesh_destroy (p4est_mesh_t * mesh);
 
+/** This structure records the local quadrants replaced by adaptation.
+ * It is filled by \ref p4est_mesh_changes_replace, which is meant to be
+ * called from the p4est_replace_t callbacks of refine, coarsen and balance.
+ * Quadrants that are replaced and later restored are treated as unchanged.
+ * Both arrays hold copies of quadrants with piggy3.which_tree set.
+ */
+typedef struct
+{
+  sc_array_t          outgoing;         /**< quadrants removed from forest */
+  sc_array_t          incoming;         /**< quadrants added to forest */
+}
+p4est_mesh_changes_t;
+
+/** Create an empty record of adaptation changes.
+ * \return              Record to be passed to p4est_mesh_changes_replace.
+ */
+p4est_mesh_changes_t *p4est_mesh_changes_new (void);
+
+/** Destroy a record of adaptation changes.
+ * \param [in] changes  Record previously created by p4est_mesh_changes_new.
+ */
+void                p4est_mesh_changes_destroy (p4est_mesh_changes_t *
+                                                changes);
+
+/** Add a replacement to a record of adaptation changes.
+ * The parameters after \a changes are those of p4est_replace_t.
+ * \param [in,out] changes  The outgoing and incoming quadrants are copied.
+ */
+void                p4est_mesh_changes_replace (p4est_mesh_changes_t *
+                                                changes,
+                                                p4est_topidx_t which_tree,
+                                                int num_outgoing,
+                                                p4est_quadrant_t * outgoing[],
+                                                int num_incoming,
+                                                p4est_quadrant_t *
+                                                incoming[]);
+
+/** Create a mesh for an adapted forest from the mesh before adaptation.
+ * Only the quadrants that were replaced, their neighbors and the quadrants
+ * next to the ghost layer are looked up in the forest; the entries of all
+ * other quadrants are renumbered in a linear pass.
+ * The partition must not have changed since \a mesh was created.
+ * The result has the same content as p4est_mesh_new_ext with the options
+ * that \a mesh was created with, except for the order of the entries in
+ * quad_to_half and the corner arrays.
+ * \param [in] mesh     Mesh of the forest before adaptation.  Unchanged.
+ * \param [in] p4est    The adapted forest.  Must be fully 2:1 balanced.
+ * \param [in] ghost    The ghost layer of the adapted forest, created with
+ *                      the same connection type as \a mesh.
+ * \param [in] changes  All replacements between \a mesh and \a p4est.
+ *                      May be NULL if only the ghost layer is new.
+ * \return              A fully allocated mesh structure.
+ */
+p4est_mesh_t       *p4est_mesh_new_update (p4est_mesh_t * mesh,
+                                           p4est_t * p4est,
+                                           p4est_ghost_t * ghost,
+                                           p4est_mesh_changes_t * changes);
+
+/** Update a mesh in place after its forest has been adapted.
+ * See p4est_mesh_new_update for the parameters and conditions.
+ * \param [in,out] mesh On output, the mesh of the adapted forest.
+ */
+void                p4est_mesh_update (p4est_mesh_t * mesh, p4est_t * p4est,
+                                       p4est_ghost_t * ghost,
+                                       p4est_mesh_changes_t * changes);
+
 /** Find a quadrant based on its cumulative number in the local forest.
  * \param [in]  p4est           Forest to be worked with.
  * \param [in]  cumulative_id   Cumulative index over all trees of quadrant.
@@ -26,14 +26,19 @@
 #include <p4est_algorithms.h>
 #include <p4est_bits.h>
 #include <p4est_communication.h>
+#include <p4est_extended.h>
 #include <p4est_nodes.h>
 #else
 #include <p8est_algorithms.h>
 #include <p8est_bits.h>
 #include <p8est_communication.h>
+#include <p8est_extended.h>
 #include <p8est_nodes.h>
 #endif
 #include <sc_ranges.h>
+#ifdef SC_ENABLE_OPENMP
+#include <omp.h>
+#endif
 
 #ifdef P4EST_ENABLE_MPI
 
@@ -253,6 +258,175 @@ p4est_nodes_new_local (p4est_t * p4est)
   return nodes;
 }
 
+/** Key of a node candidate for the sort-based deduplication. */
+typedef struct p4est_node_key
+{
+  uint64_t            morton;   /**< Interleaved node coordinates. */
+  p4est_topidx_t      which_tree;       /**< The tree of the node. */
+  p4est_locidx_t      index;    /**< Position of the candidate. */
+}
+p4est_node_key_t;
+
+/** Interleave the coordinates of a node into a Morton index.
+ * The resulting order agrees with \ref p4est_quadrant_compare.
+ */
+static              uint64_t
+p4est_node_morton (const p4est_quadrant_t * n)
+{
+  int                 i;
+  uint64_t            morton;
+
+  P4EST_ASSERT (p4est_quadrant_is_node (n, 1));
+
+  morton = 0;
+  for (i = 0; i < P4EST_MAXLEVEL; ++i) {
+    morton |= ((uint64_t) ((n->x >> i) & 1)) << (P4EST_DIM * i);
+    morton |= ((uint64_t) ((n->y >> i) & 1)) << (P4EST_DIM * i + 1);
+#ifdef P4_TO_P8
+    morton |= ((uint64_t) ((n->z >> i) & 1)) << (P4EST_DIM * i + 2);
+#endif
+  }
+  return morton;
+}
+
+/** Return one byte of the sort key consisting of tree and Morton index. */
+static inline unsigned
+p4est_node_key_digit (const p4est_node_key_t * key, int digit)
+{
+  if (digit < 8) {
+    return (unsigned) (key->morton >> (8 * digit)) & 0xff;
+  }
+  return (unsigned) (((uint32_t) key->which_tree) >> (8 * (digit - 8)))
+    & 0xff;
+}
+
+/** Sort node keys by tree and Morton index.
+ * This is a stable least significant digit radix sort with byte digits.
+ * Digits that are equal for all keys are skipped.
+ */
+static void
+p4est_node_keys_sort (p4est_node_key_t * keys, size_t num_keys)
+{
+  int                 digit;
+  unsigned            d;
+  size_t              zz, count[256], offset, sum;
+  p4est_node_key_t   *temp, *source, *dest, *swap;
+
+  temp = P4EST_ALLOC (p4est_node_key_t, num_keys);
+  source = keys;
+  dest = temp;
+  for (digit = 0; digit < 12; ++digit) {
+    memset (count, 0, 256 * sizeof (size_t));
+    for (zz = 0; zz < num_keys; ++zz) {
+      ++count[p4est_node_key_digit (source + zz, digit)];
+    }
+    if (num_keys == 0 ||
+        count[p4est_node_key_digit (source, digit)] == num_keys) {
+      continue;
+    }
+    for (sum = 0, d = 0; d < 256; ++d) {
+      offset = count[d];
+      count[d] = sum;
+      sum += offset;
+    }
+    for (zz = 0; zz < num_keys; ++zz) {
+      dest[count[p4est_node_key_digit (source + zz, digit)]++] = source[zz];
+    }
+    swap = source;
+    source = dest;
+    dest = swap;
+  }
+  if (source != keys) {
+    memcpy (keys, source, num_keys * sizeof (p4est_node_key_t));
+  }
+  P4EST_FREE (temp);
+}
+
+/** Remove duplicate nodes from an array of candidates by sorting.
+ * The array may hold any of the node types since they share the
+ * coordinate and tree layout of \ref p4est_quadrant_t.  Of each set of
+ * equal candidates, the first one is kept.
+ * \param [in,out] cands   The node candidates, compacted to unique nodes.
+ * \param [out] numbers    For each candidate, the index of its unique node.
+ * \param [in] by_first    If true, order the unique nodes by their first
+ *                         occurrence, which matches the order of an
+ *                         sc_hash_array.  Otherwise order them by tree
+ *                         and Morton index.
+ * \param [in] num_threads The keys are built and the unique nodes copied
+ *                         by this many threads if OpenMP is enabled.
+ */
+static void
+p4est_nodes_unique (sc_array_t * cands, p4est_locidx_t * numbers,
+                    int by_first, int num_threads)
+{
+  const size_t        num_cands = cands->elem_count;
+  const size_t        esize = cands->elem_size;
+  long                lz;
+  size_t              zz, num_unique;
+  size_t             *firsts, *sorted_firsts;
+  p4est_locidx_t     *order;
+  p4est_node_key_t   *keys, *key;
+  p4est_quadrant_t   *n;
+  char               *unique;
+
+  /* build and sort the flat array of keys */
+  keys = P4EST_ALLOC (p4est_node_key_t, num_cands);
+#ifdef SC_ENABLE_OPENMP
+#pragma omp parallel for num_threads (num_threads) schedule (static) \
+  private (n)
+#endif
+  for (lz = 0; lz < (long) num_cands; ++lz) {
+    n = (p4est_quadrant_t *) sc_array_index (cands, (size_t) lz);
+    keys[lz].morton = p4est_node_morton (n);
+    keys[lz].which_tree = n->p.which_tree;
+    keys[lz].index = (p4est_locidx_t) lz;
+  }
+  p4est_node_keys_sort (keys, num_cands);
+
+  /* the sort is stable, so each run of equal keys starts with the first */
+  firsts = P4EST_ALLOC (size_t, num_cands);
+  for (num_unique = 0, zz = 0; zz < num_cands; ++zz) {
+    key = keys + zz;
+    if (zz == 0 || key->morton != key[-1].morton ||
+        key->which_tree != key[-1].which_tree) {
+      firsts[num_unique++] = (size_t) key->index;
+    }
+    numbers[key->index] = (p4est_locidx_t) (num_unique - 1);
+  }
+  P4EST_FREE (keys);
+
+  if (by_first) {
+    /* renumber the runs by the position of their first candidate */
+    order = P4EST_ALLOC (p4est_locidx_t, num_unique);
+    sorted_firsts = firsts;
+    firsts = P4EST_ALLOC (size_t, num_unique);
+    for (num_unique = 0, zz = 0; zz < num_cands; ++zz) {
+      if (sorted_firsts[numbers[zz]] == zz) {
+        order[numbers[zz]] = (p4est_locidx_t) num_unique;
+        firsts[num_unique++] = zz;
+      }
+    }
+    P4EST_FREE (sorted_firsts);
+    for (zz = 0; zz < num_cands; ++zz) {
+      numbers[zz] = order[numbers[zz]];
+    }
+    P4EST_FREE (order);
+  }
+
+  /* compact the candidates */
+  unique = P4EST_ALLOC (char, num_unique * esize);
+#ifdef SC_ENABLE_OPENMP
+#pragma omp parallel for num_threads (num_threads) schedule (static)
+#endif
+  for (lz = 0; lz < (long) num_unique; ++lz) {
+    memcpy (unique + lz * esize, sc_array_index (cands, firsts[lz]), esize);
+  }
+  sc_array_resize (cands, num_unique);
+  memcpy (cands->array, unique, num_unique * esize);
+  P4EST_FREE (unique);
+  P4EST_FREE (firsts);
+}
+
 /** Determine the owning tree for a node and clamp it inside the domain.
  *
  * If the node is on the boundary, assign the lowest tree to own it.
@@ -443,6 +617,129 @@ endfunction:
   P4EST_ASSERT (c->p.which_tree >= 0 && c->p.which_tree < conn->num_trees);
 }
 
+/** Return the largest number of trees that meet at an edge or corner.
+ * This bounds the workspace of \ref p4est_quadrant_exists.
+ */
+static size_t
+p4est_nodes_exist_size (p4est_connectivity_t * conn)
+{
+  size_t              size = 0;
+  p4est_topidx_t      jt;
+
+#ifdef P4_TO_P8
+  for (jt = 0; jt < conn->num_edges; ++jt) {
+    size = SC_MAX (size, (size_t) (conn->ett_offset[jt + 1] -
+                                   conn->ett_offset[jt]));
+  }
+#endif
+  for (jt = 0; jt < conn->num_corners; ++jt) {
+    size = SC_MAX (size, (size_t) (conn->ctt_offset[jt + 1] -
+                                   conn->ctt_offset[jt]));
+  }
+  return size;
+}
+
+/** Determine the hanging status and the independent nodes of a quadrant.
+ *
+ * This function only reads the forest and may be called concurrently.
+ *
+ * \param [in] p4est        The p4est to work on.
+ * \param [in] ghost        Ghost layer to look up the neighbors.
+ * \param [in] treeid       The tree of the quadrant.
+ * \param [in] q            A local quadrant.
+ * \param [out] status      For each corner 0 if independent, 1 if face
+ *                          hanging and 2 if edge hanging.
+ * \param [out] corners     For each corner the canonicalized independent
+ *                          node related to it.
+ * \param [in,out] exist_array  Workspace for \ref p4est_quadrant_exists.
+ *                          It is only used in 3D and may be NULL in 2D.
+ * \return                  The number of face hanging corners.
+ */
+static              p4est_locidx_t
+p4est_nodes_quadrant_corners (p4est_t * p4est, p4est_ghost_t * ghost,
+                              p4est_topidx_t treeid, p4est_quadrant_t * q,
+                              int8_t * status, p4est_quadrant_t * corners,
+                              sc_array_t * exist_array)
+{
+  int                 k, qcid, face;
+#ifdef P4_TO_P8
+  int                 l, edge, corner;
+#endif
+  p4est_locidx_t      num_face_hangings;
+  p4est_quadrant_t    n, p;
+  p4est_quadrant_t   *qpp[3];
+
+  P4EST_QUADRANT_INIT (&n);
+  P4EST_QUADRANT_INIT (&p);
+  qpp[0] = q;
+  qpp[1] = qpp[2] = &p;
+
+  qcid = p4est_quadrant_child_id (q);
+  if (q->level > 0) {
+    p4est_quadrant_parent (q, &p);
+  }
+
+  /* assign independent node and face hanging node status */
+  num_face_hangings = 0;
+  for (k = 0; k < P4EST_CHILDREN; ++k) {
+    status[k] = -1;
+  }
+  for (k = 0; k < P4EST_CHILDREN; ++k) {
+    if (k == qcid || k == P4EST_CHILDREN - 1 - qcid || q->level == 0) {
+      status[k] = 0;            /* independent node */
+      continue;
+    }
+    face = p4est_child_corner_faces[qcid][k];
+    if (face == -1) {
+#ifndef P4_TO_P8
+      SC_ABORT_NOT_REACHED ();
+#else
+      P4EST_ASSERT (p8est_child_corner_edges[qcid][k] >= 0);
+      continue;
+#endif
+    }
+    p4est_quadrant_face_neighbor (&p, face, &n);
+    if (p4est_quadrant_exists (p4est, ghost, treeid, &n, NULL, NULL, NULL)) {
+      status[k] = 1;            /* face hanging node */
+#ifdef P4_TO_P8
+      for (l = 0; l < P4EST_HALF; ++l) {
+        corner = p4est_face_corners[face][l];
+        if (corner != qcid && corner != k) {
+          status[corner] = 2;   /* identify edge hanging nodes */
+        }
+      }
+#endif
+      ++num_face_hangings;
+    }
+    else {
+      status[k] = 0;            /* independent node */
+    }
+  }
+
+#ifdef P4_TO_P8
+  /* assign edge hanging node status */
+  for (k = 0; k < P4EST_CHILDREN; ++k) {
+    if (status[k] == -1) {
+      edge = p8est_child_corner_edges[qcid][k];
+      P4EST_ASSERT (edge >= 0 && edge < P8EST_EDGES);
+      p8est_quadrant_edge_neighbor (&p, edge, &n);
+      status[k] = (int8_t)
+        (p4est_quadrant_exists (p4est, ghost, treeid, &n,
+                                exist_array, NULL, NULL) ? 2 : 0);
+    }
+  }
+#endif
+
+  /* compute all independent nodes related to the element */
+  for (k = 0; k < P4EST_CHILDREN; ++k) {
+    P4EST_ASSERT (status[k] >= 0 && status[k] <= 2);
+    p4est_quadrant_corner_node (qpp[status[k]], k, &n);
+    p4est_node_canonicalize (p4est, treeid, &n, &corners[k]);
+  }
+
+  return num_face_hangings;
+}
+
 static int
 p4est_nodes_foreach (void **item, const void *u)
 {
@@ -484,8 +781,12 @@ p4est_nodes_new (p4est_t * p4est, p4est_ghost_t * ghost)
 {
   const int           num_procs = p4est->mpisize;
   const int           rank = p4est->mpirank;
+  const int           use_sort = p4est->inspect != NULL &&
+    p4est->inspect->use_nodes_sort;
+  int                 num_threads;
 #ifdef P4EST_ENABLE_MPI
   int                 mpiret;
+  ssize_t             found;
   int                 owner, prev, start;
   int                 first_peer, last_peer;
   int                 num_send_queries, num_send_nonzero, num_recv_queries;
@@ -514,10 +815,10 @@ p4est_nodes_new (p4est_t * p4est, p4est_ghost_t * ghost)
   int                 l;
 #endif
   int                 k;
-  int                 qcid, face;
+  int                 qcid;
   int                 clamped = 1;
   void               *save_user_data;
-  size_t              zz, position;
+  size_t              zz, position, exist_size;
   int8_t             *local_status, *quad_status;
   p4est_topidx_t      jt;
   p4est_locidx_t      il, first, second;
@@ -527,12 +828,15 @@ p4est_nodes_new (p4est_t * p4est, p4est_ghost_t * ghost)
   p4est_locidx_t      num_indep_nodes, dup_indep_nodes, all_face_hangings;
   p4est_locidx_t      num_face_hangings, dup_face_hangings;
   p4est_locidx_t     *local_nodes, *quad_nodes;
-  p4est_locidx_t     *new_node_number;
+  p4est_locidx_t     *new_node_number, *hang_numbers;
   p4est_tree_t       *tree;
   p4est_nodes_t      *nodes;
   p4est_quadrant_t    c, n, p;
   p4est_quadrant_t   *q, *qpp[3], *r;
+  p4est_quadrant_t    corners[P4EST_CHILDREN];
   p4est_indep_t      *in;
+  sc_array_t          exist_array;
+  sc_array_t         *exist_arrays, *exist;
   sc_array_t         *quadrants;
   sc_array_t         *inda, *faha;
   sc_array_t         *shared_indeps;
@@ -541,7 +845,7 @@ p4est_nodes_new (p4est_t * p4est, p4est_ghost_t * ghost)
 #ifndef P4_TO_P8
   p4est_hang2_t      *fh;
 #else
-  int                 edge, corner;
+  int                 face, corner;
 #ifdef P4EST_ENABLE_DEBUG
   p4est_locidx_t      num_face_hangings_end;
 #endif
@@ -549,7 +853,6 @@ p4est_nodes_new (p4est_t * p4est, p4est_ghost_t * ghost)
   p4est_locidx_t      num_edge_hangings, dup_edge_hangings;
   p8est_hang4_t      *fh;
   p8est_hang2_t      *eh;
-  sc_array_t          exist_array;
   sc_array_t         *edha;
   sc_hash_array_t    *edge_hangings;
 #endif
@@ -561,6 +864,17 @@ p4est_nodes_new (p4est_t * p4est, p4est_ghost_t * ghost)
   p4est_log_indent_push ();
   P4EST_ASSERT (p4est_is_valid (p4est));
 
+  /* only the sorting variant runs in several threads */
+  num_threads = 1;
+#ifdef SC_ENABLE_OPENMP
+  if (use_sort) {
+    num_threads = p4est->inspect->nodes_num_threads;
+    if (num_threads <= 0) {
+      num_threads = omp_get_max_threads ();
+    }
+  }
+#endif
+
   P4EST_QUADRANT_INIT (&c);
   P4EST_QUADRANT_INIT (&n);
   P4EST_QUADRANT_INIT (&p);
@@ -595,147 +909,168 @@ p4est_nodes_new (p4est_t * p4est, p4est_ghost_t * ghost)
     P4EST_ALLOC (p4est_locidx_t, num_local_nodes);
   memset (local_nodes, -1, num_local_nodes * sizeof (*local_nodes));
 
-  indep_nodes = sc_hash_array_new (sizeof (p4est_indep_t),
-                                   p4est_node_hash_piggy_fn,
-                                   p4est_node_equal_piggy_fn, &clamped);
-#ifndef P4_TO_P8
-  face_hangings = sc_hash_array_new (sizeof (p4est_hang2_t),
+  if (!use_sort) {
+    indep_nodes = sc_hash_array_new (sizeof (p4est_indep_t),
                                      p4est_node_hash_piggy_fn,
                                      p4est_node_equal_piggy_fn, &clamped);
+#ifndef P4_TO_P8
+    face_hangings = sc_hash_array_new (sizeof (p4est_hang2_t),
+                                       p4est_node_hash_piggy_fn,
+                                       p4est_node_equal_piggy_fn, &clamped);
 #else
-  face_hangings = sc_hash_array_new (sizeof (p8est_hang4_t),
-                                     p4est_node_hash_piggy_fn,
-                                     p4est_node_equal_piggy_fn, &clamped);
-  edge_hangings = sc_hash_array_new (sizeof (p8est_hang2_t),
-                                     p4est_node_hash_piggy_fn,
-                                     p4est_node_equal_piggy_fn, &clamped);
-  sc_array_init (&exist_array, sizeof (int));
+    face_hangings = sc_hash_array_new (sizeof (p8est_hang4_t),
+                                       p4est_node_hash_piggy_fn,
+                                       p4est_node_equal_piggy_fn, &clamped);
+    edge_hangings = sc_hash_array_new (sizeof (p8est_hang2_t),
+                                       p4est_node_hash_piggy_fn,
+                                       p4est_node_equal_piggy_fn, &clamped);
 #endif
+  }
+  else {
+    /* collect all candidates in flat arrays and sort them later */
+    indep_nodes = face_hangings = NULL;
+    inda = &nodes->indep_nodes;
+    sc_array_init_size (inda, sizeof (p4est_indep_t),
+                        (size_t) num_local_nodes);
+#ifndef P4_TO_P8
+    sc_array_init (faha, sizeof (p4est_hang2_t));
+#else
+    edge_hangings = NULL;
+    sc_array_init (faha, sizeof (p8est_hang4_t));
+    sc_array_init (edha, sizeof (p8est_hang2_t));
+#endif
+  }
 
   /* This first loop will fill the local_status array with hanging status.
    * It will also collect all independent nodes relevant for the elements.
    */
   num_indep_nodes = dup_indep_nodes = all_face_hangings = 0;
-  quad_nodes = local_nodes;
-  quad_status = local_status;
-  for (jt = p4est->first_local_tree; jt <= p4est->last_local_tree; ++jt) {
-    tree = p4est_tree_array_index (p4est->trees, jt);
-    quadrants = &tree->quadrants;
+  if (use_sort) {
+    /* the workspace of each thread is allocated with its final size here,
+     * so it is not reallocated within the parallel region */
+    exist_arrays = P4EST_ALLOC (sc_array_t, num_threads);
+    exist_size = p4est_nodes_exist_size (p4est->connectivity);
+    for (k = 0; k < num_threads; ++k) {
+      sc_array_init_size (&exist_arrays[k], sizeof (int), exist_size);
+    }
 
-    /* determine hanging node status and collect all anchored nodes */
-    for (zz = 0; zz < quadrants->elem_count;
-         quad_nodes += P4EST_CHILDREN, quad_status += P4EST_CHILDREN, ++zz) {
-      qpp[0] = q = p4est_quadrant_array_index (quadrants, zz);
-      qcid = p4est_quadrant_child_id (q);
-      if (q->level > 0) {
-        p4est_quadrant_parent (q, &p);
-      }
-#ifdef P4EST_ENABLE_DEBUG
-      else {
-        P4EST_QUADRANT_INIT (&p);
-      }
+    /* every quadrant writes its candidates to a fixed position, so the
+     * quadrants may be processed by several threads */
+#ifdef SC_ENABLE_OPENMP
+#pragma omp parallel num_threads (num_threads) \
+  private (jt, tree, quadrants, zz, il, k, exist) \
+  reduction (+:all_face_hangings)
 #endif
-
-      /* assign independent node and face hanging node status */
-      for (k = 0; k < P4EST_CHILDREN; ++k) {
-        if (k == qcid || k == P4EST_CHILDREN - 1 - qcid || q->level == 0) {
-          quad_status[k] = 0;   /* independent node */
-          continue;
-        }
-        face = p4est_child_corner_faces[qcid][k];
-        if (face == -1) {
-#ifndef P4_TO_P8
-          SC_ABORT_NOT_REACHED ();
+    {
+#ifdef SC_ENABLE_OPENMP
+      exist = &exist_arrays[omp_get_thread_num ()];
 #else
-          P4EST_ASSERT (p8est_child_corner_edges[qcid][k] >= 0);
-          continue;
+      exist = &exist_arrays[0];
 #endif
-        }
-        p4est_quadrant_face_neighbor (&p, face, &n);
-        if (p4est_quadrant_exists (p4est, ghost, jt, &n, NULL, NULL, NULL)) {
-          quad_status[k] = 1;   /* face hanging node */
-#ifdef P4_TO_P8
-          for (l = 0; l < P4EST_HALF; ++l) {
-            corner = p4est_face_corners[face][l];
-            if (corner != qcid && corner != k) {
-              quad_status[corner] = 2;  /* identify edge hanging nodes */
-            }
-          }
+      for (jt = p4est->first_local_tree; jt <= p4est->last_local_tree; ++jt) {
+        tree = p4est_tree_array_index (p4est->trees, jt);
+        quadrants = &tree->quadrants;
+#ifdef SC_ENABLE_OPENMP
+#pragma omp for schedule (static)
 #endif
-          ++all_face_hangings;
-        }
-        else {
-          quad_status[k] = 0;   /* independent node */
-        }
-      }
-
-#ifdef P4_TO_P8
-      /* assign edge hanging node status */
-      for (k = 0; k < P4EST_CHILDREN; ++k) {
-        if (quad_status[k] == -1) {
-          edge = p8est_child_corner_edges[qcid][k];
-          P4EST_ASSERT (edge >= 0 && edge < P8EST_EDGES);
-          p8est_quadrant_edge_neighbor (&p, edge, &n);
-          quad_status[k] = (int8_t)
-            (p4est_quadrant_exists (p4est, ghost, jt, &n,
-                                    &exist_array, NULL, NULL) ? 2 : 0);
+        for (zz = 0; zz < quadrants->elem_count; ++zz) {
+          il = P4EST_CHILDREN * (tree->quadrants_offset + (p4est_locidx_t) zz);
+          all_face_hangings += p4est_nodes_quadrant_corners
+            (p4est, ghost, jt, p4est_quadrant_array_index (quadrants, zz),
+             local_status + il,
+             (p4est_quadrant_t *) sc_array_index (inda, (size_t) il),
+             exist);
+          for (k = 0; k < P4EST_CHILDREN; ++k) {
+            local_nodes[il + k] = il + k;
+          }
         }
       }
-#endif
-
-      /* collect all independent nodes related to the element */
-      for (k = 0; k < P4EST_CHILDREN; ++k) {
-        P4EST_ASSERT (quad_status[k] >= 0 || quad_status[k] <= 2);
-        p4est_quadrant_corner_node (qpp[quad_status[k]], k, &n);
-        p4est_node_canonicalize (p4est, jt, &n, &c);
-        r =
-          (p4est_quadrant_t *) sc_hash_array_insert_unique (indep_nodes, &c,
-                                                            &position);
-        if (r != NULL) {
-          *r = c;
-          P4EST_ASSERT (num_indep_nodes == (p4est_locidx_t) position);
-          ++num_indep_nodes;
-        }
-        else {
-          ++dup_indep_nodes;
+    }
+    for (k = 0; k < num_threads; ++k) {
+      sc_array_reset (&exist_arrays[k]);
+    }
+    P4EST_FREE (exist_arrays);
+  }
+  else {
+    sc_array_init (&exist_array, sizeof (int));
+    quad_nodes = local_nodes;
+    quad_status = local_status;
+    for (jt = p4est->first_local_tree; jt <= p4est->last_local_tree; ++jt) {
+      tree = p4est_tree_array_index (p4est->trees, jt);
+      quadrants = &tree->quadrants;
+
+      /* determine hanging node status and collect all anchored nodes */
+      for (zz = 0; zz < quadrants->elem_count;
+           quad_nodes += P4EST_CHILDREN, quad_status += P4EST_CHILDREN,
+           ++zz) {
+        all_face_hangings += p4est_nodes_quadrant_corners
+          (p4est, ghost, jt, p4est_quadrant_array_index (quadrants, zz),
+           quad_status, corners, &exist_array);
+        for (k = 0; k < P4EST_CHILDREN; ++k) {
+          r = (p4est_quadrant_t *)
+            sc_hash_array_insert_unique (indep_nodes, &corners[k], &position);
+          if (r != NULL) {
+            *r = corners[k];
+            P4EST_ASSERT (num_indep_nodes == (p4est_locidx_t) position);
+            ++num_indep_nodes;
+          }
+          else {
+            ++dup_indep_nodes;
+          }
+          P4EST_ASSERT ((p4est_locidx_t) position < num_indep_nodes);
+          quad_nodes[k] = (p4est_locidx_t) position;
         }
-        P4EST_ASSERT ((p4est_locidx_t) position < num_indep_nodes);
-        quad_nodes[k] = (p4est_locidx_t) position;
       }
     }
+    sc_array_reset (&exist_array);
   }
-  P4EST_ASSERT (num_indep_nodes + dup_indep_nodes == num_local_nodes);
-#ifdef P4_TO_P8
-  sc_array_reset (&exist_array);
-#endif
-  inda = &indep_nodes->a;
-  P4EST_ASSERT (num_indep_nodes == (p4est_locidx_t) inda->elem_count);
-
-  /* Reorder independent nodes by their global treeid and z-order index. */
-  new_node_number = P4EST_ALLOC (p4est_locidx_t, num_indep_nodes);
-  for (il = 0; il < num_indep_nodes; ++il) {
-    in = (p4est_indep_t *) sc_array_index (inda, (size_t) il);
-    in->pad8 = 0;               /* shared by 0 other processors so far */
-    in->pad16 = (int16_t) (-1);
-    in->p.piggy3.local_num = il;
+  if (use_sort) {
+    /* Sort the candidates by global treeid and z-order index and make
+     * them unique.  The candidates are numbered like the local nodes. */
+    P4EST_ASSERT ((p4est_locidx_t) inda->elem_count == num_local_nodes);
+    p4est_nodes_unique (inda, local_nodes, 0, num_threads);
+    num_indep_nodes = (p4est_locidx_t) inda->elem_count;
+    dup_indep_nodes = num_local_nodes - num_indep_nodes;
+    for (il = 0; il < num_indep_nodes; ++il) {
+      in = (p4est_indep_t *) sc_array_index (inda, (size_t) il);
+      in->pad8 = 0;             /* shared by 0 other processors so far */
+      in->pad16 = (int16_t) (-1);
+      in->p.piggy3.local_num = il;
+    }
   }
-  sc_array_sort (inda, p4est_quadrant_compare_piggy);
-  for (il = 0; il < num_indep_nodes; ++il) {
-    in = (p4est_indep_t *) sc_array_index (inda, (size_t) il);
-    new_node_number[in->p.piggy3.local_num] = il;
+  P4EST_ASSERT (num_indep_nodes + dup_indep_nodes == num_local_nodes);
+  if (!use_sort) {
+    inda = &indep_nodes->a;
+    P4EST_ASSERT (num_indep_nodes == (p4est_locidx_t) inda->elem_count);
+
+    /* Reorder independent nodes by their global treeid and z-order index. */
+    new_node_number = P4EST_ALLOC (p4est_locidx_t, num_indep_nodes);
+    for (il = 0; il < num_indep_nodes; ++il) {
+      in = (p4est_indep_t *) sc_array_index (inda, (size_t) il);
+      in->pad8 = 0;             /* shared by 0 other processors so far */
+      in->pad16 = (int16_t) (-1);
+      in->p.piggy3.local_num = il;
+    }
+    sc_array_sort (inda, p4est_quadrant_compare_piggy);
+    for (il = 0; il < num_indep_nodes; ++il) {
+      in = (p4est_indep_t *) sc_array_index (inda, (size_t) il);
+      new_node_number[in->p.piggy3.local_num] = il;
 #ifndef P4EST_ENABLE_MPI
-    in->p.piggy3.local_num = il;
+      in->p.piggy3.local_num = il;
 #endif
-  }
+    }
 
-  /* Re-synchronize hash array and local nodes */
-  save_user_data = indep_nodes->internal_data.user_data;
-  indep_nodes->internal_data.user_data = new_node_number;
-  sc_hash_foreach (indep_nodes->h, p4est_nodes_foreach);
-  indep_nodes->internal_data.user_data = save_user_data;
-  for (il = 0; il < num_local_nodes; ++il) {
-    P4EST_ASSERT (local_nodes[il] >= 0 && local_nodes[il] < num_indep_nodes);
-    local_nodes[il] = new_node_number[local_nodes[il]];
+    /* Re-synchronize hash array and local nodes */
+    save_user_data = indep_nodes->internal_data.user_data;
+    indep_nodes->internal_data.user_data = new_node_number;
+    sc_hash_foreach (indep_nodes->h, p4est_nodes_foreach);
+    indep_nodes->internal_data.user_data = save_user_data;
+    for (il = 0; il < num_local_nodes; ++il) {
+      P4EST_ASSERT (local_nodes[il] >= 0 &&
+                    local_nodes[il] < num_indep_nodes);
+      local_nodes[il] = new_node_number[local_nodes[il]];
+    }
+    P4EST_FREE (new_node_number);
   }
 #ifndef P4EST_ENABLE_MPI
   num_owned_indeps = num_indep_nodes;
@@ -745,7 +1080,6 @@ p4est_nodes_new (p4est_t * p4est, p4est_ghost_t * ghost)
   offset_owned_indeps = -1;     /* will be computed below */
 #endif
   num_owned_shared = 0;
-  P4EST_FREE (new_node_number);
 
 #ifdef P4EST_ENABLE_MPI
   /* Fill send buffers and number owned nodes. */
@@ -902,8 +1236,15 @@ p4est_nodes_new (p4est_t * p4est, p4est_ghost_t * ghost)
 #endif
       ttt = (p4est_topidx_t *) (&xyz[P4EST_DIM]);
       inkey.p.which_tree = *ttt;
-      P4EST_EXECUTE_ASSERT_TRUE (sc_hash_array_lookup
-                                 (indep_nodes, &inkey, &position));
+      if (!use_sort) {
+        P4EST_EXECUTE_ASSERT_TRUE (sc_hash_array_lookup
+                                   (indep_nodes, &inkey, &position));
+      }
+      else {
+        found = sc_array_bsearch (inda, &inkey, p4est_quadrant_compare_piggy);
+        P4EST_ASSERT (found >= 0);
+        position = (size_t) found;
+      }
       P4EST_ASSERT ((p4est_locidx_t) position >= offset_owned_indeps &&
                     (p4est_locidx_t) position < end_owned_indeps);
       node_number = (p4est_locidx_t *) xyz;
@@ -1037,9 +1378,14 @@ p4est_nodes_new (p4est_t * p4est, p4est_ghost_t * ghost)
           P4EST_ASSERT (p4est_child_corner_faces[qcid][k] >= 0);
           p4est_quadrant_corner_node (q, k, &n);
           p4est_node_canonicalize (p4est, jt, &n, &c);
-          r =
-            (p4est_quadrant_t *) sc_hash_array_insert_unique (face_hangings,
-                                                              &c, &position);
+          if (use_sort) {
+            r = (p4est_quadrant_t *) sc_array_push (faha);
+            position = faha->elem_count - 1;
+          }
+          else {
+            r = (p4est_quadrant_t *)
+              sc_hash_array_insert_unique (face_hangings, &c, &position);
+          }
           if (r != NULL) {
             *r = c;
             P4EST_ASSERT (num_face_hangings == (p4est_locidx_t) position);
@@ -1091,9 +1437,14 @@ p4est_nodes_new (p4est_t * p4est, p4est_ghost_t * ghost)
           P4EST_ASSERT (p8est_child_corner_edges[qcid][k] >= 0);
           p4est_quadrant_corner_node (q, k, &n);
           p4est_node_canonicalize (p4est, jt, &n, &c);
-          r =
-            (p4est_quadrant_t *) sc_hash_array_insert_unique (edge_hangings,
-                                                              &c, &position);
+          if (use_sort) {
+            r = (p4est_quadrant_t *) sc_array_push (edha);
+            position = edha->elem_count - 1;
+          }
+          else {
+            r = (p4est_quadrant_t *)
+              sc_hash_array_insert_unique (edge_hangings, &c, &position);
+          }
           if (r != NULL) {
             *r = c;
             P4EST_ASSERT (num_edge_hangings == (p4est_locidx_t) position);
@@ -1122,10 +1473,44 @@ p4est_nodes_new (p4est_t * p4est, p4est_ghost_t * ghost)
   }
   P4EST_ASSERT (num_face_hangings + dup_face_hangings == all_face_hangings);
   P4EST_FREE (local_status);
-  sc_hash_array_rip (face_hangings, faha);
+  if (use_sort) {
+    /* Make the hanging nodes unique in the order of their first occurrence,
+     * which is the order of the hash arrays. */
+    hang_numbers = P4EST_ALLOC (p4est_locidx_t, faha->elem_count);
+    p4est_nodes_unique (faha, hang_numbers, 1, num_threads);
+    num_face_hangings = (p4est_locidx_t) faha->elem_count;
+    dup_face_hangings = all_face_hangings - num_face_hangings;
+    for (il = 0; il < num_local_nodes; ++il) {
+      if (local_nodes[il] >= num_indep_nodes &&
+          local_nodes[il] < num_indep_nodes + all_face_hangings) {
+        local_nodes[il] = num_indep_nodes +
+          hang_numbers[local_nodes[il] - num_indep_nodes];
+      }
+    }
+    P4EST_FREE (hang_numbers);
+#ifdef P4_TO_P8
+    hang_numbers = P4EST_ALLOC (p4est_locidx_t, edha->elem_count);
+    dup_edge_hangings = (p4est_locidx_t) edha->elem_count;
+    p4est_nodes_unique (edha, hang_numbers, 1, num_threads);
+    num_edge_hangings = (p4est_locidx_t) edha->elem_count;
+    dup_edge_hangings -= num_edge_hangings;
+    for (il = 0; il < num_local_nodes; ++il) {
+      if (local_nodes[il] >= num_edge_hangings_begin) {
+        local_nodes[il] = num_edge_hangings_begin +
+          hang_numbers[local_nodes[il] - num_edge_hangings_begin];
+      }
+    }
+    P4EST_FREE (hang_numbers);
+#endif
+  }
+  else {
+    sc_hash_array_rip (face_hangings, faha);
+#ifdef P4_TO_P8
+    sc_hash_array_rip (edge_hangings, edha);
+#endif
+  }
   P4EST_ASSERT (num_face_hangings == (p4est_locidx_t) faha->elem_count);
 #ifdef P4_TO_P8
-  sc_hash_array_rip (edge_hangings, edha);
   P4EST_ASSERT (num_edge_hangings == (p4est_locidx_t) edha->elem_count);
 
   /* Correct the offsets of edge hanging nodes */
@@ -1148,7 +1533,9 @@ p4est_nodes_new (p4est_t * p4est, p4est_ghost_t * ghost)
   nodes->num_owned_indeps = num_owned_indeps;
   nodes->num_owned_shared = num_owned_shared;
   nodes->offset_owned_indeps = offset_owned_indeps;
-  sc_hash_array_rip (indep_nodes, inda = &nodes->indep_nodes);
+  if (!use_sort) {
+    sc_hash_array_rip (indep_nodes, inda = &nodes->indep_nodes);
+  }
   nodes->nonlocal_ranks =
     P4EST_ALLOC (int, num_indep_nodes - num_owned_indeps);
   nodes->global_owned_indeps = P4EST_ALLOC (p4est_locidx_t, num_procs);
@@ -22,14 +22,6 @@
   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
 */
 
-/********************************************************************
- *                          IMPORTANT NOTE                          *
- *                                                                  *
- * The p4est_points functionality depends on sc/src/sc_sort.        *
- * That parallel bitonic sort is still buggy (see sc/bugs).         *
- * If you want to use this code you have to fix the sort first.     *
- ********************************************************************/
-
 #ifdef P4_TO_P8
 #include <p8est_algorithms.h>
 #include <p8est_bits.h>
@@ -43,8 +35,13 @@
 #include <p4est_extended.h>
 #include <p4est_points.h>
 #endif /* !P4_TO_P8 */
-#include <sc_allgather.h>
-#include <sc_sort.h>
+
+/** Number of samples per process used to choose the sort splitters. */
+#define P4EST_POINTS_SAMPLES 64
+
+/** Streaming repartitions when a process has this many times the
+ * average number of quadrants. */
+#define P4EST_POINTS_IMBALANCE 1.25
 
 typedef struct
 {
@@ -54,6 +51,267 @@ typedef struct
 }
 p4est_points_state_t;
 
+/** Quadrant data while streaming points into a forest. */
+typedef struct p4est_points_leaf
+{
+  p4est_gloidx_t      count;    /**< Points of the previous chunks. */
+  p4est_locidx_t      begin;    /**< First point of the current chunk. */
+  p4est_locidx_t      end;      /**< End of the points of the chunk. */
+}
+p4est_points_leaf_t;
+
+typedef struct p4est_points_stream_state
+{
+  p4est_quadrant_t   *points;   /**< The sorted local current chunk. */
+  p4est_locidx_t      max_points;
+}
+p4est_points_stream_state_t;
+
+/** Find the first point that is not less than a given quadrant.
+ * \param [in] points  Points sorted by \ref p4est_quadrant_compare_piggy.
+ * \param [in] count   Number of points.
+ * \param [in] q       Quadrant with tree information.
+ * \return             Index into \b points between 0 and \b count.
+ */
+static size_t
+p4est_points_lower_bound (const p4est_quadrant_t * points, size_t count,
+                          const p4est_quadrant_t * q)
+{
+  size_t              low, high, guess;
+
+  low = 0;
+  high = count;
+  while (low < high) {
+    guess = low + (high - low) / 2;
+    if (p4est_quadrant_compare_piggy (points + guess, q) < 0) {
+      low = guess + 1;
+    }
+    else {
+      high = guess;
+    }
+  }
+  return low;
+}
+
+/** Exchange contiguous ranges of points between all processes.
+ * The points sent to and received from each process are stored
+ * contiguously in the order of the process numbers.
+ * \param [in] mpicomm      The communicator.
+ * \param [in] send         Points to send.
+ * \param [in] send_counts  Number of points to send to each process.
+ * \param [out] recv        Points received.
+ * \param [in] recv_counts  Number of points received from each process.
+ */
+static void
+p4est_points_exchange (sc_MPI_Comm mpicomm, int num_procs, int rank,
+                       const p4est_quadrant_t * send,
+                       const size_t * send_counts,
+                       p4est_quadrant_t * recv, const size_t * recv_counts)
+{
+  const size_t        qsize = sizeof (p4est_quadrant_t);
+  int                 mpiret;
+  int                 p;
+  size_t              send_offset, recv_offset, self_offset;
+  sc_array_t          requests;
+  sc_MPI_Request     *req;
+
+  sc_array_init (&requests, sizeof (sc_MPI_Request));
+  self_offset = 0;
+  for (recv_offset = 0, p = 0; p < num_procs; ++p) {
+    if (p == rank) {
+      self_offset = recv_offset;
+    }
+    else if (recv_counts[p] > 0) {
+      P4EST_ASSERT (recv_counts[p] * qsize <= (size_t) INT_MAX);
+      req = (sc_MPI_Request *) sc_array_push (&requests);
+      mpiret = sc_MPI_Irecv (recv + recv_offset,
+                             (int) (recv_counts[p] * qsize), sc_MPI_BYTE,
+                             p, P4EST_COMM_POINTS_SORT, mpicomm, req);
+      SC_CHECK_MPI (mpiret);
+    }
+    recv_offset += recv_counts[p];
+  }
+  for (send_offset = 0, p = 0; p < num_procs; ++p) {
+    if (p == rank) {
+      P4EST_ASSERT (send_counts[p] == recv_counts[p]);
+      memcpy (recv + self_offset, send + send_offset,
+              send_counts[p] * qsize);
+    }
+    else if (send_counts[p] > 0) {
+      P4EST_ASSERT (send_counts[p] * qsize <= (size_t) INT_MAX);
+      req = (sc_MPI_Request *) sc_array_push (&requests);
+      mpiret = sc_MPI_Isend ((void *) (send + send_offset),
+                             (int) (send_counts[p] * qsize), sc_MPI_BYTE,
+                             p, P4EST_COMM_POINTS_SORT, mpicomm, req);
+      SC_CHECK_MPI (mpiret);
+    }
+    send_offset += send_counts[p];
+  }
+  mpiret = sc_MPI_Waitall ((int) requests.elem_count,
+                           (sc_MPI_Request *) requests.array,
+                           sc_MPI_STATUSES_IGNORE);
+  SC_CHECK_MPI (mpiret);
+  sc_array_reset (&requests);
+}
+
+/** Sort points in parallel by tree and Morton index.
+ * This is a sample sort: every process sorts its points locally and
+ * contributes a fixed number of regularly spaced samples.  The samples
+ * are gathered and weighted by the point count of their process, which
+ * determines one splitter per process.  The points are sent to the
+ * process of their splitter interval and sorted there.  Finally the
+ * sorted sequence is shifted to reproduce the original point counts.
+ * \param [in] mpicomm     The communicator.
+ * \param [in,out] points  On input the unsorted local points.  On output
+ *                         the same number of points from the global sort.
+ * \param [in] nmemb       The number of points on each process.
+ */
+static void
+p4est_points_sort (sc_MPI_Comm mpicomm, p4est_quadrant_t * points,
+                   const size_t * nmemb)
+{
+  const size_t        qsize = sizeof (p4est_quadrant_t);
+  int                 mpiret;
+  int                 num_procs, rank;
+  int                 p, num_samples, total_samples;
+  int                *sample_counts, *sample_bytes, *sample_displs;
+  size_t              zz, lcount, total, target, next;
+  size_t              recv_total, first, last, begin, end;
+  size_t             *send_counts, *recv_counts, *sorted_counts;
+  size_t             *bounds;
+  double              weight, threshold;
+  p4est_quadrant_t   *samples, *all_samples, *splitters, *sorted;
+
+  mpiret = sc_MPI_Comm_size (mpicomm, &num_procs);
+  SC_CHECK_MPI (mpiret);
+  mpiret = sc_MPI_Comm_rank (mpicomm, &rank);
+  SC_CHECK_MPI (mpiret);
+  lcount = nmemb[rank];
+
+  /* sort locally */
+  qsort (points, lcount, qsize, p4est_quadrant_compare_piggy);
+  if (num_procs == 1) {
+    return;
+  }
+  for (total = 0, p = 0; p < num_procs; ++p) {
+    total += nmemb[p];
+  }
+  if (total == 0) {
+    return;
+  }
+
+  /* take regularly spaced samples of the local points */
+  num_samples = (int) SC_MIN (lcount, (size_t) P4EST_POINTS_SAMPLES);
+  samples = P4EST_ALLOC (p4est_quadrant_t, num_samples);
+  for (p = 0; p < num_samples; ++p) {
+    samples[p] = points[((2 * (size_t) p + 1) * lcount) /
+                        (2 * (size_t) num_samples)];
+  }
+  sample_counts = P4EST_ALLOC (int, num_procs);
+  mpiret = sc_MPI_Allgather (&num_samples, 1, sc_MPI_INT,
+                             sample_counts, 1, sc_MPI_INT, mpicomm);
+  SC_CHECK_MPI (mpiret);
+  sample_bytes = P4EST_ALLOC (int, num_procs);
+  sample_displs = P4EST_ALLOC (int, num_procs);
+  for (total_samples = 0, p = 0; p < num_procs; ++p) {
+    sample_bytes[p] = sample_counts[p] * (int) qsize;
+    sample_displs[p] = total_samples * (int) qsize;
+    total_samples += sample_counts[p];
+  }
+  all_samples = P4EST_ALLOC (p4est_quadrant_t, total_samples);
+  mpiret = sc_MPI_Allgatherv (samples, num_samples * (int) qsize,
+                              sc_MPI_BYTE, all_samples, sample_bytes,
+                              sample_displs, sc_MPI_BYTE, mpicomm);
+  SC_CHECK_MPI (mpiret);
+  P4EST_FREE (sample_displs);
+  P4EST_FREE (sample_bytes);
+  P4EST_FREE (samples);
+
+  /* remember the origin of each sample to compute its weight */
+  for (zz = 0, p = 0; p < num_procs; ++p) {
+    for (next = zz + (size_t) sample_counts[p]; zz < next; ++zz) {
+      all_samples[zz].p.piggy3.local_num = (p4est_locidx_t) p;
+    }
+  }
+  qsort (all_samples, (size_t) total_samples, qsize,
+         p4est_quadrant_compare_piggy);
+
+  /* splitter p is the first sample above p / num_procs of all points */
+  splitters = P4EST_ALLOC (p4est_quadrant_t, num_procs);
+  weight = 0.;
+  for (zz = 0, p = 1; p < num_procs; ++p) {
+    threshold = (double) total * p / num_procs;
+    while (zz + 1 < (size_t) total_samples && weight < threshold) {
+      next = (size_t) all_samples[zz].p.piggy3.local_num;
+      weight += nmemb[next] / (double) sample_counts[next];
+      ++zz;
+    }
+    splitters[p] = all_samples[zz];
+  }
+  P4EST_FREE (all_samples);
+  P4EST_FREE (sample_counts);
+
+  /* send the points of each splitter interval to its process */
+  bounds = P4EST_ALLOC (size_t, num_procs + 1);
+  bounds[0] = 0;
+  for (p = 1; p < num_procs; ++p) {
+    bounds[p] = p4est_points_lower_bound (points, lcount, splitters + p);
+    bounds[p] = SC_MAX (bounds[p], bounds[p - 1]);
+  }
+  bounds[num_procs] = lcount;
+  P4EST_FREE (splitters);
+  send_counts = P4EST_ALLOC (size_t, num_procs);
+  for (p = 0; p < num_procs; ++p) {
+    send_counts[p] = bounds[p + 1] - bounds[p];
+  }
+  recv_counts = P4EST_ALLOC (size_t, num_procs);
+  mpiret = sc_MPI_Alltoall (send_counts, (int) sizeof (size_t), sc_MPI_BYTE,
+                            recv_counts, (int) sizeof (size_t), sc_MPI_BYTE,
+                            mpicomm);
+  SC_CHECK_MPI (mpiret);
+  for (recv_total = 0, p = 0; p < num_procs; ++p) {
+    recv_total += recv_counts[p];
+  }
+  sorted = P4EST_ALLOC (p4est_quadrant_t, recv_total);
+  p4est_points_exchange (mpicomm, num_procs, rank,
+                         points, send_counts, sorted, recv_counts);
+  qsort (sorted, recv_total, qsize, p4est_quadrant_compare_piggy);
+
+  /* shift the sorted points to restore the original counts */
+  sorted_counts = P4EST_ALLOC (size_t, num_procs);
+  mpiret = sc_MPI_Allgather (&recv_total, (int) sizeof (size_t),
+                             sc_MPI_BYTE, sorted_counts,
+                             (int) sizeof (size_t), sc_MPI_BYTE, mpicomm);
+  SC_CHECK_MPI (mpiret);
+  for (first = 0, p = 0; p < rank; ++p) {
+    first += sorted_counts[p];
+  }
+  last = first + recv_total;
+  for (target = 0, p = 0; p < num_procs; ++p) {
+    begin = SC_MAX (first, target);
+    end = SC_MIN (last, target + nmemb[p]);
+    send_counts[p] = begin < end ? end - begin : 0;
+    target += nmemb[p];
+  }
+  for (target = 0, p = 0; p < rank; ++p) {
+    target += nmemb[p];
+  }
+  for (first = 0, p = 0; p < num_procs; ++p) {
+    begin = SC_MAX (first, target);
+    end = SC_MIN (first + sorted_counts[p], target + lcount);
+    recv_counts[p] = begin < end ? end - begin : 0;
+    first += sorted_counts[p];
+  }
+  p4est_points_exchange (mpicomm, num_procs, rank,
+                         sorted, send_counts, points, recv_counts);
+
+  P4EST_FREE (sorted_counts);
+  P4EST_FREE (sorted);
+  P4EST_FREE (recv_counts);
+  P4EST_FREE (send_counts);
+  P4EST_FREE (bounds);
+}
+
 static void
 p4est_points_init (p4est_t * p4est, p4est_topidx_t which_tree,
                    p4est_quadrant_t * quadrant)
@@ -147,8 +405,7 @@ p4est_new_points (sc_MPI_Comm mpicomm, p4est_connectivity_t * connectivity,
   mpiret = sc_MPI_Allgather (&lcount, isizet, sc_MPI_BYTE,
                              nmemb, isizet, sc_MPI_BYTE, mpicomm);
   SC_CHECK_MPI (mpiret);
-  sc_psort (mpicomm, points, nmemb, sizeof (p4est_quadrant_t),
-            p4est_quadrant_compare_piggy);
+  p4est_points_sort (mpicomm, points, nmemb);
   P4EST_FREE (nmemb);
 #ifdef P4EST_ENABLE_DEBUG
   first_quad = points;
@@ -393,3 +650,243 @@ p4est_new_points (sc_MPI_Comm mpicomm, p4est_connectivity_t * connectivity,
 
   return p4est;
 }
+
+static void
+p4est_points_stream_init (p4est_t * p4est, p4est_topidx_t which_tree,
+                          p4est_quadrant_t * quadrant)
+{
+  p4est_points_leaf_t *leaf = (p4est_points_leaf_t *) quadrant->p.user_data;
+
+  leaf->count = 0;
+  leaf->begin = leaf->end = 0;
+}
+
+static int
+p4est_points_stream_refine (p4est_t * p4est, p4est_topidx_t which_tree,
+                            p4est_quadrant_t * quadrant)
+{
+  p4est_points_stream_state_t *s =
+    (p4est_points_stream_state_t *) p4est->user_pointer;
+  p4est_points_leaf_t *leaf = (p4est_points_leaf_t *) quadrant->p.user_data;
+
+  return leaf->count + (leaf->end - leaf->begin) > s->max_points;
+}
+
+/** Distribute the points of a refined quadrant to its children.
+ * The points of the current chunk are assigned exactly.  The points of
+ * previous chunks are no longer available and are split evenly.
+ */
+static void
+p4est_points_stream_replace (p4est_t * p4est, p4est_topidx_t which_tree,
+                             int num_outgoing, p4est_quadrant_t * outgoing[],
+                             int num_incoming, p4est_quadrant_t * incoming[])
+{
+  p4est_points_stream_state_t *s =
+    (p4est_points_stream_state_t *) p4est->user_pointer;
+  p4est_points_leaf_t *parent, *child;
+  p4est_locidx_t      current;
+  int                 i;
+
+  P4EST_ASSERT (num_outgoing == 1 && num_incoming == P4EST_CHILDREN);
+
+  parent = (p4est_points_leaf_t *) outgoing[0]->p.user_data;
+  current = parent->begin;
+  for (i = 0; i < P4EST_CHILDREN; ++i) {
+    child = (p4est_points_leaf_t *) incoming[i]->p.user_data;
+    child->count = parent->count / P4EST_CHILDREN +
+      (i < (int) (parent->count % P4EST_CHILDREN));
+    child->begin = current;
+    while (current < parent->end &&
+           p4est_quadrant_contains_node (incoming[i], s->points + current)) {
+      ++current;
+    }
+    child->end = current;
+  }
+  P4EST_ASSERT (current == parent->end);
+}
+
+p4est_t            *
+p4est_new_points_stream (sc_MPI_Comm mpicomm,
+                         p4est_connectivity_t * connectivity, int maxlevel,
+                         p4est_points_read_t read_fn, void *reader,
+                         size_t chunk_size, p4est_locidx_t max_points,
+                         size_t data_size, p4est_init_t init_fn,
+                         void *user_pointer)
+{
+  int                 mpiret;
+  int                 num_procs, rank, p, owner, round;
+  size_t              zz, lcount, pending, recv_total, window;
+  size_t              first, offset, granted;
+  size_t             *send_counts, *recv_counts, *grant_counts;
+  long long           lcounts[2], gcounts[2];
+  p4est_gloidx_t      max_local, gtotal;
+  p4est_locidx_t      current;
+  p4est_topidx_t      jt;
+  p4est_quadrant_t   *chunk, *held, *points, *q, quad;
+  p4est_points_leaf_t *leaf;
+  p4est_points_stream_state_t state;
+  p4est_tree_t       *tree;
+  p4est_t            *p4est;
+
+  P4EST_GLOBAL_PRODUCTIONF ("Into " P4EST_STRING
+                            "_new_points_stream with max level %d"
+                            " max points %lld\n",
+                            maxlevel, (long long) max_points);
+  p4est_log_indent_push ();
+  P4EST_ASSERT (p4est_connectivity_is_valid (connectivity));
+  P4EST_ASSERT (0 <= maxlevel && maxlevel <= P4EST_QMAXLEVEL);
+  P4EST_ASSERT (max_points >= -1);
+  P4EST_ASSERT (chunk_size > 0);
+
+  mpiret = sc_MPI_Comm_size (mpicomm, &num_procs);
+  SC_CHECK_MPI (mpiret);
+  mpiret = sc_MPI_Comm_rank (mpicomm, &rank);
+  SC_CHECK_MPI (mpiret);
+
+  /* begin with one quadrant per tree that counts the points */
+  state.points = NULL;
+  state.max_points = max_points;
+  p4est = p4est_new_ext (mpicomm, connectivity, 0, 0, 1,
+                         sizeof (p4est_points_leaf_t),
+                         p4est_points_stream_init, &state);
+
+  /* the chunk holds the points held back and those read freshly */
+  chunk = P4EST_ALLOC (p4est_quadrant_t, chunk_size);
+  held = P4EST_ALLOC (p4est_quadrant_t, chunk_size);
+  points = P4EST_ALLOC (p4est_quadrant_t, chunk_size);
+  send_counts = P4EST_ALLOC (size_t, num_procs);
+  recv_counts = P4EST_ALLOC (size_t, num_procs);
+  grant_counts = P4EST_ALLOC (size_t, num_procs);
+  gtotal = 0;
+  pending = 0;
+  for (round = 0;; ++round) {
+    /* fill the chunk until all readers are exhausted */
+    lcount = pending;
+    if (lcount < chunk_size) {
+      lcount += read_fn (reader, chunk + pending, chunk_size - pending);
+    }
+    P4EST_ASSERT (pending <= lcount && lcount <= chunk_size);
+    lcounts[0] = (long long) lcount;
+    lcounts[1] = (long long) (lcount - pending);
+    mpiret = sc_MPI_Allreduce (lcounts, gcounts, 2, sc_MPI_LONG_LONG_INT,
+                               sc_MPI_SUM, mpicomm);
+    SC_CHECK_MPI (mpiret);
+    gtotal += gcounts[1];
+    if (gcounts[0] == 0) {
+      break;
+    }
+
+    /* request to send the points to the owners of their quadrants */
+    qsort (chunk, lcount, sizeof (p4est_quadrant_t),
+           p4est_quadrant_compare_piggy);
+    memset (send_counts, 0, num_procs * sizeof (size_t));
+    P4EST_QUADRANT_INIT (&quad);
+    for (owner = rank, zz = 0; zz < lcount; ++zz) {
+      q = chunk + zz;
+      P4EST_ASSERT (p4est_quadrant_is_node (q, 1));
+      P4EST_ASSERT (0 <= q->p.which_tree &&
+                    q->p.which_tree < connectivity->num_trees);
+      p4est_node_to_quadrant (q, P4EST_QMAXLEVEL, &quad);
+      owner = p4est_comm_find_owner (p4est, q->p.which_tree, &quad, owner);
+      ++send_counts[owner];
+    }
+    mpiret = sc_MPI_Alltoall (send_counts, (int) sizeof (size_t),
+                              sc_MPI_BYTE, recv_counts,
+                              (int) sizeof (size_t), sc_MPI_BYTE, mpicomm);
+    SC_CHECK_MPI (mpiret);
+
+    /* grant at most one chunk of points, beginning with a rotating sender */
+    for (recv_total = 0, p = 0; p < num_procs; ++p) {
+      owner = (p + round) % num_procs;
+      window = SC_MIN (recv_counts[owner], chunk_size - recv_total);
+      recv_counts[owner] = window;
+      recv_total += window;
+    }
+    mpiret = sc_MPI_Alltoall (recv_counts, (int) sizeof (size_t),
+                              sc_MPI_BYTE, grant_counts,
+                              (int) sizeof (size_t), sc_MPI_BYTE, mpicomm);
+    SC_CHECK_MPI (mpiret);
+
+    /* move the granted points to the front and hold back the others */
+    for (first = offset = pending = 0, p = 0; p < num_procs; ++p) {
+      granted = grant_counts[p];
+      P4EST_ASSERT (granted <= send_counts[p]);
+      memmove (chunk + offset, chunk + first,
+               granted * sizeof (p4est_quadrant_t));
+      memcpy (held + pending, chunk + first + granted,
+              (send_counts[p] - granted) * sizeof (p4est_quadrant_t));
+      pending += send_counts[p] - granted;
+      offset += granted;
+      first += send_counts[p];
+    }
+    P4EST_ASSERT (first == lcount && offset + pending == lcount);
+    p4est_points_exchange (mpicomm, num_procs, rank,
+                           chunk, grant_counts, points, recv_counts);
+    memcpy (chunk, held, pending * sizeof (p4est_quadrant_t));
+    qsort (points, recv_total, sizeof (p4est_quadrant_t),
+           p4est_quadrant_compare_piggy);
+
+    /* assign the received points to the local leaves */
+    current = 0;
+    for (jt = p4est->first_local_tree; jt <= p4est->last_local_tree; ++jt) {
+      tree = p4est_tree_array_index (p4est->trees, jt);
+      for (zz = 0; zz < tree->quadrants.elem_count; ++zz) {
+        q = p4est_quadrant_array_index (&tree->quadrants, zz);
+        leaf = (p4est_points_leaf_t *) q->p.user_data;
+        leaf->begin = current;
+        while ((size_t) current < recv_total &&
+               points[current].p.which_tree == jt &&
+               p4est_quadrant_contains_node (q, points + current)) {
+          ++current;
+        }
+        leaf->end = current;
+      }
+    }
+    P4EST_ASSERT ((size_t) current == recv_total);
+
+    /* refine where the counts exceed the maximum */
+    if (max_points >= 0) {
+      state.points = points;
+      p4est_refine_ext (p4est, 1, maxlevel, p4est_points_stream_refine,
+                        NULL, p4est_points_stream_replace);
+      state.points = NULL;
+    }
+
+    /* keep only the counts of the chunk */
+    for (jt = p4est->first_local_tree; jt <= p4est->last_local_tree; ++jt) {
+      tree = p4est_tree_array_index (p4est->trees, jt);
+      for (zz = 0; zz < tree->quadrants.elem_count; ++zz) {
+        q = p4est_quadrant_array_index (&tree->quadrants, zz);
+        leaf = (p4est_points_leaf_t *) q->p.user_data;
+        leaf->count += leaf->end - leaf->begin;
+        leaf->begin = leaf->end = 0;
+      }
+    }
+
+    /* repartition when the quadrants have become imbalanced */
+    for (max_local = 0, p = 0; p < num_procs; ++p) {
+      max_local = SC_MAX (max_local, p4est->global_first_quadrant[p + 1] -
+                          p4est->global_first_quadrant[p]);
+    }
+    if ((double) max_local >
+        P4EST_POINTS_IMBALANCE * p4est->global_num_quadrants / num_procs) {
+      p4est_partition (p4est, 0, NULL);
+    }
+  }
+  P4EST_FREE (grant_counts);
+  P4EST_FREE (recv_counts);
+  P4EST_FREE (send_counts);
+  P4EST_FREE (points);
+  P4EST_FREE (held);
+  P4EST_FREE (chunk);
+
+  /* initialize user pointer and data size */
+  p4est_reset_data (p4est, data_size, init_fn, user_pointer);
+
+  p4est_log_indent_pop ();
+  P4EST_GLOBAL_PRODUCTIONF ("Done " P4EST_STRING
+                            "_new_points_stream with %lld points"
+                            " %lld total quadrants\n", (long long) gtotal,
+                            (long long) p4est->global_num_quadrants);
+  return p4est;
+}
@@ -0,0 +1,526 @@
+/*
+  This file is part of p4est.
+  p4est is a C library to manage a collection (a forest) of multiple
+  connected adaptive quadtrees or octrees in parallel.
+
+  Copyright (C) 2010 The University of Texas System
+  Additional copyright (C) 2011 individual authors
+  Written by Carsten Burstedde, Lucas C. Wilcox, and Tobin Isaac
+
+  p4est is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  p4est is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with p4est; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*/
+
+#ifndef P4_TO_P8
+#include <p4est_bits.h>
+#include <p4est_query.h>
+#include <p4est_search.h>
+#else
+#include <p8est_bits.h>
+#include <p8est_query.h>
+#include <p8est_search.h>
+#endif
+
+/** Number of intervals per edge for sampling the image of a tree. */
+#define P4EST_QUERY_SAMPLES 4
+
+/** Number of intervals per edge for sampling the image of a quadrant. */
+#define P4EST_QUERY_QUADRANT_SAMPLES 2
+
+/** The state of a query that is shared by all query points. */
+typedef struct p4est_query_context
+{
+  p4est_t            *p4est;    /**< The forest being queried. */
+  p4est_geometry_t   *geom;     /**< The geometry, may be NULL. */
+  const double       *xyz;      /**< Coordinates of the query points. */
+  const double       *radius;   /**< Radii of the query points. */
+  double             *tree_bounds;      /**< Six bounds per local tree. */
+  sc_array_t         *hits;     /**< Results of a radius query. */
+  int                 k;        /**< Leaves per nearest neighbor query. */
+  int                *num_nearest;      /**< Leaves found per query. */
+  p4est_query_leaf_t *nearest;  /**< A max-heap of k leaves per query. */
+}
+p4est_query_context_t;
+
+/** A leaf found by a radius query. */
+typedef struct p4est_query_hit
+{
+  size_t              query;    /**< Index of the query point. */
+  p4est_query_leaf_t  leaf;     /**< The leaf and its distance. */
+}
+p4est_query_hit_t;
+
+/** Map a point in the reference coordinates of a tree to physical space.
+ * \param [in] ctx      The query context.
+ * \param [in] which_tree   The tree of the point.
+ * \param [in] abc      Reference coordinates in [0, 1]^3.
+ * \param [out] xyz     Physical coordinates.
+ */
+static void
+p4est_query_map (p4est_query_context_t * ctx, p4est_topidx_t which_tree,
+                 const double abc[3], double xyz[3])
+{
+  const double        rlen = (double) P4EST_ROOT_LEN;
+
+  if (ctx->geom != NULL) {
+    ctx->geom->X (ctx->geom, which_tree, abc, xyz);
+  }
+  else {
+    p4est_qcoord_to_vertex (ctx->p4est->connectivity, which_tree,
+                            (p4est_qcoord_t) (abc[0] * rlen),
+                            (p4est_qcoord_t) (abc[1] * rlen),
+#ifdef P4_TO_P8
+                            (p4est_qcoord_t) (abc[2] * rlen),
+#endif
+                            xyz);
+  }
+}
+
+/** Check whether a sample is used to bound the image of a quadrant.
+ * In 2D the image may be a curved surface in space whose interior bulges
+ * out beyond its edges, so all samples are used.  In 3D the image of the
+ * boundary bounds the image of a one-to-one map, so only the samples on
+ * the faces are used.
+ * \param [in] i        The grid index of the sample in each direction.
+ * \param [in] n        The number of intervals per edge.
+ * \param [in] skip     A direction that is not considered, or -1.
+ * \return              True if the sample is used.  In 3D it must be on a
+ *                      face normal to a direction other than \a skip.
+ */
+static int
+p4est_query_sample_used (const int i[3], int n, int skip)
+{
+#ifndef P4_TO_P8
+  return 1;
+#else
+  int                 j;
+
+  for (j = 0; j < P4EST_DIM; ++j) {
+    if (j != skip && (i[j] == 0 || i[j] == n)) {
+      return 1;
+    }
+  }
+  return 0;
+#endif
+}
+
+/** Compute a bounding box of the image of a quadrant from samples.
+ * The quadrant is sampled on a grid of n intervals per edge, in 3D only on
+ * its faces, see \ref p4est_query_sample_used.  Between the samples the
+ * image may bulge out by about one eighth of the second differences along
+ * the grid lines, so the box is padded by half of their largest magnitude.
+ * This is exact for multilinear maps and a safe bound for smooth
+ * geometries that the samples resolve.
+ * \param [in] ctx      The query context.
+ * \param [in] which_tree   The tree of the quadrant.
+ * \param [in] quad     The quadrant.
+ * \param [in] n        The number of intervals per edge, at least one.
+ * \param [out] bounds  Minimum and maximum for each physical coordinate.
+ */
+static void
+p4est_query_sample_bounds (p4est_query_context_t * ctx,
+                           p4est_topidx_t which_tree,
+                           const p4est_quadrant_t * quad, int n,
+                           double bounds[6])
+{
+  const double        rlen = (double) P4EST_ROOT_LEN;
+  const double        h = P4EST_QUADRANT_LEN (quad->level) / rlen / n;
+#ifndef P4_TO_P8
+  const int           nz = 0;
+#else
+  const int           nz = n;
+#endif
+  int                 i[3], j, l, first;
+  size_t              m, stride[3];
+  double              abc[3], d, pad[3];
+  double              xyz[(P4EST_QUERY_SAMPLES + 1) *
+                          (P4EST_QUERY_SAMPLES + 1) *
+                          (P4EST_QUERY_SAMPLES + 1)][3];
+
+  P4EST_ASSERT (1 <= n && n <= P4EST_QUERY_SAMPLES);
+  stride[0] = 1;
+  stride[1] = (size_t) (n + 1);
+  stride[2] = stride[1] * stride[1];
+
+  /* map the samples */
+  first = 1;
+  abc[2] = 0.;
+  for (i[2] = 0; i[2] <= nz; ++i[2]) {
+    for (i[1] = 0; i[1] <= n; ++i[1]) {
+      for (i[0] = 0; i[0] <= n; ++i[0]) {
+        if (!p4est_query_sample_used (i, n, -1)) {
+          continue;
+        }
+        m = i[0] * stride[0] + i[1] * stride[1] + i[2] * stride[2];
+        abc[0] = quad->x / rlen + i[0] * h;
+        abc[1] = quad->y / rlen + i[1] * h;
+#ifdef P4_TO_P8
+        abc[2] = quad->z / rlen + i[2] * h;
+#endif
+        p4est_query_map (ctx, which_tree, abc, xyz[m]);
+        for (l = 0; l < 3; ++l) {
+          if (first || xyz[m][l] < bounds[2 * l]) {
+            bounds[2 * l] = xyz[m][l];
+          }
+          if (first || xyz[m][l] > bounds[2 * l + 1]) {
+            bounds[2 * l + 1] = xyz[m][l];
+          }
+        }
+        first = 0;
+      }
+    }
+  }
+  if (n == 1) {
+    return;
+  }
+
+  /* pad the box by the second differences along the sampled lines */
+  pad[0] = pad[1] = pad[2] = 0.;
+  for (i[2] = 0; i[2] <= nz; ++i[2]) {
+    for (i[1] = 0; i[1] <= n; ++i[1]) {
+      for (i[0] = 0; i[0] <= n; ++i[0]) {
+        m = i[0] * stride[0] + i[1] * stride[1] + i[2] * stride[2];
+        for (j = 0; j < P4EST_DIM; ++j) {
+          if (i[j] == 0 || i[j] == n ||
+              !p4est_query_sample_used (i, n, j)) {
+            continue;
+          }
+          for (l = 0; l < 3; ++l) {
+            d = fabs (xyz[m - stride[j]][l] - 2. * xyz[m][l] +
+                      xyz[m + stride[j]][l]);
+            pad[l] = SC_MAX (pad[l], d);
+          }
+        }
+      }
+    }
+  }
+  for (l = 0; l < 3; ++l) {
+    bounds[2 * l] -= .5 * pad[l];
+    bounds[2 * l + 1] += .5 * pad[l];
+  }
+}
+
+/** Compute the bounding box of the image of a quadrant.
+ * Without a geometry the image is the multilinear interpolation of the
+ * tree vertices and bounded by its corners.  With a geometry, the image
+ * is sampled, see \ref p4est_query_sample_bounds.
+ * \param [in] ctx      The query context.
+ * \param [in] which_tree   The tree of the quadrant, must be local.
+ * \param [in] quad     The quadrant.
+ * \param [out] bounds  Minimum and maximum for each physical coordinate.
+ */
+static void
+p4est_query_bounds (p4est_query_context_t * ctx, p4est_topidx_t which_tree,
+                    const p4est_quadrant_t * quad, double bounds[6])
+{
+  /* the root is bounded by the precomputed tree bounds */
+  if (quad->level == 0) {
+    memcpy (bounds, ctx->tree_bounds +
+            6 * (which_tree - ctx->p4est->first_local_tree),
+            6 * sizeof (double));
+    return;
+  }
+  p4est_query_sample_bounds (ctx, which_tree, quad, ctx->geom != NULL ?
+                             P4EST_QUERY_QUADRANT_SAMPLES : 1, bounds);
+}
+
+/** Compute the bounding box of each local tree.
+ * With a geometry, the trees are sampled more finely than the quadrants.
+ */
+static void
+p4est_query_tree_bounds (p4est_query_context_t * ctx)
+{
+  const p4est_topidx_t first_tree = ctx->p4est->first_local_tree;
+  const p4est_topidx_t last_tree = ctx->p4est->last_local_tree;
+  p4est_topidx_t      jt;
+  p4est_quadrant_t    root;
+
+  P4EST_QUADRANT_INIT (&root);
+  p4est_quadrant_set_morton (&root, 0, 0);
+  ctx->tree_bounds = P4EST_ALLOC (double,
+                                  6 * SC_MAX (last_tree - first_tree + 1, 0));
+  for (jt = first_tree; jt <= last_tree; ++jt) {
+    p4est_query_sample_bounds (ctx, jt, &root, ctx->geom != NULL ?
+                               P4EST_QUERY_SAMPLES : 1,
+                               ctx->tree_bounds + 6 * (jt - first_tree));
+  }
+}
+
+/** Compute the distance between a point and a bounding box. */
+static double
+p4est_query_distance (const double bounds[6], const double xyz[3])
+{
+  int                 j;
+  double              d, dist2;
+
+  dist2 = 0.;
+  for (j = 0; j < 3; ++j) {
+    d = SC_MAX (bounds[2 * j] - xyz[j], xyz[j] - bounds[2 * j + 1]);
+    if (d > 0.) {
+      dist2 += d * d;
+    }
+  }
+  return sqrt (dist2);
+}
+
+/** Order leaves by distance and then by tree and number. */
+static int
+p4est_query_leaf_compare (const p4est_query_leaf_t * l1,
+                          const p4est_query_leaf_t * l2)
+{
+  if (l1->distance != l2->distance) {
+    return l1->distance < l2->distance ? -1 : 1;
+  }
+  if (l1->which_tree != l2->which_tree) {
+    return l1->which_tree < l2->which_tree ? -1 : 1;
+  }
+  return (l1->local_num > l2->local_num) - (l1->local_num < l2->local_num);
+}
+
+static int
+p4est_query_hit_compare (const void *v1, const void *v2)
+{
+  const p4est_query_hit_t *h1 = (const p4est_query_hit_t *) v1;
+  const p4est_query_hit_t *h2 = (const p4est_query_hit_t *) v2;
+
+  if (h1->query != h2->query) {
+    return h1->query < h2->query ? -1 : 1;
+  }
+  return p4est_query_leaf_compare (&h1->leaf, &h2->leaf);
+}
+
+static int
+p4est_query_leaf_compare_fn (const void *v1, const void *v2)
+{
+  return p4est_query_leaf_compare ((const p4est_query_leaf_t *) v1,
+                                   (const p4est_query_leaf_t *) v2);
+}
+
+/** Check all query points active for a quadrant against its bounding box.
+ * The box is computed once and shared by all points.
+ */
+static void
+p4est_query_radius_batch (p4est_t * p4est, p4est_topidx_t which_tree,
+                          p4est_quadrant_t * quadrant,
+                          p4est_locidx_t local_num, sc_array_t * points,
+                          const size_t * actives, size_t num_actives,
+                          int *matches)
+{
+  p4est_query_context_t *ctx = (p4est_query_context_t *) p4est->user_pointer;
+  size_t              zz, qz;
+  double              bounds[6], dist;
+  p4est_query_hit_t  *hit;
+
+  p4est_query_bounds (ctx, which_tree, quadrant, bounds);
+  for (zz = 0; zz < num_actives; ++zz) {
+    qz = actives[zz];
+    dist = p4est_query_distance (bounds, ctx->xyz + 3 * qz);
+    matches[zz] = dist <= ctx->radius[qz];
+    if (matches[zz] && local_num >= 0) {
+      hit = (p4est_query_hit_t *) sc_array_push (ctx->hits);
+      hit->query = qz;
+      hit->leaf.which_tree = which_tree;
+      hit->leaf.local_num = local_num;
+      hit->leaf.distance = dist;
+    }
+  }
+}
+
+void
+p4est_query_radius (p4est_t * p4est, p4est_geometry_t * geom,
+                    size_t num_queries, const double *xyz,
+                    const double *radius,
+                    sc_array_t * offsets, sc_array_t * leaves)
+{
+  void               *orig_user_pointer = p4est->user_pointer;
+  size_t              zz, qz, *poff;
+  p4est_query_context_t ctx;
+  p4est_query_hit_t  *hit;
+  sc_array_t          points;
+
+  P4EST_ASSERT (offsets->elem_size == sizeof (size_t));
+  P4EST_ASSERT (leaves->elem_size == sizeof (p4est_query_leaf_t));
+
+  ctx.p4est = p4est;
+  ctx.geom = geom;
+  ctx.xyz = xyz;
+  ctx.radius = radius;
+  ctx.hits = sc_array_new (sizeof (p4est_query_hit_t));
+  ctx.k = 0;
+  ctx.num_nearest = NULL;
+  ctx.nearest = NULL;
+  p4est_query_tree_bounds (&ctx);
+
+  /* one pass through the forest answers all queries */
+  sc_array_init_data (&points, (void *) xyz, 3 * sizeof (double),
+                      num_queries);
+  p4est->user_pointer = &ctx;
+  p4est_search_batch (p4est, NULL, p4est_query_radius_batch, &points);
+  p4est->user_pointer = orig_user_pointer;
+
+  /* order the leaves by query and distance */
+  sc_array_sort (ctx.hits, p4est_query_hit_compare);
+  sc_array_resize (offsets, num_queries + 1);
+  sc_array_resize (leaves, ctx.hits->elem_count);
+  poff = (size_t *) offsets->array;
+  for (qz = 0, zz = 0; zz < ctx.hits->elem_count; ++zz) {
+    hit = (p4est_query_hit_t *) sc_array_index (ctx.hits, zz);
+    while (qz <= hit->query) {
+      poff[qz++] = zz;
+    }
+    *(p4est_query_leaf_t *) sc_array_index (leaves, zz) = hit->leaf;
+  }
+  while (qz <= num_queries) {
+    poff[qz++] = ctx.hits->elem_count;
+  }
+
+  sc_array_destroy (ctx.hits);
+  P4EST_FREE (ctx.tree_bounds);
+}
+
+/** Add a leaf to the nearest leaves of a query if it is closer than them.
+ * The at most k leaves are kept in a binary max-heap ordered by
+ * \ref p4est_query_leaf_compare, so the farthest one is replaced.
+ * \param [in,out] best     The heap of the query with room for k leaves.
+ * \param [in,out] count    The number of leaves in the heap.
+ * \param [in] k            The number of leaves to find, at least one.
+ * \param [in] leaf         The candidate leaf.
+ */
+static void
+p4est_query_nearest_insert (p4est_query_leaf_t * best, int *count, int k,
+                            const p4est_query_leaf_t * leaf)
+{
+  int                 child, parent;
+
+  if (*count < k) {
+    /* sift the new leaf up */
+    for (child = (*count)++; child > 0; child = parent) {
+      parent = (child - 1) / 2;
+      if (p4est_query_leaf_compare (&best[parent], leaf) >= 0) {
+        break;
+      }
+      best[child] = best[parent];
+    }
+    best[child] = *leaf;
+    return;
+  }
+  if (p4est_query_leaf_compare (leaf, &best[0]) >= 0) {
+    /* the leaf is not closer than the farthest one found */
+    return;
+  }
+
+  /* replace the farthest leaf and sift down */
+  for (parent = 0; (child = 2 * parent + 1) < k; parent = child) {
+    if (child + 1 < k &&
+        p4est_query_leaf_compare (&best[child + 1], &best[child]) > 0) {
+      ++child;
+    }
+    if (p4est_query_leaf_compare (&best[child], leaf) <= 0) {
+      break;
+    }
+    best[parent] = best[child];
+  }
+  best[parent] = *leaf;
+}
+
+/** Update the nearest leaves of all query points active for a quadrant.
+ * The box is computed once and shared by all points.  A quadrant is only
+ * entered for the points to which it may hold a closer leaf.
+ */
+static void
+p4est_query_nearest_batch (p4est_t * p4est, p4est_topidx_t which_tree,
+                           p4est_quadrant_t * quadrant,
+                           p4est_locidx_t local_num, sc_array_t * points,
+                           const size_t * actives, size_t num_actives,
+                           int *matches)
+{
+  p4est_query_context_t *ctx = (p4est_query_context_t *) p4est->user_pointer;
+  const int           k = ctx->k;
+  size_t              zz, qz;
+  double              bounds[6];
+  p4est_query_leaf_t  leaf, *best;
+
+  p4est_query_bounds (ctx, which_tree, quadrant, bounds);
+  for (zz = 0; zz < num_actives; ++zz) {
+    qz = actives[zz];
+    best = ctx->nearest + (size_t) k * qz;
+    leaf.distance = p4est_query_distance (bounds, ctx->xyz + 3 * qz);
+    if (local_num < 0) {
+      matches[zz] = ctx->num_nearest[qz] < k ||
+        leaf.distance <= best[0].distance;
+    }
+    else {
+      leaf.which_tree = which_tree;
+      leaf.local_num = local_num;
+      p4est_query_nearest_insert (best, &ctx->num_nearest[qz], k, &leaf);
+    }
+  }
+}
+
+void
+p4est_query_nearest (p4est_t * p4est, p4est_geometry_t * geom,
+                     size_t num_queries, const double *xyz, int k,
+                     sc_array_t * offsets, sc_array_t * leaves)
+{
+  void               *orig_user_pointer = p4est->user_pointer;
+  size_t              qz, *poff;
+  p4est_query_context_t ctx;
+  sc_array_t          points, view;
+
+  P4EST_ASSERT (k >= 0);
+  P4EST_ASSERT (offsets->elem_size == sizeof (size_t));
+  P4EST_ASSERT (leaves->elem_size == sizeof (p4est_query_leaf_t));
+
+  sc_array_resize (offsets, num_queries + 1);
+  poff = (size_t *) offsets->array;
+  sc_array_truncate (leaves);
+  if (k == 0 || num_queries == 0) {
+    memset (poff, 0, (num_queries + 1) * sizeof (size_t));
+    return;
+  }
+
+  ctx.p4est = p4est;
+  ctx.geom = geom;
+  ctx.xyz = xyz;
+  ctx.radius = NULL;
+  ctx.hits = NULL;
+  ctx.k = k;
+  ctx.num_nearest = P4EST_ALLOC_ZERO (int, num_queries);
+  ctx.nearest = P4EST_ALLOC (p4est_query_leaf_t, (size_t) k * num_queries);
+  p4est_query_tree_bounds (&ctx);
+
+  /* one pass through the forest answers all queries */
+  sc_array_init_data (&points, (void *) xyz, 3 * sizeof (double),
+                      num_queries);
+  p4est->user_pointer = &ctx;
+  p4est_search_batch (p4est, NULL, p4est_query_nearest_batch, &points);
+  p4est->user_pointer = orig_user_pointer;
+
+  /* order the leaves of each query by distance */
+  for (qz = 0; qz < num_queries; ++qz) {
+    poff[qz] = leaves->elem_count;
+    sc_array_init_data (&view, ctx.nearest + (size_t) k * qz,
+                        sizeof (p4est_query_leaf_t),
+                        (size_t) ctx.num_nearest[qz]);
+    sc_array_sort (&view, p4est_query_leaf_compare_fn);
+    sc_array_resize (leaves, poff[qz] + view.elem_count);
+    memcpy (sc_array_index (leaves, poff[qz]), view.array,
+            view.elem_count * sizeof (p4est_query_leaf_t));
+  }
+  poff[num_queries] = leaves->elem_count;
+
+  P4EST_FREE (ctx.nearest);
+  P4EST_FREE (ctx.num_nearest);
+  P4EST_FREE (ctx.tree_bounds);
+}
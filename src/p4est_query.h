@@ -0,0 +1,112 @@
+/*
+  This file is part of p4est.
+  p4est is a C library to manage a collection (a forest) of multiple
+  connected adaptive quadtrees or octrees in parallel.
+
+  Copyright (C) 2010 The University of Texas System
+  Additional copyright (C) 2011 individual authors
+  Written by Carsten Burstedde, Lucas C. Wilcox, and Tobin Isaac
+
+  p4est is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  p4est is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with p4est; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*/
+
+/** \file p4est_query.h
+ *
+ * Radius and nearest neighbor queries for the leaves of a forest
+ *
+ * The queries are answered for the local leaves of a forest in physical
+ * space.  A leaf is represented by a bounding box of its image, and the
+ * distance between a point and a leaf is the distance to this box.
+ * Without a geometry, the image is interpolated from the vertices of the
+ * connectivity and the box of its mapped corners is exact.  With a
+ * geometry, each tree and quadrant is sampled on a grid, and the box of
+ * the samples is padded by half of their largest second difference along
+ * the grid lines to cover the image bulging out between them.  This box
+ * is exact for bilinear geometries and bounds the image of smooth
+ * geometries that are resolved by the samples.
+ *
+ * \ingroup p4est
+ */
+
+#ifndef P4EST_QUERY_H
+#define P4EST_QUERY_H
+
+#include <p4est_geometry.h>
+#include <p4est.h>
+
+SC_EXTERN_C_BEGIN;
+
+/** A leaf returned by a query. */
+typedef struct p4est_query_leaf
+{
+  p4est_topidx_t      which_tree;       /**< The tree of the leaf. */
+  p4est_locidx_t      local_num;        /**< Local number of the leaf. */
+  double              distance; /**< Distance from the query point. */
+}
+p4est_query_leaf_t;
+
+/** Find all local leaves within a distance of each of a set of points.
+ * The queries are answered in one pass through the forest with
+ * \ref p4est_search_batch, so the bounding box of each visited quadrant
+ * is computed only once for all nearby query points.
+ * \param [in] p4est        The forest to query.  Its user_pointer is
+ *                          used during the call and restored on return.
+ * \param [in] geom         Geometry of the forest or NULL.
+ * \param [in] num_queries  Number of query points.
+ * \param [in] xyz          Three physical coordinates for each query.
+ * \param [in] radius       The query radius of each point.
+ * \param [in,out] offsets  Array of size_t resized to \b num_queries + 1.
+ *                          The results of query i are the entries from
+ *                          offsets[i] to offsets[i + 1] - 1 of \b leaves.
+ * \param [in,out] leaves   Array of p4est_query_leaf_t that is resized to
+ *                          hold the results, sorted by increasing distance
+ *                          for each query.
+ */
+void                p4est_query_radius (p4est_t * p4est,
+                                        p4est_geometry_t * geom,
+                                        size_t num_queries,
+                                        const double *xyz,
+                                        const double *radius,
+                                        sc_array_t * offsets,
+                                        sc_array_t * leaves);
+
+/** Find the k nearest local leaves to each of a set of points.
+ * The queries are answered in one pass through the forest with
+ * \ref p4est_search_batch.  Each query keeps the k nearest leaves found so
+ * far, and a quadrant is only entered for the queries to which it may
+ * hold a closer leaf.  Ties in distance are broken by tree and number.
+ * \param [in] p4est        The forest to query.  Its user_pointer is
+ *                          used during the call and restored on return.
+ * \param [in] geom         Geometry of the forest or NULL.
+ * \param [in] num_queries  Number of query points.
+ * \param [in] xyz          Three physical coordinates for each query.
+ * \param [in] k            Number of leaves to find for each query.
+ *                          Fewer are returned if there are less local leaves.
+ * \param [in,out] offsets  Array of size_t resized to \b num_queries + 1,
+ *                          see \ref p4est_query_radius.
+ * \param [in,out] leaves   Array of p4est_query_leaf_t that is resized to
+ *                          hold the results, sorted by increasing distance
+ *                          for each query.
+ */
+void                p4est_query_nearest (p4est_t * p4est,
+                                         p4est_geometry_t * geom,
+                                         size_t num_queries,
+                                         const double *xyz, int k,
+                                         sc_array_t * offsets,
+                                         sc_array_t * leaves);
+
+SC_EXTERN_C_END;
+
+#endif /* !P4EST_QUERY_H */
@@ -0,0 +1,462 @@
+/*
+  This file is part of p4est.
+  p4est is a C library to manage a collection (a forest) of multiple
+  connected adaptive quadtrees or octrees in parallel.
+
+  Copyright (C) 2010 The University of Texas System
+  Additional copyright (C) 2011 individual authors
+  Written by Carsten Burstedde, Lucas C. Wilcox, and Tobin Isaac
+
+  p4est is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  p4est is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with p4est; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*/
+
+#ifndef P4_TO_P8
+#include <p4est_bits.h>
+#include <p4est_communication.h>
+#include <p4est_ray.h>
+#include <p4est_search.h>
+#else
+#include <p8est_bits.h>
+#include <p8est_communication.h>
+#include <p8est_ray.h>
+#include <p8est_search.h>
+#endif
+#include <sc_notify.h>
+
+/** A ray to be handed off to another process. */
+typedef struct p4est_ray_send
+{
+  int                 rank;     /**< The receiving process. */
+  p4est_ray_t         ray;      /**< The current state of the ray. */
+}
+p4est_ray_send_t;
+
+/** The state of a traversal that is shared by all rays. */
+typedef struct p4est_ray_context
+{
+  p4est_t            *p4est;    /**< The forest being traversed. */
+  p4est_ghost_t      *ghost;    /**< The ghost layer, may be NULL. */
+  sc_array_t         *leaves;   /**< The leaves crossed on this process. */
+  sc_array_t         *outgoing; /**< Rays to be handed off. */
+}
+p4est_ray_context_t;
+
+static int
+p4est_ray_send_compare (const void *v1, const void *v2)
+{
+  const p4est_ray_send_t *s1 = (const p4est_ray_send_t *) v1;
+  const p4est_ray_send_t *s2 = (const p4est_ray_send_t *) v2;
+
+  return (s1->rank > s2->rank) - (s1->rank < s2->rank);
+}
+
+/** Compute the smallest quadrant that a ray enters at a point.
+ * On each axis the point is assigned to the cell that the ray moves into.
+ * \param [in] x        Point in the reference coordinates of a tree.
+ * \param [in] d        Direction of the ray.
+ * \param [out] probe   The quadrant of level P4EST_QMAXLEVEL that the
+ *                      ray enters if it is inside the tree.
+ * \return              -1 if the ray stays inside the tree, or else the
+ *                      first tree face that it crosses.
+ */
+static int
+p4est_ray_probe (const double x[], const double d[],
+                 p4est_quadrant_t * probe)
+{
+  const double        ncells = (double) (1 << P4EST_QMAXLEVEL);
+  const p4est_qcoord_t h = P4EST_QUADRANT_LEN (P4EST_QMAXLEVEL);
+  int                 i;
+  double              u, c;
+  p4est_qcoord_t      coords[P4EST_DIM];
+
+  for (i = 0; i < P4EST_DIM; ++i) {
+    u = x[i] * ncells;
+    c = d[i] < 0. ? ceil (u) - 1. : floor (u);
+    if (c < 0.) {
+      return 2 * i;
+    }
+    if (c >= ncells) {
+      return 2 * i + 1;
+    }
+    coords[i] = h * (p4est_qcoord_t) c;
+  }
+
+  P4EST_QUADRANT_INIT (probe);
+  probe->x = coords[0];
+  probe->y = coords[1];
+#ifdef P4_TO_P8
+  probe->z = coords[2];
+#endif
+  probe->level = P4EST_QMAXLEVEL;
+  P4EST_ASSERT (p4est_quadrant_is_valid (probe));
+
+  return -1;
+}
+
+/** Move a point and direction across a tree face into the neighbor tree.
+ * This applies the transformation of p4est_quadrant_transform_face to
+ * continuous reference coordinates.
+ * \param [in] conn     The connectivity of the forest.
+ * \param [in] which_tree   The tree that the ray leaves.
+ * \param [in] face     The face that the ray leaves through.
+ * \param [in,out] x    Point in the tree, on output in the neighbor tree.
+ * \param [in,out] d    Direction in the tree, on output in the neighbor.
+ * \return              The neighbor tree, or -1 at the domain boundary.
+ */
+static              p4est_topidx_t
+p4est_ray_cross_face (p4est_connectivity_t * conn,
+                      p4est_topidx_t which_tree, int face,
+                      double x[], double d[])
+{
+  int                 ftransform[P4EST_FTRANSFORM];
+  const int          *my_axis = &ftransform[0];
+  const int          *target_axis = &ftransform[3];
+  const int          *edge_reverse = &ftransform[6];
+  int                 i;
+  double              nx[3], nd[3];
+  p4est_topidx_t      ntree;
+
+  ntree = p4est_find_face_transform (conn, which_tree, face, ftransform);
+  if (ntree < 0) {
+    return -1;
+  }
+
+  nx[2] = nd[2] = 0.;
+  for (i = 0; i < P4EST_DIM - 1; ++i) {
+    nx[target_axis[i]] =
+      !edge_reverse[i] ? x[my_axis[i]] : 1. - x[my_axis[i]];
+    nd[target_axis[i]] = !edge_reverse[i] ? d[my_axis[i]] : -d[my_axis[i]];
+  }
+  switch (edge_reverse[2]) {
+  case 0:
+    nx[target_axis[2]] = -x[my_axis[2]];
+    nd[target_axis[2]] = -d[my_axis[2]];
+    break;
+  case 1:
+    nx[target_axis[2]] = x[my_axis[2]] + 1.;
+    nd[target_axis[2]] = d[my_axis[2]];
+    break;
+  case 2:
+    nx[target_axis[2]] = x[my_axis[2]] - 1.;
+    nd[target_axis[2]] = d[my_axis[2]];
+    break;
+  case 3:
+    nx[target_axis[2]] = 2. - x[my_axis[2]];
+    nd[target_axis[2]] = -d[my_axis[2]];
+    break;
+  default:
+    SC_ABORT_NOT_REACHED ();
+  }
+  for (i = 0; i < 3; ++i) {
+    x[i] = nx[i];
+    d[i] = nd[i];
+  }
+
+  return ntree;
+}
+
+/** Find the leaf that contains a quadrant of maximum level.
+ * \param [in] ctx      The traversal context.
+ * \param [in] which_tree   The tree of the quadrant.
+ * \param [in] probe    Quadrant of level P4EST_QMAXLEVEL.
+ * \param [out] leaf    The local leaf or ghost containing \b probe,
+ *                      or NULL if it is owned by another process.
+ * \param [out] num     Its local number, or the number of local quadrants
+ *                      plus the ghost index, or -1.
+ * \return              -1 if the leaf was found, or else the owner rank.
+ */
+static int
+p4est_ray_find_leaf (p4est_ray_context_t * ctx, p4est_topidx_t which_tree,
+                     const p4est_quadrant_t * probe,
+                     p4est_quadrant_t ** leaf, p4est_locidx_t * num)
+{
+  p4est_t            *p4est = ctx->p4est;
+  ssize_t             result;
+  p4est_tree_t       *tree;
+  p4est_quadrant_t   *q;
+  int                 owner;
+
+  *leaf = NULL;
+  *num = -1;
+
+  /* look for a local leaf */
+  if (p4est->first_local_tree <= which_tree &&
+      which_tree <= p4est->last_local_tree) {
+    tree = p4est_tree_array_index (p4est->trees, which_tree);
+    result = p4est_find_higher_bound (&tree->quadrants, probe,
+                                      tree->quadrants.elem_count / 2);
+    if (result >= 0) {
+      q = p4est_quadrant_array_index (&tree->quadrants, (size_t) result);
+      if (p4est_quadrant_is_equal (q, probe) ||
+          p4est_quadrant_is_ancestor (q, probe)) {
+        *leaf = q;
+        *num = tree->quadrants_offset + (p4est_locidx_t) result;
+        return -1;
+      }
+    }
+  }
+
+  /* look for a ghost leaf */
+  if (ctx->ghost != NULL) {
+    result = p4est_ghost_contains (ctx->ghost, -1, which_tree, probe);
+    if (result >= 0) {
+      *leaf = p4est_quadrant_array_index (&ctx->ghost->ghosts,
+                                          (size_t) result);
+      *num = p4est->local_num_quadrants + (p4est_locidx_t) result;
+      return -1;
+    }
+  }
+
+  /* the leaf is owned by another process */
+  owner = p4est_comm_find_owner (p4est, which_tree, probe, p4est->mpirank);
+  P4EST_ASSERT (owner != p4est->mpirank);
+  return owner;
+}
+
+/** March one ray through the leaves known to this process.
+ * The crossed leaves are appended to the context.  If the ray enters a
+ * leaf of another process, it is appended to the outgoing rays.
+ * \param [in] ctx      The traversal context.
+ * \param [in] start    The ray in its current state.
+ */
+static void
+p4est_ray_march (p4est_ray_context_t * ctx, const p4est_ray_t * start)
+{
+  const double        rlen = (double) P4EST_ROOT_LEN;
+  int                 i, k, face, axis, owner;
+  double              x[3], d[3], s, tau, ti, len;
+  double              lo[P4EST_DIM], hi[P4EST_DIM];
+  p4est_topidx_t      jt;
+  p4est_locidx_t      num;
+  p4est_quadrant_t    probe, *leaf;
+  p4est_ray_leaf_t   *rl;
+  p4est_ray_send_t   *send;
+
+  jt = start->which_tree;
+  for (i = 0; i < 3; ++i) {
+    x[i] = start->origin[i];
+    d[i] = start->direction[i];
+  }
+  s = start->tmin;
+#ifndef P4_TO_P8
+  x[2] = d[2] = 0.;
+#endif
+  P4EST_ASSERT (d[0] != 0. || d[1] != 0. || d[2] != 0.);
+
+  while (s < start->tmax) {
+    /* find the cell the ray enters, crossing at most one face per axis */
+    for (k = 0;; ++k) {
+      face = p4est_ray_probe (x, d, &probe);
+      if (face < 0) {
+        break;
+      }
+      if (k == P4EST_DIM) {
+        return;
+      }
+      jt = p4est_ray_cross_face (ctx->p4est->connectivity, jt, face, x, d);
+      if (jt < 0) {
+        /* the ray leaves the domain */
+        return;
+      }
+    }
+
+    /* find the leaf or hand the ray off to its owner */
+    owner = p4est_ray_find_leaf (ctx, jt, &probe, &leaf, &num);
+    if (owner >= 0) {
+      send = (p4est_ray_send_t *) sc_array_push (ctx->outgoing);
+      send->rank = owner;
+      send->ray = *start;
+      send->ray.which_tree = jt;
+      for (i = 0; i < 3; ++i) {
+        send->ray.origin[i] = x[i];
+        send->ray.direction[i] = d[i];
+      }
+      send->ray.tmin = s;
+      return;
+    }
+
+    /* compute the parameter where the ray exits the leaf */
+    len = P4EST_QUADRANT_LEN (leaf->level) / rlen;
+    lo[0] = leaf->x / rlen;
+    lo[1] = leaf->y / rlen;
+#ifdef P4_TO_P8
+    lo[2] = leaf->z / rlen;
+#endif
+    tau = -1.;
+    axis = -1;
+    for (i = 0; i < P4EST_DIM; ++i) {
+      hi[i] = lo[i] + len;
+      if (d[i] == 0.) {
+        continue;
+      }
+      ti = ((d[i] > 0. ? hi[i] : lo[i]) - x[i]) / d[i];
+      if (axis == -1 || ti < tau) {
+        tau = ti;
+        axis = i;
+      }
+    }
+    P4EST_ASSERT (axis >= 0);
+    tau = SC_MAX (tau, 0.);
+
+    /* record the leaf, skipping crossings of zero length */
+    if (s + tau > s) {
+      rl = (p4est_ray_leaf_t *) sc_array_push (ctx->leaves);
+      rl->id = start->id;
+      rl->which_tree = jt;
+      rl->local_num = num;
+      rl->entry = s;
+      rl->exit = SC_MIN (s + tau, start->tmax);
+    }
+
+    /* move to the exit point, keeping it on the boundary of the leaf */
+    for (i = 0; i < P4EST_DIM; ++i) {
+      x[i] = SC_MIN (SC_MAX (x[i] + tau * d[i], lo[i]), hi[i]);
+    }
+    x[axis] = d[axis] > 0. ? hi[axis] : lo[axis];
+    s += tau;
+  }
+}
+
+/** Send the outgoing rays to their new owners in one batch.
+ * \param [in] p4est    The forest.
+ * \param [in] outgoing Array of p4est_ray_send_t; sorted on output.
+ * \return              A new array of the received p4est_ray_t.
+ */
+static sc_array_t  *
+p4est_ray_exchange (p4est_t * p4est, sc_array_t * outgoing)
+{
+  const int           mpisize = p4est->mpisize;
+  const size_t        esize = sizeof (p4est_ray_t);
+  int                 mpiret;
+  int                 i, num_receivers, num_senders;
+  int                 byte_count;
+  int                *receivers, *senders;
+  size_t              zz, zoff, *offsets;
+  p4est_ray_t        *sendbuf;
+  p4est_ray_send_t   *send;
+  sc_array_t         *incoming;
+  sc_MPI_Request     *requests;
+  sc_MPI_Status       status;
+
+  /* pack the rays in order of the receiving process */
+  sc_array_sort (outgoing, p4est_ray_send_compare);
+  receivers = P4EST_ALLOC (int, mpisize);
+  offsets = P4EST_ALLOC (size_t, mpisize + 1);
+  sendbuf = P4EST_ALLOC (p4est_ray_t, outgoing->elem_count);
+  num_receivers = 0;
+  for (zz = 0; zz < outgoing->elem_count; ++zz) {
+    send = (p4est_ray_send_t *) sc_array_index (outgoing, zz);
+    P4EST_ASSERT (send->rank != p4est->mpirank);
+    if (num_receivers == 0 || receivers[num_receivers - 1] != send->rank) {
+      receivers[num_receivers] = send->rank;
+      offsets[num_receivers++] = zz;
+    }
+    sendbuf[zz] = send->ray;
+  }
+  offsets[num_receivers] = outgoing->elem_count;
+
+  /* post the messages to the other processes */
+  requests = P4EST_ALLOC (sc_MPI_Request, num_receivers);
+  for (i = 0; i < num_receivers; ++i) {
+    mpiret = sc_MPI_Isend (sendbuf + offsets[i],
+                           (int) ((offsets[i + 1] - offsets[i]) * esize),
+                           sc_MPI_BYTE, receivers[i], P4EST_COMM_RAY,
+                           p4est->mpicomm, requests + i);
+    SC_CHECK_MPI (mpiret);
+  }
+
+  /* find the processes that send to us and receive their rays */
+  senders = P4EST_ALLOC (int, mpisize);
+  mpiret = sc_notify (receivers, num_receivers, senders, &num_senders,
+                      p4est->mpicomm);
+  SC_CHECK_MPI (mpiret);
+  incoming = sc_array_new (esize);
+  for (i = 0; i < num_senders; ++i) {
+    mpiret = sc_MPI_Probe (senders[i], P4EST_COMM_RAY, p4est->mpicomm,
+                           &status);
+    SC_CHECK_MPI (mpiret);
+    mpiret = sc_MPI_Get_count (&status, sc_MPI_BYTE, &byte_count);
+    SC_CHECK_MPI (mpiret);
+    P4EST_ASSERT (byte_count > 0 && byte_count % esize == 0);
+    zoff = incoming->elem_count;
+    sc_array_resize (incoming, zoff + (size_t) byte_count / esize);
+    mpiret = sc_MPI_Recv (sc_array_index (incoming, zoff), byte_count,
+                          sc_MPI_BYTE, senders[i], P4EST_COMM_RAY,
+                          p4est->mpicomm, sc_MPI_STATUS_IGNORE);
+    SC_CHECK_MPI (mpiret);
+  }
+
+  /* complete the sends and clean up */
+  if (num_receivers > 0) {
+    mpiret = sc_MPI_Waitall (num_receivers, requests,
+                             sc_MPI_STATUSES_IGNORE);
+    SC_CHECK_MPI (mpiret);
+  }
+  P4EST_FREE (requests);
+  P4EST_FREE (senders);
+  P4EST_FREE (sendbuf);
+  P4EST_FREE (offsets);
+  P4EST_FREE (receivers);
+
+  return incoming;
+}
+
+sc_array_t         *
+p4est_ray_traverse (p4est_t * p4est, p4est_ghost_t * ghost,
+                    sc_array_t * rays)
+{
+  int                 mpiret;
+  int                 num_rounds;
+  size_t              zz;
+  p4est_gloidx_t      local_moving, global_moving;
+  p4est_ray_context_t ctx;
+  sc_array_t         *queue, *incoming;
+
+  P4EST_ASSERT (rays->elem_size == sizeof (p4est_ray_t));
+  P4EST_ASSERT (ghost == NULL ||
+                ghost->mpisize == p4est->mpisize);
+
+  ctx.p4est = p4est;
+  ctx.ghost = ghost;
+  ctx.leaves = sc_array_new (sizeof (p4est_ray_leaf_t));
+  ctx.outgoing = sc_array_new (sizeof (p4est_ray_send_t));
+
+  /* march the rays and hand them off in rounds until all have ended */
+  queue = rays;
+  for (num_rounds = 1;; ++num_rounds) {
+    for (zz = 0; zz < queue->elem_count; ++zz) {
+      p4est_ray_march (&ctx, (p4est_ray_t *) sc_array_index (queue, zz));
+    }
+    if (queue != rays) {
+      sc_array_destroy (queue);
+    }
+
+    local_moving = (p4est_gloidx_t) ctx.outgoing->elem_count;
+    mpiret = sc_MPI_Allreduce (&local_moving, &global_moving, 1,
+                               P4EST_MPI_GLOIDX, sc_MPI_SUM, p4est->mpicomm);
+    SC_CHECK_MPI (mpiret);
+    if (global_moving == 0) {
+      break;
+    }
+    incoming = p4est_ray_exchange (p4est, ctx.outgoing);
+    sc_array_truncate (ctx.outgoing);
+    queue = incoming;
+  }
+  P4EST_GLOBAL_INFOF ("Done " P4EST_STRING "_ray_traverse with %d rounds\n",
+                      num_rounds);
+
+  sc_array_destroy (ctx.outgoing);
+  return ctx.leaves;
+}
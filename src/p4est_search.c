@@ -31,6 +31,10 @@
 #include <p8est_communication.h>
 #include <p8est_search.h>
 #endif
+#include <sc_notify.h>
+#ifdef SC_ENABLE_OPENMP
+#include <omp.h>
+#endif
 
 ssize_t
 p4est_find_lower_bound (sc_array_t * array,
@@ -452,96 +456,526 @@ find_range_boundaries_exit:
   return touch;
 }
 
-/** This recursion context saves on the number of parameters passed. */
+/** One level of the explicit stack of the search traversal. */
+typedef struct p4est_search_level
+{
+  p4est_quadrant_t    quadrant;         /**< Branch quadrant of this level. */
+  size_t              split[P4EST_CHILDREN + 1];        /**< Child offsets. */
+  int                 child;            /**< Next child to visit. */
+  size_t              act_begin;        /**< First active point of branch. */
+  size_t              act_end;          /**< After last active point. */
+}
+p4est_search_level_t;
+
+/** This traversal context saves on the number of parameters passed.
+ * The active points of all levels are stored consecutively in one buffer
+ * that is reused throughout the search.
+ */
 typedef struct p4est_search_recursion
 {
   p4est_t            *p4est;            /**< Forest being traversed. */
   p4est_topidx_t      which_tree;       /**< Current tree number. */
+  p4est_tree_t       *tree;             /**< Current tree. */
   p4est_search_query_t search_quadrant_fn;      /**< The quadrant callback. */
   p4est_search_query_t search_point_fn;         /**< The point callback. */
+  p4est_search_batch_t search_batch_fn;         /**< The batch callback. */
   sc_array_t         *points;           /**< Array of points to search. */
+  size_t             *actives;          /**< Stack of active point indices. */
+  size_t              num_actives;      /**< Used entries of the stack. */
+  size_t              alloc_actives;    /**< Allocated entries. */
+  int                *matches;          /**< Results of batch callback. */
+  int                 depth;            /**< Number of levels in use. */
+  p4est_search_level_t levels[P4EST_QMAXLEVEL + 1];     /**< Branches. */
 }
 p4est_search_recursion_t;
 
+/** Push an active point index, growing the buffer if necessary.
+ * Threads may search concurrently, so the reallocation is serialized.
+ */
+static inline void
+p4est_search_push_active (p4est_search_recursion_t * rec, size_t pz)
+{
+  if (rec->num_actives == rec->alloc_actives) {
+    rec->alloc_actives = SC_MAX (2 * rec->alloc_actives, 8);
+#ifdef SC_ENABLE_OPENMP
+#pragma omp critical (p4est_search_alloc)
+#endif
+    rec->actives = P4EST_REALLOC (rec->actives, size_t, rec->alloc_actives);
+  }
+  rec->actives[rec->num_actives++] = pz;
+}
+
+/** Visit a quadrant of the traversal.
+ * If the traversal is to continue below the quadrant, a new level is pushed
+ * onto the stack, and the indices of the points that remain active are
+ * appended to the buffer of active points.
+ * \param [in] quadrant     The quadrant to visit.  It may be overwritten.
+ * \param [in] qbegin       First quadrant below \b quadrant in the tree.
+ * \param [in] qend         After last quadrant below \b quadrant.
+ * \param [in] act_begin    First active point in the buffer.
+ * \param [in] act_end      After last active point in the buffer.
+ */
 static void
-p4est_search_recursion (const p4est_search_recursion_t * rec,
-                        p4est_quadrant_t * quadrant,
-                        sc_array_t * quadrants, sc_array_t * actives)
+p4est_search_visit (p4est_search_recursion_t * rec,
+                    const p4est_quadrant_t * quadrant,
+                    size_t qbegin, size_t qend,
+                    size_t act_begin, size_t act_end)
 {
-  const size_t        qcount = quadrants->elem_count;
+  sc_array_t         *tquadrants = &rec->tree->quadrants;
+  const size_t        qcount = qend - qbegin;
   int                 i;
   int                 is_leaf, is_match;
-  size_t              zz, *pz, *qz;
-  size_t              split[P4EST_CHILDREN + 1];
+  size_t              zz, pz, chbegin;
   p4est_locidx_t      local_num;
-  p4est_quadrant_t   *q, *lq, child;
-  sc_array_t          child_quadrants, child_actives, *chact;
+  p4est_quadrant_t   *q, *lq, *quad;
+  p4est_search_level_t *level;
+  sc_array_t          view;
 
   /*
-   * Invariants of the recursion:
-   * 1. quadrant is larger or equal in size than those in the array.
-   * 2. quadrant is equal to or an ancestor of those in the array.
+   * Invariants of the traversal:
+   * 1. quadrant is larger or equal in size than those in the range.
+   * 2. quadrant is equal to or an ancestor of those in the range.
    */
 
-  P4EST_ASSERT ((rec->points == NULL) == (actives == NULL));
-  P4EST_ASSERT (rec->points == NULL ||
-                actives->elem_count <= rec->points->elem_count);
+  P4EST_ASSERT (act_begin <= act_end && act_end <= rec->num_actives);
+  P4EST_ASSERT (rec->depth <= P4EST_QMAXLEVEL);
 
   /* return if there are no quadrants or active points */
-  if (qcount == 0 || (rec->points != NULL && actives->elem_count == 0))
+  if (qcount == 0 || (rec->points != NULL && act_begin == act_end))
     return;
 
+  /* the branch quadrant is stored in the next free level */
+  level = &rec->levels[rec->depth];
+
   /* determine leaf situation */
-  q = p4est_quadrant_array_index (quadrants, 0);
+  q = p4est_quadrant_array_index (tquadrants, qbegin);
   if (qcount > 1) {
     P4EST_ASSERT (p4est_quadrant_is_ancestor (quadrant, q));
     is_leaf = 0;
     local_num = -1;
-    lq = p4est_quadrant_array_index (quadrants, quadrants->elem_count - 1);
+    lq = p4est_quadrant_array_index (tquadrants, qend - 1);
     P4EST_ASSERT (!p4est_quadrant_is_equal (q, lq) &&
                   p4est_quadrant_is_ancestor (quadrant, lq));
 
     /* skip unnecessary intermediate levels if possible */
+    quad = &level->quadrant;
     if (p4est_quadrant_ancestor_id (q, quadrant->level + 1) ==
         p4est_quadrant_ancestor_id (lq, quadrant->level + 1)) {
-      p4est_nearest_common_ancestor (q, lq, quadrant);
-      P4EST_ASSERT (p4est_quadrant_is_ancestor (quadrant, q));
-      P4EST_ASSERT (p4est_quadrant_is_ancestor (quadrant, lq));
+      p4est_nearest_common_ancestor (q, lq, quad);
+      P4EST_ASSERT (p4est_quadrant_is_ancestor (quad, q));
+      P4EST_ASSERT (p4est_quadrant_is_ancestor (quad, lq));
+    }
+    else if (quad != quadrant) {
+      *quad = *quadrant;
     }
   }
   else {
-    p4est_locidx_t      offset;
-    p4est_tree_t       *tree;
-
     P4EST_ASSERT (p4est_quadrant_is_equal (quadrant, q) ||
                   p4est_quadrant_is_ancestor (quadrant, q));
     is_leaf = 1;
 
     /* determine offset of quadrant in local forest */
-    tree = p4est_tree_array_index (rec->p4est->trees, rec->which_tree);
-    offset = (p4est_locidx_t) ((quadrants->array - tree->quadrants.array)
-                               / sizeof (p4est_quadrant_t));
-    P4EST_ASSERT (offset >= 0 &&
-                  (size_t) offset < tree->quadrants.elem_count);
-    local_num = tree->quadrants_offset + offset;
+    local_num = rec->tree->quadrants_offset + (p4est_locidx_t) qbegin;
 
     /* skip unnecessary intermediate levels if possible */
-    quadrant = q;
+    quad = q;
   }
 
-  /* execute quadrant callback if present, which may stop the recursion */
+  /* execute quadrant callback if present, which may stop the traversal */
   if (rec->search_quadrant_fn != NULL &&
       !rec->search_quadrant_fn (rec->p4est, rec->which_tree,
-                                quadrant, local_num, NULL)) {
+                                quad, local_num, NULL)) {
     return;
   }
 
   /* check out points */
+  chbegin = rec->num_actives;
   if (rec->points == NULL) {
     /* we have called the callback already.  For leafs we are done */
     if (is_leaf) {
       return;
     }
+  }
+  else {
+    /* query callback for all points and return if none remain */
+    if (rec->search_batch_fn != NULL) {
+      rec->search_batch_fn (rec->p4est, rec->which_tree, quad, local_num,
+                            rec->points, rec->actives + act_begin,
+                            act_end - act_begin, rec->matches);
+      if (!is_leaf) {
+        for (zz = act_begin; zz < act_end; ++zz) {
+          if (rec->matches[zz - act_begin]) {
+            p4est_search_push_active (rec, rec->actives[zz]);
+          }
+        }
+      }
+    }
+    else {
+      for (zz = act_begin; zz < act_end; ++zz) {
+        pz = rec->actives[zz];
+        is_match = rec->search_point_fn (rec->p4est, rec->which_tree,
+                                         quad, local_num,
+                                         sc_array_index (rec->points, pz));
+        if (!is_leaf && is_match) {
+          p4est_search_push_active (rec, pz);
+        }
+      }
+    }
+    if (rec->num_actives == chbegin) {
+      return;
+    }
+  }
+
+  /* leaf situation has returned above */
+  P4EST_ASSERT (!is_leaf);
+
+  /* split quadrant range and push a new level */
+  sc_array_init_view (&view, tquadrants, qbegin, qcount);
+  p4est_split_array (&view, (int) quad->level, level->split);
+  for (i = 0; i <= P4EST_CHILDREN; ++i) {
+    level->split[i] += qbegin;
+  }
+  level->child = 0;
+  level->act_begin = chbegin;
+  level->act_end = rec->num_actives;
+  ++rec->depth;
+}
+
+/** Run the traversal of one tree with an explicit stack. */
+static void
+p4est_search_tree (p4est_search_recursion_t * rec,
+                   const p4est_quadrant_t * root, size_t num_points)
+{
+  int                 i;
+  p4est_quadrant_t    child;
+  p4est_search_level_t *level;
+
+  P4EST_ASSERT (rec->depth == 0);
+  p4est_search_visit (rec, root, 0, rec->tree->quadrants.elem_count,
+                      0, num_points);
+  while (rec->depth > 0) {
+    level = &rec->levels[rec->depth - 1];
+
+    /* find the next child that contains quadrants */
+    for (i = level->child; i < P4EST_CHILDREN; ++i) {
+      if (level->split[i] < level->split[i + 1]) {
+        break;
+      }
+    }
+    if (i == P4EST_CHILDREN) {
+      /* this level is done: release its active points */
+      rec->num_actives = level->act_begin;
+      --rec->depth;
+      continue;
+    }
+    level->child = i + 1;
+    p4est_quadrant_child (&level->quadrant, &child, i);
+    p4est_search_visit (rec, &child, level->split[i], level->split[i + 1],
+                        level->act_begin, level->act_end);
+  }
+}
+
+/** Return the number of the calling thread. */
+static inline int
+p4est_search_thread_num (void)
+{
+#ifdef SC_ENABLE_OPENMP
+  return omp_get_thread_num ();
+#else
+  return 0;
+#endif
+}
+
+/** Search one local tree with a contiguous range of points.
+ * \param [in] rec         Traversal context owned by the calling thread.
+ * \param [in] which_tree  The local tree to search.
+ * \param [in] pbegin      First point of the range.
+ * \param [in] pend        After last point of the range.
+ */
+static void
+p4est_search_task (p4est_search_recursion_t * rec,
+                   p4est_topidx_t which_tree, size_t pbegin, size_t pend)
+{
+  size_t              zz;
+  p4est_quadrant_t    root;
+  p4est_quadrant_t   *f, *l;
+  sc_array_t         *tquadrants;
+
+  rec->which_tree = which_tree;
+
+  /* grab complete tree quadrant array */
+  rec->tree = p4est_tree_array_index (rec->p4est->trees, which_tree);
+  tquadrants = &rec->tree->quadrants;
+
+  /* find the smallest quadrant that contains all of this tree */
+  f = p4est_quadrant_array_index (tquadrants, 0);
+  l = p4est_quadrant_array_index (tquadrants, tquadrants->elem_count - 1);
+  p4est_nearest_common_ancestor (f, l, &root);
+
+  /* list the active points; the buffer holds at least the range */
+  P4EST_ASSERT (pend - pbegin <= rec->alloc_actives);
+  for (zz = pbegin; zz < pend; ++zz) {
+    rec->actives[zz - pbegin] = zz;
+  }
+  rec->num_actives = pend - pbegin;
+
+  /* perform top-down search */
+  p4est_search_tree (rec, &root, pend - pbegin);
+  P4EST_ASSERT (rec->num_actives == pend - pbegin);
+}
+
+/** Search the local forest with either per-point or batch point callbacks.
+ * The work is split into tasks of one local tree and one chunk of points
+ * each, which are distributed over \b num_threads threads if enabled.
+ */
+static void
+p4est_search_internal (p4est_t * p4est, int num_threads,
+                       p4est_search_query_t search_quadrant_fn,
+                       p4est_search_query_t search_point_fn,
+                       p4est_search_batch_t search_batch_fn,
+                       sc_array_t * points)
+{
+  int                 t;
+  int                 num_chunks;
+  long                task, num_tasks, num_local_trees;
+  size_t              num_points, chunk_size, pbegin, pend;
+  p4est_search_recursion_t *recs, *rec;
+
+  /* correct call convention? */
+  P4EST_ASSERT (p4est != NULL);
+  P4EST_ASSERT (points == NULL || search_point_fn != NULL ||
+                search_batch_fn != NULL);
+
+  /* we do nothing if there is nothing we can do */
+  if (search_quadrant_fn == NULL && points == NULL) {
+    return;
+  }
+  num_local_trees =
+    (long) p4est->last_local_tree - (long) p4est->first_local_tree + 1;
+  if (num_local_trees <= 0) {
+    return;
+  }
+
+  /* determine the number of threads and point chunks */
+#ifdef SC_ENABLE_OPENMP
+  if (num_threads <= 0) {
+    num_threads = omp_get_max_threads ();
+  }
+#else
+  num_threads = 1;
+#endif
+  num_threads = SC_MAX (num_threads, 1);
+  num_points = points == NULL ? 0 : points->elem_count;
+  num_chunks = (int) SC_MIN ((size_t) num_threads, SC_MAX (num_points, 1));
+  chunk_size = (num_points + num_chunks - 1) / num_chunks;
+  num_tasks = num_local_trees * num_chunks;
+
+  /* set traversal contexts; the level stack is too large for the C stack */
+  recs = P4EST_ALLOC (p4est_search_recursion_t, num_threads);
+  for (t = 0; t < num_threads; ++t) {
+    rec = recs + t;
+    rec->p4est = p4est;
+    rec->which_tree = -1;
+    rec->tree = NULL;
+    rec->search_quadrant_fn = search_quadrant_fn;
+    rec->search_point_fn = search_point_fn;
+    rec->search_batch_fn = search_batch_fn;
+    rec->points = points;
+    rec->depth = 0;
+    rec->num_actives = 0;
+    rec->alloc_actives = chunk_size;
+    rec->actives = P4EST_ALLOC (size_t, rec->alloc_actives);
+    rec->matches = search_batch_fn == NULL ? NULL :
+      P4EST_ALLOC (int, chunk_size);
+  }
+
+  /* each task searches one tree with one chunk of points */
+#ifdef SC_ENABLE_OPENMP
+#pragma omp parallel for num_threads (num_threads) schedule (dynamic) \
+  private (pbegin, pend)
+#endif
+  for (task = 0; task < num_tasks; ++task) {
+    pbegin = (size_t) (task % num_chunks) * chunk_size;
+    pend = SC_MIN (pbegin + chunk_size, num_points);
+    p4est_search_task (recs + p4est_search_thread_num (),
+                       p4est->first_local_tree +
+                       (p4est_topidx_t) (task / num_chunks),
+                       SC_MIN (pbegin, pend), pend);
+  }
+
+  /* clean up after the tree loop */
+  for (t = 0; t < num_threads; ++t) {
+    P4EST_FREE (recs[t].matches);
+    P4EST_FREE (recs[t].actives);
+  }
+  P4EST_FREE (recs);
+}
+
+void
+p4est_search (p4est_t * p4est, p4est_search_query_t search_quadrant_fn,
+              p4est_search_query_t search_point_fn, sc_array_t * points)
+{
+  P4EST_ASSERT (points == NULL || search_point_fn != NULL);
+
+  p4est_search_internal (p4est, 1, search_quadrant_fn, search_point_fn,
+                         NULL, points);
+}
+
+void
+p4est_search_batch (p4est_t * p4est, p4est_search_query_t search_quadrant_fn,
+                    p4est_search_batch_t search_batch_fn, sc_array_t * points)
+{
+  P4EST_ASSERT (points == NULL || search_batch_fn != NULL);
+
+  p4est_search_internal (p4est, 1, search_quadrant_fn, NULL,
+                         search_batch_fn, points);
+}
+
+void
+p4est_search_threads (p4est_t * p4est, int num_threads,
+                      p4est_search_query_t search_quadrant_fn,
+                      p4est_search_query_t search_point_fn,
+                      sc_array_t * points)
+{
+  P4EST_ASSERT (points == NULL || search_point_fn != NULL);
+
+  p4est_search_internal (p4est, num_threads, search_quadrant_fn,
+                         search_point_fn, NULL, points);
+}
+
+/** This recursion context saves on the number of parameters passed. */
+typedef struct p4est_search_partition_recursion
+{
+  p4est_t            *p4est;            /**< Forest being traversed. */
+  p4est_topidx_t      which_tree;       /**< Current tree number. */
+  p4est_search_partition_t quadrant_fn;         /**< The quadrant callback. */
+  p4est_search_partition_t point_fn;    /**< The point callback. */
+  p4est_traverse_query_t traverse_fn;   /**< The traversal callback. */
+  sc_array_t         *points;           /**< Array of points to search. */
+  sc_array_t         *routes;           /**< If not NULL, record matches. */
+}
+p4est_search_partition_recursion_t;
+
+/** A point matched with a single process in the partition search. */
+typedef struct p4est_search_route
+{
+  int                 rank;
+  size_t              index;
+}
+p4est_search_route_t;
+
+static int
+p4est_search_route_compare (const void *v1, const void *v2)
+{
+  const p4est_search_route_t *r1 = (const p4est_search_route_t *) v1;
+  const p4est_search_route_t *r2 = (const p4est_search_route_t *) v2;
+
+  if (r1->rank != r2->rank) {
+    return r1->rank < r2->rank ? -1 : 1;
+  }
+  return (r1->index > r2->index) - (r1->index < r2->index);
+}
+
+/** Find the last process whose first position is not larger than a given
+ * position.  This process is not empty.
+ * \param [in] lo       A process whose first position is known to be less
+ *                      or equal to the given position.
+ * \param [in] hi       The result is not larger than this process.
+ * \param [in] which_tree   Tree of the position.
+ * \param [in] q        Position as a quadrant of level P4EST_QMAXLEVEL.
+ */
+static int
+p4est_search_partition_owner (p4est_t * p4est, int lo, int hi,
+                              p4est_topidx_t which_tree,
+                              const p4est_quadrant_t * q)
+{
+  int                 guess;
+  const p4est_quadrant_t *pos;
+
+  P4EST_ASSERT (0 <= lo && lo <= hi && hi < p4est->mpisize);
+  P4EST_ASSERT (q->level == P4EST_QMAXLEVEL);
+
+  while (lo < hi) {
+    guess = lo + (hi - lo + 1) / 2;
+    pos = &p4est->global_first_position[guess];
+    if (pos->p.which_tree < which_tree ||
+        (pos->p.which_tree == which_tree &&
+         p4est_quadrant_compare (pos, q) <= 0)) {
+      lo = guess;
+    }
+    else {
+      hi = guess - 1;
+    }
+  }
+  return lo;
+}
+
+/** Find the range of processes whose partition overlaps a quadrant.
+ * \param [in] lo       A process whose first position is known to be less
+ *                      or equal to the first descendant of \b quadrant.
+ * \param [in] hi       The last process that may overlap \b quadrant.
+ */
+static void
+p4est_search_partition_range (p4est_t * p4est, int lo, int hi,
+                              p4est_topidx_t which_tree,
+                              const p4est_quadrant_t * quadrant,
+                              int *pfirst, int *plast)
+{
+  p4est_quadrant_t    desc;
+
+  p4est_quadrant_first_descendant (quadrant, &desc, P4EST_QMAXLEVEL);
+  *pfirst = p4est_search_partition_owner (p4est, lo, hi, which_tree, &desc);
+  p4est_quadrant_last_descendant (quadrant, &desc, P4EST_QMAXLEVEL);
+  *plast = p4est_search_partition_owner (p4est, *pfirst, hi,
+                                         which_tree, &desc);
+}
+
+static void
+p4est_search_partition_recursion (const p4est_search_partition_recursion_t
+                                  * rec, p4est_quadrant_t * quadrant,
+                                  int pfirst, int plast,
+                                  sc_array_t * actives)
+{
+  int                 i;
+  int                 cfirst, clast;
+  int                 is_match;
+  size_t              zz, *pz, *qz;
+  p4est_quadrant_t    child;
+  sc_array_t          child_actives, *chact;
+  p4est_search_route_t *route;
+
+  /*
+   * Invariants of the recursion:
+   * 1. The processes pfirst and plast are not empty.
+   * 2. The partition of the processes pfirst to plast covers the quadrant.
+   */
+
+  P4EST_ASSERT ((rec->points == NULL) == (actives == NULL));
+  P4EST_ASSERT (0 <= pfirst && pfirst <= plast &&
+                plast < rec->p4est->mpisize);
+
+  /* return if there are no active points */
+  if (rec->points != NULL && actives->elem_count == 0)
+    return;
+
+  /* execute quadrant callback if present, which may stop the recursion */
+  if (rec->quadrant_fn != NULL &&
+      !rec->quadrant_fn (rec->p4est, rec->which_tree,
+                         quadrant, pfirst, plast, NULL)) {
+    return;
+  }
+  if (rec->traverse_fn != NULL &&
+      !rec->traverse_fn (rec->p4est, rec->which_tree,
+                         quadrant, pfirst, plast)) {
+    return;
+  }
+
+  /* check out points */
+  if (rec->points == NULL) {
+    /* we have called the callback already.  For single processes we are done */
+    if (pfirst == plast) {
+      return;
+    }
     chact = NULL;
   }
   else {
@@ -550,67 +984,76 @@ p4est_search_recursion (const p4est_search_recursion_t * rec,
     sc_array_init (chact, sizeof (size_t));
     for (zz = 0; zz < actives->elem_count; ++zz) {
       pz = (size_t *) sc_array_index (actives, zz);
-      is_match = rec->search_point_fn (rec->p4est, rec->which_tree,
-                                       quadrant, local_num,
-                                       sc_array_index (rec->points, *pz));
-      if (!is_leaf && is_match) {
+      is_match = rec->point_fn (rec->p4est, rec->which_tree, quadrant,
+                                pfirst, plast,
+                                sc_array_index (rec->points, *pz));
+      if (!is_match) {
+        continue;
+      }
+      if (pfirst < plast) {
         qz = (size_t *) sc_array_push (chact);
         *qz = *pz;
       }
+      else if (rec->routes != NULL) {
+        route = (p4est_search_route_t *) sc_array_push (rec->routes);
+        route->rank = pfirst;
+        route->index = *pz;
+      }
     }
     if (chact->elem_count == 0) {
+      sc_array_reset (chact);
       return;
     }
   }
 
-  /* leaf situation has returned above */
-  P4EST_ASSERT (!is_leaf);
+  /* the single process situation has returned above */
+  P4EST_ASSERT (pfirst < plast);
+  P4EST_ASSERT (quadrant->level < P4EST_QMAXLEVEL);
 
-  /* split quadrant array and run recursion */
-  p4est_split_array (quadrants, (int) quadrant->level, split);
+  /* determine the processes of each child and run recursion */
+  cfirst = pfirst;
   for (i = 0; i < P4EST_CHILDREN; ++i) {
     p4est_quadrant_child (quadrant, &child, i);
-    if (split[i] < split[i + 1]) {
-      sc_array_init_view (&child_quadrants, quadrants,
-                          split[i], split[i + 1] - split[i]);
-      p4est_search_recursion (rec, &child, &child_quadrants, chact);
-      sc_array_reset (&child_quadrants);
-    }
+    p4est_search_partition_range (rec->p4est, cfirst, plast,
+                                  rec->which_tree, &child, &cfirst, &clast);
+    p4est_search_partition_recursion (rec, &child, cfirst, clast, chact);
+    cfirst = clast;
   }
   if (chact != NULL) {
     sc_array_reset (chact);
   }
 }
 
-void
-p4est_search (p4est_t * p4est, p4est_search_query_t search_quadrant_fn,
-              p4est_search_query_t search_point_fn, sc_array_t * points)
+/** Run the partition search and optionally record the matching processes.
+ */
+static void
+p4est_search_partition_internal (p4est_t * p4est,
+                                 p4est_traverse_query_t traverse_fn,
+                                 p4est_search_partition_t quadrant_fn,
+                                 p4est_search_partition_t point_fn,
+                                 sc_array_t * points, sc_array_t * routes)
 {
+  int                 pfirst, plast;
   p4est_topidx_t      jt;
-  p4est_tree_t       *tree;
   p4est_quadrant_t    root;
-  p4est_quadrant_t   *f, *l;
-  p4est_search_recursion_t srec, *rec = &srec;
+  p4est_search_partition_recursion_t srec, *rec = &srec;
   sc_array_t          actives, *acts;
-  sc_array_t         *tquadrants;
   size_t              zz, *pz;
 
   /* correct call convention? */
   P4EST_ASSERT (p4est != NULL);
-  P4EST_ASSERT (points == NULL || search_point_fn != NULL);
+  P4EST_ASSERT (points == NULL || point_fn != NULL);
 
   /* we do nothing if there is nothing we can do */
-  if (search_quadrant_fn == NULL && points == NULL) {
+  if (traverse_fn == NULL && quadrant_fn == NULL && points == NULL) {
     return;
   }
 
   /* prepare start of recursion by listing the active points */
   if (points == NULL) {
-    /* we ignore the points logic completely */
     acts = NULL;
   }
   else {
-    /* mark all input points as active */
     acts = &actives;
     sc_array_init_size (acts, sizeof (size_t), points->elem_count);
     for (zz = 0; zz < acts->elem_count; ++zz) {
@@ -622,23 +1065,22 @@ p4est_search (p4est_t * p4est, p4est_search_query_t search_quadrant_fn,
   /* set recursion context */
   rec->p4est = p4est;
   rec->which_tree = -1;
-  rec->search_quadrant_fn = search_quadrant_fn;
-  rec->search_point_fn = search_point_fn;
+  rec->quadrant_fn = quadrant_fn;
+  rec->point_fn = point_fn;
+  rec->traverse_fn = traverse_fn;
   rec->points = points;
-  for (jt = p4est->first_local_tree; jt <= p4est->last_local_tree; ++jt) {
+  rec->routes = routes;
+  P4EST_QUADRANT_INIT (&root);
+  p4est_quadrant_set_morton (&root, 0, 0);
+  pfirst = 0;
+  for (jt = 0; jt < p4est->connectivity->num_trees; ++jt) {
     rec->which_tree = jt;
 
-    /* grab complete tree quadrant array */
-    tree = p4est_tree_array_index (p4est->trees, jt);
-    tquadrants = &tree->quadrants;
-
-    /* find the smallest quadrant that contains all of this tree */
-    f = p4est_quadrant_array_index (tquadrants, 0);
-    l = p4est_quadrant_array_index (tquadrants, tquadrants->elem_count - 1);
-    p4est_nearest_common_ancestor (f, l, &root);
-
-    /* perform top-down search */
-    p4est_search_recursion (rec, &root, tquadrants, acts);
+    /* the processes of consecutive trees are non-decreasing */
+    p4est_search_partition_range (p4est, pfirst, p4est->mpisize - 1,
+                                  jt, &root, &pfirst, &plast);
+    p4est_search_partition_recursion (rec, &root, pfirst, plast, acts);
+    pfirst = plast;
   }
 
   /* clean up after the tree loop */
@@ -647,3 +1089,347 @@ p4est_search (p4est_t * p4est, p4est_search_query_t search_quadrant_fn,
     sc_array_reset (acts);
   }
 }
+
+void
+p4est_search_partition (p4est_t * p4est,
+                        p4est_search_partition_t quadrant_fn,
+                        p4est_search_partition_t point_fn,
+                        sc_array_t * points)
+{
+  p4est_search_partition_internal (p4est, NULL, quadrant_fn, point_fn,
+                                   points, NULL);
+}
+
+void
+p4est_traverse (p4est_t * p4est, p4est_traverse_query_t traverse_fn)
+{
+  p4est_search_partition_internal (p4est, traverse_fn, NULL, NULL, NULL,
+                                   NULL);
+}
+
+sc_array_t         *
+p4est_search_partition_route (p4est_t * p4est,
+                              p4est_search_partition_t point_fn,
+                              sc_array_t * points, sc_array_t * sources)
+{
+  const int           mpisize = p4est->mpisize;
+  const int           mpirank = p4est->mpirank;
+  const size_t        esize = points->elem_size;
+  int                 mpiret;
+  int                 i, num_receivers, num_senders;
+  int                 self_index;
+  int                 byte_count;
+  int                *receivers, *senders;
+  size_t              zz, zoff, *offsets;
+  char               *sendbuf;
+  sc_array_t         *routes, *result;
+  sc_array_t         *requests;
+  sc_MPI_Request     *request;
+  sc_MPI_Status       status;
+  p4est_search_route_t *route;
+
+  P4EST_ASSERT (point_fn != NULL);
+  P4EST_ASSERT (sources == NULL || sources->elem_size == sizeof (int));
+
+  /* match the points with the processes and order them by rank;
+   * a point may match several branches of the same process */
+  routes = sc_array_new (sizeof (p4est_search_route_t));
+  p4est_search_partition_internal (p4est, NULL, NULL, point_fn, points,
+                                   routes);
+  sc_array_sort (routes, p4est_search_route_compare);
+  sc_array_uniq (routes, p4est_search_route_compare);
+
+  /* pack the points in order of the receiving process */
+  receivers = P4EST_ALLOC (int, mpisize);
+  offsets = P4EST_ALLOC (size_t, mpisize + 1);
+  sendbuf = P4EST_ALLOC (char, routes->elem_count * esize);
+  num_receivers = 0;
+  for (zz = 0; zz < routes->elem_count; ++zz) {
+    route = (p4est_search_route_t *) sc_array_index (routes, zz);
+    if (num_receivers == 0 || receivers[num_receivers - 1] != route->rank) {
+      receivers[num_receivers] = route->rank;
+      offsets[num_receivers++] = zz;
+    }
+    memcpy (sendbuf + zz * esize, sc_array_index (points, route->index),
+            esize);
+  }
+  offsets[num_receivers] = routes->elem_count;
+
+  /* post the messages to the other processes */
+  self_index = -1;
+  requests = sc_array_new (sizeof (sc_MPI_Request));
+  for (i = 0; i < num_receivers; ++i) {
+    if (receivers[i] == mpirank) {
+      self_index = i;
+      continue;
+    }
+    request = (sc_MPI_Request *) sc_array_push (requests);
+    mpiret = sc_MPI_Isend (sendbuf + offsets[i] * esize,
+                           (int) ((offsets[i + 1] - offsets[i]) * esize),
+                           sc_MPI_BYTE, receivers[i],
+                           P4EST_COMM_SEARCH_ROUTE, p4est->mpicomm, request);
+    SC_CHECK_MPI (mpiret);
+  }
+
+  /* find the processes that send to us; the result is sorted */
+  senders = P4EST_ALLOC (int, mpisize);
+  if (self_index >= 0) {
+    memmove (receivers + self_index, receivers + self_index + 1,
+             (num_receivers - self_index - 1) * sizeof (int));
+  }
+  mpiret = sc_notify (receivers, num_receivers - (self_index >= 0),
+                      senders, &num_senders, p4est->mpicomm);
+  SC_CHECK_MPI (mpiret);
+  if (self_index >= 0) {
+    /* the current process is treated like any other sender */
+    for (i = num_senders; i > 0 && senders[i - 1] > mpirank; --i) {
+      senders[i] = senders[i - 1];
+    }
+    senders[i] = mpirank;
+    ++num_senders;
+  }
+
+  /* receive the points in order of the sending process */
+  result = sc_array_new (esize);
+  if (sources != NULL) {
+    sc_array_truncate (sources);
+  }
+  for (i = 0; i < num_senders; ++i) {
+    zoff = result->elem_count;
+    if (senders[i] == mpirank) {
+      zz = offsets[self_index + 1] - offsets[self_index];
+      sc_array_resize (result, zoff + zz);
+      memcpy (sc_array_index (result, zoff),
+              sendbuf + offsets[self_index] * esize, zz * esize);
+    }
+    else {
+      mpiret = sc_MPI_Probe (senders[i], P4EST_COMM_SEARCH_ROUTE,
+                             p4est->mpicomm, &status);
+      SC_CHECK_MPI (mpiret);
+      mpiret = sc_MPI_Get_count (&status, sc_MPI_BYTE, &byte_count);
+      SC_CHECK_MPI (mpiret);
+      P4EST_ASSERT (byte_count > 0 && byte_count % esize == 0);
+      sc_array_resize (result, zoff + (size_t) byte_count / esize);
+      mpiret = sc_MPI_Recv (sc_array_index (result, zoff), byte_count,
+                            sc_MPI_BYTE, senders[i], P4EST_COMM_SEARCH_ROUTE,
+                            p4est->mpicomm, sc_MPI_STATUS_IGNORE);
+      SC_CHECK_MPI (mpiret);
+    }
+    if (sources != NULL) {
+      for (zz = zoff; zz < result->elem_count; ++zz) {
+        *(int *) sc_array_push (sources) = senders[i];
+      }
+    }
+  }
+
+  /* complete the sends and clean up */
+  if (requests->elem_count > 0) {
+    mpiret = sc_MPI_Waitall ((int) requests->elem_count,
+                             (sc_MPI_Request *) requests->array,
+                             sc_MPI_STATUSES_IGNORE);
+    SC_CHECK_MPI (mpiret);
+  }
+  sc_array_destroy (requests);
+  P4EST_FREE (senders);
+  P4EST_FREE (sendbuf);
+  P4EST_FREE (offsets);
+  P4EST_FREE (receivers);
+  sc_array_destroy (routes);
+
+  return result;
+}
+
+/** Sort key of a point for p4est_locate_points. */
+typedef struct p4est_locate_key
+{
+  uint64_t            key;      /**< Morton index at P4EST_QMAXLEVEL */
+  size_t              index;    /**< Position in the input point array */
+}
+p4est_locate_key_t;
+
+/** Number of bits of a Morton index at level P4EST_QMAXLEVEL. */
+#define P4EST_LOCATE_KEY_BITS (P4EST_DIM * P4EST_QMAXLEVEL)
+
+/** Number of bits sorted in one radix pass. */
+#define P4EST_LOCATE_RADIX_BITS 8
+
+/** Number of radix passes needed to sort a Morton index. */
+#define P4EST_LOCATE_RADIX_PASSES \
+  ((P4EST_LOCATE_KEY_BITS + P4EST_LOCATE_RADIX_BITS - 1) / \
+   P4EST_LOCATE_RADIX_BITS)
+
+/** Number of histogram entries needed by p4est_locate_radix_sort. */
+#define P4EST_LOCATE_RADIX_HIST \
+  (P4EST_LOCATE_RADIX_PASSES << P4EST_LOCATE_RADIX_BITS)
+
+/** Stable least-significant-digit radix sort of keys by Morton index.
+ * \param [in,out] keys     Array of \b n keys, sorted on output.
+ * \param [in,out] buffer   Work array of \b n keys.
+ * \param [in] n            Number of keys.
+ * \param [out] hist        Work array of P4EST_LOCATE_RADIX_HIST entries.
+ */
+static void
+p4est_locate_radix_sort (p4est_locate_key_t * keys,
+                         p4est_locate_key_t * buffer, size_t n, size_t *hist)
+{
+  const int           nbuckets = 1 << P4EST_LOCATE_RADIX_BITS;
+  const uint64_t      mask = (uint64_t) nbuckets - 1;
+  int                 pass, d;
+  size_t              zz, sum, count;
+  size_t             *h;
+  p4est_locate_key_t *src, *dest, *swap;
+
+  if (n == 0) {
+    return;
+  }
+
+  /* compute the histograms of all passes in one sweep */
+  memset (hist, 0, P4EST_LOCATE_RADIX_HIST * sizeof (size_t));
+  for (zz = 0; zz < n; ++zz) {
+    for (pass = 0; pass < P4EST_LOCATE_RADIX_PASSES; ++pass) {
+      d = (int) ((keys[zz].key >> (pass * P4EST_LOCATE_RADIX_BITS)) & mask);
+      ++hist[pass * nbuckets + d];
+    }
+  }
+
+  src = keys;
+  dest = buffer;
+  for (pass = 0; pass < P4EST_LOCATE_RADIX_PASSES; ++pass) {
+    h = hist + pass * nbuckets;
+
+    /* a pass where all keys share the same digit does not change the order */
+    d = (int) ((src[0].key >> (pass * P4EST_LOCATE_RADIX_BITS)) & mask);
+    if (h[d] == n) {
+      continue;
+    }
+
+    /* turn the histogram into bucket offsets and scatter */
+    for (sum = 0, d = 0; d < nbuckets; ++d) {
+      count = h[d];
+      h[d] = sum;
+      sum += count;
+    }
+    for (zz = 0; zz < n; ++zz) {
+      d = (int) ((src[zz].key >> (pass * P4EST_LOCATE_RADIX_BITS)) & mask);
+      dest[h[d]++] = src[zz];
+    }
+    swap = src;
+    src = dest;
+    dest = swap;
+  }
+  if (src != keys) {
+    memcpy (keys, src, n * sizeof (p4est_locate_key_t));
+  }
+}
+
+void
+p4est_locate_points (p4est_t * p4est, sc_array_t * points,
+                     sc_array_t * locations)
+{
+  const p4est_topidx_t first_tree = p4est->first_local_tree;
+  const p4est_topidx_t last_tree = p4est->last_local_tree;
+  int                 shift;
+  size_t              zz, num_points, num_local, *tree_offsets, *hist;
+  size_t              qz, qcount;
+  uint64_t            qfirst, qlast;
+  p4est_topidx_t      jt;
+  p4est_locidx_t     *loc;
+  p4est_quadrant_t   *point, *quad, node;
+  p4est_locate_key_t *keys, *buffer, *tkeys;
+  p4est_tree_t       *tree;
+
+  P4EST_ASSERT (points->elem_size == sizeof (p4est_quadrant_t));
+  P4EST_ASSERT (locations->elem_size == sizeof (p4est_locidx_t));
+
+  num_points = points->elem_count;
+  sc_array_resize (locations, num_points);
+  if (num_points == 0) {
+    return;
+  }
+  loc = (p4est_locidx_t *) locations->array;
+
+  /* bucket the points of local trees by tree, the others are not found */
+  tree_offsets = P4EST_ALLOC_ZERO (size_t, last_tree - first_tree + 2);
+  for (zz = 0; zz < num_points; ++zz) {
+    point = p4est_quadrant_array_index (points, zz);
+    P4EST_ASSERT (p4est_quadrant_is_node (point, 1));
+    jt = point->p.which_tree;
+    P4EST_ASSERT (0 <= jt && jt < p4est->connectivity->num_trees);
+    loc[zz] = -1;
+    if (first_tree <= jt && jt <= last_tree) {
+      ++tree_offsets[jt - first_tree + 1];
+    }
+  }
+  for (jt = first_tree; jt <= last_tree; ++jt) {
+    tree_offsets[jt - first_tree + 1] += tree_offsets[jt - first_tree];
+  }
+  num_local = first_tree <= last_tree ?
+    tree_offsets[last_tree - first_tree + 1] : 0;
+  if (num_local == 0) {
+    P4EST_FREE (tree_offsets);
+    return;
+  }
+
+  /* compute the Morton index of each point at the finest quadrant level */
+  keys = P4EST_ALLOC (p4est_locate_key_t, num_local);
+  buffer = P4EST_ALLOC (p4est_locate_key_t, num_local);
+  for (zz = 0; zz < num_points; ++zz) {
+    point = p4est_quadrant_array_index (points, zz);
+    jt = point->p.which_tree;
+    if (jt < first_tree || jt > last_tree) {
+      continue;
+    }
+    p4est_node_to_quadrant (point, P4EST_QMAXLEVEL, &node);
+    tkeys = keys + tree_offsets[jt - first_tree]++;
+    tkeys->key = p4est_quadrant_linear_id (&node, P4EST_QMAXLEVEL);
+    tkeys->index = zz;
+  }
+  for (jt = last_tree; jt > first_tree; --jt) {
+    tree_offsets[jt - first_tree] = tree_offsets[jt - first_tree - 1];
+  }
+  tree_offsets[0] = 0;
+
+  /* sort each tree's points and merge them with the tree's quadrants */
+  hist = P4EST_ALLOC (size_t, P4EST_LOCATE_RADIX_HIST);
+  for (jt = first_tree; jt <= last_tree; ++jt) {
+    tree = p4est_tree_array_index (p4est->trees, jt);
+    tkeys = keys + tree_offsets[jt - first_tree];
+    num_points = tree_offsets[jt - first_tree + 1] -
+      tree_offsets[jt - first_tree];
+    p4est_locate_radix_sort (tkeys, buffer, num_points, hist);
+
+    qcount = tree->quadrants.elem_count;
+    qz = 0;
+    qfirst = qlast = 0;
+    if (qcount > 0) {
+      quad = p4est_quadrant_array_index (&tree->quadrants, 0);
+      shift = P4EST_DIM * (P4EST_QMAXLEVEL - (int) quad->level);
+      qfirst = p4est_quadrant_linear_id (quad, (int) quad->level) << shift;
+      qlast = qfirst + (((uint64_t) 1 << shift) - 1);
+    }
+    for (zz = 0; zz < num_points; ++zz) {
+      /* advance to the first quadrant that does not end before the point */
+      while (qz < qcount && qlast < tkeys[zz].key) {
+        if (++qz < qcount) {
+          quad = p4est_quadrant_array_index (&tree->quadrants, qz);
+          shift = P4EST_DIM * (P4EST_QMAXLEVEL - (int) quad->level);
+          qfirst = p4est_quadrant_linear_id (quad, (int) quad->level) << shift;
+          qlast = qfirst + (((uint64_t) 1 << shift) - 1);
+        }
+      }
+      if (qz == qcount) {
+        /* the remaining points lie beyond the local part of the tree */
+        break;
+      }
+      if (qfirst <= tkeys[zz].key) {
+        loc[tkeys[zz].index] =
+          tree->quadrants_offset + (p4est_locidx_t) qz;
+      }
+    }
+  }
+
+  P4EST_FREE (hist);
+  P4EST_FREE (buffer);
+  P4EST_FREE (keys);
+  P4EST_FREE (tree_offsets);
+}
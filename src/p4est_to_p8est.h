@@ -86,6 +86,8 @@
 #define p4est_tree_t                    p8est_tree_t
 #define p4est_quadrant_t                p8est_quadrant_t
 #define p4est_inspect_t                 p8est_inspect_t
+#define p4est_balance_graph             p8est_balance_graph
+#define p4est_balance_graph_t           p8est_balance_graph_t
 #define p4est_position_t                p8est_position_t
 #define p4est_init_t                    p8est_init_t
 #define p4est_refine_t                  p8est_refine_t
@@ -99,6 +101,7 @@
 #define p4est_lnodes_code_t             p8est_lnodes_code_t
 #define p4est_lnodes_rank_t             p8est_lnodes_rank_t
 #define p4est_lnodes_buffer_t           p8est_lnodes_buffer_t
+#define p4est_lnodes_plan_t             p8est_lnodes_plan_t
 #define p4est_iter_volume_t             p8est_iter_volume_t
 #define p4est_iter_volume_info_t        p8est_iter_volume_info_t
 #define p4est_iter_face_t               p8est_iter_face_t
@@ -108,11 +111,18 @@
 #define p4est_iter_corner_side_t        p8est_iter_corner_side_t
 #define p4est_iter_corner_info_t        p8est_iter_corner_info_t
 #define p4est_search_query_t            p8est_search_query_t
+#define p4est_search_batch_t            p8est_search_batch_t
+#define p4est_search_partition_t        p8est_search_partition_t
 #define p4est_transfer_comm_t           p8est_transfer_comm_t
 #define p4est_transfer_context_t        p8est_transfer_context_t
 #define p4est_traverse_query_t          p8est_traverse_query_t
+#define p4est_ray_t                     p8est_ray_t
+#define p4est_ray_leaf_t                p8est_ray_leaf_t
+#define p4est_query_leaf_t              p8est_query_leaf_t
+#define p4est_points_read_t             p8est_points_read_t
 #define p4est_mesh_t                    p8est_mesh_t
 #define p4est_mesh_face_neighbor_t      p8est_mesh_face_neighbor_t
+#define p4est_mesh_changes_t            p8est_mesh_changes_t
 #define p4est_wrap_t                    p8est_wrap_t
 #define p4est_wrap_leaf_t               p8est_wrap_leaf_t
 #define p4est_wrap_flags_t              p8est_wrap_flags_t
@@ -137,6 +147,7 @@
 #define p4est_connectivity_new_twotrees p8est_connectivity_new_twotrees
 #define p4est_connectivity_new_byname   p8est_connectivity_new_byname
 #define p4est_connectivity_new_copy     p8est_connectivity_new_copy
+#define p4est_connectivity_new_rotwrap  p8est_connectivity_new_rotwrap
 #define p4est_connectivity_bcast        p8est_connectivity_bcast
 #define p4est_connectivity_destroy      p8est_connectivity_destroy
 #define p4est_connectivity_set_attr     p8est_connectivity_set_attr
@@ -190,14 +201,20 @@
 #define p4est_mesh_new_ext              p8est_mesh_new_ext
 #define p4est_copy_ext                  p8est_copy_ext
 #define p4est_refine_ext                p8est_refine_ext
+#define p4est_refine_balance_ext        p8est_refine_balance_ext
 #define p4est_coarsen_ext               p8est_coarsen_ext
 #define p4est_balance_ext               p8est_balance_ext
 #define p4est_balance_subtree_ext       p8est_balance_subtree_ext
+#define p4est_balance_dirty_ext         p8est_balance_dirty_ext
+#define p4est_balance_dirty_add         p8est_balance_dirty_add
 #define p4est_partition_ext             p8est_partition_ext
 #define p4est_partition_for_coarsening  p8est_partition_for_coarsening
 #define p4est_save_ext                  p8est_save_ext
 #define p4est_load_ext                  p8est_load_ext
 #define p4est_source_ext                p8est_source_ext
+#define p4est_stats_reset               p8est_stats_reset
+#define p4est_stats_compute             p8est_stats_compute
+#define p4est_stats_print               p8est_stats_print
 
 /* functions in p4est_iterate */
 #define p4est_iterate                   p8est_iterate
@@ -209,6 +226,7 @@
 
 /* functions in p4est_points */
 #define p4est_new_points                p8est_new_points
+#define p4est_new_points_stream         p8est_new_points_stream
 
 /* functions in p4est_bits */
 #define p4est_quadrant_print            p8est_quadrant_print
@@ -219,6 +237,7 @@
 #define p4est_quadrant_disjoint         p8est_quadrant_disjoint
 #define p4est_quadrant_compare_piggy    p8est_quadrant_compare_piggy
 #define p4est_quadrant_compare_local_num p8est_quadrant_compare_local_num
+#define p4est_quadrant_compare_hilbert  p8est_quadrant_compare_hilbert
 #define p4est_quadrant_equal_fn         p8est_quadrant_equal_fn
 #define p4est_quadrant_hash_fn          p8est_quadrant_hash_fn
 #define p4est_node_equal_piggy_fn       p8est_node_equal_piggy_fn
@@ -277,6 +296,7 @@
 #define p4est_quadrant_shift_corner     p8est_quadrant_shift_corner
 #define p4est_quadrant_linear_id        p8est_quadrant_linear_id
 #define p4est_quadrant_set_morton       p8est_quadrant_set_morton
+#define p4est_quadrant_hilbert_id       p8est_quadrant_hilbert_id
 
 /* functions in p4est_search */
 #define p4est_find_lower_bound          p8est_find_lower_bound
@@ -284,8 +304,20 @@
 #define p4est_split_array               p8est_split_array
 #define p4est_find_range_boundaries     p8est_find_range_boundaries
 #define p4est_search                    p8est_search
+#define p4est_search_batch              p8est_search_batch
+#define p4est_search_threads            p8est_search_threads
+#define p4est_search_partition          p8est_search_partition
+#define p4est_search_partition_route    p8est_search_partition_route
+#define p4est_locate_points             p8est_locate_points
 #define p4est_traverse                  p8est_traverse
 
+/* functions in p4est_ray */
+#define p4est_ray_traverse              p8est_ray_traverse
+
+/* functions in p4est_query */
+#define p4est_query_radius              p8est_query_radius
+#define p4est_query_nearest             p8est_query_nearest
+
 /* functions in p4est_algorithms */
 #define p4est_quadrant_init_data        p8est_quadrant_init_data
 #define p4est_quadrant_free_data        p8est_quadrant_free_data
@@ -304,6 +336,7 @@
 #define p4est_complete_subtree          p8est_complete_subtree
 #define p4est_balance_subtree           p8est_balance_subtree
 #define p4est_balance_border            p8est_balance_border
+#define p4est_balance_local             p8est_balance_local
 #define p4est_linearize_tree            p8est_linearize_tree
 #define p4est_next_nonempty_process     p8est_next_nonempty_process
 #define p4est_partition_correction      p8est_partition_correction
@@ -392,6 +425,7 @@
 /* functions in p4est_lnodes */
 #define p4est_lnodes_new                p8est_lnodes_new
 #define p4est_lnodes_destroy            p8est_lnodes_destroy
+#define p4est_lnodes_renumber           p8est_lnodes_renumber
 #define p4est_ghost_support_lnodes      p8est_ghost_support_lnodes
 #define p4est_ghost_expand_by_lnodes    p8est_ghost_expand_by_lnodes
 #define p4est_partition_lnodes          p8est_partition_lnodes
@@ -404,6 +438,14 @@
 #define p4est_lnodes_share_all_end      p8est_lnodes_share_all_end
 #define p4est_lnodes_share_all          p8est_lnodes_share_all
 #define p4est_lnodes_buffer_destroy     p8est_lnodes_buffer_destroy
+#define p4est_lnodes_plan_new           p8est_lnodes_plan_new
+#define p4est_lnodes_plan_destroy       p8est_lnodes_plan_destroy
+#define p4est_lnodes_plan_share_owned_begin p8est_lnodes_plan_share_owned_begin
+#define p4est_lnodes_plan_share_owned_end p8est_lnodes_plan_share_owned_end
+#define p4est_lnodes_plan_share_owned   p8est_lnodes_plan_share_owned
+#define p4est_lnodes_plan_share_all_begin p8est_lnodes_plan_share_all_begin
+#define p4est_lnodes_plan_share_all_end p8est_lnodes_plan_share_all_end
+#define p4est_lnodes_plan_share_all     p8est_lnodes_plan_share_all
 #define p4est_lnodes_rank_array_index   p8est_lnodes_rank_array_index
 #define p4est_lnodes_rank_array_index_int p8est_lnodes_rank_array_index_int
 #define p4est_lnodes_global_index       p8est_lnodes_global_index
@@ -412,6 +454,11 @@
 #define p4est_mesh_memory_used          p8est_mesh_memory_used
 #define p4est_mesh_new                  p8est_mesh_new
 #define p4est_mesh_destroy              p8est_mesh_destroy
+#define p4est_mesh_changes_new          p8est_mesh_changes_new
+#define p4est_mesh_changes_destroy      p8est_mesh_changes_destroy
+#define p4est_mesh_changes_replace      p8est_mesh_changes_replace
+#define p4est_mesh_new_update           p8est_mesh_new_update
+#define p4est_mesh_update               p8est_mesh_update
 #define p4est_mesh_quadrant_cumulative  p8est_mesh_quadrant_cumulative
 #define p4est_mesh_face_neighbor_init   p8est_mesh_face_neighbor_init
 #define p4est_mesh_face_neighbor_init2  p8est_mesh_face_neighbor_init2
@@ -422,6 +469,7 @@
 #define p4est_balance_seeds_face        p8est_balance_seeds_face
 #define p4est_balance_seeds_corner      p8est_balance_seeds_corner
 #define p4est_balance_seeds             p8est_balance_seeds
+#define p4est_balance_seeds_batch       p8est_balance_seeds_batch
 
 /* functions in p4est_wrap */
 #define p4est_wrap_new_conn             p8est_wrap_new_conn
@@ -0,0 +1,190 @@
+/*
+  This file is part of p4est.
+  p4est is a C library to manage a collection (a forest) of multiple
+  connected adaptive quadtrees or octrees in parallel.
+
+  Copyright (C) 2010 The University of Texas System
+  Additional copyright (C) 2011 individual authors
+  Written by Carsten Burstedde, Lucas C. Wilcox, and Tobin Isaac
+
+  p4est is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  p4est is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with p4est; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*/
+
+#include <p4est_trace.h>
+
+/** One entry of the ring buffer. */
+typedef struct p4est_trace_event
+{
+  const char         *name;     /**< static string, not owned */
+  double              time;     /**< wall clock time of the event */
+  char                phase;    /**< 'B', 'E' or 'i' as in Chrome traces */
+  int                 peer;     /**< message partner, or -1 */
+  int                 tag;      /**< message tag */
+  size_t              bytes;    /**< message size */
+}
+p4est_trace_event_t;
+
+int                 p4est_trace_enabled = 0;
+
+static sc_MPI_Comm  p4est_trace_mpicomm = sc_MPI_COMM_NULL;
+static p4est_trace_event_t *p4est_trace_events = NULL;
+static size_t       p4est_trace_capacity = 0;
+static size_t       p4est_trace_count = 0;
+static double       p4est_trace_origin = 0.;
+
+static p4est_trace_event_t *
+p4est_trace_push (const char *name, char phase)
+{
+  p4est_trace_event_t *ev;
+
+  P4EST_ASSERT (p4est_trace_events != NULL);
+
+  /* when the buffer is full, the oldest event is overwritten */
+  ev = p4est_trace_events + p4est_trace_count++ % p4est_trace_capacity;
+  ev->name = name;
+  ev->time = sc_MPI_Wtime ();
+  ev->phase = phase;
+  ev->peer = -1;
+  ev->tag = 0;
+  ev->bytes = 0;
+
+  return ev;
+}
+
+void
+p4est_trace_start (sc_MPI_Comm mpicomm, size_t capacity)
+{
+  int                 mpiret;
+
+  P4EST_ASSERT (!p4est_trace_enabled);
+  P4EST_ASSERT (capacity > 0);
+
+  p4est_trace_mpicomm = mpicomm;
+  p4est_trace_events = P4EST_ALLOC (p4est_trace_event_t, capacity);
+  p4est_trace_capacity = capacity;
+  p4est_trace_count = 0;
+
+  /* time stamps are relative to a common starting point */
+  mpiret = sc_MPI_Barrier (mpicomm);
+  SC_CHECK_MPI (mpiret);
+  p4est_trace_origin = sc_MPI_Wtime ();
+  p4est_trace_enabled = 1;
+}
+
+static void
+p4est_trace_write (const char *filename)
+{
+  int                 mpiret;
+  int                 retval;
+  int                 mpisize, rank;
+  int                 token = 0;
+#ifdef P4EST_ENABLE_MPI
+  sc_MPI_Status       mpistatus;
+#endif
+  size_t              zz, first;
+  FILE               *file;
+  p4est_trace_event_t *ev;
+
+  mpiret = sc_MPI_Comm_size (p4est_trace_mpicomm, &mpisize);
+  SC_CHECK_MPI (mpiret);
+  mpiret = sc_MPI_Comm_rank (p4est_trace_mpicomm, &rank);
+  SC_CHECK_MPI (mpiret);
+
+  /* the processes append to the file in order of their rank */
+#ifdef P4EST_ENABLE_MPI
+  if (rank > 0) {
+    mpiret = sc_MPI_Recv (&token, 1, sc_MPI_INT, rank - 1, P4EST_COMM_TRACE,
+                          p4est_trace_mpicomm, &mpistatus);
+    SC_CHECK_MPI (mpiret);
+  }
+#endif
+  file = fopen (filename, rank == 0 ? "w" : "a");
+  SC_CHECK_ABORT (file != NULL, "trace file open");
+  fprintf (file, "%s{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,"
+           "\"tid\":0,\"args\":{\"name\":\"rank %d\"}}",
+           rank == 0 ? "{\"traceEvents\":[\n" : ",\n", rank, rank);
+
+  first = p4est_trace_count > p4est_trace_capacity ?
+    p4est_trace_count - p4est_trace_capacity : 0;
+  if (first > 0) {
+    P4EST_INFOF ("Trace dropped %llu oldest events\n",
+                 (unsigned long long) first);
+  }
+  for (zz = first; zz < p4est_trace_count; ++zz) {
+    ev = p4est_trace_events + zz % p4est_trace_capacity;
+    fprintf (file, ",\n{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%.3f,"
+             "\"pid\":%d,\"tid\":0", ev->name, ev->phase,
+             1.e6 * (ev->time - p4est_trace_origin), rank);
+    if (ev->phase == 'i') {
+      fprintf (file, ",\"s\":\"t\",\"args\":{\"peer\":%d,\"tag\":%d,"
+               "\"bytes\":%llu}", ev->peer, ev->tag,
+               (unsigned long long) ev->bytes);
+    }
+    fputc ('}', file);
+  }
+  if (rank == mpisize - 1) {
+    fprintf (file, "\n]}\n");
+  }
+  retval = fclose (file);
+  SC_CHECK_ABORT (retval == 0, "trace file close");
+
+#ifdef P4EST_ENABLE_MPI
+  if (rank < mpisize - 1) {
+    mpiret = sc_MPI_Send (&token, 1, sc_MPI_INT, rank + 1, P4EST_COMM_TRACE,
+                          p4est_trace_mpicomm);
+    SC_CHECK_MPI (mpiret);
+  }
+#endif
+}
+
+void
+p4est_trace_stop (const char *filename)
+{
+  P4EST_ASSERT (p4est_trace_enabled);
+
+  p4est_trace_enabled = 0;
+  if (filename != NULL) {
+    p4est_trace_write (filename);
+  }
+
+  P4EST_FREE (p4est_trace_events);
+  p4est_trace_events = NULL;
+  p4est_trace_capacity = p4est_trace_count = 0;
+  p4est_trace_mpicomm = sc_MPI_COMM_NULL;
+}
+
+void
+p4est_trace_begin (const char *name)
+{
+  p4est_trace_push (name, 'B');
+}
+
+void
+p4est_trace_end (const char *name)
+{
+  p4est_trace_push (name, 'E');
+}
+
+void
+p4est_trace_message (const char *name, int peer, int tag,
+                     int count, sc_MPI_Datatype datatype)
+{
+  p4est_trace_event_t *ev;
+
+  ev = p4est_trace_push (name, 'i');
+  ev->peer = peer;
+  ev->tag = tag;
+  ev->bytes = (size_t) count * sc_mpi_sizeof (datatype);
+}
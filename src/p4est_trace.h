@@ -0,0 +1,106 @@
+/*
+  This file is part of p4est.
+  p4est is a C library to manage a collection (a forest) of multiple
+  connected adaptive quadtrees or octrees in parallel.
+
+  Copyright (C) 2010 The University of Texas System
+  Additional copyright (C) 2011 individual authors
+  Written by Carsten Burstedde, Lucas C. Wilcox, and Tobin Isaac
+
+  p4est is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  p4est is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with p4est; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*/
+
+/** \file p4est_trace.h
+ *
+ * Record timelines of algorithm phases and messages for Chrome and Perfetto.
+ *
+ * Tracing is off by default.  While it is on, every process appends events
+ * to a fixed size ring buffer in memory: the begin and end of the phases of
+ * p4est_refine, p4est_balance, p4est_partition and p4est_ghost_new, each
+ * point-to-point message posted, and the time spent waiting for messages.
+ * When the buffer is full, the oldest events are overwritten.
+ * p4est_trace_stop writes the events of all processes into one file in the
+ * Chrome trace event format, one process id per MPI rank.
+ *
+ * The hooks in the library are the P4EST_TRACE macros below.  When tracing
+ * is off, each of them costs a single branch on a global flag.
+ * Tracing is not thread-safe; only one thread must record events.
+ */
+
+#ifndef P4EST_TRACE_H
+#define P4EST_TRACE_H
+
+#include <p4est_base.h>
+
+SC_EXTERN_C_BEGIN;
+
+/** Nonzero between p4est_trace_start and p4est_trace_stop. */
+extern int          p4est_trace_enabled;
+
+/** Begin recording events into a ring buffer on every process.
+ * This function is collective.  It synchronizes the processes to align
+ * their time stamps and must not be called while tracing is on.
+ * \param [in] mpicomm      Communicator used to write the trace file.
+ * \param [in] capacity     Number of events kept per process, positive.
+ */
+void                p4est_trace_start (sc_MPI_Comm mpicomm, size_t capacity);
+
+/** Stop recording, optionally write the trace and free the ring buffer.
+ * This function is collective over the communicator of p4est_trace_start.
+ * The processes append their events to the file one after another.
+ * \param [in] filename     If not NULL, name of the JSON file to write.
+ *                          The file can be opened by chrome://tracing or
+ *                          https://ui.perfetto.dev.
+ */
+void                p4est_trace_stop (const char *filename);
+
+/** Record the begin of a phase.
+ * \param [in] name     Static string, the pointer is stored.
+ */
+void                p4est_trace_begin (const char *name);
+
+/** Record the end of a phase.
+ * \param [in] name     Static string, the pointer is stored.
+ */
+void                p4est_trace_end (const char *name);
+
+/** Record a point-to-point message.
+ * \param [in] name     Static string, the pointer is stored.
+ * \param [in] peer     Rank of the process sent to or received from.
+ * \param [in] tag      Message tag.
+ * \param [in] count    Number of items in the message.
+ * \param [in] datatype MPI datatype of the items.
+ */
+void                p4est_trace_message (const char *name, int peer, int tag,
+                                         int count, sc_MPI_Datatype datatype);
+
+#define P4EST_TRACE_BEGIN(n)                            \
+  do { if (p4est_trace_enabled) {                       \
+      p4est_trace_begin (n); } } while (0)
+#define P4EST_TRACE_END(n)                              \
+  do { if (p4est_trace_enabled) {                       \
+      p4est_trace_end (n); } } while (0)
+#define P4EST_TRACE_ISEND(p,t,c,d)                      \
+  do { if (p4est_trace_enabled) {                       \
+      p4est_trace_message ("MPI_Isend", (p), (t),       \
+                           (int) (c), (d)); } } while (0)
+#define P4EST_TRACE_IRECV(p,t,c,d)                      \
+  do { if (p4est_trace_enabled) {                       \
+      p4est_trace_message ("MPI_Irecv", (p), (t),       \
+                           (int) (c), (d)); } } while (0)
+
+SC_EXTERN_C_END;
+
+#endif /* !P4EST_TRACE_H */
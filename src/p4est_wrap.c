@@ -87,6 +87,12 @@ replace_on_refine (p4est_t * p4est, p4est_topidx_t which_tree,
     }
   }
 
+  /* record the change for updating the mesh */
+  if (pp->changes != NULL) {
+    p4est_mesh_changes_replace (pp->changes, which_tree,
+                                num_outgoing, outgoing, num_incoming, incoming);
+  }
+
   /* pass the replaced quadrants to the user-provided function */
   if (pp->replace_fn != NULL) {
     pp->replace_fn (p4est, which_tree,
@@ -135,10 +141,18 @@ replace_on_coarsen (p4est_t * p4est, p4est_topidx_t which_tree,
 {
   p4est_wrap_t       *pp = (p4est_wrap_t *) p4est->user_pointer;
   P4EST_ASSERT (num_incoming == 1 && num_outgoing == P4EST_CHILDREN);
-  P4EST_ASSERT (pp->coarsen_delay > 0);
+  P4EST_ASSERT (pp->coarsen_delay >= 0);
 
   /* reset most recent adaptation timer */
-  incoming[0]->p.user_int = pp->coarsen_affect ? 0 : -1;
+  if (pp->coarsen_delay) {
+    incoming[0]->p.user_int = pp->coarsen_affect ? 0 : -1;
+  }
+
+  /* record the change for updating the mesh */
+  if (pp->changes != NULL) {
+    p4est_mesh_changes_replace (pp->changes, which_tree,
+                                num_outgoing, outgoing, num_incoming, incoming);
+  }
 
   /* pass the replaced quadrants to the user-provided function */
   if (pp->replace_fn != NULL) {
@@ -157,11 +171,19 @@ replace_on_balance (p4est_t * p4est, p4est_topidx_t which_tree,
 
   /* this function is called when refinement occurs in balance */
   P4EST_ASSERT (num_outgoing == 1 && num_incoming == P4EST_CHILDREN);
-  P4EST_ASSERT (pp->coarsen_delay > 0);
+  P4EST_ASSERT (pp->coarsen_delay >= 0);
 
   /* negative value means coarsening is allowed next time */
-  for (k = 0; k < P4EST_CHILDREN; ++k) {
-    incoming[k]->p.user_int = -1;
+  if (pp->coarsen_delay) {
+    for (k = 0; k < P4EST_CHILDREN; ++k) {
+      incoming[k]->p.user_int = -1;
+    }
+  }
+
+  /* record the change for updating the mesh */
+  if (pp->changes != NULL) {
+    p4est_mesh_changes_replace (pp->changes, which_tree,
+                                num_outgoing, outgoing, num_incoming, incoming);
   }
 
   /* pass the replaced quadrants to the user-provided function */
@@ -586,9 +608,13 @@ p4est_wrap_adapt (p4est_wrap_t * pp)
   P4EST_ASSERT (pp->match_aux == 0);
 
   P4EST_ASSERT (pp->temp_flags == NULL);
+  P4EST_ASSERT (pp->changes == NULL);
   P4EST_ASSERT (pp->num_refine_flags >= 0 &&
                 pp->num_refine_flags <= p4est->local_num_quadrants);
 
+  /* Record all replaced quadrants to update the mesh incrementally */
+  pp->changes = p4est_mesh_changes_new ();
+
   /* This allocation is optimistic when not all refine requests are honored */
   pp->temp_flags = P4EST_ALLOC_ZERO (uint8_t, p4est->local_num_quadrants +
                                      (P4EST_CHILDREN - 1) *
@@ -613,7 +639,7 @@ p4est_wrap_adapt (p4est_wrap_t * pp)
 #endif
   global_num = p4est->global_num_quadrants;
   p4est_coarsen_ext (p4est, 0, 1, coarsen_callback, NULL,
-                     pp->coarsen_delay ? replace_on_coarsen : pp->replace_fn);
+                     replace_on_coarsen);
   P4EST_ASSERT (pp->inside_counter == local_num);
   P4EST_ASSERT (local_num - p4est->local_num_quadrants ==
                 pp->num_replaced * (P4EST_CHILDREN - 1));
@@ -626,12 +652,14 @@ p4est_wrap_adapt (p4est_wrap_t * pp)
   /* Only if refinement and/or coarsening happened do we need to balance */
   if (changed) {
     P4EST_FREE (pp->flags);
-    p4est_balance_ext (p4est, pp->btype, NULL, pp->coarsen_delay ?
-                       replace_on_balance : pp->replace_fn);
+    p4est_balance_ext (p4est, pp->btype, NULL, replace_on_balance);
     pp->flags = P4EST_ALLOC_ZERO (uint8_t, p4est->local_num_quadrants);
 
+    /* The partition is unchanged, so only the replaced quadrants and their
+     * neighborhood need to be searched for the new mesh */
     pp->ghost_aux = p4est_ghost_new (p4est, pp->btype);
-    pp->mesh_aux = p4est_mesh_new_ext (p4est, pp->ghost_aux, 1, 1, pp->btype);
+    pp->mesh_aux = p4est_mesh_new_update (pp->mesh, p4est, pp->ghost_aux,
+                                          pp->changes);
     pp->match_aux = 1;
   }
 #ifdef P4EST_ENABLE_DEBUG
@@ -641,6 +669,8 @@ p4est_wrap_adapt (p4est_wrap_t * pp)
     }
   }
 #endif
+  p4est_mesh_changes_destroy (pp->changes);
+  pp->changes = NULL;
   pp->num_refine_flags = 0;
 
   return changed;
@@ -94,6 +94,7 @@ typedef struct p4est_wrap
   p4est_ghost_t      *ghost_aux;
   p4est_mesh_t       *mesh_aux;
   int                 match_aux;
+  p4est_mesh_changes_t *changes;
 }
 p4est_wrap_t;
 
@@ -122,6 +122,11 @@ p8est_tree_t;
  */
 typedef struct p8est_inspect p8est_inspect_t;
 
+/** Neighborhood communicator cached by the balance exchange.
+ * Opaque; see \ref p8est_inspect::use_balance_neighbor.
+ */
+typedef struct p8est_balance_graph p8est_balance_graph_t;
+
 /** The p8est forest datatype */
 typedef struct p8est
 {
@@ -160,6 +165,9 @@ typedef struct p8est
   sc_mempool_t       *quadrant_pool;  /**< memory allocator for temporary
                                            quadrants */
   p8est_inspect_t    *inspect;        /**< algorithmic switches */
+  p8est_balance_graph_t *balance_graph;  /**< cached by balance, internal */
+  double              stats[P4EST_STAT_NUM];  /**< counters and timings,
+                                                 see p4est_stat_t */
 }
 p8est_t;
 
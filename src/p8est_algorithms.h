@@ -222,6 +222,27 @@ void                p8est_balance_border (p8est_t * p8est,
                                           p8est_replace_t replace_fn,
                                           sc_array_t * borders);
 
+/** Balances all local trees of a p8est, each on its own, which is the
+ * first local pass of p8est_balance_ext.  The leaves are replaced serially
+ * in tree order, so init_fn and replace_fn need not be thread-safe.
+ * If inspect->balance_num_threads is greater than one, a tree that holds
+ * more than its share of the local quadrants is split into subtrees.
+ * These are balanced independently, then the leaves that they split in
+ * each other are balanced with their seeds by p8est_balance_border,
+ * which is repeated until no more leaves are split.
+ * With OpenMP, the subtrees and trees are balanced in that many threads.
+ * \param [in,out] p8est     The p8est to work on.
+ * \param [in]     btype      The balance type.
+ * \param [in]     init_fn    Callback function to initialize the user_data
+ *                            which is already allocated automatically.
+ * \param [in]     replace_fn Callback function for each replaced leaf.
+ *                            May be NULL.
+ */
+void                p8est_balance_local (p8est_t * p8est,
+                                         p8est_connect_type_t btype,
+                                         p8est_init_t init_fn,
+                                         p8est_replace_t replace_fn);
+
 /** Remove overlaps from a sorted list of quadrants.
  *
  * This is alogorithm 8 from H. Sundar, R.S. Sampath and G. Biros
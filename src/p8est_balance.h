@@ -70,4 +70,23 @@ int                 p8est_balance_seeds_corner (p8est_quadrant_t * q,
                                                 int face, p8est_connect_type_t
                                                 balance, sc_array_t * seeds);
 
+/** Batch version of p8est_balance_seeds for many test quadrants against one
+ * trial quadrant \a p.  The level and insulation layer tests are evaluated
+ * without branches, so that most of the quadrants in a leaf range are
+ * discarded cheaply before the face, edge, or corner variant is called.
+ *
+ * \param [in] p          Trial quadrant.
+ * \param [in] quadrants  Array of test quadrants, e.g. a range of leaves.
+ * \param [in] balance    Balance condition.
+ * \param [in,out] seeds  The seeds of all test quadrants that cause \a p to
+ *                        split are appended to this array.  The appended part
+ *                        is sorted and free of duplicates.
+ * \return                The number of test quadrants that cause \a p to
+ *                        split.
+ */
+size_t              p8est_balance_seeds_batch (p8est_quadrant_t * p,
+                                               sc_array_t * quadrants,
+                                               p8est_connect_type_t balance,
+                                               sc_array_t * seeds);
+
 #endif
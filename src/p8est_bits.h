@@ -99,6 +99,16 @@ int                 p8est_quadrant_compare_piggy (const void *v1,
 int                 p8est_quadrant_compare_local_num (const void *v1,
                                                       const void *v2);
 
+/** Compare two quadrants in the order of the Hilbert curve of their tree.
+ * An ancestor is sorted before all of its descendants.
+ * Both quadrants must be valid.
+ * \return Returns < 0 if \a v1 < \a v2,
+ *                   0 if \a v1 == \a v2,
+ *                 > 0 if \a v1 > \a v2
+ */
+int                 p8est_quadrant_compare_hilbert (const void *v1,
+                                                 const void *v2);
+
 /** Test if two quadrants have equal Morton indices, callback version.
  * \return true if \a v1 describes the same quadrant as \a v2.
  */
@@ -711,6 +721,17 @@ uint64_t            p8est_quadrant_linear_id (const p8est_quadrant_t *
 void                p8est_quadrant_set_morton (p8est_quadrant_t * quadrant,
                                                int level, uint64_t id);
 
+/** Computes the position of a quadrant on the Hilbert curve of a uniform grid.
+ * The curve starts at the origin of the tree and visits every quadrant of a
+ * given level contiguously, so that consecutive positions are face neighbors.
+ * \param [in] quadrant  Valid quadrant whose id will be computed.
+ * \param [in] level     Level of the grid, at most the quadrant's level.
+ * \return Returns the position of the ancestor of \a quadrant at \a level.
+ * \note The user_data of \a quadrant is never modified.
+ */
+uint64_t            p8est_quadrant_hilbert_id (const p8est_quadrant_t *
+                                               quadrant, int level);
+
 SC_EXTERN_C_END;
 
 #endif /* !P8EST_BITS_H */
@@ -44,6 +44,7 @@
 #include <p8est_mesh.h>
 #include <p8est_iterate.h>
 #include <p8est_lnodes.h>
+#include <sc_statistics.h>
 
 SC_EXTERN_C_BEGIN;
 
@@ -82,6 +83,33 @@ struct p8est_inspect
   /** time spent in sc_notify_allgather */
   double              balance_notify_allgather;
   int                 use_B;
+  /** Deduplicate the nodes in p8est_nodes_new by sorting flat arrays
+   * of node keys instead of inserting them into hash tables. */
+  int                 use_nodes_sort;
+  /** Number of threads for the sorting variant of p8est_nodes_new if
+   * OpenMP is enabled.  If zero or negative, use omp_get_max_threads. */
+  int                 nodes_num_threads;
+  /** If greater than one, the first local pass of p8est_balance_ext
+   * splits the trees with more than their share of the local quadrants
+   * into subtrees, see p8est_balance_local.  With OpenMP, the trees, the
+   * subtrees, and the border subtrees of each tree are balanced in this
+   * many threads.  The leaves are replaced serially in order, so the
+   * init_fn and replace_fn callbacks need not be thread-safe. */
+  int                 balance_num_threads;
+  /** Exchange the balance queries and responses by neighborhood
+   * collectives on a distributed graph communicator if MPI-3 is
+   * available.  The graph connects all processes that may exchange
+   * balance quadrants on the current partition, so the pattern need not
+   * be found by sc_ranges or sc_notify.  It is kept with the forest and
+   * reused without communication while the partition stays the same. */
+  int                 use_balance_neighbor;
+  /** Number of threads for p8est_lnodes_new if OpenMP is enabled.
+   * If zero or negative, use omp_get_max_threads.  The iteration that
+   * finds the owners of the nodes stays serial, while creating the nodes,
+   * numbering the owned ones and mapping the element nodes to them runs
+   * in threads over ranges of the local elements.  The result does not
+   * depend on the number of threads. */
+  int                 lnodes_num_threads;
 };
 
 /** Callback function prototype to replace one set of quadrants with another.
@@ -192,6 +220,35 @@ void                p8est_refine_ext (p8est_t * p8est,
                                       p8est_init_t init_fn,
                                       p8est_replace_t replace_fn);
 
+/** Refine a forest and restore the 2:1 balance in the same call.
+ * The refinement records the leaves it splits, and only these and the
+ * ripple they cause are balanced by \ref p8est_balance_dirty_ext.  The
+ * leaves away from the refinement are not traversed a second time, and
+ * init_fn and replace_fn are called only for the quadrants that balance
+ * really splits.  The neighbors of refined leaves are split locally
+ * without communication; see \ref p8est_balance_dirty_ext for the
+ * messages exchanged when the ripple reaches other processes.  The result
+ * equals that of \ref p8est_refine_ext followed by \ref p8est_balance_ext if
+ * the forest is balanced on input.
+ * \param [in,out] p8est The forest is changed in place.
+ * \param [in] refine_recursive Boolean to decide on recursive refinement.
+ * \param [in] maxlevel   Maximum allowed refinement level (inclusive).
+ * \param [in] refine_fn  Callback function as in \ref p8est_refine_ext.
+ * \param [in] btype      Balance type (face, edge, corner/full).
+ * \param [in] init_fn    Callback function to initialize the user_data for
+ *                        newly created quadrants; may be NULL.
+ * \param [in] replace_fn Callback function that allows the user to change
+ *                        incoming quadrants based on the quadrants they
+ *                        replace, by refinement or balance; may be NULL.
+ */
+void                p8est_refine_balance_ext (p8est_t * p8est,
+                                              int refine_recursive,
+                                              int maxlevel,
+                                              p8est_refine_t refine_fn,
+                                              p8est_connect_type_t btype,
+                                              p8est_init_t init_fn,
+                                              p8est_replace_t replace_fn);
+
 /** Coarsen a forest.
  * \param [in,out] p8est The forest is changed in place.
  * \param [in] coarsen_recursive Boolean to decide on recursive coarsening.
@@ -232,6 +289,47 @@ void                p8est_balance_ext (p8est_t * p8est,
                                        p8est_init_t init_fn,
                                        p8est_replace_t replace_fn);
 
+/** 2:1 balance a forest after a localized adaptation.
+ * Only the quadrants recorded in \a dirty and the ripple they cause are
+ * examined.  The ripple is followed through the local leaves without
+ * communication.  When it has stopped, the queries to the processes whose
+ * ranges it reaches are sent at once and answered; the resulting splits
+ * ripple locally again.  Each of these exchanges is preceded by a global
+ * reduction and a collective sc_notify over the communicator, while
+ * point-to-point messages go only to the processes reached.  One more
+ * reduction detects that no process has queries left.  The result equals
+ * that of \ref p8est_balance_ext if the forest was balanced before the
+ * recorded quadrants were created.
+ * The forest must not be partitioned between recording and balancing.
+ * \param [in,out] p8est  The p8est to be worked on.
+ * \param [in] btype      Balance type (face, edge, corner/full).
+ * \param [in] init_fn    Callback function to initialize the user_data
+ *                        which is already allocated automatically.
+ * \param [in] replace_fn Callback function that allows the user to change
+ *                        incoming quadrants based on the quadrants they
+ *                        replace.
+ * \param [in,out] dirty  Array of p8est_quadrant_t, for example filled by
+ *                        \ref p8est_balance_dirty_add.  Emptied on output.
+ */
+void                p8est_balance_dirty_ext (p8est_t * p8est,
+                                             p8est_connect_type_t btype,
+                                             p8est_init_t init_fn,
+                                             p8est_replace_t replace_fn,
+                                             sc_array_t * dirty);
+
+/** Record quadrants as dirty for \ref p8est_balance_dirty_ext.
+ * Meant to be called from a replace callback of refine or coarsen with
+ * the incoming quadrants.
+ * \param [in,out] dirty  Array of p8est_quadrant_t to append to.
+ * \param [in] which_tree The tree of the quadrants.
+ * \param [in] num_quadrants  Number of quadrants.
+ * \param [in] quadrants  The quadrants to record.
+ */
+void                p8est_balance_dirty_add (sc_array_t * dirty,
+                                             p4est_topidx_t which_tree,
+                                             int num_quadrants,
+                                             p8est_quadrant_t * quadrants[]);
+
 void                p8est_balance_subtree_ext (p8est_t * p8est,
                                                p8est_connect_type_t btype,
                                                p4est_topidx_t which_tree,
@@ -334,6 +432,32 @@ p8est_t            *p8est_source_ext (sc_io_source_t * src,
                                       int broadcasthead, void *user_pointer,
                                       p8est_connectivity_t ** connectivity);
 
+/** Zero all counters and timings in \a p8est->stats.
+ * Not collective.
+ * \param [in,out] p8est   The forest whose statistics are reset.
+ */
+void                p8est_stats_reset (p8est_t * p8est);
+
+/** Aggregate the counters and timings of a forest over all processes.
+ * This function is collective.
+ * \param [in] p8est       The forest whose statistics are aggregated.
+ * \param [out] stats      Array of P4EST_STAT_NUM entries.  On output,
+ *                         the entries contain min, max, average and
+ *                         standard deviation over the processes and are
+ *                         named by p4est_stat_name.  Without
+ *                         --enable-memtrack the memory entries have no
+ *                         values.
+ */
+void                p8est_stats_compute (p8est_t * p8est,
+                                         sc_statinfo_t * stats);
+
+/** Aggregate and print the counters and timings of a forest.
+ * This function is collective.
+ * \param [in] p8est       The forest whose statistics are printed.
+ * \param [in] log_priority        Priority passed to sc_stats_print.
+ */
+void                p8est_stats_print (p8est_t * p8est, int log_priority);
+
 /** Create the data necessary to create a PETsc DMPLEX representation of a
  * forest, as well as the accompanying lnodes and ghost layer.  The forest
  * must be at least face balanced (see p4est_balance()).  See
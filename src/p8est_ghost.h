@@ -152,10 +152,10 @@ ssize_t             p8est_ghost_bsearch (p8est_ghost_t * ghost,
  * \param [in] q                Valid quadrant's ancestor is searched.
  * \return                      Offset in the ghost layer, or -1 if not found.
  */
-ssize_t             p8est_ghost_tree_contains (p8est_ghost_t * ghost,
-                                               int which_proc,
-                                               p4est_topidx_t which_tree,
-                                               const p8est_quadrant_t * q);
+ssize_t             p8est_ghost_contains (p8est_ghost_t * ghost,
+                                          int which_proc,
+                                          p4est_topidx_t which_tree,
+                                          const p8est_quadrant_t * q);
 
 /** Checks if quadrant exists in the local forest or the ghost layer.
  *
@@ -22,14 +22,6 @@
   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
 */
 
-/********************************************************************
- *                          IMPORTANT NOTE                          *
- *                                                                  *
- * The p4est_points functionality depends on sc/src/sc_sort.        *
- * That parallel bitonic sort is still buggy (see sc/bugs).         *
- * If you want to use this code you have to fix the sort first.     *
- ********************************************************************/
-
 #ifndef P8EST_POINTS_H
 #define P8EST_POINTS_H
 
@@ -70,6 +62,72 @@ p8est_t            *p8est_new_points (sc_MPI_Comm mpicomm,
                                       size_t data_size, p8est_init_t init_fn,
                                       void *user_pointer);
 
+/** Callback to read the next chunk of points for a streaming construction.
+ * \param [in] reader      The reader passed to \ref p8est_new_points_stream.
+ * \param [out] points     Array to be filled with clamped quadrant nodes.
+ *                         The tree id must be stored in p.which_tree.
+ * \param [in] chunk_size  Maximum number of points to read.
+ * \return                 The number of points read.  Zero signals the end
+ *                         of the local points and must be returned for
+ *                         all subsequent calls.
+ */
+typedef size_t      (*p8est_points_read_t) (void *reader,
+                                            p8est_quadrant_t * points,
+                                            size_t chunk_size);
+
+/** Create a new forest from a distributed stream of points.
+ * The points are read in chunks from a callback and are not kept in
+ * memory.  In every round the points are sent to the owners of their
+ * quadrants, which count the points of each leaf and refine the leaves
+ * that exceed \b max_points.  A process accepts at most \b chunk_size
+ * points per round, beginning with a different sender each round, and
+ * the points it does not accept stay with their sender for the next
+ * round.  Thus besides the forest every process needs memory for three
+ * times \b chunk_size points: the chunk to send, the points held back,
+ * and the points received.  Since the points of earlier rounds are not
+ * available after they have been counted, the count of a leaf that is
+ * refined later is split evenly between its children.  Thus the result
+ * agrees with \ref p8est_new_points if all points are received in one
+ * round and approximates it otherwise.
+ * The forest is repartitioned when the quadrants become imbalanced.
+ *
+ * \param [in] mpicomm       A valid MPI communicator.
+ * \param [in] connectivity  This is the connectivity information that
+ *                           the forest is built with.  Note the p4est
+ *                           does not take ownership of the memory.
+ * \param [in] maxlevel      Level of the smallest possible quadrants.
+ * \param [in] read_fn       Callback to read the local points.  It is
+ *                           called while there is room in the chunk until
+ *                           it returns zero and no points are held back
+ *                           on all processes.
+ * \param [in] reader        Passed to every call of \b read_fn.
+ * \param [in] chunk_size    Maximum number of points read, sent, or
+ *                           received by a process in one round.
+ * \param [in] max_points    Maximum number of points per quadrant.
+ *                           Applies to quadrants above maxlevel, so 0 is ok.
+ *                           A value of -1 disables all refinement.
+ * \param [in] data_size     This is the size of data for each quadrant which
+ *                           can be zero.  Then user_data_pool is set to NULL.
+ * \param [in] init_fn       Callback function to initialize the user_data
+ *                           which is already allocated automatically.
+ * \param [in] user_pointer  Assign to the user_pointer member of the p4est
+ *                           before init_fn is called the first time.
+ *
+ * \return This returns a valid forest.
+ *
+ * \note The connectivity structure must not be destroyed
+ *       during the lifetime of this forest.
+ */
+p8est_t            *p8est_new_points_stream (sc_MPI_Comm mpicomm,
+                                             p8est_connectivity_t *
+                                             connectivity, int maxlevel,
+                                             p8est_points_read_t read_fn,
+                                             void *reader, size_t chunk_size,
+                                             p4est_locidx_t max_points,
+                                             size_t data_size,
+                                             p8est_init_t init_fn,
+                                             void *user_pointer);
+
 SC_EXTERN_C_END;
 
 #endif /* !P8EST_POINTS_H */
@@ -0,0 +1,101 @@
+/*
+  This file is part of p4est.
+  p4est is a C library to manage a collection (a forest) of multiple
+  connected adaptive quadtrees or octrees in parallel.
+
+  Copyright (C) 2010 The University of Texas System
+  Additional copyright (C) 2011 individual authors
+  Written by Carsten Burstedde, Lucas C. Wilcox, and Tobin Isaac
+
+  p4est is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  p4est is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with p4est; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*/
+
+/** \file p8est_ray.h
+ *
+ * March rays and segments through the leaves of a forest
+ *
+ * \ingroup p8est
+ */
+
+#ifndef P8EST_RAY_H
+#define P8EST_RAY_H
+
+#include <p8est_ghost.h>
+
+SC_EXTERN_C_BEGIN;
+
+/** A ray or segment in the reference coordinates of a tree.
+ * The points on the ray are origin + (t - tmin) * direction for parameters
+ * tmin <= t <= tmax.
+ * A ray is straight within each tree and continues across tree faces by
+ * the connectivity's face transformation.  It is thus straight in physical
+ * space only if the geometry is affine on each tree, such as for a brick.
+ * While a ray is being traversed, this structure holds its current state:
+ * which_tree, origin and direction refer to the tree the ray is in, and
+ * tmin is the parameter that the traversal has reached.
+ */
+typedef struct p8est_ray
+{
+  p4est_gloidx_t      id;       /**< User-defined identifier of the ray. */
+  p4est_topidx_t      which_tree;       /**< The tree containing origin. */
+  double              origin[3];        /**< Point in [0, 1]^3 of the tree. */
+  double              direction[3];     /**< Direction in the same reference
+                                             frame; must not be zero. */
+  double              tmin;     /**< Parameter of the origin. */
+  double              tmax;     /**< Parameter of the last point. */
+}
+p8est_ray_t;
+
+/** One leaf crossed by a ray, as returned by \ref p8est_ray_traverse. */
+typedef struct p8est_ray_leaf
+{
+  p4est_gloidx_t      id;       /**< Identifier of the ray. */
+  p4est_topidx_t      which_tree;       /**< Tree of the leaf. */
+  p4est_locidx_t      local_num;        /**< Local octant number, or the
+                                             number of local octants plus
+                                             the index of a ghost. */
+  double              entry;    /**< Ray parameter where it enters. */
+  double              exit;     /**< Ray parameter where it exits. */
+}
+p8est_ray_leaf_t;
+
+/** Find the ordered list of leaves crossed by each of a set of rays.
+ * Each ray is marched from leaf to leaf across faces, edges and corners,
+ * including leaves of the ghost layer if one is passed.  When a ray enters
+ * a leaf that is neither local nor a ghost, it is handed off to the owner
+ * of that leaf.  The hand-offs are exchanged between the processes in
+ * batches, one round after the other, until all rays have ended.
+ * Each leaf crossed by a ray is reported on exactly one process:  on its
+ * owner, or on a process that has it as a ghost and marched through it.
+ * A ray ends when it reaches tmax or leaves the domain.
+ * This function is collective.
+ * \param [in] p8est        The forest to traverse.
+ * \param [in] ghost        A ghost layer for \b p8est, or NULL.
+ * \param [in] rays         Array of p8est_ray_t that start on this process.
+ *                          The rays may start anywhere in the domain.
+ * \return                  A new array of p8est_ray_leaf_t.  The crossings
+ *                          of one ray on one process are contiguous and
+ *                          ordered by increasing parameter.  A ray that
+ *                          leaves the process and comes back produces
+ *                          several such runs, in order.  Crossings of zero
+ *                          length at edges and corners are not reported.
+ */
+sc_array_t         *p8est_ray_traverse (p8est_t * p8est,
+                                        p8est_ghost_t * ghost,
+                                        sc_array_t * rays);
+
+SC_EXTERN_C_END;
+
+#endif /* !P8EST_RAY_H */
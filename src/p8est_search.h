@@ -140,6 +140,8 @@ typedef int         (*p8est_search_query_t) (p8est_t * p8est,
  * root of the subtree that contains all of the tree's local quadrants.
  * Likewise, some intermediate levels in the recursion may be skipped.
  * Its outer loop is thus a depth-first, processor-local forest traversal.
+ * The traversal uses an explicit stack and reuses its buffers for the
+ * active points, so it does not allocate memory per quadrant.
  * Each quadrant in that loop either is a leaf, or a (direct or indirect)
  * strict ancestor of a leaf.  On entering a new quadrant, a user-provided
  * quadrant-callback is executed.
@@ -180,6 +182,77 @@ void                p8est_search (p8est_t * p8est,
                                   p8est_search_query_t search_point_fn,
                                   sc_array_t * points);
 
+/** Callback function to query the match of many "points" with a quadrant.
+ *
+ * This is the batch variant of \ref p8est_search_query_t used by
+ * \ref p8est_search_batch.  It is called once per quadrant with all points
+ * that are still active for this quadrant, such that the tests can be
+ * written as one loop over the points, for example to vectorize
+ * bounding box tests.
+ *
+ * \param [in] p8est        The forest to be queried.
+ * \param [in] which_tree   The tree id under consideration.
+ * \param [in] quadrant     The quadrant under consideration,
+ *                          see \ref p8est_search_query_t.
+ * \param [in] local_num    If the quadrant is not a leaf, this is -1.
+ *                          Otherwise it is the (non-negative) index of the
+ *                          quadrant relative to the processor-local storage.
+ * \param [in] points       The array of points passed to the search.
+ * \param [in] actives      Indices into \b points of the active points.
+ * \param [in] num_actives  Number of entries in \b actives, at least one.
+ * \param [out] matches     Array of length \b num_actives.  Set entry i
+ *                          to true if point actives[i] may be contained in
+ *                          the quadrant and false otherwise.  The values
+ *                          have no effect on a leaf.
+ */
+typedef void        (*p8est_search_batch_t) (p8est_t * p8est,
+                                             p4est_topidx_t which_tree,
+                                             p8est_quadrant_t * quadrant,
+                                             p4est_locidx_t local_num,
+                                             sc_array_t * points,
+                                             const size_t * actives,
+                                             size_t num_actives,
+                                             int *matches);
+
+/** Search through the local part of a forest with a batch point callback.
+ * This function is equivalent to \ref p8est_search, except that the points
+ * active for a quadrant are passed to \b search_batch_fn all at once.
+ * \param [in] p8est        The forest to be searched.
+ * \param [in] search_quadrant_fn   See \ref p8est_search.
+ * \param [in] search_batch_fn      If \b points is not NULL, must be not
+ *                          NULL.  Must set true for any possible matching
+ *                          point.  If \b points is NULL, it is ignored.
+ * \param [in] points       User-defined array of "points".
+ */
+void                p8est_search_batch (p8est_t * p8est,
+                                        p8est_search_query_t
+                                        search_quadrant_fn,
+                                        p8est_search_batch_t search_batch_fn,
+                                        sc_array_t * points);
+
+/** Search through the local part of a forest with several threads.
+ * This function is equivalent to \ref p8est_search, except that the work
+ * is divided into tasks of one local tree and one contiguous chunk of
+ * \b points each, which are distributed dynamically over the threads.
+ * Threads are only used if libsc is configured with OpenMP.
+ * Both callbacks must be reentrant:  They may be called concurrently for
+ * different trees and points, and with several chunks the quadrant callback
+ * is called once per chunk for the same octant.  Each point is only passed
+ * to one thread at a time, so the point callback may modify its point.
+ * \param [in] p8est        The forest to be searched.
+ * \param [in] num_threads  Number of threads to use.  If zero or negative,
+ *                          the OpenMP default is used.
+ * \param [in] search_quadrant_fn   See \ref p8est_search.
+ * \param [in] search_point_fn      See \ref p8est_search.
+ * \param [in] points       User-defined array of "points".
+ */
+void                p8est_search_threads (p8est_t * p8est, int num_threads,
+                                          p8est_search_query_t
+                                          search_quadrant_fn,
+                                          p8est_search_query_t
+                                          search_point_fn,
+                                          sc_array_t * points);
+
 /** Callback function for the traversal recursion.
  * \param [in] p8est        The forest to traverse.
  *                          Its local quadrants are never accessed.
@@ -217,6 +290,107 @@ typedef int         (*p8est_traverse_query_t) (p8est_t * p8est,
 void                p8est_traverse (p8est_t * p8est,
                                     p8est_traverse_query_t traverse_fn);
 
+/** Callback function for the partition recursion.
+ * \param [in] p8est        The forest to traverse.
+ *                          Its local quadrants are never accessed.
+ * \param [in] which_tree   The tree number under consideration.
+ * \param [in] quadrant     This quadrant is not from local forest storage,
+ *                          and its user data is undefined.  It represents
+ *                          the branch of the forest in the top-down
+ *                          recursion.
+ * \param [in] pfirst       The lowest processor that owns part of \b quadrant.
+ *                          Guaranteed to be non-empty.
+ * \param [in] plast        The highest processor that owns part of
+ *                          \b quadrant.  Guaranteed to be non-empty.
+ *                          If this is equal to \b pfirst, the recursion
+ *                          stops for \b quadrant's branch after this
+ *                          function returns.
+ * \param [in] point        Pointer to a user-defined point object.
+ *                          If called per-quadrant, this is NULL.
+ * \return                  If false, the recursion at quadrant is terminated.
+ *                          If true, it continues if \b pfirst < \b plast.
+ */
+typedef int         (*p8est_search_partition_t) (p8est_t * p8est,
+                                                 p4est_topidx_t which_tree,
+                                                 p8est_quadrant_t * quadrant,
+                                                 int pfirst, int plast,
+                                                 void *point);
+
+/** Traverse the global partition top-down.
+ * We proceed top-down through the partition, identically on all processors
+ * except for the results of two user-provided callbacks.  The recursion will
+ * only go down branches that are split between multiple processors.
+ * The callback functions can be used to stop a branch recursion even for
+ * split branches.  This function offers the option to search for arbitrary
+ * user-defined points analogously to \ref p8est_search.
+ * Only p8est->global_first_position is used, so the cost of the traversal
+ * depends on the number of points and the depth of the partition boundaries,
+ * not on the local forest.
+ * \note Traversing the whole processor partition will be at least O(P),
+ *       so sensible use of the callback function is advised to cut it short.
+ * \param [in] p8est        The forest to traverse.
+ *                          Its local quadrants are never accessed.
+ * \param [in] quadrant_fn  This function controls the recursion,
+ *                          which only continues deeper if this
+ *                          callback returns true for a branch quadrant.
+ *                          It is allowed to set this to NULL.
+ * \param [in] point_fn     This function decides per-point whether it is
+ *                          followed down the recursion.
+ *                          Must be non-NULL if \b points are not NULL.
+ * \param [in] points       User-provided array of \b points that are
+ *                          passed to the callback \b point_fn.
+ *                          See \ref p8est_search for details.
+ */
+void                p8est_search_partition (p8est_t * p8est,
+                                            p8est_search_partition_t
+                                            quadrant_fn,
+                                            p8est_search_partition_t
+                                            point_fn, sc_array_t * points);
+
+/** Send points to all processes whose partition may contain them.
+ * The points are matched with processes by \ref p8est_search_partition
+ * using \b point_fn:  A point is sent to a process whenever the callback
+ * returns true for a quadrant owned by that process alone, and at most
+ * once to each process.  The communication is sparse: each process only
+ * exchanges messages with the processes it sends points to or receives
+ * points from, and the senders are identified with sc_notify.
+ * This function is collective.
+ * \param [in] p8est        The forest whose partition is used.
+ * \param [in] point_fn     The point callback, must not be NULL.
+ * \param [in] points       Array of local points of arbitrary element size.
+ *                          Since the points are copied bytewise, they must
+ *                          not contain pointers to local memory.
+ * \param [in,out] sources  If not NULL, an array of int that is resized to
+ *                          contain the sending rank of each received point.
+ * \return                  A new array with the element size of \b points
+ *                          that contains the points received from all
+ *                          processes, including the current one, ordered
+ *                          by increasing sender rank.
+ */
+sc_array_t         *p8est_search_partition_route (p8est_t * p8est,
+                                                  p8est_search_partition_t
+                                                  point_fn,
+                                                  sc_array_t * points,
+                                                  sc_array_t * sources);
+
+/** Find the local octants that contain a large set of points.
+ * The points of local trees are sorted by their Morton index with a radix
+ * sort and then merged with the tree's octants in one linear sweep.
+ * This takes O(N + M) operations for N points and M local octants.
+ * \param [in] p8est        The forest to search.
+ * \param [in] points       Array of p8est_quadrant_t that are clamped
+ *                          octant nodes as in p8est_new_points.  The tree id
+ *                          must be stored in p.which_tree.
+ * \param [in,out] locations  Array of p4est_locidx_t that is resized to the
+ *                          number of points.  Entry i is set to the local
+ *                          index of the octant that contains point i,
+ *                          counted over all local trees, or -1 if the
+ *                          point is not inside the local partition.
+ */
+void                p8est_locate_points (p8est_t * p8est,
+                                         sc_array_t * points,
+                                         sc_array_t * locations);
+
 SC_EXTERN_C_END;
 
 #endif /* !P8EST_SEARCH_H */
@@ -86,6 +86,123 @@ refine_fn (p4est_t * p4est, p4est_topidx_t which_tree,
   return 1;
 }
 
+static int
+refine_corner_fn (p4est_t * p4est, p4est_topidx_t which_tree,
+                  p4est_quadrant_t * quadrant)
+{
+  return which_tree == 2 && quadrant->x == 0 && quadrant->y == 0 &&
+    (int) quadrant->level < refine_level + 6;
+}
+
+static int
+refine_origin_fn (p4est_t * p4est, p4est_topidx_t which_tree,
+                  p4est_quadrant_t * quadrant)
+{
+  return which_tree == 2 && quadrant->x == 0 && quadrant->y == 0 &&
+    (int) quadrant->level < refine_level + 8;
+}
+
+static int
+coarsen_fn (p4est_t * p4est, p4est_topidx_t which_tree,
+            p4est_quadrant_t * quadrants[])
+{
+  return which_tree == 0 && (int) quadrants[0]->level > 2;
+}
+
+static void
+check_memory_peak (void)
+{
+  const size_t        mb = 1 << 20;
+  double              stat;
+  char               *block;
+  p4est_memory_peak_t memory;
+
+  /* a freed allocation and nested transient storage raise the peak */
+  stat = 0.;
+  p4est_memory_peak_begin (&memory);
+  block = P4EST_ALLOC (char, mb);
+  P4EST_FREE (block);
+  p4est_memory_hold (mb);
+  p4est_memory_hold (2 * mb);
+  p4est_memory_release (2 * mb);
+  p4est_memory_release (mb);
+  p4est_memory_peak_stat (&memory, 0, &stat);
+#ifdef P4EST_ENABLE_MEMTRACK
+  SC_CHECK_ABORT (stat >= (double) (3 * mb), "Memory peak");
+#else
+  SC_CHECK_ABORT (stat == 0., "Memory peak without memtrack");
+#endif
+}
+
+/* balancing in subtrees and threads must produce the serial result */
+static void
+check_balance_threads (p4est_t * unbalanced, p4est_t * balanced,
+                       p4est_connect_type_t btype)
+{
+  int                 num_threads;
+  p4est_t            *copy;
+  p4est_inspect_t     inspect;
+
+  for (num_threads = 1; num_threads <= 4; ++num_threads) {
+    memset (&inspect, 0, sizeof (inspect));
+    inspect.balance_num_threads = num_threads;
+    copy = p4est_copy (unbalanced, 0);
+    copy->inspect = &inspect;
+    p4est_balance (copy, btype, init_fn);
+    copy->inspect = NULL;
+    SC_CHECK_ABORT (p4est_is_balanced (copy, btype), "Threaded balanced");
+    SC_CHECK_ABORT (p4est_checksum (copy) == p4est_checksum (balanced),
+                    "Threaded balance");
+    p4est_destroy (copy);
+  }
+}
+
+/* a single tree is split into subtrees by the threaded balance */
+static void
+check_balance_split (sc_MPI_Comm mpicomm, p4est_connect_type_t btype)
+{
+  p4est_t            *p4est, *copy;
+  p4est_connectivity_t *connectivity;
+
+#ifndef P4_TO_P8
+  connectivity = p4est_connectivity_new_unitsquare ();
+#else
+  connectivity = p8est_connectivity_new_unitcube ();
+#endif
+  p4est = p4est_new_ext (mpicomm, connectivity, 0, 2, 1, 0, NULL, NULL);
+  p4est_refine (p4est, 1, refine_fn, NULL);
+  copy = p4est_copy (p4est, 0);
+  p4est_balance (p4est, btype, NULL);
+  check_balance_threads (copy, p4est, btype);
+  p4est_destroy (copy);
+  p4est_destroy (p4est);
+  p4est_connectivity_destroy (connectivity);
+}
+
+static void
+dirty_replace_fn (p4est_t * p4est, p4est_topidx_t which_tree,
+                  int num_outgoing, p4est_quadrant_t * outgoing[],
+                  int num_incoming, p4est_quadrant_t * incoming[])
+{
+  p4est_balance_dirty_add ((sc_array_t *) p4est->user_pointer, which_tree,
+                           num_incoming, incoming);
+}
+
+/* compare the dirty-region balance against a full balance of a copy */
+static void
+check_balance_dirty (p4est_t * p4est, sc_array_t * dirty)
+{
+  p4est_t            *copy;
+
+  copy = p4est_copy (p4est, 0);
+  p4est_balance (copy, P4EST_CONNECT_FULL, NULL);
+  p4est_balance_dirty_ext (p4est, P4EST_CONNECT_FULL, NULL, NULL, dirty);
+  SC_CHECK_ABORT (dirty->elem_count == 0, "Dirty emptied");
+  SC_CHECK_ABORT (p4est_checksum (copy) == p4est_checksum (p4est),
+                  "Dirty balance");
+  p4est_destroy (copy);
+}
+
 int
 main (int argc, char **argv)
 {
@@ -99,7 +216,10 @@ main (int argc, char **argv)
   p4est_quadrant_t   *q;
   p4est_tree_t        stree, *tree = &stree;
 #endif
-  p4est_t            *p4est;
+  p4est_t            *p4est, *copy, *copy2;
+  p4est_balance_graph_t *graph;
+  p4est_inspect_t     inspect;
+  sc_array_t         *dirty;
   p4est_connectivity_t *connectivity;
 
   /* initialize MPI */
@@ -114,6 +234,8 @@ main (int argc, char **argv)
   sc_init (mpicomm, 1, 1, NULL, SC_LP_DEFAULT);
   p4est_init (NULL, SC_LP_DEFAULT);
 
+  check_memory_peak ();
+
 #ifndef P4_TO_P8
   connectivity = p4est_connectivity_new_star ();
 #else
@@ -167,8 +289,58 @@ main (int argc, char **argv)
   p4est_refine (p4est, 1, refine_fn, NULL);
   SC_CHECK_ABORT (!p4est_is_balanced (p4est, P4EST_CONNECT_FULL),
                   "Balance 2");
+  copy = p4est_copy (p4est, 1);
+  copy2 = p4est_copy (p4est, 0);
   p4est_balance (p4est, P4EST_CONNECT_FULL, NULL);
   SC_CHECK_ABORT (p4est_is_balanced (p4est, P4EST_CONNECT_FULL), "Balance 3");
+#ifdef P4EST_ENABLE_MEMTRACK
+  /* the peak includes the exchange arrays of every peer */
+  SC_CHECK_ABORT (p4est->stats[P4EST_STAT_BALANCE_MEMORY] >=
+                  (double) (p4est_memory_used (p4est) + p4est->mpisize *
+                            4 * sizeof (sc_array_t)), "Balance memory");
+#else
+  SC_CHECK_ABORT (p4est->stats[P4EST_STAT_BALANCE_MEMORY] == 0.,
+                  "Balance memory without memtrack");
+#endif
+
+  /* the threaded local balance must produce the same forest */
+#ifndef SC_ENABLE_OPENMP
+  P4EST_GLOBAL_INFO ("Balancing the subtrees serially without OpenMP\n");
+#endif
+  check_balance_threads (copy, p4est, P4EST_CONNECT_FULL);
+  p4est_destroy (copy);
+  check_balance_split (mpicomm, P4EST_CONNECT_FACE);
+#ifdef P4_TO_P8
+  check_balance_split (mpicomm, P8EST_CONNECT_EDGE);
+#endif
+  check_balance_split (mpicomm, P4EST_CONNECT_FULL);
+
+  /* so must the exchange by neighborhood collectives, also when cached */
+  memset (&inspect, 0, sizeof (inspect));
+  inspect.use_balance_neighbor = 1;
+  copy2->inspect = &inspect;
+  p4est_balance (copy2, P4EST_CONNECT_FULL, NULL);
+  SC_CHECK_ABORT (p4est_checksum (copy2) == p4est_checksum (p4est),
+                  "Neighbor balance");
+  p4est_balance (copy2, P4EST_CONNECT_FULL, NULL);
+  p4est_balance (copy2, P4EST_CONNECT_FULL, NULL);
+  SC_CHECK_ABORT (p4est_checksum (copy2) == p4est_checksum (p4est),
+                  "Neighbor rebalance");
+
+  /* the graph depends on the partition only, not on the refinement */
+  graph = copy2->balance_graph;
+  copy = p4est_copy (copy2, 0);
+  copy->inspect = NULL;
+  p4est_refine (copy, 1, refine_corner_fn, NULL);
+  p4est_refine (copy2, 1, refine_corner_fn, NULL);
+  p4est_balance (copy, P4EST_CONNECT_FULL, NULL);
+  p4est_balance (copy2, P4EST_CONNECT_FULL, NULL);
+  SC_CHECK_ABORT (copy2->balance_graph == graph, "Neighbor graph cached");
+  SC_CHECK_ABORT (p4est_checksum (copy2) == p4est_checksum (copy),
+                  "Neighbor refined balance");
+  p4est_destroy (copy);
+  copy2->inspect = NULL;
+  p4est_destroy (copy2);
 
   /* check reset data function */
   p4est_reset_data (p4est, 17, NULL, NULL);
@@ -189,6 +361,26 @@ main (int argc, char **argv)
   p4est_balance (p4est, P4EST_CONNECT_FULL, NULL);
   SC_CHECK_ABORT (p4est_checksum (p4est) == crc, "Rebalance");
 
+  /* balance a localized refinement and coarsening by their dirty regions */
+  dirty = sc_array_new (sizeof (p4est_quadrant_t));
+  p4est->user_pointer = dirty;
+  p4est_refine_ext (p4est, 1, -1, refine_corner_fn, NULL, dirty_replace_fn);
+  check_balance_dirty (p4est, dirty);
+  p4est_coarsen_ext (p4est, 1, 0, coarsen_fn, NULL, dirty_replace_fn);
+  check_balance_dirty (p4est, dirty);
+  p4est->user_pointer = NULL;
+  sc_array_destroy (dirty);
+
+  /* refine with balance in one call and compare to refine then balance */
+  copy = p4est_copy (p4est, 0);
+  p4est_refine (copy, 1, refine_origin_fn, NULL);
+  p4est_balance (copy, P4EST_CONNECT_FULL, NULL);
+  p4est_refine_balance_ext (p4est, 1, -1, refine_origin_fn,
+                            P4EST_CONNECT_FULL, NULL, NULL);
+  SC_CHECK_ABORT (p4est_checksum (copy) == p4est_checksum (p4est),
+                  "Refine balance");
+  p4est_destroy (copy);
+
   /* clean up and exit */
   P4EST_ASSERT (p4est->user_data_pool->elem_count ==
                 (size_t) p4est->local_num_quadrants);
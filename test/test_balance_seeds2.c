@@ -300,6 +300,39 @@ compare_seeds (sc_array_t * seeds, sc_array_t * seeds_check)
   }
 }
 
+static void
+check_balance_seeds_batch (p4est_quadrant_t * p, sc_array_t * quadrants,
+                           p4est_connect_type_t b, sc_array_t * seeds,
+                           sc_array_t * seeds_check)
+{
+  size_t              zz, num_split, num_check;
+  size_t              count;
+  p4est_quadrant_t   *q;
+  sc_array_t         *qseeds = sc_array_new (sizeof (p4est_quadrant_t));
+
+  /* collect the seeds of each test quadrant one by one */
+  sc_array_resize (seeds_check, 0);
+  num_check = 0;
+  for (zz = 0; zz < quadrants->elem_count; zz++) {
+    q = p4est_quadrant_array_index (quadrants, zz);
+    if (p4est_balance_seeds (q, p, b, qseeds)) {
+      num_check++;
+      count = seeds_check->elem_count;
+      sc_array_resize (seeds_check, count + qseeds->elem_count);
+      memcpy (sc_array_index (seeds_check, count), qseeds->array,
+              qseeds->elem_count * qseeds->elem_size);
+    }
+  }
+  sc_array_sort (seeds_check, p4est_quadrant_compare);
+  sc_array_uniq (seeds_check, p4est_quadrant_compare);
+  sc_array_destroy (qseeds);
+
+  sc_array_resize (seeds, 0);
+  num_split = p4est_balance_seeds_batch (p, quadrants, b, seeds);
+  SC_CHECK_ABORT (num_split == num_check, "p4est_balance_seeds_batch count");
+  compare_seeds (seeds, seeds_check);
+}
+
 int
 main (int argc, char **argv)
 {
@@ -319,6 +352,8 @@ main (int argc, char **argv)
   uint64_t            i, ifirst, ilast;
   int                 level;
   sc_array_t         *seeds, *seeds_check;
+  sc_array_t         *quadrants;
+  p4est_quadrant_t   *r;
   int                 testval;
   int                 checkval;
   int                 j, nrand = 1000;
@@ -628,6 +663,26 @@ main (int argc, char **argv)
     }
   }
 
+  /* batch test: random quadrants in and around the insulation layer */
+  P4EST_GLOBAL_VERBOSE ("Testing batch\n");
+  quadrants = sc_array_new (sizeof (p4est_quadrant_t));
+  for (j = 0; j < nrand; j++) {
+    level = ((random ()) % (maxlevel + 2)) + 3;
+    ilast = ((uint64_t) 1) << (P4EST_DIM * level);
+    i = ((uint64_t) random () * (uint64_t) random ()) % ilast;
+    r = p4est_quadrant_array_push (quadrants);
+    p4est_quadrant_set_morton (r, level, i);
+  }
+  check_balance_seeds_batch (&root, quadrants, P4EST_CONNECT_FACE,
+                             seeds, seeds_check);
+#ifdef P4_TO_P8
+  check_balance_seeds_batch (&root, quadrants, P8EST_CONNECT_EDGE,
+                             seeds, seeds_check);
+#endif
+  check_balance_seeds_batch (&root, quadrants, P4EST_CONNECT_FULL,
+                             seeds, seeds_check);
+  sc_array_destroy (quadrants);
+
   sc_array_destroy (seeds);
   sc_array_destroy (seeds_check);
 
@@ -578,6 +578,133 @@ same_point (tpoint_t * a, tpoint_t * b, p4est_connectivity_t * conn)
 
 }
 
+static void
+check_shared_points (p4est_lnodes_t * lnodes, tpoint_t * tpoints,
+                     p4est_connectivity_t * conn, int mpirank)
+{
+  size_t              zz, zy;
+  p4est_locidx_t      nid;
+  tpoint_t           *tpoint_p;
+  sc_array_t          tpoint_array;
+  p4est_lnodes_buffer_t *buffer;
+  sc_array_t         *peer_buffer;
+  p4est_lnodes_rank_t *lrank;
+  sc_array_t         *shared_nodes;
+
+  sc_array_init_data (&tpoint_array, tpoints, sizeof (tpoint_t),
+                      (size_t) lnodes->num_local_nodes);
+  buffer = p4est_lnodes_share_all (&tpoint_array, lnodes);
+
+  for (zz = 0; zz < lnodes->sharers->elem_count; zz++) {
+    lrank = p4est_lnodes_rank_array_index (lnodes->sharers, zz);
+    if (lrank->rank == mpirank) {
+      continue;
+    }
+    peer_buffer = (sc_array_t *) sc_array_index (buffer->recv_buffers, zz);
+    shared_nodes = &(lrank->shared_nodes);
+    P4EST_ASSERT (shared_nodes->elem_count == peer_buffer->elem_count);
+    for (zy = 0; zy < shared_nodes->elem_count; zy++) {
+      nid = *((p4est_locidx_t *) sc_array_index (shared_nodes, zy));
+      tpoint_p = (tpoint_t *) sc_array_index (peer_buffer, zy);
+      SC_CHECK_ABORT (same_point (tpoint_p, tpoints + nid, conn),
+                      "Lnodes: bad element-to-global node map across processors");
+    }
+  }
+
+  p4est_lnodes_buffer_destroy (buffer);
+}
+
+/** Renumber the nodes and verify that they represent the same points. */
+static void
+check_renumber (p4est_lnodes_t * lnodes, tpoint_t * tpoints,
+                p4est_connectivity_t * conn, int mpirank)
+{
+  size_t              zz;
+  size_t              nelnodes =
+    (size_t) lnodes->num_local_elements * lnodes->vnodes;
+  p4est_locidx_t      nin = lnodes->num_local_nodes;
+  p4est_locidx_t      nid, oid;
+  p4est_locidx_t     *old_nodes;
+  p4est_gloidx_t      gn;
+  tpoint_t           *new_points;
+  sc_array_t         *global_nodes;
+
+  old_nodes = P4EST_ALLOC (p4est_locidx_t, nelnodes);
+  memcpy (old_nodes, lnodes->element_nodes,
+          nelnodes * sizeof (p4est_locidx_t));
+  p4est_lnodes_renumber (lnodes);
+  SC_CHECK_ABORT (lnodes->num_local_nodes == nin,
+                  "Lnodes: renumber changed the node count");
+
+  new_points = P4EST_ALLOC (tpoint_t, nin);
+  memset (new_points, -1, nin * sizeof (tpoint_t));
+  for (zz = 0; zz < nelnodes; zz++) {
+    nid = lnodes->element_nodes[zz];
+    oid = old_nodes[zz];
+    SC_CHECK_ABORT (0 <= nid && nid < nin, "Lnodes: bad renumbered node");
+    SC_CHECK_ABORT ((nid < lnodes->owned_count) ==
+                    (oid < lnodes->owned_count),
+                    "Lnodes: renumber changed node ownership");
+    if (new_points[nid].tree == -1) {
+      new_points[nid] = tpoints[oid];
+    }
+    else {
+      SC_CHECK_ABORT (same_point (new_points + nid, tpoints + oid, conn),
+                      "Lnodes: bad renumbered element-to-global node map");
+    }
+  }
+  check_shared_points (lnodes, new_points, conn, mpirank);
+
+  global_nodes = sc_array_new_size (sizeof (p4est_gloidx_t), nin);
+  for (zz = 0; zz < global_nodes->elem_count; zz++) {
+    *((p4est_gloidx_t *) sc_array_index (global_nodes, zz)) =
+      p4est_lnodes_global_index (lnodes, zz);
+  }
+  p4est_lnodes_share_owned (global_nodes, lnodes);
+  for (zz = 0; zz < global_nodes->elem_count; zz++) {
+    gn = *((p4est_gloidx_t *) sc_array_index (global_nodes, zz));
+    SC_CHECK_ABORT (gn == p4est_lnodes_global_index (lnodes, zz),
+                    "Lnodes: bad renumbered global index across procesors");
+  }
+
+  sc_array_destroy (global_nodes);
+  P4EST_FREE (new_points);
+  P4EST_FREE (old_nodes);
+}
+
+/** Verify that the nodes do not depend on the number of threads. */
+static void
+check_threads (p4est_t * p4est, p4est_ghost_t * ghost_layer, int degree,
+               p4est_lnodes_t * lnodes)
+{
+#ifdef SC_ENABLE_OPENMP
+  size_t              nelnodes =
+    (size_t) lnodes->num_local_elements * lnodes->vnodes;
+  p4est_inspect_t     inspect, *saved = p4est->inspect;
+  p4est_lnodes_t     *tlnodes;
+  int                 num_threads;
+
+  for (num_threads = 1; num_threads <= 3; num_threads += 2) {
+    memset (&inspect, 0, sizeof (inspect));
+    inspect.lnodes_num_threads = num_threads;
+    p4est->inspect = &inspect;
+    tlnodes = p4est_lnodes_new (p4est, ghost_layer, degree);
+    p4est->inspect = saved;
+    SC_CHECK_ABORT (tlnodes->num_local_nodes == lnodes->num_local_nodes &&
+                    tlnodes->owned_count == lnodes->owned_count &&
+                    !memcmp (tlnodes->element_nodes, lnodes->element_nodes,
+                             nelnodes * sizeof (p4est_locidx_t)) &&
+                    !memcmp (tlnodes->nonlocal_nodes, lnodes->nonlocal_nodes,
+                             (lnodes->num_local_nodes - lnodes->owned_count)
+                             * sizeof (p4est_gloidx_t)),
+                    "Lnodes: result depends on the number of threads");
+    p4est_lnodes_destroy (tlnodes);
+  }
+#else
+  P4EST_GLOBAL_INFO ("Lnodes thread test skipped without OpenMP\n");
+#endif
+}
+
 int
 main (int argc, char **argv)
 {
@@ -595,7 +722,7 @@ main (int argc, char **argv)
   int                 i, j, k;
   p4est_lnodes_t     *lnodes;
   p4est_locidx_t      nin;
-  tpoint_t           *tpoints, tpoint, *tpoint_p;
+  tpoint_t           *tpoints, tpoint;
   p4est_locidx_t      elid;
   p4est_locidx_t      elnid;
   p4est_locidx_t      nid;
@@ -611,8 +738,7 @@ main (int argc, char **argv)
   int                 is_hanging;
   int                 f;
   int                 c;
-  sc_array_t          tpoint_array;
-  p4est_lnodes_buffer_t *buffer;
+  p4est_lnodes_plan_t *plan;
   sc_array_t         *peer_buffer;
   p4est_lnodes_rank_t *lrank;
   sc_array_t         *shared_nodes;
@@ -749,6 +875,11 @@ main (int argc, char **argv)
         lnodes = p4est_lnodes_new (p4est, ghost_layer, j);
         break;
       }
+      check_threads (p4est, j == -1 ? face_ghost_layer :
+#ifdef P4_TO_P8
+                     j == -2 ? edge_ghost_layer :
+#endif
+                     ghost_layer, j, lnodes);
 
       if (j < 0) {
         p4est_lnodes_destroy (lnodes);
@@ -917,27 +1048,7 @@ main (int argc, char **argv)
         }
       }
 
-      sc_array_init_data (&tpoint_array, tpoints, sizeof (tpoint_t), nin);
-      buffer = p4est_lnodes_share_all (&tpoint_array, lnodes);
-
-      for (zz = 0; zz < lnodes->sharers->elem_count; zz++) {
-        lrank = p4est_lnodes_rank_array_index (lnodes->sharers, zz);
-        if (lrank->rank == mpirank) {
-          continue;
-        }
-        peer_buffer =
-          (sc_array_t *) sc_array_index (buffer->recv_buffers, zz);
-        shared_nodes = &(lrank->shared_nodes);
-        P4EST_ASSERT (shared_nodes->elem_count == peer_buffer->elem_count);
-        for (zy = 0; zy < shared_nodes->elem_count; zy++) {
-          nid = *((p4est_locidx_t *) sc_array_index (shared_nodes, zy));
-          tpoint_p = (tpoint_t *) sc_array_index (peer_buffer, zy);
-          SC_CHECK_ABORT (same_point (tpoint_p, tpoints + nid, conn),
-                          "Lnodes: bad element-to-global node map across processors");
-        }
-      }
-
-      p4est_lnodes_buffer_destroy (buffer);
+      check_shared_points (lnodes, tpoints, conn, mpirank);
 
       global_nodes = sc_array_new (sizeof (p4est_gloidx_t));
       sc_array_resize (global_nodes, lnodes->num_local_nodes);
@@ -954,6 +1065,44 @@ main (int argc, char **argv)
                         "Lnodes: bad global index across procesors");
       }
 
+      /* repeat both exchanges with a reused persistent plan */
+      plan = p4est_lnodes_plan_new (lnodes, sizeof (p4est_gloidx_t));
+      for (k = 0; k < 2; k++) {
+        for (zz = 0; zz < global_nodes->elem_count; zz++) {
+          *((p4est_gloidx_t *) sc_array_index (global_nodes, zz)) =
+            (zz < (size_t) lnodes->owned_count) ?
+            p4est_lnodes_global_index (lnodes, zz) : -1;
+        }
+        p4est_lnodes_plan_share_owned (plan, global_nodes);
+        for (zz = 0; zz < global_nodes->elem_count; zz++) {
+          gn = *((p4est_gloidx_t *) sc_array_index (global_nodes, zz));
+          SC_CHECK_ABORT (gn == p4est_lnodes_global_index (lnodes, zz),
+                          "Lnodes: bad global index from plan");
+        }
+
+        p4est_lnodes_plan_share_all (plan, global_nodes);
+        for (zz = 0; zz < lnodes->sharers->elem_count; zz++) {
+          lrank = p4est_lnodes_rank_array_index (lnodes->sharers, zz);
+          if (lrank->rank == mpirank) {
+            continue;
+          }
+          peer_buffer =
+            (sc_array_t *) sc_array_index (plan->recv_buffers, zz);
+          shared_nodes = &(lrank->shared_nodes);
+          SC_CHECK_ABORT (shared_nodes->elem_count == peer_buffer->elem_count,
+                          "Lnodes: bad plan receive count");
+          for (zy = 0; zy < shared_nodes->elem_count; zy++) {
+            nid = *((p4est_locidx_t *) sc_array_index (shared_nodes, zy));
+            gn = *((p4est_gloidx_t *) sc_array_index (peer_buffer, zy));
+            SC_CHECK_ABORT (gn == p4est_lnodes_global_index (lnodes, nid),
+                            "Lnodes: bad shared global index from plan");
+          }
+        }
+      }
+      p4est_lnodes_plan_destroy (plan);
+
+      check_renumber (lnodes, tpoints, conn, mpirank);
+
       sc_array_destroy (global_nodes);
 
       p4est_lnodes_destroy (lnodes);
@@ -155,7 +155,7 @@ test_loadsave (p4est_connectivity_t * connectivity, const char *prefix,
 {
   int                 mpiret, retval;
   unsigned            csum, csum2;
-  double              elapsed, wtime;
+  double              elapsed, wtime, qbytes;
   p4est_connectivity_t *conn2;
   p4est_t            *p4est, *p4est2;
   sc_statinfo_t       stats[STATS_COUNT];
@@ -189,15 +189,25 @@ test_loadsave (p4est_connectivity_t * connectivity, const char *prefix,
   p4est_connectivity_destroy (conn2);
 
   /* save, synchronize, load p4est and compare */
+  p4est_stats_reset (p4est);
   wtime = sc_MPI_Wtime ();
   p4est_save (p4est_name, p4est, 1);
   elapsed = sc_MPI_Wtime () - wtime;
   sc_stats_set1 (stats + STATS_P4EST_SAVE1, elapsed, "p4est save 1");
+  qbytes = (double) p4est->local_num_quadrants *
+    ((P4EST_DIM + 1) * sizeof (p4est_qcoord_t) + sizeof (int));
+  SC_CHECK_ABORT (p4est->stats[P4EST_STAT_SAVE_BYTES] >= qbytes &&
+                  (mpirank == 0 ||
+                   p4est->stats[P4EST_STAT_SAVE_BYTES] == qbytes),
+                  "save statistics");
 
   wtime = sc_MPI_Wtime ();
   p4est2 = p4est_load (p4est_name, mpicomm, sizeof (int), 1, NULL, &conn2);
   elapsed = sc_MPI_Wtime () - wtime;
   sc_stats_set1 (stats + STATS_P4EST_LOAD1a, elapsed, "p4est load 1a");
+  SC_CHECK_ABORT (p4est2->stats[P4EST_STAT_LOAD_BYTES] > qbytes,
+                  "load statistics");
+  p4est_stats_print (p4est2, SC_LP_INFO);
 
   SC_CHECK_ABORT (p4est_connectivity_is_equal (connectivity, conn2),
                   "load/save connectivity mismatch Ba");
@@ -0,0 +1,244 @@
+/*
+  This file is part of p4est.
+  p4est is a C library to manage a collection (a forest) of multiple
+  connected adaptive quadtrees or octrees in parallel.
+
+  Copyright (C) 2010 The University of Texas System
+  Additional copyright (C) 2011 individual authors
+  Written by Carsten Burstedde, Lucas C. Wilcox, and Tobin Isaac
+
+  p4est is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  p4est is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with p4est; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*/
+
+#ifndef P4_TO_P8
+#include <p4est_algorithms.h>
+#include <p4est_bits.h>
+#include <p4est_points.h>
+#else
+#include <p8est_algorithms.h>
+#include <p8est_bits.h>
+#include <p8est_points.h>
+#endif
+
+#define TEST_POINTS_NUM 300
+
+/** Create random clamped nodes, optionally clustered in a corner. */
+static p4est_quadrant_t *
+create_points (p4est_topidx_t num_trees, int clustered, int rank,
+               size_t num_points)
+{
+  const p4est_qcoord_t mask = ~(P4EST_QUADRANT_LEN (P4EST_QMAXLEVEL) - 1);
+  const double        rlen = (double) P4EST_ROOT_LEN;
+  size_t              zz;
+  double              scale;
+  p4est_quadrant_t   *points, *q;
+
+  points = P4EST_ALLOC_ZERO (p4est_quadrant_t, num_points);
+  for (zz = 0; zz < num_points; ++zz) {
+    q = points + zz;
+    scale = clustered ? .01 : 1.;
+    q->x = (p4est_qcoord_t) (scale * rlen * rand () / (RAND_MAX + 1.)) & mask;
+    q->y = (p4est_qcoord_t) (scale * rlen * rand () / (RAND_MAX + 1.)) & mask;
+#ifdef P4_TO_P8
+    q->z = (p4est_qcoord_t) (scale * rlen * rand () / (RAND_MAX + 1.)) & mask;
+#endif
+    q->level = P4EST_MAXLEVEL;
+    q->p.which_tree = clustered ? (p4est_topidx_t) (rank % num_trees) :
+      (p4est_topidx_t) (num_trees * (rand () / (RAND_MAX + 1.)));
+    P4EST_ASSERT (p4est_quadrant_is_node (q, 1));
+  }
+  return points;
+}
+
+typedef struct test_reader
+{
+  p4est_quadrant_t   *points;
+  size_t              num_points, position;
+}
+test_reader_t;
+
+static size_t
+read_points (void *reader, p4est_quadrant_t * points, size_t chunk_size)
+{
+  test_reader_t      *r = (test_reader_t *) reader;
+  size_t              count;
+
+  count = SC_MIN (chunk_size, r->num_points - r->position);
+  memcpy (points, r->points + r->position, count * sizeof (*points));
+  r->position += count;
+  return count;
+}
+
+/** Count the points contained in a quadrant by brute force. */
+static              p4est_locidx_t
+count_points (const p4est_quadrant_t * all_points, const int *counts,
+              int num_procs, p4est_topidx_t which_tree,
+              const p4est_quadrant_t * q)
+{
+  int                 p;
+  size_t              zp;
+  p4est_locidx_t      count;
+  const p4est_quadrant_t *n;
+
+  for (count = 0, p = 0; p < num_procs; ++p) {
+    for (zp = 0; zp < (size_t) counts[p] / sizeof (p4est_quadrant_t); ++zp) {
+      n = all_points + p * TEST_POINTS_NUM + zp;
+      if (n->p.which_tree == which_tree &&
+          p4est_quadrant_contains_node (q, n)) {
+        ++count;
+      }
+    }
+  }
+  return count;
+}
+
+/** Check that no leaf above the maximum level holds too many points.
+ * If chunk_size is positive, the forest is built by streaming the points
+ * in chunks.  If it is at least the number of points of all processes,
+ * every process reads and receives its points in one round.  Then the
+ * streaming is exact and the parent of every leaf holds too many points.
+ */
+static void
+check_points (sc_MPI_Comm mpicomm, p4est_connectivity_t * conn,
+              int clustered, int maxlevel, p4est_locidx_t max_points,
+              size_t chunk_size)
+{
+  const size_t        qsize = sizeof (p4est_quadrant_t);
+  int                 mpiret;
+  int                 num_procs, rank, p;
+  int                *counts, *displs;
+  int                 exact;
+  size_t              zz;
+  p4est_locidx_t      count;
+  p4est_topidx_t      jt;
+  p4est_quadrant_t   *points, *all_points, *q, parent;
+  test_reader_t       reader;
+  p4est_tree_t       *tree;
+  p4est_t            *p4est;
+
+  mpiret = sc_MPI_Comm_size (mpicomm, &num_procs);
+  SC_CHECK_MPI (mpiret);
+  mpiret = sc_MPI_Comm_rank (mpicomm, &rank);
+  SC_CHECK_MPI (mpiret);
+
+  /* the last process contributes no points */
+  points = create_points (conn->num_trees, clustered, rank,
+                          rank == num_procs - 1 && num_procs > 1 ?
+                          0 : TEST_POINTS_NUM);
+
+  /* keep a copy of all points for brute force counting */
+  counts = P4EST_ALLOC (int, num_procs);
+  displs = P4EST_ALLOC (int, num_procs);
+  for (p = 0; p < num_procs; ++p) {
+    counts[p] = (p == num_procs - 1 && num_procs > 1 ?
+                 0 : TEST_POINTS_NUM) * (int) qsize;
+    displs[p] = p * TEST_POINTS_NUM * (int) qsize;
+  }
+  all_points = P4EST_ALLOC (p4est_quadrant_t, num_procs * TEST_POINTS_NUM);
+  mpiret = sc_MPI_Allgatherv (points, counts[rank], sc_MPI_BYTE,
+                              all_points, counts, displs, sc_MPI_BYTE,
+                              mpicomm);
+  SC_CHECK_MPI (mpiret);
+
+  if (chunk_size == 0) {
+    p4est = p4est_new_points (mpicomm, conn, maxlevel, points,
+                              (p4est_locidx_t) (counts[rank] / (int) qsize),
+                              max_points, 0, NULL, NULL);
+    exact = 0;
+  }
+  else {
+    reader.points = points;
+    reader.num_points = (size_t) counts[rank] / qsize;
+    reader.position = 0;
+    p4est = p4est_new_points_stream (mpicomm, conn, maxlevel, read_points,
+                                     &reader, chunk_size, max_points,
+                                     0, NULL, NULL);
+    exact = chunk_size >= (size_t) (num_procs * TEST_POINTS_NUM);
+  }
+  SC_CHECK_ABORT (p4est_is_valid (p4est), "Points forest invalid");
+
+  for (jt = p4est->first_local_tree; jt <= p4est->last_local_tree; ++jt) {
+    tree = p4est_tree_array_index (p4est->trees, jt);
+    for (zz = 0; zz < tree->quadrants.elem_count; ++zz) {
+      q = p4est_quadrant_array_index (&tree->quadrants, zz);
+      SC_CHECK_ABORT ((int) q->level <= maxlevel, "Points leaf level");
+      if (chunk_size > 0 && !exact) {
+        continue;
+      }
+      if ((int) q->level < maxlevel) {
+        count = count_points (all_points, counts, num_procs, jt, q);
+        SC_CHECK_ABORTF (count <= max_points, "Points leaf holds %lld",
+                         (long long) count);
+      }
+      if (exact && q->level > 0) {
+        p4est_quadrant_parent (q, &parent);
+        count = count_points (all_points, counts, num_procs, jt, &parent);
+        SC_CHECK_ABORTF (count > max_points, "Points parent holds %lld",
+                         (long long) count);
+      }
+    }
+  }
+
+  p4est_destroy (p4est);
+  P4EST_FREE (all_points);
+  P4EST_FREE (displs);
+  P4EST_FREE (counts);
+  P4EST_FREE (points);
+}
+
+int
+main (int argc, char **argv)
+{
+  int                 mpiret;
+  int                 num_procs;
+  size_t              all_size;
+  sc_MPI_Comm         mpicomm;
+  p4est_connectivity_t *conn;
+
+  mpiret = sc_MPI_Init (&argc, &argv);
+  SC_CHECK_MPI (mpiret);
+  mpicomm = sc_MPI_COMM_WORLD;
+  mpiret = sc_MPI_Comm_size (mpicomm, &num_procs);
+  SC_CHECK_MPI (mpiret);
+  all_size = (size_t) (num_procs * TEST_POINTS_NUM);
+
+  sc_init (mpicomm, 1, 1, NULL, SC_LP_DEFAULT);
+  p4est_init (NULL, SC_LP_DEFAULT);
+
+#ifndef P4_TO_P8
+  conn = p4est_connectivity_new_star ();
+#else
+  conn = p8est_connectivity_new_rotcubes ();
+#endif
+  srand (17);
+  check_points (mpicomm, conn, 0, 8, 3, 0);
+  check_points (mpicomm, conn, 0, 4, 0, 0);
+  check_points (mpicomm, conn, 1, 12, 5, 0);
+
+  /* build the forests from streams of points */
+  check_points (mpicomm, conn, 0, 8, 3, all_size);
+  check_points (mpicomm, conn, 1, 12, 5, all_size);
+  check_points (mpicomm, conn, 1, 12, 5, TEST_POINTS_NUM);
+  check_points (mpicomm, conn, 0, 8, 3, 17);
+  check_points (mpicomm, conn, 1, 12, 0, 1);
+  p4est_connectivity_destroy (conn);
+
+  sc_finalize ();
+
+  mpiret = sc_MPI_Finalize ();
+  SC_CHECK_MPI (mpiret);
+
+  return 0;
+}
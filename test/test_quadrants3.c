@@ -119,6 +119,64 @@ check_linear_id (const p4est_quadrant_t * q1, const p4est_quadrant_t * q2)
   }
 }
 
+static void
+check_hilbert_id (int level)
+{
+  const p4est_qcoord_t qh = P4EST_QUADRANT_LEN (level);
+  int8_t             *seen;
+  uint64_t            num, m, id;
+  int64_t             dx, dy, dz;
+  p4est_quadrant_t    q, par, *quads, *q1, *q2;
+
+  num = (uint64_t) 1 << (P4EST_DIM * level);
+  quads = P4EST_ALLOC (p4est_quadrant_t, num);
+  seen = P4EST_ALLOC_ZERO (int8_t, num);
+
+  /* the Hilbert id is a permutation of the Morton id */
+  for (m = 0; m < num; ++m) {
+    p4est_quadrant_set_morton (&q, level, m);
+    id = p4est_quadrant_hilbert_id (&q, level);
+    SC_CHECK_ABORT (id < num && !seen[id], "Hilbert permutation");
+    seen[id] = 1;
+    quads[id] = q;
+
+    /* descendants are contiguous on the curve */
+    if (level > 0) {
+      p4est_quadrant_parent (&q, &par);
+      SC_CHECK_ABORT (p4est_quadrant_hilbert_id (&q, level - 1) ==
+                      p4est_quadrant_hilbert_id (&par, level - 1),
+                      "Hilbert ancestor");
+      SC_CHECK_ABORT (p4est_quadrant_compare_hilbert (&par, &q) < 0,
+                      "Hilbert compare ancestor");
+    }
+  }
+
+  /* the curve starts at the origin and steps between face neighbors */
+  SC_CHECK_ABORT (quads[0].x == 0 && quads[0].y == 0
+#ifdef P4_TO_P8
+                  && quads[0].z == 0
+#endif
+                  , "Hilbert origin");
+  for (id = 1; id < num; ++id) {
+    q1 = &quads[id - 1];
+    q2 = &quads[id];
+    dx = q1->x - q2->x;
+    dy = q1->y - q2->y;
+#ifdef P4_TO_P8
+    dz = q1->z - q2->z;
+#else
+    dz = 0;
+#endif
+    SC_CHECK_ABORT (dx * dx + dy * dy + dz * dz == (int64_t) qh * qh,
+                    "Hilbert neighbor");
+    SC_CHECK_ABORT (p4est_quadrant_compare_hilbert (q1, q2) < 0,
+                    "Hilbert compare");
+  }
+
+  P4EST_FREE (quads);
+  P4EST_FREE (seen);
+}
+
 int
 main (int argc, char **argv)
 {
@@ -558,6 +616,11 @@ main (int argc, char **argv)
   check_linear_id (&I, &H);
   check_linear_id (&I, &I);
 
+  /* test the Hilbert curve on uniform grids */
+  for (level = 0; level <= 3; ++level) {
+    check_hilbert_id (level);
+  }
+
   check_linear_id (&P, &F);
   check_linear_id (&P, &G);
   check_linear_id (&P, &H);
@@ -0,0 +1,347 @@
+/*
+  This file is part of p4est.
+  p4est is a C library to manage a collection (a forest) of multiple
+  connected adaptive quadtrees or octrees in parallel.
+
+  Copyright (C) 2010 The University of Texas System
+  Additional copyright (C) 2011 individual authors
+  Written by Carsten Burstedde, Lucas C. Wilcox, and Tobin Isaac
+
+  p4est is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  p4est is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with p4est; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*/
+
+#ifndef P4_TO_P8
+#include <p4est_bits.h>
+#include <p4est_extended.h>
+#include <p4est_query.h>
+#else
+#include <p8est_bits.h>
+#include <p8est_extended.h>
+#include <p8est_query.h>
+#endif
+
+#define TEST_QUERY_NUM 32
+#define TEST_QUERY_K 5
+
+static int
+refine_fn (p4est_t * p4est, p4est_topidx_t which_tree,
+           p4est_quadrant_t * quadrant)
+{
+  const int           id = p4est_quadrant_child_id (quadrant);
+
+  if ((int) quadrant->level >= 5) {
+    return 0;
+  }
+  return quadrant->level < 2 || (id + (int) which_tree) % 3 == 0;
+}
+
+/** Return a random number in [a, b]. */
+static double
+random_range (double a, double b)
+{
+  return a + (b - a) * rand () / (double) RAND_MAX;
+}
+
+/** Compute the distance from a point to each local leaf of a brick. */
+static void
+leaf_distances (p4est_t * p4est, const double xyz[3], double *dist)
+{
+  const double        rlen = (double) P4EST_ROOT_LEN;
+  int                 j;
+  double              lo[3], len, d, dist2;
+  const double       *v;
+  size_t              zz;
+  p4est_topidx_t      jt;
+  p4est_tree_t       *tree;
+  p4est_quadrant_t   *q;
+
+  for (jt = p4est->first_local_tree; jt <= p4est->last_local_tree; ++jt) {
+    tree = p4est_tree_array_index (p4est->trees, jt);
+    v = p4est->connectivity->vertices +
+      3 * p4est->connectivity->tree_to_vertex[P4EST_CHILDREN * jt];
+    for (zz = 0; zz < tree->quadrants.elem_count; ++zz) {
+      q = p4est_quadrant_array_index (&tree->quadrants, zz);
+      len = P4EST_QUADRANT_LEN (q->level) / rlen;
+      lo[0] = v[0] + q->x / rlen;
+      lo[1] = v[1] + q->y / rlen;
+#ifndef P4_TO_P8
+      lo[2] = v[2];
+#else
+      lo[2] = v[2] + q->z / rlen;
+#endif
+      dist2 = 0.;
+      for (j = 0; j < P4EST_DIM; ++j) {
+        d = SC_MAX (lo[j] - xyz[j], xyz[j] - lo[j] - len);
+        if (d > 0.) {
+          dist2 += d * d;
+        }
+      }
+#ifndef P4_TO_P8
+      d = xyz[2] - lo[2];
+      dist2 += d * d;
+#endif
+      dist[tree->quadrants_offset + (p4est_locidx_t) zz] = sqrt (dist2);
+    }
+  }
+}
+
+static int
+double_compare (const void *v1, const void *v2)
+{
+  const double        d1 = *(const double *) v1;
+  const double        d2 = *(const double *) v2;
+
+  return d1 < d2 ? -1 : d1 > d2 ? 1 : 0;
+}
+
+/** Compare the radius and nearest queries with a brute force search. */
+static void
+check_queries (p4est_t * p4est, p4est_geometry_t * geom, const int dims[])
+{
+  const p4est_locidx_t num_local = p4est->local_num_quadrants;
+  int                 j, k, count;
+  double              xyz[3 * TEST_QUERY_NUM], radius[TEST_QUERY_NUM];
+  double             *dist, *sorted;
+  size_t              zz, *offsets;
+  p4est_query_leaf_t *leaf;
+  sc_array_t         *aoffsets, *leaves;
+
+  for (k = 0; k < TEST_QUERY_NUM; ++k) {
+    xyz[3 * k + 2] = 0.;
+    for (j = 0; j < P4EST_DIM; ++j) {
+      xyz[3 * k + j] = random_range (-.5, dims[j] + .5);
+    }
+    if (k % 4 == 0) {
+      /* query a point off the plane of the forest */
+      xyz[3 * k + 2] += .25;
+    }
+    radius[k] = random_range (0., .6);
+  }
+
+  dist = P4EST_ALLOC (double, num_local);
+  sorted = P4EST_ALLOC (double, num_local);
+  aoffsets = sc_array_new (sizeof (size_t));
+  leaves = sc_array_new (sizeof (p4est_query_leaf_t));
+
+  /* every leaf within the radius is found with its distance */
+  p4est_query_radius (p4est, geom, TEST_QUERY_NUM, xyz, radius,
+                      aoffsets, leaves);
+  SC_CHECK_ABORT (aoffsets->elem_count == TEST_QUERY_NUM + 1,
+                  "Query radius offsets");
+  offsets = (size_t *) aoffsets->array;
+  SC_CHECK_ABORT (offsets[0] == 0 &&
+                  offsets[TEST_QUERY_NUM] == leaves->elem_count,
+                  "Query radius range");
+  for (k = 0; k < TEST_QUERY_NUM; ++k) {
+    leaf_distances (p4est, xyz + 3 * k, dist);
+    for (count = 0, j = 0; j < (int) num_local; ++j) {
+      count += dist[j] <= radius[k];
+    }
+    SC_CHECK_ABORTF ((size_t) count == offsets[k + 1] - offsets[k],
+                     "Query radius %d count %d expected %d", k,
+                     (int) (offsets[k + 1] - offsets[k]), count);
+    for (zz = offsets[k]; zz < offsets[k + 1]; ++zz) {
+      leaf = (p4est_query_leaf_t *) sc_array_index (leaves, zz);
+      SC_CHECK_ABORT (0 <= leaf->local_num && leaf->local_num < num_local,
+                      "Query radius leaf");
+      SC_CHECK_ABORT (fabs (leaf->distance - dist[leaf->local_num]) < 1e-12,
+                      "Query radius distance");
+      SC_CHECK_ABORT (zz == offsets[k] ||
+                      leaf[-1].distance <= leaf->distance,
+                      "Query radius order");
+    }
+  }
+
+  /* the nearest leaves have the smallest distances */
+  p4est_query_nearest (p4est, geom, TEST_QUERY_NUM, xyz, TEST_QUERY_K,
+                       aoffsets, leaves);
+  SC_CHECK_ABORT (aoffsets->elem_count == TEST_QUERY_NUM + 1,
+                  "Query nearest offsets");
+  offsets = (size_t *) aoffsets->array;
+  for (k = 0; k < TEST_QUERY_NUM; ++k) {
+    leaf_distances (p4est, xyz + 3 * k, dist);
+    memcpy (sorted, dist, num_local * sizeof (double));
+    qsort (sorted, (size_t) num_local, sizeof (double), double_compare);
+    count = SC_MIN (TEST_QUERY_K, (int) num_local);
+    SC_CHECK_ABORTF ((size_t) count == offsets[k + 1] - offsets[k],
+                     "Query nearest %d count %d expected %d", k,
+                     (int) (offsets[k + 1] - offsets[k]), count);
+    for (j = 0; j < count; ++j) {
+      leaf = (p4est_query_leaf_t *) sc_array_index (leaves, offsets[k] + j);
+      SC_CHECK_ABORT (0 <= leaf->local_num && leaf->local_num < num_local,
+                      "Query nearest leaf");
+      SC_CHECK_ABORT (fabs (leaf->distance - dist[leaf->local_num]) < 1e-12,
+                      "Query nearest distance");
+      SC_CHECK_ABORTF (fabs (leaf->distance - sorted[j]) < 1e-12,
+                       "Query nearest %d rank %d distance %g expected %g",
+                       k, j, leaf->distance, sorted[j]);
+    }
+  }
+
+  sc_array_destroy (leaves);
+  sc_array_destroy (aoffsets);
+  P4EST_FREE (sorted);
+  P4EST_FREE (dist);
+}
+
+/** Map a brick through a smooth warp that bends its lines and faces. */
+static void
+warp_X (p4est_geometry_t * geom, p4est_topidx_t which_tree,
+        const double abc[3], double xyz[3])
+{
+  const p4est_connectivity_t *conn = (p4est_connectivity_t *) geom->user;
+  const double       *v = conn->vertices +
+    3 * conn->tree_to_vertex[P4EST_CHILDREN * which_tree];
+  double              r[3];
+  int                 j;
+
+  for (j = 0; j < 3; ++j) {
+    r[j] = v[j] + abc[j];
+  }
+  xyz[0] = r[0] + .2 * sin (M_PI * r[1] + 1.);
+  xyz[1] = r[1] + .2 * sin (M_PI * (r[0] + r[2]) + 2.);
+  xyz[2] = r[2] + .2 * sin (M_PI * r[0] + 1.);
+}
+
+/** Every leaf is found by a query at a point of its curved image. */
+static void
+check_warp (p4est_t * p4est, p4est_connectivity_t * conn)
+{
+  const double        rlen = (double) P4EST_ROOT_LEN;
+  const p4est_locidx_t num_local = p4est->local_num_quadrants;
+  int                 j, k, edge, found;
+  double              xyz[3 * TEST_QUERY_NUM], radius[TEST_QUERY_NUM];
+  double              abc[3], len;
+  p4est_locidx_t      il, lnum[TEST_QUERY_NUM];
+  p4est_topidx_t      jt;
+  size_t              zz, *offsets;
+  p4est_tree_t       *tree;
+  p4est_quadrant_t   *q;
+  p4est_geometry_t    geom;
+  p4est_query_leaf_t *leaf;
+  sc_array_t         *aoffsets, *leaves;
+
+  if (num_local == 0) {
+    return;
+  }
+  geom.name = "warp";
+  geom.user = conn;
+  geom.X = warp_X;
+  geom.destroy = NULL;
+
+  /* map a point of a random leaf */
+  for (k = 0; k < TEST_QUERY_NUM; ++k) {
+    il = lnum[k] = rand () % num_local;
+    for (jt = p4est->first_local_tree;; ++jt) {
+      tree = p4est_tree_array_index (p4est->trees, jt);
+      if (il < tree->quadrants_offset +
+          (p4est_locidx_t) tree->quadrants.elem_count) {
+        break;
+      }
+    }
+    q = p4est_quadrant_array_index (&tree->quadrants,
+                                    (size_t) (il - tree->quadrants_offset));
+    /* a point on an edge of the leaf, where its image bulges the most */
+    len = P4EST_QUADRANT_LEN (q->level) / rlen;
+    edge = k % P4EST_DIM;
+    for (j = 0; j < P4EST_DIM; ++j) {
+      abc[j] = j == edge ? random_range (0., len) : (rand () & 1) * len;
+    }
+    abc[0] += q->x / rlen;
+    abc[1] += q->y / rlen;
+#ifndef P4_TO_P8
+    abc[2] = 0.;
+#else
+    abc[2] += q->z / rlen;
+#endif
+    warp_X (&geom, jt, abc, xyz + 3 * k);
+    radius[k] = 0.;
+  }
+
+  aoffsets = sc_array_new (sizeof (size_t));
+  leaves = sc_array_new (sizeof (p4est_query_leaf_t));
+  p4est_query_radius (p4est, &geom, TEST_QUERY_NUM, xyz, radius,
+                      aoffsets, leaves);
+  offsets = (size_t *) aoffsets->array;
+  for (k = 0; k < TEST_QUERY_NUM; ++k) {
+    found = 0;
+    for (zz = offsets[k]; zz < offsets[k + 1]; ++zz) {
+      leaf = (p4est_query_leaf_t *) sc_array_index (leaves, zz);
+      found |= leaf->local_num == lnum[k];
+    }
+    SC_CHECK_ABORTF (found, "Query warp %d leaf %d", k, (int) lnum[k]);
+  }
+
+  /* the nearest leaf is at distance zero */
+  p4est_query_nearest (p4est, &geom, TEST_QUERY_NUM, xyz, 1,
+                       aoffsets, leaves);
+  offsets = (size_t *) aoffsets->array;
+  for (k = 0; k < TEST_QUERY_NUM; ++k) {
+    SC_CHECK_ABORT (offsets[k + 1] - offsets[k] == 1, "Query warp nearest");
+    leaf = (p4est_query_leaf_t *) sc_array_index (leaves, offsets[k]);
+    SC_CHECK_ABORT (leaf->distance == 0., "Query warp distance");
+  }
+
+  sc_array_destroy (leaves);
+  sc_array_destroy (aoffsets);
+}
+
+int
+main (int argc, char **argv)
+{
+  int                 mpiret;
+  int                 dims[P4EST_DIM];
+  sc_MPI_Comm         mpicomm;
+  p4est_connectivity_t *conn;
+  p4est_geometry_t   *geom;
+  p4est_t            *p4est;
+
+  mpiret = sc_MPI_Init (&argc, &argv);
+  SC_CHECK_MPI (mpiret);
+  mpicomm = sc_MPI_COMM_WORLD;
+
+  sc_init (mpicomm, 1, 1, NULL, SC_LP_DEFAULT);
+  p4est_init (NULL, SC_LP_DEFAULT);
+
+  dims[0] = 3;
+  dims[1] = 2;
+#ifndef P4_TO_P8
+  conn = p4est_connectivity_new_brick (dims[0], dims[1], 0, 0);
+#else
+  dims[2] = 2;
+  conn = p8est_connectivity_new_brick (dims[0], dims[1], dims[2], 0, 0, 0);
+#endif
+  p4est = p4est_new_ext (mpicomm, conn, 0, 0, 1, 0, NULL, NULL);
+  p4est_refine (p4est, 1, refine_fn, NULL);
+  p4est_partition (p4est, 0, NULL);
+  srand (1 + p4est->mpirank);
+
+  /* query through the vertices and through a geometry */
+  check_queries (p4est, NULL, dims);
+  geom = p4est_geometry_new_connectivity (conn);
+  check_queries (p4est, geom, dims);
+  p4est_geometry_destroy (geom);
+  check_warp (p4est, conn);
+
+  p4est_destroy (p4est);
+  p4est_connectivity_destroy (conn);
+
+  sc_finalize ();
+
+  mpiret = sc_MPI_Finalize ();
+  SC_CHECK_MPI (mpiret);
+
+  return 0;
+}
@@ -0,0 +1,275 @@
+/*
+  This file is part of p4est.
+  p4est is a C library to manage a collection (a forest) of multiple
+  connected adaptive quadtrees or octrees in parallel.
+
+  Copyright (C) 2010 The University of Texas System
+  Additional copyright (C) 2011 individual authors
+  Written by Carsten Burstedde, Lucas C. Wilcox, and Tobin Isaac
+
+  p4est is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  p4est is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with p4est; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*/
+
+#ifndef P4_TO_P8
+#include <p4est_bits.h>
+#include <p4est_extended.h>
+#include <p4est_ray.h>
+#else
+#include <p8est_bits.h>
+#include <p8est_extended.h>
+#include <p8est_ray.h>
+#endif
+
+#define TEST_RAY_NUM 16
+
+static int
+refine_fn (p4est_t * p4est, p4est_topidx_t which_tree,
+           p4est_quadrant_t * quadrant)
+{
+  const int           id = p4est_quadrant_child_id (quadrant);
+
+  if ((int) quadrant->level >= 5) {
+    return 0;
+  }
+  return quadrant->level < 2 || (id + (int) which_tree) % 3 == 0;
+}
+
+/** Return a random number in [a, b]. */
+static double
+random_range (double a, double b)
+{
+  return a + (b - a) * rand () / (double) RAND_MAX;
+}
+
+/** Compute the lower corner of a tree of a brick in physical space. */
+static void
+tree_corner (p4est_connectivity_t * conn, p4est_topidx_t which_tree,
+             double corner[3])
+{
+  const double       *v =
+    conn->vertices + 3 * conn->tree_to_vertex[P4EST_CHILDREN * which_tree];
+
+  corner[0] = v[0];
+  corner[1] = v[1];
+  corner[2] = v[2];
+}
+
+/** Check that the crossings of all rays add up to their expected length
+ * and that each crossed leaf contains the midpoint of its crossing.
+ * If the domain is periodic, no ray leaves it and positions are not
+ * checked since the rays may wrap around. */
+static void
+check_rays (p4est_t * p4est, p4est_ghost_t * ghost, const int dims[],
+            int periodic)
+{
+  const int           num_total = TEST_RAY_NUM * p4est->mpisize;
+  const double        rlen = (double) P4EST_ROOT_LEN;
+  int                 mpiret;
+  int                 i, k;
+  double             *expected, *found, *buffer;
+  double              corner[3], scorner[3], lq[P4EST_DIM];
+  double              lo, hi, len, t0, t1, ta, tb, mid, pos;
+  size_t              zz;
+  p4est_ray_t        *ray, *start;
+  p4est_ray_leaf_t   *rl;
+  p4est_tree_t       *tree;
+  p4est_quadrant_t   *leaf;
+  sc_array_t         *rays, *leaves;
+
+  /* create random rays that start on this process */
+  rays = sc_array_new_size (sizeof (p4est_ray_t), TEST_RAY_NUM);
+  expected = P4EST_ALLOC_ZERO (double, num_total);
+  for (k = 0; k < TEST_RAY_NUM; ++k) {
+    ray = (p4est_ray_t *) sc_array_index_int (rays, k);
+    ray->id = (p4est_gloidx_t) p4est->mpirank * TEST_RAY_NUM + k;
+    ray->which_tree =
+      (p4est_topidx_t) (rand () % p4est->connectivity->num_trees);
+    ray->origin[2] = ray->direction[2] = 0.;
+    for (i = 0; i < P4EST_DIM; ++i) {
+      ray->origin[i] = random_range (0., 1.);
+      ray->direction[i] = random_range (-1., 1.);
+    }
+    ray->direction[k % P4EST_DIM] += ray->direction[k % P4EST_DIM] >= 0. ?
+      .1 : -.1;
+    ray->tmin = random_range (-1., 1.);
+    ray->tmax = ray->tmin + random_range (.5, 4.);
+
+    /* clip the parameter range against the brick */
+    t0 = ray->tmin;
+    t1 = ray->tmax;
+    if (!periodic) {
+      tree_corner (p4est->connectivity, ray->which_tree, corner);
+      for (i = 0; i < P4EST_DIM; ++i) {
+        pos = corner[i] + ray->origin[i];
+        if (ray->direction[i] != 0.) {
+          ta = ray->tmin + (0. - pos) / ray->direction[i];
+          tb = ray->tmin + (dims[i] - pos) / ray->direction[i];
+          t0 = SC_MAX (t0, SC_MIN (ta, tb));
+          t1 = SC_MIN (t1, SC_MAX (ta, tb));
+        }
+      }
+    }
+    expected[ray->id] = SC_MAX (t1 - t0, 0.);
+  }
+
+  /* traverse the forest and check the crossed leaves */
+  leaves = p4est_ray_traverse (p4est, ghost, rays);
+  found = P4EST_ALLOC_ZERO (double, num_total);
+  for (zz = 0; zz < leaves->elem_count; ++zz) {
+    rl = (p4est_ray_leaf_t *) sc_array_index (leaves, zz);
+    SC_CHECK_ABORT (rl->entry < rl->exit, "Ray crossing order");
+    SC_CHECK_ABORT (0 <= rl->id && rl->id < num_total, "Ray id");
+    if (rl->local_num < p4est->local_num_quadrants) {
+      tree = p4est_tree_array_index (p4est->trees, rl->which_tree);
+      SC_CHECK_ABORT (tree->quadrants_offset <= rl->local_num,
+                      "Ray local tree");
+      leaf = p4est_quadrant_array_index (&tree->quadrants,
+                                         (size_t) (rl->local_num -
+                                                   tree->quadrants_offset));
+    }
+    else {
+      SC_CHECK_ABORT (ghost != NULL, "Ray ghost");
+      leaf = p4est_quadrant_array_index (&ghost->ghosts,
+                                         (size_t) (rl->local_num -
+                                                   p4est->
+                                                   local_num_quadrants));
+      SC_CHECK_ABORT (leaf->p.piggy3.which_tree == rl->which_tree,
+                      "Ray ghost tree");
+    }
+    if (!periodic) {
+      /* the ray is straight in the brick, so we can check the position */
+      for (start = NULL, k = 0; k < TEST_RAY_NUM; ++k) {
+        ray = (p4est_ray_t *) sc_array_index_int (rays, k);
+        if (ray->id == rl->id) {
+          start = ray;
+        }
+      }
+      if (start != NULL) {
+        mid = .5 * (rl->entry + rl->exit);
+        tree_corner (p4est->connectivity, start->which_tree, scorner);
+        tree_corner (p4est->connectivity, rl->which_tree, corner);
+        len = P4EST_QUADRANT_LEN (leaf->level) / rlen;
+        lq[0] = leaf->x / rlen;
+        lq[1] = leaf->y / rlen;
+#ifdef P4_TO_P8
+        lq[2] = leaf->z / rlen;
+#endif
+        for (i = 0; i < P4EST_DIM; ++i) {
+          pos = scorner[i] + start->origin[i] +
+            (mid - start->tmin) * start->direction[i];
+          lo = corner[i] + lq[i];
+          hi = lo + len;
+          SC_CHECK_ABORT (lo - 1e-10 <= pos && pos <= hi + 1e-10,
+                          "Ray leaf position");
+        }
+      }
+    }
+    found[rl->id] += rl->exit - rl->entry;
+  }
+
+  /* compare the total length of each ray */
+  buffer = P4EST_ALLOC (double, num_total);
+  mpiret = sc_MPI_Allreduce (expected, buffer, num_total, sc_MPI_DOUBLE,
+                             sc_MPI_SUM, p4est->mpicomm);
+  SC_CHECK_MPI (mpiret);
+  memcpy (expected, buffer, num_total * sizeof (double));
+  mpiret = sc_MPI_Allreduce (found, buffer, num_total, sc_MPI_DOUBLE,
+                             sc_MPI_SUM, p4est->mpicomm);
+  SC_CHECK_MPI (mpiret);
+  for (k = 0; k < num_total; ++k) {
+    SC_CHECK_ABORTF (fabs (buffer[k] - expected[k]) < 1e-8,
+                     "Ray %d length %g expected %g", k, buffer[k],
+                     expected[k]);
+  }
+
+  P4EST_FREE (buffer);
+  P4EST_FREE (found);
+  P4EST_FREE (expected);
+  sc_array_destroy (leaves);
+  sc_array_destroy (rays);
+}
+
+int
+main (int argc, char **argv)
+{
+  sc_MPI_Comm         mpicomm;
+  int                 mpiret;
+  int                 mpirank;
+  int                 periodic;
+  int                 dims[P4EST_DIM];
+  p4est_connectivity_t *conn;
+  p4est_ghost_t      *ghost;
+  p4est_t            *p4est;
+
+  /* initialize MPI */
+  mpiret = sc_MPI_Init (&argc, &argv);
+  SC_CHECK_MPI (mpiret);
+  mpicomm = sc_MPI_COMM_WORLD;
+  mpiret = sc_MPI_Comm_rank (mpicomm, &mpirank);
+  SC_CHECK_MPI (mpiret);
+
+  sc_init (mpicomm, 1, 1, NULL, SC_LP_DEFAULT);
+  p4est_init (NULL, SC_LP_DEFAULT);
+  srand (17 + mpirank);
+
+  dims[0] = 3;
+  dims[1] = 2;
+#ifdef P4_TO_P8
+  dims[2] = 2;
+#endif
+  for (periodic = 0; periodic < 2; ++periodic) {
+#ifndef P4_TO_P8
+    conn = p4est_connectivity_new_brick (dims[0], dims[1],
+                                         periodic, periodic);
+#else
+    conn = p8est_connectivity_new_brick (dims[0], dims[1], dims[2],
+                                         periodic, periodic, periodic);
+#endif
+    p4est = p4est_new_ext (mpicomm, conn, 0, 0, 1, 0, NULL, NULL);
+    p4est_refine (p4est, 1, refine_fn, NULL);
+    p4est_partition (p4est, 0, NULL);
+
+    /* rays are handed off at every process boundary without ghosts */
+    check_rays (p4est, NULL, dims, periodic);
+
+    /* with ghosts they may cross the ghost layer before a hand-off */
+    ghost = p4est_ghost_new (p4est, P4EST_CONNECT_FULL);
+    check_rays (p4est, ghost, dims, periodic);
+    p4est_ghost_destroy (ghost);
+
+    p4est_destroy (p4est);
+    p4est_connectivity_destroy (conn);
+  }
+
+#ifndef P4_TO_P8
+  /* a closed domain whose faces are connected with reversed orientation */
+  conn = p4est_connectivity_new_rotwrap ();
+  p4est = p4est_new_ext (mpicomm, conn, 0, 0, 1, 0, NULL, NULL);
+  p4est_refine (p4est, 1, refine_fn, NULL);
+  p4est_partition (p4est, 0, NULL);
+  ghost = p4est_ghost_new (p4est, P4EST_CONNECT_FULL);
+  check_rays (p4est, ghost, dims, 1);
+  p4est_ghost_destroy (ghost);
+  p4est_destroy (p4est);
+  p4est_connectivity_destroy (conn);
+#endif
+
+  sc_finalize ();
+
+  mpiret = sc_MPI_Finalize ();
+  SC_CHECK_MPI (mpiret);
+
+  return 0;
+}
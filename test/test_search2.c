@@ -146,19 +146,214 @@ search_callback (p4est_t * p4est, p4est_topidx_t which_tree,
   return is_match;
 }
 
+static void
+search_batch_callback (p4est_t * p4est, p4est_topidx_t which_tree,
+                       p4est_quadrant_t * quadrant, p4est_locidx_t local_num,
+                       sc_array_t * points, const size_t * actives,
+                       size_t num_actives, int *matches)
+{
+  size_t              zz;
+
+  SC_CHECK_ABORT (num_actives > 0, "Batch without points");
+  for (zz = 0; zz < num_actives; ++zz) {
+    matches[zz] = search_callback (p4est, which_tree, quadrant, local_num,
+                                   sc_array_index (points, actives[zz]));
+  }
+}
+
+/** Compare a position in a tree with the first position of a process. */
+static int
+compare_position (p4est_topidx_t which_tree, const p4est_quadrant_t * q,
+                  const p4est_quadrant_t * pos)
+{
+  if (which_tree != pos->p.which_tree) {
+    return which_tree < pos->p.which_tree ? -1 : 1;
+  }
+  return p4est_quadrant_compare (q, pos);
+}
+
+/** Return whether the partition of a process overlaps a quadrant. */
+static int
+process_overlaps (p4est_t * p4est, int p, p4est_topidx_t which_tree,
+                  const p4est_quadrant_t * quadrant)
+{
+  const p4est_quadrant_t *gfp = p4est->global_first_position;
+  p4est_quadrant_t    first, last;
+
+  if (p < 0 || p >= p4est->mpisize ||
+      p4est->global_first_quadrant[p] ==
+      p4est->global_first_quadrant[p + 1]) {
+    return 0;
+  }
+  p4est_quadrant_first_descendant (quadrant, &first, P4EST_QMAXLEVEL);
+  p4est_quadrant_last_descendant (quadrant, &last, P4EST_QMAXLEVEL);
+  return compare_position (which_tree, &last, &gfp[p]) >= 0 &&
+    compare_position (which_tree, &first, &gfp[p + 1]) < 0;
+}
+
+static int
+traverse_callback (p4est_t * p4est, p4est_topidx_t which_tree,
+                   p4est_quadrant_t * quadrant, int pfirst, int plast)
+{
+  int                 p;
+
+  SC_CHECK_ABORT (pfirst <= plast, "Traverse range");
+  SC_CHECK_ABORT (process_overlaps (p4est, pfirst, which_tree, quadrant) &&
+                  process_overlaps (p4est, plast, which_tree, quadrant),
+                  "Traverse first and last");
+  for (p = 0; p < p4est->mpisize; ++p) {
+    if (p < pfirst || p > plast) {
+      SC_CHECK_ABORT (!process_overlaps (p4est, p, which_tree, quadrant),
+                      "Traverse outside");
+    }
+  }
+  ++found_count;
+
+  return 1;
+}
+
+static int
+partition_callback (p4est_t * p4est, p4est_topidx_t which_tree,
+                    p4est_quadrant_t * quadrant, int pfirst, int plast,
+                    void *point)
+{
+  test_point_t       *p = (test_point_t *) point;
+
+  P4EST_ASSERT (point != NULL);
+
+  if (which_tree != p->quad.p.piggy3.which_tree) {
+    return 0;
+  }
+  return p4est_quadrant_is_equal (quadrant, &p->quad) ||
+    p4est_quadrant_is_ancestor (quadrant, &p->quad) ||
+    p4est_quadrant_is_ancestor (&p->quad, quadrant);
+}
+
+static int
+locate_callback (p4est_t * p4est, p4est_topidx_t which_tree,
+                 p4est_quadrant_t * quadrant, p4est_locidx_t local_num,
+                 void *point)
+{
+  p4est_quadrant_t   *node = (p4est_quadrant_t *) point;
+
+  /* this callback is reentrant and only writes to its own point */
+  if (which_tree != node->p.piggy3.which_tree ||
+      !p4est_quadrant_contains_node (quadrant, node)) {
+    return 0;
+  }
+  if (local_num >= 0) {
+    node->p.piggy3.local_num = local_num;
+  }
+  return 1;
+}
+
+static void
+check_locate (p4est_t * p4est)
+{
+  const int           num_points = 1000;
+  const p4est_qcoord_t mask = ~(P4EST_QUADRANT_LEN (P4EST_QMAXLEVEL) - 1);
+  int                 mpiret;
+  int                 k, found_count, found_total;
+  uint64_t            seed;
+  p4est_locidx_t      loc;
+  p4est_quadrant_t   *point, *quad;
+  p4est_tree_t       *tree;
+  sc_array_t         *points, *locations;
+  sc_array_t         *first, *first_locations;
+
+  /* all processes create the same pseudo-random clamped nodes */
+  points = sc_array_new_size (sizeof (p4est_quadrant_t), num_points);
+  seed = 17;
+  for (k = 0; k < num_points; ++k) {
+    point = p4est_quadrant_array_index (points, k);
+    P4EST_QUADRANT_INIT (point);
+    seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+    point->x = (p4est_qcoord_t) ((seed >> 33) % P4EST_ROOT_LEN) & mask;
+    seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+    point->y = (p4est_qcoord_t) ((seed >> 33) % P4EST_ROOT_LEN) & mask;
+#ifdef P4_TO_P8
+    seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+    point->z = (p4est_qcoord_t) ((seed >> 33) % P4EST_ROOT_LEN) & mask;
+#endif
+    point->level = P4EST_MAXLEVEL;
+    point->p.piggy3.which_tree = k % p4est->connectivity->num_trees;
+    point->p.piggy3.local_num = -1;
+  }
+
+  /* every located point must be contained in its quadrant */
+  locations = sc_array_new (sizeof (p4est_locidx_t));
+  p4est_locate_points (p4est, points, locations);
+  SC_CHECK_ABORT ((int) locations->elem_count == num_points, "Locate size");
+  found_count = 0;
+  for (k = 0; k < num_points; ++k) {
+    loc = *(p4est_locidx_t *) sc_array_index_int (locations, k);
+    if (loc < 0) {
+      continue;
+    }
+    point = p4est_quadrant_array_index (points, k);
+    tree = p4est_tree_array_index (p4est->trees, point->p.which_tree);
+    SC_CHECK_ABORT (tree->quadrants_offset <= loc &&
+                    loc < tree->quadrants_offset +
+                    (p4est_locidx_t) tree->quadrants.elem_count,
+                    "Locate tree");
+    quad = p4est_quadrant_array_index (&tree->quadrants,
+                                       loc - tree->quadrants_offset);
+    SC_CHECK_ABORT (p4est_quadrant_contains_node (quad, point),
+                    "Locate contains");
+    ++found_count;
+  }
+
+  /* the partition covers the domain, so each point is found exactly once */
+  mpiret = sc_MPI_Allreduce (&found_count, &found_total,
+                             1, sc_MPI_INT, sc_MPI_SUM, p4est->mpicomm);
+  SC_CHECK_MPI (mpiret);
+  SC_CHECK_ABORT (found_total == num_points, "Locate count");
+
+  /* trees without points, including the last local one, are skipped */
+  first = sc_array_new (sizeof (p4est_quadrant_t));
+  first_locations = sc_array_new (sizeof (p4est_locidx_t));
+  for (k = 0; k < num_points; k += p4est->connectivity->num_trees) {
+    *p4est_quadrant_array_push (first) =
+      *p4est_quadrant_array_index (points, k);
+  }
+  p4est_locate_points (p4est, first, first_locations);
+  for (k = 0; k < (int) first->elem_count; ++k) {
+    SC_CHECK_ABORT (*(p4est_locidx_t *) sc_array_index_int
+                    (first_locations, k) ==
+                    *(p4est_locidx_t *) sc_array_index_int
+                    (locations, k * p4est->connectivity->num_trees),
+                    "Locate first tree");
+  }
+  sc_array_destroy (first_locations);
+  sc_array_destroy (first);
+
+  /* a threaded search must find the same quadrants */
+  p4est_search_threads (p4est, 0, NULL, locate_callback, points);
+  for (k = 0; k < num_points; ++k) {
+    loc = *(p4est_locidx_t *) sc_array_index_int (locations, k);
+    point = p4est_quadrant_array_index (points, k);
+    SC_CHECK_ABORT (point->p.piggy3.local_num == loc, "Threaded search");
+  }
+
+  sc_array_destroy (locations);
+  sc_array_destroy (points);
+}
+
 int
 main (int argc, char **argv)
 {
   sc_MPI_Comm         mpicomm;
   int                 mpiret;
   int                 found_total;
+  int                 k, q, level, *source;
+  int                 route_count, route_total;
   p4est_locidx_t      jt, Al, Bl;
   p4est_locidx_t      local_count;
   p4est_connectivity_t *conn;
   p4est_quadrant_t   *A, *B;
   p4est_geometry_t   *geom;
   p4est_t            *p4est;
-  sc_array_t         *points;
+  sc_array_t         *points, *routed, *sources;
   test_point_t       *p;
   const char         *vtkname;
 
@@ -239,11 +434,73 @@ main (int argc, char **argv)
   SC_CHECK_ABORT (A->p.piggy3.local_num == Al, "Search A");
   SC_CHECK_ABORT (B->p.piggy3.local_num == Bl, "Search B");
 
+  /* Repeat the search with the batch callback */
+  found_count = 0;
+  A->p.piggy3.local_num = B->p.piggy3.local_num = -1;
+  p4est_search_batch (p4est, NULL, search_batch_callback, points);
+  mpiret = sc_MPI_Allreduce (&found_count, &found_total,
+                             1, sc_MPI_INT, sc_MPI_SUM, mpicomm);
+  SC_CHECK_MPI (mpiret);
+  SC_CHECK_ABORT (found_total == (int) points->elem_count, "Batch search");
+  SC_CHECK_ABORT (A->p.piggy3.local_num == Al, "Batch A");
+  SC_CHECK_ABORT (B->p.piggy3.local_num == Bl, "Batch B");
+
   /* Use another search to count local quadrants */
   local_count = 0;
   p4est_search (p4est, count_callback, NULL, NULL);
   SC_CHECK_ABORT (local_count == p4est->local_num_quadrants, "Count search");
 
+  /* Traverse the whole partition */
+  found_count = 0;
+  p4est_traverse (p4est, traverse_callback);
+  SC_CHECK_ABORT (found_count >= conn->num_trees, "Traverse partition");
+
+  /* Send quadrants to the processes whose partition overlaps them */
+  sc_array_destroy (points);
+  points = sc_array_new_size (sizeof (test_point_t), 8);
+  route_count = 0;
+  for (k = 0; k < (int) points->elem_count; ++k) {
+    p = (test_point_t *) sc_array_index_int (points, k);
+    p->name = NULL;
+    level = k % 4;
+    P4EST_QUADRANT_INIT (&p->quad);
+    p4est_quadrant_set_morton (&p->quad, level, (uint64_t)
+                               (7 * p4est->mpirank + 5 * k) %
+                               ((uint64_t) 1 << (P4EST_DIM * level)));
+    p->quad.p.piggy3.which_tree =
+      (p4est_topidx_t) ((p4est->mpirank + k) % conn->num_trees);
+    for (q = 0; q < p4est->mpisize; ++q) {
+      route_count += process_overlaps (p4est, q, p->quad.p.piggy3.which_tree,
+                                       &p->quad);
+    }
+  }
+  sources = sc_array_new (sizeof (int));
+  routed = p4est_search_partition_route (p4est, partition_callback, points,
+                                         sources);
+  SC_CHECK_ABORT (routed->elem_count == sources->elem_count, "Route sources");
+  for (k = 0; k < (int) routed->elem_count; ++k) {
+    p = (test_point_t *) sc_array_index_int (routed, k);
+    source = (int *) sc_array_index_int (sources, k);
+    SC_CHECK_ABORT (0 <= *source && *source < p4est->mpisize &&
+                    (k == 0 || source[-1] <= *source), "Route order");
+    SC_CHECK_ABORT (process_overlaps (p4est, p4est->mpirank,
+                                      p->quad.p.piggy3.which_tree, &p->quad),
+                    "Route owner");
+  }
+  mpiret = sc_MPI_Allreduce (&route_count, &route_total,
+                             1, sc_MPI_INT, sc_MPI_SUM, mpicomm);
+  SC_CHECK_MPI (mpiret);
+  route_count = (int) routed->elem_count;
+  mpiret = sc_MPI_Allreduce (&route_count, &found_total,
+                             1, sc_MPI_INT, sc_MPI_SUM, mpicomm);
+  SC_CHECK_MPI (mpiret);
+  SC_CHECK_ABORT (found_total == route_total, "Route count");
+  sc_array_destroy (sources);
+  sc_array_destroy (routed);
+
+  /* Locate many points by a sorted merge */
+  check_locate (p4est);
+
   /* Clear memory */
   sc_array_destroy (points);
   p4est_destroy (p4est);
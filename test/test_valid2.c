@@ -95,6 +95,134 @@ coarsen_fn (p4est_t * p4est, p4est_topidx_t which_tree,
   return pid == 3;
 }
 
+/** Compare the coordinates and tree of two nodes of any type. */
+static int
+node_is_equal (const void *v1, const void *v2)
+{
+  const p4est_quadrant_t *n1 = (const p4est_quadrant_t *) v1;
+  const p4est_quadrant_t *n2 = (const p4est_quadrant_t *) v2;
+
+  return n1->x == n2->x && n1->y == n2->y &&
+#ifdef P4_TO_P8
+    n1->z == n2->z &&
+#endif
+    n1->level == n2->level && n1->p.which_tree == n2->p.which_tree;
+}
+
+/** Copy the sharers of an independent node and sort them. */
+static int         *
+sharers_sorted (p4est_nodes_t * nodes, p4est_indep_t * in, int *buffer)
+{
+  sc_recycle_array_t *rarr;
+
+  rarr = (sc_recycle_array_t *) sc_array_index (&nodes->shared_indeps,
+                                                (size_t) in->pad8 - 1);
+  memcpy (buffer, sc_array_index (&rarr->a, (size_t) in->pad16),
+          in->pad8 * sizeof (int));
+  qsort (buffer, (size_t) in->pad8, sizeof (int), sc_int_compare);
+  return buffer;
+}
+
+/** Build the nodes by sorting in the given number of threads and compare
+ * them with the hashed version. */
+static void
+check_nodes_sort (p4est_t * p4est, p4est_ghost_t * ghost,
+                  p4est_nodes_t * nodes, int num_threads)
+{
+  p4est_locidx_t      il, num_indep, num_nodes;
+  size_t              zz;
+  p4est_indep_t      *i1, *i2;
+#ifndef P4_TO_P8
+  p4est_hang2_t      *f1, *f2;
+#else
+  p8est_hang4_t      *f1, *f2;
+  p8est_hang2_t      *e1, *e2;
+#endif
+  int                 buffer1[INT8_MAX], buffer2[INT8_MAX];
+  int                *sharers1, *sharers2;
+  p4est_inspect_t     inspect;
+  p4est_nodes_t      *sorted;
+
+  memset (&inspect, 0, sizeof (inspect));
+  inspect.use_nodes_sort = 1;
+  inspect.nodes_num_threads = num_threads;
+  p4est->inspect = &inspect;
+  sorted = p4est_nodes_new (p4est, ghost);
+  p4est->inspect = NULL;
+
+  SC_CHECK_ABORT (sorted->num_owned_indeps == nodes->num_owned_indeps &&
+                  sorted->num_owned_shared == nodes->num_owned_shared &&
+                  sorted->offset_owned_indeps == nodes->offset_owned_indeps,
+                  "Sorted nodes counts");
+  SC_CHECK_ABORT (sorted->indep_nodes.elem_count ==
+                  nodes->indep_nodes.elem_count &&
+                  sorted->face_hangings.elem_count ==
+                  nodes->face_hangings.elem_count
+#ifdef P4_TO_P8
+                  && sorted->edge_hangings.elem_count ==
+                  nodes->edge_hangings.elem_count
+#endif
+                  , "Sorted nodes sizes");
+  num_indep = (p4est_locidx_t) nodes->indep_nodes.elem_count;
+  for (zz = 0; zz < nodes->indep_nodes.elem_count; ++zz) {
+    i1 = (p4est_indep_t *) sc_array_index (&nodes->indep_nodes, zz);
+    i2 = (p4est_indep_t *) sc_array_index (&sorted->indep_nodes, zz);
+    SC_CHECK_ABORT (node_is_equal (i1, i2) && i1->pad8 == i2->pad8 &&
+                    i1->p.piggy3.local_num == i2->p.piggy3.local_num,
+                    "Sorted independent node");
+    if (i1->pad8 > 0 && nodes->shared_offsets == NULL &&
+        sorted->shared_offsets == NULL) {
+      /* the sharers are stored in the order the queries arrived */
+      sharers1 = sharers_sorted (nodes, i1, buffer1);
+      sharers2 = sharers_sorted (sorted, i2, buffer2);
+      SC_CHECK_ABORT (!memcmp (sharers1, sharers2,
+                               i1->pad8 * sizeof (int)),
+                      "Sorted node sharers");
+    }
+  }
+  for (zz = 0; zz < nodes->face_hangings.elem_count; ++zz) {
+#ifndef P4_TO_P8
+    f1 = (p4est_hang2_t *) sc_array_index (&nodes->face_hangings, zz);
+    f2 = (p4est_hang2_t *) sc_array_index (&sorted->face_hangings, zz);
+#else
+    f1 = (p8est_hang4_t *) sc_array_index (&nodes->face_hangings, zz);
+    f2 = (p8est_hang4_t *) sc_array_index (&sorted->face_hangings, zz);
+#endif
+    SC_CHECK_ABORT (node_is_equal (f1, f2) &&
+                    !memcmp (f1->p.piggy.depends, f2->p.piggy.depends,
+                             sizeof (f1->p.piggy.depends)),
+                    "Sorted face hanging node");
+  }
+#ifdef P4_TO_P8
+  for (zz = 0; zz < nodes->edge_hangings.elem_count; ++zz) {
+    e1 = (p8est_hang2_t *) sc_array_index (&nodes->edge_hangings, zz);
+    e2 = (p8est_hang2_t *) sc_array_index (&sorted->edge_hangings, zz);
+    SC_CHECK_ABORT (node_is_equal (e1, e2) &&
+                    !memcmp (e1->p.piggy.depends, e2->p.piggy.depends,
+                             sizeof (e1->p.piggy.depends)),
+                    "Sorted edge hanging node");
+  }
+#endif
+  num_nodes = P4EST_CHILDREN * nodes->num_local_quadrants;
+  for (il = 0; il < num_nodes; ++il) {
+    SC_CHECK_ABORT (sorted->local_nodes[il] == nodes->local_nodes[il],
+                    "Sorted local nodes");
+  }
+  for (il = 0; il < num_indep - nodes->num_owned_indeps; ++il) {
+    SC_CHECK_ABORT (sorted->nonlocal_ranks[il] == nodes->nonlocal_ranks[il],
+                    "Sorted nonlocal ranks");
+  }
+  for (il = 0; il < p4est->mpisize; ++il) {
+    SC_CHECK_ABORT (sorted->global_owned_indeps[il] ==
+                    nodes->global_owned_indeps[il],
+                    "Sorted global owned nodes");
+  }
+  SC_CHECK_ABORT (sorted->shared_indeps.elem_count ==
+                  nodes->shared_indeps.elem_count, "Sorted shared nodes");
+
+  p4est_nodes_destroy (sorted);
+}
+
 static void
 check_all (sc_MPI_Comm mpicomm, p4est_connectivity_t * conn,
            const char *vtkname, unsigned crc_expected, unsigned gcrc_expected)
@@ -145,6 +273,13 @@ check_all (sc_MPI_Comm mpicomm, p4est_connectivity_t * conn,
   }
 
   nodes = p4est_nodes_new (p4est, ghost);
+  check_nodes_sort (p4est, ghost, nodes, 1);
+#ifdef SC_ENABLE_OPENMP
+  check_nodes_sort (p4est, ghost, nodes, 0);
+  check_nodes_sort (p4est, ghost, nodes, 3);
+#else
+  P4EST_GLOBAL_INFO ("Skipping the threaded nodes sort without OpenMP\n");
+#endif
   p4est_nodes_destroy (nodes);
   p4est_ghost_destroy (ghost);
 
@@ -28,12 +28,93 @@
 #include <p8est_wrap.h>
 #endif
 
+static void
+check_mesh_equal (p4est_mesh_t * mesh, p4est_mesh_t * ref)
+{
+  int                 f, c, h;
+  p4est_locidx_t      jl, lq, offset, v, w;
+  p4est_locidx_t      cstart, cend, rstart, rend;
+  p4est_locidx_t     *halfs, *rhalfs;
+
+  lq = ref->local_num_quadrants;
+  SC_CHECK_ABORT (mesh->local_num_quadrants == lq, "Mesh local count");
+  SC_CHECK_ABORT (mesh->ghost_num_quadrants == ref->ghost_num_quadrants,
+                  "Mesh ghost count");
+  offset = lq + ref->ghost_num_quadrants;
+
+  for (jl = 0; jl < lq; ++jl) {
+    SC_CHECK_ABORT (mesh->quad_to_tree[jl] == ref->quad_to_tree[jl],
+                    "Mesh tree");
+    for (f = 0; f < P4EST_FACES; ++f) {
+      v = mesh->quad_to_quad[P4EST_FACES * jl + f];
+      w = ref->quad_to_quad[P4EST_FACES * jl + f];
+      SC_CHECK_ABORT (mesh->quad_to_face[P4EST_FACES * jl + f] ==
+                      ref->quad_to_face[P4EST_FACES * jl + f], "Mesh face");
+      if (ref->quad_to_face[P4EST_FACES * jl + f] >= 0) {
+        SC_CHECK_ABORT (v == w, "Mesh face neighbor");
+        continue;
+      }
+      halfs = (p4est_locidx_t *) sc_array_index (mesh->quad_to_half, v);
+      rhalfs = (p4est_locidx_t *) sc_array_index (ref->quad_to_half, w);
+      for (h = 0; h < P4EST_HALF; ++h) {
+        SC_CHECK_ABORT (halfs[h] == rhalfs[h], "Mesh half neighbor");
+      }
+    }
+    for (c = 0; c < P4EST_CHILDREN; ++c) {
+      v = mesh->quad_to_corner[P4EST_CHILDREN * jl + c];
+      w = ref->quad_to_corner[P4EST_CHILDREN * jl + c];
+      SC_CHECK_ABORT ((v < offset) == (w < offset), "Mesh corner type");
+      if (w < offset) {
+        SC_CHECK_ABORT (v == w, "Mesh corner neighbor");
+        continue;
+      }
+      cstart = *(p4est_locidx_t *) sc_array_index (mesh->corner_offset,
+                                                   v - offset);
+      cend = *(p4est_locidx_t *) sc_array_index (mesh->corner_offset,
+                                                 v - offset + 1);
+      rstart = *(p4est_locidx_t *) sc_array_index (ref->corner_offset,
+                                                   w - offset);
+      rend = *(p4est_locidx_t *) sc_array_index (ref->corner_offset,
+                                                 w - offset + 1);
+      SC_CHECK_ABORT (cend - cstart == rend - rstart, "Mesh corner count");
+      for (; cstart < cend; ++cstart, ++rstart) {
+        SC_CHECK_ABORT (*(p4est_locidx_t *)
+                        sc_array_index (mesh->corner_quad, cstart) ==
+                        *(p4est_locidx_t *)
+                        sc_array_index (ref->corner_quad, rstart),
+                        "Mesh corner quadrant");
+        SC_CHECK_ABORT (*(int8_t *)
+                        sc_array_index (mesh->corner_corner, cstart) ==
+                        *(int8_t *)
+                        sc_array_index (ref->corner_corner, rstart),
+                        "Mesh corner corner");
+      }
+    }
+  }
+  for (h = 0; h <= P4EST_QMAXLEVEL; ++h) {
+    SC_CHECK_ABORT (sc_array_is_equal (mesh->quad_level + h,
+                                       ref->quad_level + h), "Mesh levels");
+  }
+}
+
+static void
+check_mesh_update (p4est_wrap_t * wrap)
+{
+  p4est_mesh_t       *ref;
+
+  /* the incrementally updated mesh must match a newly created one */
+  ref = p4est_mesh_new_ext (wrap->p4est, wrap->ghost_aux, 1, 1, wrap->btype);
+  check_mesh_equal (wrap->mesh_aux, ref);
+  p4est_mesh_destroy (ref);
+}
+
 static int
 wrap_adapt_partition (p4est_wrap_t * wrap, int weight_exponent)
 {
   p4est_locidx_t      uf, ul;
 
   if (p4est_wrap_adapt (wrap)) {
+    check_mesh_update (wrap);
     if (p4est_wrap_partition (wrap, weight_exponent, &uf, &ul, NULL)) {
 
       SC_CHECK_ABORT (uf >= 0 && ul >= 0, "Invalid post window");